@@ -0,0 +1,98 @@
+/**
+ * MIDI BytePulse - Clock Distribution Bus
+ *
+ * Every accepted clock tick enters here once, with the timestamp it was
+ * received at, and goes to the enabled outputs in a fixed order:
+ * SYNC OUT edge, DIN OUT byte, USB packet. Outputs follow the routing
+ * matrix for the tick's source port, so a tick is never echoed back to the
+ * port it came from unless a thru rule asks for it. How long each output
+ * took after the tick was released is recorded in Stats.
+ *
+ * With a groove template set, ticks are released later through the
+ * Scheduler: each 16th step has an offset (1/128 of a 16th) and the ticks
+ * in between are warped linearly, so the clock stays monotonic.
+ *
+ * Each output also has a signed latency offset in microseconds. Positive
+ * offsets delay that output; negative offsets send it ahead of the tick,
+ * scheduled from the previous tick and the measured tick period.
+ *
+ * Song Position Pointers take the same route as transport and reach DIN
+ * OUT ahead of the Continue that resumes from them.
+ */
+
+#ifndef CLOCK_BUS_H
+#define CLOCK_BUS_H
+
+#include <Arduino.h>
+#include "Sync.h"
+
+#define CLOCK_PULSE_WIDTH_US  5000     // SYNC OUT default, see Settings
+#define CLOCK_DIN_BYTE_US     320      // one byte on the wire at 31250 baud
+#define CLOCK_PERIOD_MAX_US   250000   // slower than 10 BPM counts as stopped
+#define CLOCK_TICKS_PER_STEP  6        // 24 PPQN clock, 16th note steps
+#define GROOVE_MAX_STEPS      16
+
+enum ClockOutput {
+  CLOCK_OUTPUT_SYNC = 0,
+  CLOCK_OUTPUT_DIN,
+  CLOCK_OUTPUT_USB,
+  CLOCK_OUTPUT_COUNT
+};
+
+// Index into Stats::counters.clockSkewLastUs / clockSkewMaxUs
+enum ClockSkew {
+  CLOCK_SKEW_INPUT = 0,   // tick timestamp -> release into the bus (immediate ticks only)
+  CLOCK_SKEW_SYNC_OUT,    // release -> SYNC OUT edge
+  CLOCK_SKEW_DIN,         // release -> DIN byte on the wire (estimated from the TX backlog)
+  CLOCK_SKEW_USB,         // release -> USB packet handed to the endpoint
+  CLOCK_SKEW_COUNT
+};
+
+class ClockBus {
+public:
+  static void begin();
+  static void tick(ClockSource source, unsigned long timestampUs);
+  static void transport(ClockSource source, byte status);
+  static void songPosition(ClockSource source, uint16_t position);
+  static void resetPosition();
+  static void sourceLost();
+  static void locate(uint32_t ticks);
+  static void update();
+  static bool setGroove(uint8_t steps, const uint8_t* offsets);
+  static void setOutputOffset(uint8_t output, int16_t offsetUs);
+  static bool isPending() { return pendingDIN || pendingUSB; }
+
+private:
+  enum Output {
+    OUTPUT_SYNC = 1 << CLOCK_OUTPUT_SYNC,
+    OUTPUT_DIN  = 1 << CLOCK_OUTPUT_DIN,
+    OUTPUT_USB  = 1 << CLOCK_OUTPUT_USB
+  };
+
+  static uint8_t outputsFor(ClockSource source, byte status);
+  static void countForwards(ClockSource source, uint8_t outputs);
+  static unsigned long grooveDelay(uint8_t position);
+  static void dispatch(uint8_t outputs, unsigned long dueUs, uint8_t& immediate);
+  static void cancelPending();
+  static void release(uint8_t outputs);
+  static void releaseScheduled(uint8_t outputs);
+  static void endPulse(uint8_t unused);
+  static void recordSkew(uint8_t index, unsigned long elapsedUs);
+  static bool isSyncOutConnected();
+
+  static volatile uint8_t* syncOutPort;
+  static uint8_t syncOutMask;
+  static volatile uint8_t pendingDIN;
+  static volatile uint8_t pendingUSB;
+  static volatile unsigned long pendingSinceUs;
+
+  static unsigned long lastTickUs;
+  static unsigned long periodUs;
+  static uint8_t grooveSteps;
+  static uint8_t grooveOffsets[GROOVE_MAX_STEPS];
+  static uint8_t grooveTick;
+  static int16_t outputOffsetUs[CLOCK_OUTPUT_COUNT];
+  static uint8_t predictedOutputs;   // outputs whose next tick is already scheduled
+};
+
+#endif  // CLOCK_BUS_H
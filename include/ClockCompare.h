@@ -0,0 +1,68 @@
+/**
+ * MIDI BytePulse - Clock Source Comparison
+ *
+ * Measurement mode that timestamps the ticks of every clock source, also the
+ * ones Sync ignores, and compares each against the reference (the
+ * highest-priority source present: SYNC IN, then USB, then DIN). Drift is
+ * the tempo difference over the whole measurement in 0.1 ppm, phase the
+ * smoothed time from the nearest reference tick. Results are read over SysEx.
+ */
+
+#ifndef CLOCK_COMPARE_H
+#define CLOCK_COMPARE_H
+
+#include <Arduino.h>
+#include "Sync.h"
+#include "config.h"
+
+#define COMPARE_TIMEOUT_US    1000000UL    // a source silent this long starts over
+#define COMPARE_MAX_SPAN_US   0x40000000UL // ~18 min, keeps the drift products in 64 bits
+#define COMPARE_DRIFT_LIMIT   100000L      // 1 %, reported when tempos differ further
+
+// Wire layout of the result dump, little-endian, packed
+struct CompareSourceResult {
+  uint32_t intervals;   // 24 PPQN tick intervals measured
+  int32_t driftDeciPpm; // tempo relative to the reference, 0.1 ppm, + = faster
+  int32_t phaseUs;      // from the nearest reference tick, + = later
+};
+
+struct CompareResult {
+  uint8_t reference;            // ClockSource, CLOCK_SOURCE_NONE if nothing ticks
+  uint8_t reserved[3];          // keeps the layout free of padding on any compiler
+  CompareSourceResult sources[3];  // SYNC IN, DIN, USB
+};
+
+class ClockCompare {
+public:
+  static void setEnabled(bool enable);
+  static bool isEnabled() { return enabled; }
+
+  // One clock tick (SYNC IN: one pulse worth `ticks` 24 PPQN ticks)
+  static inline void tick(ClockSource source, unsigned long timestampUs, uint8_t ticks = 1) {
+    #if CLOCK_ANALYSIS_ENABLED
+    if (enabled) record(source, timestampUs, ticks);
+    #endif
+  }
+
+  static uint8_t snapshot(uint8_t* buffer);
+
+private:
+  struct Track {
+    unsigned long firstUs;
+    unsigned long lastUs;
+    uint32_t intervals;
+    int32_t phaseUs;     // smoothed, 1/8 per tick
+    bool active;
+    bool phaseValid;
+  };
+
+  static bool enabled;
+  static Track tracks[3];
+  static ClockSource lastReference;
+
+  static void record(ClockSource source, unsigned long timestampUs, uint8_t ticks);
+  static ClockSource reference(unsigned long nowUs);
+  static bool isPresent(uint8_t index, unsigned long nowUs);
+};
+
+#endif  // CLOCK_COMPARE_H
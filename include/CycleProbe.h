@@ -0,0 +1,49 @@
+/**
+ * MIDI BytePulse - Cycle Probes
+ *
+ * With CYCLE_PROBES set, instrumented functions write their probe id to
+ * GPIOR0 on entry (bit 7 set) and again on exit. Each write is a single
+ * OUT instruction, which the simavr bench (tools/bench) timestamps in CPU
+ * cycles. Without the flag the probes compile to nothing.
+ */
+
+#ifndef CYCLE_PROBE_H
+#define CYCLE_PROBE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+enum ProbeId {
+  PROBE_LOOP = 1,
+  PROBE_SYNC_HANDLE_CLOCK,
+  PROBE_SYNC_UPDATE,
+  PROBE_FORWARD_USB_TO_DIN,
+  PROBE_SYNC_IN_ISR
+};
+
+#define PROBE_ENTRY  0x80
+
+#if CYCLE_PROBES
+
+class CycleProbe {
+public:
+  explicit CycleProbe(uint8_t id) : id(id) { GPIOR0 = id | PROBE_ENTRY; }
+  ~CycleProbe() { GPIOR0 = id; }
+
+private:
+  uint8_t id;
+};
+
+#define CYCLE_PROBE(id) CycleProbe cycleProbe(id)
+
+// The bench has no USB host: it places one USB-MIDI packet here at a time,
+// flag byte first, and processUSBMIDI() takes it when the endpoint is empty
+extern volatile uint8_t benchUSBMailbox[5];
+
+#else
+
+#define CYCLE_PROBE(id)
+
+#endif
+
+#endif  // CYCLE_PROBE_H
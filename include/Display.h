@@ -1,9 +1,44 @@
+/**
+ * MIDI BytePulse - Display
+ *
+ * The TM1637 is driven through a small compositor. Each layer holds four
+ * digit patterns; the highest active layer is what gets shown:
+ *   base     - splash, idle and play animation (always active; beat dot
+ *              only without DISPLAY_ANIMATIONS_ENABLED)
+ *   meter    - throughput meter, toggled by a double press (THROUGHPUT_METER_ENABLED)
+ *   message  - transient text such as StOP or note numbers (500 ms)
+ *   overlay  - BPM / IdLE while the button is held
+ * The composed frame is compared with what the module already holds and
+ * only changed digits go out on the bus, one digit per write slot.
+ *
+ * Meter pages, stepped by single presses: load of DIN IN, DIN OUT and USB
+ * as a percentage of 31250 baud (dot after the port letter), each followed
+ * by its messages per second (thousands shown with a decimal point). The
+ * port letter blinks while its held load is at METER_OVERLOAD_PERCENT.
+ */
+
 #ifndef DISPLAY_H
 #define DISPLAY_H
 
 #include <Arduino.h>
 #include <AceTMI.h>
-#include <AceSegment.h>
+#include "config.h"
+
+#define DISPLAY_DIGITS             4
+#define DISPLAY_BRIGHTNESS         2      // 0-7
+#define DISPLAY_MESSAGE_MS         500
+#define DISPLAY_WRITE_INTERVAL_MS  10     // one digit write takes ~4 ms on the bus
+#define DISPLAY_DOUBLE_PRESS_MS    400
+#define DISPLAY_METER_PAGES        6
+#define DISPLAY_BLINK_MS           125
+
+enum DisplayLayer {
+  DISPLAY_LAYER_BASE = 0,
+  DISPLAY_LAYER_METER,
+  DISPLAY_LAYER_MESSAGE,
+  DISPLAY_LAYER_OVERLAY,
+  DISPLAY_LAYER_COUNT
+};
 
 class Display {
 public:
@@ -19,24 +54,51 @@ public:
   void showBPM();
   void showIdle();
   void setButtonPressed(bool pressed);
+  bool isMeterShown() const { return activeLayers & (1 << DISPLAY_LAYER_METER); }
+
+  static uint8_t glyph(char c);
 
 private:
   ace_tmi::SimpleTmi1637Interface* tmiInterface = nullptr;
-  ace_segment::Tm1637Module<ace_tmi::SimpleTmi1637Interface, 4>* ledModule = nullptr;
+  uint8_t layers[DISPLAY_LAYER_COUNT][DISPLAY_DIGITS];
+  uint8_t activeLayers = 0;
+  uint8_t frame[DISPLAY_DIGITS];   // composed, waiting to go out
+  uint8_t shown[DISPLAY_DIGITS];   // what the module currently holds
+  bool frameDirty = false;
+  uint8_t scanDigit = 0;
+  unsigned long lastWriteTime = 0;
+  unsigned long messageTime = 0;
   uint16_t currentBPM = 0;
-  unsigned long lastFlushTime = 0;
   bool isIdle = false;
   bool isPlaying = false;
   unsigned long lastIdleAnimTime = 0;
   uint8_t idleAnimFrame = 0;
-  unsigned long midiMessageTime = 0;
-  bool showingMIDIMessage = false;
   bool animationNeedsUpdate = false;
   uint8_t currentBeat = 0;
   bool buttonPressed = false;
-  
-  void initializeHardware();
-  uint8_t charToSegment(char c);
+  #if DISPLAY_ANIMATIONS_ENABLED
+  bool splashActive = false;
+  unsigned long splashStartTime = 0;
+  uint8_t splashFrame = 0;
+  #endif
+  unsigned long releaseTime = 0;
+  bool doublePressArmed = false;
+  uint8_t meterPage = 0;
+  uint8_t meterStep = 0;          // ThroughputMeter::steps() the layer shows
+  uint8_t meterBlink = 0;
+  bool meterDirty = false;
+
+  #if DISPLAY_ANIMATIONS_ENABLED
+  bool updateSplash(unsigned long now);
+  #endif
+  void updateBase(unsigned long now);
+  void updateMeter(unsigned long now);
+  void setLayerText(DisplayLayer layer, const char* text);
+  void showLayer(DisplayLayer layer);
+  void hideLayer(DisplayLayer layer);
+  void compose();
+  void writeCommand(uint8_t command);
+  void writeDigit(uint8_t digit, uint8_t pattern);
 };
 
 #endif
@@ -0,0 +1,91 @@
+/**
+ * MIDI BytePulse - Event Trace
+ *
+ * A fixed ring of the last EVENT_TRACE_SIZE transport and fault events,
+ * each stamped with micros(): Start / Continue / Stop and whether they were
+ * followed, source switches, clock timeouts, full buffers and drops. Logging is
+ * a short critical section and never blocks, so Sync, the merge engine and
+ * interrupt handlers all log straight in.
+ *
+ * The ring is read over SysEx after the fact (GET_TRACE): logging pauses
+ * while the dump streams, the records are put in order oldest first in
+ * place, and events arriving meanwhile are only counted.
+ */
+
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define EVENT_TRACE_SIZE  32     // records, power of two
+
+enum EventType {
+  EVENT_START = 1,        // value: 1 = followed, 0 = ignored
+  EVENT_CONTINUE,         // value: as Start
+  EVENT_STOP,             // value: as Start
+  EVENT_SONG_POSITION,    // value: position in 16ths
+  EVENT_SOURCE,           // source: the new active source, value: the previous one
+  EVENT_TIMEOUT,          // value: ms since the last tick
+  EVENT_UNPLUGGED,        // SYNC IN cable pulled while playing
+  EVENT_SYNC_IN_EDGE,     // first SYNC IN pulse while stopped (interrupt)
+  EVENT_MTC_HOLD,         // value: 1 = clock went quiet (interrupt), 0 = Stop
+  EVENT_RX_FULL,          // DIN RX buffer full, value: times in a row
+  EVENT_MERGE_DROP,       // source: MergeSource (NONE: realtime ring), value: drops in a row
+  EVENT_SCHEDULER_DROP    // value: drops in a row
+};
+
+// Wire layout of one record, little-endian, packed
+struct EventRecord {
+  uint32_t timeUs;
+  uint8_t type;           // EventType
+  uint8_t source;         // ClockSource unless noted
+  uint16_t value;
+};
+
+// Wire layout of the trace dump, little-endian, packed
+struct EventTraceDump {
+  uint32_t nowUs;         // micros() when the dump was taken
+  uint16_t logged;        // events since the trace was last cleared, saturating
+  uint8_t count;          // records that follow, oldest first
+  uint8_t lost;           // events that arrived during the previous dump
+  EventRecord records[EVENT_TRACE_SIZE];
+};
+
+class EventTrace {
+public:
+  static inline void log(uint8_t type, uint8_t source, uint16_t value = 0) {
+    #if EVENT_TRACE_ENABLED
+    record(micros(), type, source, value, false);
+    #endif
+  }
+
+  static inline void logAt(unsigned long timeUs, uint8_t type, uint8_t source, uint16_t value = 0) {
+    #if EVENT_TRACE_ENABLED
+    record(timeUs, type, source, value, false);
+    #endif
+  }
+
+  // A fault repeating back to back counts up in its newest record, so a
+  // flood of drops does not push everything else out of the ring
+  static inline void repeat(uint8_t type, uint8_t source) {
+    #if EVENT_TRACE_ENABLED
+    record(micros(), type, source, 1, true);
+    #endif
+  }
+
+  // Pauses logging and returns the dump, valid until resume()
+  static const uint8_t* freeze(uint16_t& length);
+  static void resume(bool clear);
+
+private:
+  static EventTraceDump dump;
+  static uint8_t head;
+  static volatile bool frozen;
+  static uint8_t lostWhileFrozen;
+
+  static void record(unsigned long timeUs, uint8_t type, uint8_t source, uint16_t value, bool repeats);
+  static void reverse(uint8_t first, uint8_t last);
+};
+
+#endif  // EVENT_TRACE_H
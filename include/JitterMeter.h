@@ -0,0 +1,73 @@
+/**
+ * MIDI BytePulse - Clock Jitter Analyzer
+ *
+ * Interval statistics of the active clock source, updated per tick in O(1)
+ * with adds and shifts (a division only for gaps and SYNC IN pulses worth
+ * several ticks): count, sums of the deviation from the
+ * first interval and of its square, min/max, and a histogram of deviations
+ * from the running average interval. Ticks far off the average are counted
+ * as missing (gap) or extra instead. Mean and standard deviation are worked
+ * out when the results are read over SysEx.
+ */
+
+#ifndef JITTER_METER_H
+#define JITTER_METER_H
+
+#include <Arduino.h>
+#include "Sync.h"
+#include "config.h"
+
+#define JITTER_BINS          16
+#define JITTER_BIN_SHIFT     7       // 128 us per bin, +-1024 us across the histogram
+#define JITTER_MAX_COUNT     0xFFFF  // intervals summed before the statistics freeze
+
+// Wire layout of the result dump, little-endian, packed
+struct JitterResult {
+  uint8_t source;        // ClockSource being measured
+  uint8_t reserved[3];
+  uint32_t count;        // intervals in the statistics
+  uint32_t meanNs;       // mean interval per 24 PPQN tick
+  uint32_t stdDevNs;
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint16_t missing;      // ticks a gap left out
+  uint16_t extra;        // ticks arriving at under half the interval
+  uint16_t histogram[JITTER_BINS];  // deviation from the running average, bin 8 = [0, 128) us
+};
+
+class JitterMeter {
+public:
+  static void setEnabled(bool enable);
+
+  // The active source changed (CLOCK_SOURCE_NONE: stopped)
+  static void follow(ClockSource source);
+
+  // One accepted tick of the active source (SYNC IN: one pulse worth `ticks`)
+  static inline void tick(unsigned long timestampUs, uint8_t ticks = 1) {
+    #if CLOCK_ANALYSIS_ENABLED
+    if (enabled) record(timestampUs, ticks);
+    #endif
+  }
+
+  static uint8_t snapshot(uint8_t* buffer);
+
+private:
+  static bool enabled;
+  static ClockSource source;
+  static unsigned long lastUs;
+  static unsigned long expectedUs;  // running average, same 3/4 filter as Sync
+  static unsigned long baseUs;      // first interval, origin of the sums
+  static uint16_t count;
+  static int32_t sum;
+  static uint64_t sumSquares;
+  static unsigned long minUs;
+  static unsigned long maxUs;
+  static uint16_t missing;
+  static uint16_t extra;
+  static uint16_t histogram[JITTER_BINS];
+
+  static void clear();
+  static void record(unsigned long timestampUs, uint8_t ticks);
+};
+
+#endif  // JITTER_METER_H
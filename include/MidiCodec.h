@@ -0,0 +1,137 @@
+/**
+ * MIDI BytePulse - MIDI 1.0 Byte Codec
+ *
+ * Parses the DIN byte stream (running status, realtime bytes anywhere,
+ * SysEx) and hands each message to a handler policy class. Dispatch is
+ * resolved at compile time, so there are no callback pointers, and SysEx is
+ * passed on in chunks of a size set by the template parameter instead of
+ * being held whole.
+ *
+ * The handler provides:
+ *   static void channelMessage(byte status, byte data1, byte data2);
+ *   static void systemCommon(byte status, byte data1, byte data2);
+ *   static void realtime(byte status);
+ *   static void sysEx(const byte* data, uint8_t length, bool last);
+ *   static void error();
+ */
+
+#ifndef MIDI_CODEC_H
+#define MIDI_CODEC_H
+
+#include <Arduino.h>
+
+class MidiCodec {
+public:
+  // Data bytes that follow a status byte (SysEx and single-byte messages: 0)
+  static inline uint8_t dataLength(byte status) {
+    if (status < 0xF0) return ((status & 0xE0) == 0xC0) ? 1 : 2;
+    if (status == 0xF1 || status == 0xF3) return 1;
+    if (status == 0xF2) return 2;
+    return 0;
+  }
+};
+
+template <class Handler, uint8_t SysExChunk>
+class MidiParser {
+public:
+  static void reset() {
+    status = 0;
+    received = 0;
+    sysExLength = 0;
+    inSysEx = false;
+  }
+
+  static inline void parse(byte data) {
+    if (data >= 0xF8) {
+      // Realtime cuts into anything without disturbing it
+      if (data != 0xF9 && data != 0xFD) Handler::realtime(data);
+    } else if (data & 0x80) {
+      parseStatus(data);
+    } else if (inSysEx) {
+      appendSysEx(data);
+    } else {
+      parseData(data);
+    }
+  }
+
+private:
+  static byte status;       // status the next data bytes belong to (0: none)
+  static byte data1;
+  static uint8_t received;  // data bytes of the current message so far
+  static bool inSysEx;
+  static uint8_t sysExLength;
+  static byte sysExBuffer[SysExChunk];
+
+  static void appendSysEx(byte data) {
+    sysExBuffer[sysExLength++] = data;
+    if (sysExLength == SysExChunk) {
+      Handler::sysEx(sysExBuffer, sysExLength, false);
+      sysExLength = 0;
+    }
+  }
+
+  static void endSysEx() {
+    // Room for the F7 is guaranteed: a full buffer is always passed on at once
+    sysExBuffer[sysExLength++] = 0xF7;
+    Handler::sysEx(sysExBuffer, sysExLength, true);
+    sysExLength = 0;
+    inSysEx = false;
+  }
+
+  static void parseStatus(byte data) {
+    if (inSysEx) {
+      endSysEx();
+      if (data == 0xF7) return;
+      Handler::error();  // SysEx cut short by another status byte
+    } else if (received) {
+      Handler::error();  // previous message incomplete
+    }
+    received = 0;
+
+    if (data == 0xF0) {
+      status = 0;
+      inSysEx = true;
+      appendSysEx(data);
+    } else if (data < 0xF0 || data == 0xF1 || data == 0xF2 || data == 0xF3) {
+      status = data;
+    } else {
+      // Tune Request, stray F7 and undefined F4/F5 also cancel running status
+      status = 0;
+      if (data == 0xF6) Handler::systemCommon(data, 0, 0);
+      else if (data == 0xF7) Handler::error();
+    }
+  }
+
+  static void parseData(byte data) {
+    if (!status) {
+      Handler::error();  // data byte without a status
+      return;
+    }
+
+    if (received == 0 && MidiCodec::dataLength(status) == 2) {
+      data1 = data;
+      received = 1;
+      return;
+    }
+
+    byte first = received ? data1 : data;
+    byte second = received ? data : 0;
+    received = 0;
+
+    if (status < 0xF0) {
+      Handler::channelMessage(status, first, second);
+    } else {
+      Handler::systemCommon(status, first, second);
+      status = 0;  // no running status for system common messages
+    }
+  }
+};
+
+template <class Handler, uint8_t SysExChunk> byte MidiParser<Handler, SysExChunk>::status = 0;
+template <class Handler, uint8_t SysExChunk> byte MidiParser<Handler, SysExChunk>::data1 = 0;
+template <class Handler, uint8_t SysExChunk> uint8_t MidiParser<Handler, SysExChunk>::received = 0;
+template <class Handler, uint8_t SysExChunk> bool MidiParser<Handler, SysExChunk>::inSysEx = false;
+template <class Handler, uint8_t SysExChunk> uint8_t MidiParser<Handler, SysExChunk>::sysExLength = 0;
+template <class Handler, uint8_t SysExChunk> byte MidiParser<Handler, SysExChunk>::sysExBuffer[SysExChunk];
+
+#endif  // MIDI_CODEC_H
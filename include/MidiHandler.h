@@ -6,7 +6,8 @@
 #define MIDI_HANDLER_H
 
 #include <Arduino.h>
-#include <MIDIUSB.h>
+#include "UsbMidi.h"
+#include "config.h"
 
 class Sync;
 class Display;
@@ -19,28 +20,36 @@ public:
   void setDisplay(Display* d);
   static void flushBuffer();
   static void forwardUSBtoDIN(const midiEventPacket_t& event);
+  // False when the USB endpoint had no room; nothing was sent then
+  static bool sendMessage(const midiEventPacket_t& event, unsigned long timestampUs);
+  
+  // Stamped now; the time only matters to the UMP interface
+  static inline bool sendMessage(const midiEventPacket_t& event) {
+    return sendMessage(event, MIDI_UMP_ENABLED ? micros() : 0);
+  }
 
 private:
   static Sync* sync;
   static Display* display;
+  static unsigned long rxTimeUs;  // when the DIN byte being parsed arrived
+  
+  // SysEx chunk bytes the USB endpoint has not taken yet. They still sit in
+  // the parser's buffer, which is left alone by not parsing until they are out.
+  static const byte* usbSysEx;
+  static uint8_t usbSysExLength;
+  static bool usbSysExLast;
   
-  static void sendMessage(const midiEventPacket_t& event);
-  static void forwardDINtoUSB(byte channel, byte type, byte data1, byte data2);
+  static bool sendSysExToUSB();
+  static void forwardFromDIN(byte status, byte data1, byte data2);
+  static void forwardRealtimeFromDIN(byte type);
   
-  static void handleNoteOn(byte channel, byte note, byte velocity);
-  static void handleNoteOff(byte channel, byte note, byte velocity);
-  static void handleAfterTouchPoly(byte channel, byte note, byte pressure);
-  static void handleControlChange(byte channel, byte controller, byte value);
-  static void handleProgramChange(byte channel, byte program);
-  static void handleAfterTouchChannel(byte channel, byte pressure);
-  static void handlePitchBend(byte channel, int bend);
-  static void handleSystemExclusive(byte* data, unsigned size);
-  static void handleClock();
-  static void handleStart();
-  static void handleContinue();
-  static void handleStop();
-  static void handleActiveSensing();
-  static void handleSystemReset();
+  // Handler policy for the DIN parser (see MidiCodec.h)
+  template <class Handler, uint8_t SysExChunk> friend class MidiParser;
+  static void channelMessage(byte status, byte data1, byte data2);
+  static void systemCommon(byte status, byte data1, byte data2);
+  static void realtime(byte status);
+  static void sysEx(const byte* data, uint8_t length, bool last);
+  static void error();
 };
 
 #endif  // MIDI_HANDLER_H
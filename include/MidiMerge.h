@@ -0,0 +1,102 @@
+/**
+ * MIDI BytePulse - DIN OUT Merge Engine
+ *
+ * Every byte for DIN OUT goes through here. Each source has its own queue and
+ * SysEx state; messages are queued and written whole (never with running
+ * status), sources are served round-robin one message at a time, and realtime
+ * bytes cut in ahead of everything. A SysEx holds the output for its source
+ * until F7 so it is never split by another source's message.
+ *
+ * The local source carries messages the device makes itself (MIDI Time
+ * Code). sendCommon() puts a system common message in a slot of its own
+ * instead, so a Song Position Pointer goes out ahead of the queues and
+ * before the Continue and clock that follow it. It waits out a SysEx on the
+ * wire; the realtime bytes behind it do not.
+ *
+ * Messages are written whole from loop() with interrupts off per byte, so an
+ * idle UART is always between messages: the clock bus and MTC write straight
+ * to it from their interrupts then.
+ */
+
+#ifndef MIDI_MERGE_H
+#define MIDI_MERGE_H
+
+#include <Arduino.h>
+
+#define MERGE_DIN_QUEUE_SIZE    128   // room for two SysEx chunks from the DIN parser
+#define MERGE_USB_QUEUE_SIZE    64    // USB SysEx arrives in 3-byte fragments
+#define MERGE_LOCAL_QUEUE_SIZE  16    // one MTC full frame plus a few quarter frames
+#define MERGE_REALTIME_SIZE     8
+#define MERGE_TX_LIMIT          12    // max bytes waiting in the Serial1 TX buffer
+#define MERGE_SYSEX_TIMEOUT_MS  100   // release a SysEx lock whose source went quiet
+
+enum MergeSource {
+  MERGE_SOURCE_DIN = 0,
+  MERGE_SOURCE_USB = 1,
+  MERGE_SOURCE_LOCAL = 2,
+  MERGE_SOURCE_COUNT,
+  MERGE_SOURCE_NONE = 0xFF
+};
+
+class MidiMerge {
+public:
+  static void begin();
+  static void update();
+
+  static bool send(uint8_t source, byte status, byte data1, byte data2);
+  static bool sendSysEx(uint8_t source, const byte* data, uint16_t length);
+  static bool sendSysExChunk(uint8_t source, const byte* data, uint8_t length);
+  static void sendRealtime(byte status);
+  static void sendCommon(byte status, byte data1, byte data2);
+  static uint8_t freeSpace(uint8_t source);
+  static uint8_t txBacklog();
+  static bool isIdle();
+  static bool realtimePending() { return realtimeHead != realtimeTail || commonLength > 0; }
+  // A message from the source may be written around the queues: none of its
+  // own is waiting and no SysEx is open on the wire
+  static bool mayCutIn(uint8_t source) {
+    return lockedSource == MERGE_SOURCE_NONE && queues[source].head == queues[source].tail && !realtimePending();
+  }
+
+  static inline uint8_t messageLength(byte status) {
+    if (status < 0xF0) return ((status & 0xE0) == 0xC0) ? 2 : 3;
+    if (status == 0xF1 || status == 0xF3) return 2;
+    if (status == 0xF2) return 3;
+    return 1;
+  }
+
+private:
+  struct Queue {
+    byte* buffer;
+    uint8_t mask;
+    uint8_t head;
+    uint8_t tail;
+    bool inSysEx;        // producer side: SysEx started but no F7 yet
+    bool dropSysEx;      // producer side: rest of this SysEx is discarded
+    unsigned long lastWrite;
+  };
+
+  static Queue queues[MERGE_SOURCE_COUNT];
+  static byte dinBuffer[MERGE_DIN_QUEUE_SIZE];
+  static byte usbBuffer[MERGE_USB_QUEUE_SIZE];
+  static byte localBuffer[MERGE_LOCAL_QUEUE_SIZE];
+  static byte realtime[MERGE_REALTIME_SIZE];
+  static uint8_t realtimeHead;
+  static uint8_t realtimeTail;
+  static byte common[3];
+  static uint8_t commonLength;     // 0: slot empty
+  static uint8_t lockedSource;
+  static uint8_t nextSource;
+  static bool txStalled;           // counted once until a queued byte goes out again
+
+  static uint8_t txFree();
+  static uint8_t used(const Queue& q) { return (q.head - q.tail) & q.mask; }
+  static void transmit(byte data);
+  static void push(Queue& q, byte data);
+  static void closeSysEx(uint8_t source);
+  static bool drainSysEx(uint8_t source);
+  static bool flushCommon();
+  static void stall();
+};
+
+#endif  // MIDI_MERGE_H
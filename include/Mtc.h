@@ -0,0 +1,102 @@
+/**
+ * MIDI BytePulse - MIDI Time Code Generator
+ *
+ * Turns the clock the bus is following into MTC on DIN OUT and the USB
+ * Clock port. Song time runs from the first tick after a locate and holds
+ * when the ticks stop, so MTC follows Start, Stop and Continue of whatever
+ * drives the clock. Quarter frames (F1) are released by the Timer1
+ * scheduler at their exact due time, with a sub-microsecond remainder
+ * carried between frames so 24 and 29.97 fps do not drift. Every locate
+ * sends a full-frame SysEx first; a Song Position Pointer locates to the
+ * position at the last measured tempo, or once the clock has one.
+ *
+ * On an idle DIN line the interrupt writes the quarter frame to the UART
+ * itself; otherwise loop() hands it to the DIN OUT merge. loop() always
+ * sends the USB packet, stamped with the due time.
+ */
+
+#ifndef MTC_H
+#define MTC_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define MTC_PENDING_SIZE  4    // quarter frames waiting for loop(), power of two
+
+// Frame rates as set over SysEx; the MTC rate code is one less
+enum MtcRate {
+  MTC_RATE_OFF = 0,
+  MTC_RATE_24,
+  MTC_RATE_25,
+  MTC_RATE_2997_DROP,
+  MTC_RATE_30,
+  MTC_RATE_COUNT
+};
+
+struct MtcTime {
+  uint8_t hours;
+  uint8_t minutes;
+  uint8_t seconds;
+  uint8_t frames;
+};
+
+class Mtc {
+public:
+  static void begin();
+  static bool setRate(uint8_t rate);
+  static void locate(uint64_t positionUs);
+  static void locateTicks(uint32_t ticks);
+  static void tick(unsigned long timestampUs);
+  static void hold();
+  static void update();
+  static bool isPending() {
+    #if MTC_ENABLED
+    return pendingHead != pendingTail;
+    #else
+    return false;
+    #endif
+  }
+
+  static void frameToTime(uint8_t rate, uint32_t frame, MtcTime& time);
+  static void advanceTwoFrames(uint8_t rate, MtcTime& time);
+  static uint8_t quarterFrame(uint8_t rate, const MtcTime& time, uint8_t piece);
+
+private:
+  struct Pending {
+    uint8_t data;
+    bool dinSent;                   // already written to the UART by release()
+    unsigned long dueUs;
+  };
+
+  static void seek(uint64_t positionUs);
+  static void release(uint8_t unused);
+  static bool writeDIN(uint8_t data);
+  static void holdAt(unsigned long dueUs);
+  static void sendFullFrame();
+  static bool sendFullFrameToUSB();
+
+  static uint8_t rate;
+  static volatile bool running;
+  static MtcTime time;              // time of the current 8-piece block
+  static volatile uint8_t piece;
+  static unsigned long nextDueUs;
+  static uint32_t fraction;         // of a microsecond, in 1 / stepDivisor
+  static unsigned long stepUs;
+  static uint32_t stepRemainder;
+  static uint32_t stepDivisor;
+  static long resumeOffsetUs;       // next quarter frame from the first tick after a hold
+  static volatile unsigned long lastTickUs;
+  static volatile unsigned long periodUs;
+  static bool locateDeferred;       // a locate in ticks waits for the clock period
+  static uint32_t deferredTicks;
+
+  static byte fullFrame[10];
+  static uint8_t fullFrameSent;     // bytes of it the USB endpoint has taken
+
+  static Pending pending[MTC_PENDING_SIZE];
+  static volatile uint8_t pendingHead;
+  static volatile uint8_t pendingTail;
+  static volatile uint8_t pendingDIN;      // of them, waiting for the merge
+};
+
+#endif  // MTC_H
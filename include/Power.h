@@ -0,0 +1,46 @@
+/**
+ * MIDI BytePulse - Idle Sleep and CPU Duty Cycle
+ *
+ * At the end of a loop pass that left nothing queued, the MCU enters idle
+ * sleep. Idle mode keeps every clock running, so UART RX/TX, USB, the SYNC IN
+ * edge, the Timer1 scheduler and the 1.024 ms Timer0 tick all wake it; the
+ * tick bounds how long anything polled (button, timeouts, display) waits.
+ * USB OUT packets raise no interrupt here, so after each one the loop keeps
+ * polling for POWER_USB_HOLD_MS and USB input never waits on a tick.
+ *
+ * Time not spent asleep is busy time, summed over one-second windows into
+ * Stats as a permille duty cycle, alongside the longest sleep and the
+ * SYNC IN edge to loop wake latency.
+ */
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <Arduino.h>
+
+#define POWER_WINDOW_US     1000000UL
+#define POWER_USB_HOLD_MS   100
+
+class Power {
+public:
+  static void begin();
+  static void idle(bool workPending);
+
+  static inline void keepAwake() { lastActivityMs = millis(); }
+
+  // From interrupt handlers the firmware owns, to time the wake-up
+  static inline void wakeEvent() {
+    if (sleeping) wakeEventUs = micros();
+  }
+
+private:
+  static volatile bool sleeping;
+  static volatile unsigned long wakeEventUs;
+  static unsigned long lastActivityMs;
+  static unsigned long windowStartUs;
+  static unsigned long windowSleptUs;
+
+  static void account(unsigned long nowUs);
+};
+
+#endif  // POWER_H
@@ -0,0 +1,62 @@
+/**
+ * MIDI BytePulse - Routing / Filter Matrix
+ *
+ * Configuration is one rule per (source, destination) port pair: a mask of
+ * allowed message types and a mask of allowed channels. compile() folds the
+ * rules into per-source lookup tables so the hot path decides every message
+ * with two table reads.
+ */
+
+#ifndef ROUTING_H
+#define ROUTING_H
+
+#include <Arduino.h>
+
+enum MidiPort {
+  PORT_DIN = 0,
+  PORT_USB = 1,
+  PORT_COUNT
+};
+
+#define ROUTE_TO_DIN  (1 << PORT_DIN)
+#define ROUTE_TO_USB  (1 << PORT_USB)
+
+// Type index: 0-6 channel messages 0x8n-0xEn, 7-22 system messages 0xF0-0xFF
+#define ROUTE_TYPE_COUNT       23
+#define ROUTE_TYPE_BIT(status) (1UL << Routing::typeIndex(status))
+#define ROUTE_TYPES_CHANNEL    0x0000007FUL
+#define ROUTE_TYPES_SYSTEM     0x007FFF80UL
+#define ROUTE_TYPES_TRANSPORT  0x000E8200UL   // song position, clock, start, continue, stop
+#define ROUTE_TYPES_ALL        0x007FFFFFUL
+#define ROUTE_CHANNELS_ALL     0xFFFF
+
+struct RouteRule {
+  uint32_t typeMask;
+  uint16_t channelMask;
+};
+
+class Routing {
+public:
+  static void begin();
+  static void setRule(uint8_t source, uint8_t destination, uint32_t typeMask, uint16_t channelMask);
+  static uint8_t getRules(uint8_t* buffer);
+  static void compile();
+
+  static inline uint8_t typeIndex(byte status) {
+    return (status < 0xF0) ? (status >> 4) - 8 : (status & 0x0F) + 7;
+  }
+
+  // Destination mask (ROUTE_TO_*) for a message with this status byte
+  static inline uint8_t destinations(uint8_t source, byte status) {
+    uint8_t mask = typeRoutes[source][typeIndex(status)];
+    if (status < 0xF0) mask &= channelRoutes[source][status & 0x0F];
+    return mask;
+  }
+
+private:
+  static RouteRule rules[PORT_COUNT][PORT_COUNT];
+  static uint8_t typeRoutes[PORT_COUNT][ROUTE_TYPE_COUNT];
+  static uint8_t channelRoutes[PORT_COUNT][16];
+};
+
+#endif  // ROUTING_H
@@ -0,0 +1,45 @@
+/**
+ * MIDI BytePulse - Scheduled Output Queue
+ *
+ * Runs callbacks at an absolute micros() time from the Timer1 compare A
+ * interrupt, so delayed output lands within a few microseconds of its due
+ * time instead of waiting for the next loop pass. Timer1 free-runs at
+ * 0.5 us per count; events further out than one compare window are reached
+ * by re-arming the compare until they are due.
+ *
+ * Callbacks run in interrupt context: keep them to port writes, UDR1 writes
+ * and setting flags for loop().
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+#define SCHEDULER_QUEUE_SIZE   16
+#define SCHEDULER_WINDOW_US    30000   // longest single compare wait
+#define SCHEDULER_EARLY_US     4       // fire when this close (micros() resolution)
+
+typedef void (*ScheduledCallback)(uint8_t arg);
+
+class Scheduler {
+public:
+  static void begin();
+  static bool at(unsigned long dueUs, ScheduledCallback callback, uint8_t arg);
+  static void cancel(ScheduledCallback callback);
+  static void service();  // called from the compare interrupt
+
+private:
+  struct Event {
+    unsigned long dueUs;
+    ScheduledCallback callback;
+    uint8_t arg;
+  };
+
+  static void arm();
+
+  static Event queue[SCHEDULER_QUEUE_SIZE];
+  static volatile uint8_t count;
+};
+
+#endif  // SCHEDULER_H
@@ -0,0 +1,79 @@
+/**
+ * MIDI BytePulse - Persistent Settings
+ *
+ * Everything remote configuration can change lives in one packed record,
+ * read directly from RAM by the modules that use it. The record is kept in
+ * EEPROM as an append log: each save goes to the next slot with a higher
+ * sequence number and a CRC, so cells wear evenly and a save cut short by
+ * a power loss leaves the previous record in charge. At boot only the slot
+ * headers are scanned and the newest record is CRC-checked; anything that
+ * fails falls back to the compile-time defaults.
+ *
+ * Changes are batched: a save starts SETTINGS_SAVE_DELAY_MS after the last
+ * change and update() hands the EEPROM one byte whenever it is ready, so
+ * the loop never waits the 3.4 ms a byte takes to program.
+ */
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <Arduino.h>
+#include "Routing.h"
+
+#define SETTINGS_VERSION        1
+#define SETTINGS_SLOT_SIZE      64
+#define SETTINGS_SLOT_COUNT     16      // 1 KB of EEPROM
+#define SETTINGS_SAVE_DELAY_MS  2000
+
+#define SETTINGS_PULSE_MIN_US   500     // SYNC OUT pulse, must end before the next tick at 300 BPM
+#define SETTINGS_PULSE_MAX_US   8000
+#define SETTINGS_TIMEOUT_MIN    2
+#define SETTINGS_TIMEOUT_MAX    48
+
+// Wire layout of the settings record and dump, little-endian, packed
+struct SettingsData {
+  uint8_t syncInPPQN;           // SYNC IN pulses per quarter note
+  uint8_t timeoutPeriods;       // USB / SYNC IN clock stops after this many missing periods
+  uint16_t syncPulseWidthUs;    // SYNC OUT pulse width
+  int16_t outputOffsetUs[3];    // clock bus latency offsets, indexed by ClockOutput
+  uint8_t grooveSteps;          // 0 = straight
+  uint8_t grooveOffsets[16];    // 1/128 of a 16th per step
+  uint8_t mtcRate;              // MTC frame rate (MtcRate), 0 = off
+  uint32_t routeTypes[PORT_COUNT][PORT_COUNT];      // routing rules, [source][destination]
+  uint16_t routeChannels[PORT_COUNT][PORT_COUNT];
+};
+
+// One EEPROM slot; an erased slot reads version 0xFF
+struct SettingsRecord {
+  uint8_t version;
+  uint8_t reserved;
+  uint16_t sequence;            // the newest record wins, compared with wraparound
+  SettingsData data;
+  uint16_t crc;                 // CRC-16/CCITT of everything before it
+  uint8_t unused[2];            // rounds the record to a multiple of 4 bytes
+};
+
+class Settings {
+public:
+  static SettingsData data;
+
+  static void load();
+  static void reset();
+  static void changed();
+  static void update();
+  static bool isSaving() { return savePos < sizeof(SettingsRecord); }
+
+private:
+  static SettingsRecord staged;    // the record being written, safe from later changes
+  static uint8_t slot;             // where the newest record is
+  static uint16_t sequence;        // its sequence number
+  static uint8_t savePos;
+  static bool dirty;
+  static unsigned long changedMs;
+
+  static void defaults();
+  static uint16_t crc(const uint8_t* bytes, uint8_t length);
+  static bool readSlot(uint8_t index, SettingsRecord& record);
+};
+
+#endif  // SETTINGS_H
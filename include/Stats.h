@@ -0,0 +1,60 @@
+/**
+ * MIDI BytePulse - Pipeline Counters
+ * Always-on saturating counters, dumped over SysEx (see SysExHandler)
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <Arduino.h>
+
+// Wire layout of the counter dump: little-endian, packed, in this order.
+// 32-bit members come first so no host compiler pads it either.
+struct StatsCounters {
+  uint32_t dinToUSB;          // messages forwarded DIN IN -> USB
+  uint32_t usbToDIN;          // messages forwarded USB -> DIN OUT
+  uint32_t realtime;          // realtime messages received (DIN + USB)
+  uint32_t clockTicks[4];     // clock ticks received, indexed by ClockSource
+  uint32_t bootReadyUs;       // power-on to end of setup(), kept across resets
+  uint32_t firstForwardUs;    // power-on to first forwarded message, kept across resets
+  uint32_t dinToDIN;          // messages forwarded DIN IN -> DIN OUT (thru)
+  uint16_t rxBufferFull;      // Serial1 RX buffer found full: DIN bytes lost
+  uint16_t txStalls;          // times DIN OUT backed up: TX buffer full until a queued byte went out
+  uint16_t usbSendFailures;   // UsbMidi::sendMIDI() did not accept the packet
+  uint16_t parserErrors;      // DIN parser errors
+  uint16_t sourceSwitches;    // active clock source changes in Sync
+  uint16_t mergeDrops;        // messages dropped by the DIN OUT merge (queue full)
+  uint16_t clockSkewLastUs[4];  // clock bus timings of the last tick, indexed by ClockSkew
+  uint16_t clockSkewMaxUs[4];   // worst case of the same since the last reset
+  uint16_t schedulerDrops;    // events refused by the full Scheduler queue
+  uint16_t busyPermille;      // CPU time not spent asleep over the last full second, 1/1000
+  uint16_t busyPeakPermille;  // busiest second since the last reset
+  uint16_t sleepMaxUs;        // longest single idle sleep
+  uint16_t wakeLatencyMaxUs;  // SYNC IN edge during sleep -> loop running again
+  uint16_t settingsLoadUs;    // boot: settings found and checked in EEPROM, kept across resets
+};
+
+static_assert(sizeof(StatsCounters) == 80, "StatsCounters is sent as is: no padding");
+
+class Stats {
+public:
+  static StatsCounters counters;
+
+  static void reset();
+  static uint8_t snapshot(uint8_t* buffer);
+
+  static inline void count(uint32_t& counter) {
+    if (counter != 0xFFFFFFFFUL) counter++;
+  }
+
+  static inline void count(uint16_t& counter) {
+    if (counter != 0xFFFF) counter++;
+  }
+
+  static inline void countForward(uint32_t& counter) {
+    count(counter);
+    if (counters.firstForwardUs == 0) counters.firstForwardUs = micros();
+  }
+};
+
+#endif  // STATS_H
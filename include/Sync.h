@@ -17,12 +17,15 @@ public:
   void begin();
   void handleClock(ClockSource source);
   void handleStart(ClockSource source);
+  void handleContinue(ClockSource source);
   void handleStop(ClockSource source);
+  void handleSongPosition(ClockSource source, uint16_t position);
   void handleSyncInPulse();
   void update();
   bool isBeatActive() const { return ledState; }
   bool isClockRunning() const { return isPlaying; }
   uint16_t getCurrentBPM() const { return currentBPM; }
+  bool setSyncInPPQN(byte ppqn);
   
   void (*onBPMUpdate)(uint16_t bpm) = nullptr;
   void (*onClockStop)() = nullptr;
@@ -31,10 +34,13 @@ public:
   void setDisplay(Display* disp) { display = disp; }
 
 private:
+  void startPlayback(ClockSource source, byte status);
+  void handleSyncInTick(unsigned long timestampUs);
   void checkUSBTimeout();
-  bool isSyncOutConnected();
+  void setActiveSource(ClockSource source);
+  void setPhase(uint32_t ticks);
+  bool acceptsTransport(ClockSource source) const;
   bool isSyncInConnected();
-  void sendMIDIClock();
   
   unsigned long lastPulseTime = 0;
   unsigned long lastUSBClockTime = 0;
@@ -46,8 +52,11 @@ private:
   unsigned long lastSyncInTime = 0;
   unsigned long prevSyncInTime = 0;
   unsigned long avgSyncInInterval = 0;
-  volatile unsigned long syncInPulseTime = 0;
-  bool clockState = false;
+  volatile unsigned long syncInPulseTime = 0;  // micros() of the last SYNC IN edge
+  byte syncInPPQN = 24;
+  byte interpolateRemaining = 0;  // ticks still to generate before the next pulse
+  unsigned long interpolateNextUs = 0;
+  unsigned long interpolateStepUs = 0;
   bool ledState = false;
   byte ppqnCounter = 0;
   bool isPlaying = false;
@@ -59,6 +68,11 @@ private:
   uint16_t currentBPM = 0;
   uint16_t lastDisplayedBPM = 0;
   
+  // Song position in 24 PPQN ticks: per source, and what the outputs were last sent
+  uint32_t songTicks[4] = {0, 0, 0, 0};
+  uint32_t outputTicks = 0;
+  byte stoppedSources = 0;   // bit per ClockSource: Stop seen, ticks not counted
+  
   Display* display = nullptr;
 };
 
@@ -0,0 +1,81 @@
+/**
+ * MIDI BytePulse - SysEx Remote Queries
+ *
+ * Requests arrive on USB:  F0 7D 42 <cmd> [args] F7
+ * Replies go back on USB:  F0 7D 42 <cmd | 0x40> <7-bit packed payload> F7
+ * Payload packing: every 7 raw bytes are preceded by one byte holding their MSBs.
+ */
+
+#ifndef SYSEX_HANDLER_H
+#define SYSEX_HANDLER_H
+
+#include <Arduino.h>
+#include "UsbMidi.h"
+#include "Stats.h"
+
+class Sync;
+
+#define SYSEX_RX_BUFFER_SIZE     32
+// Raw payload of the largest dump; packing and framing are added as it streams
+#define SYSEX_REPLY_BUFFER_SIZE  sizeof(StatsCounters)
+#define SYSEX_PACKETS_PER_PASS   2
+
+enum SysExCommand {
+  SYSEX_CMD_GET_COUNTERS   = 0x01,
+  SYSEX_CMD_RESET_COUNTERS = 0x02,
+  SYSEX_CMD_SET_ROUTE      = 0x03,
+  SYSEX_CMD_GET_ROUTES     = 0x04,
+  SYSEX_CMD_SET_TRANSFORM  = 0x05,
+  SYSEX_CMD_SET_GROOVE     = 0x06,
+  SYSEX_CMD_SET_OFFSET     = 0x07,
+  SYSEX_CMD_SET_SYNC_PPQN  = 0x08,
+  SYSEX_CMD_SET_COMPARE    = 0x09,
+  SYSEX_CMD_GET_COMPARE    = 0x0A,
+  SYSEX_CMD_SET_JITTER     = 0x0B,
+  SYSEX_CMD_GET_JITTER     = 0x0C,
+  SYSEX_CMD_SET_TIMING     = 0x0D,
+  SYSEX_CMD_GET_SETTINGS   = 0x0E,
+  SYSEX_CMD_RESET_SETTINGS = 0x0F,
+  SYSEX_CMD_SET_MTC        = 0x10,
+  SYSEX_CMD_GET_TRACE      = 0x11
+};
+
+class SysExHandler {
+public:
+  void begin();
+  void handleUSBPacket(const midiEventPacket_t& event);
+  void update();
+  bool isReplying() const { return txStage != TX_IDLE || txPacket.header != 0; }
+  void setSync(Sync* s) { sync = s; }
+
+private:
+  enum TxStage { TX_IDLE, TX_HEADER, TX_PAYLOAD, TX_END };
+
+  void receiveByte(byte data);
+  void dispatch();
+  void startReply(byte command, const uint8_t* data, uint16_t length);
+  int16_t nextReplyByte();
+  uint32_t readSeptets(uint8_t offset, uint8_t count);
+  void applySettings();
+
+  uint8_t rxBuffer[SYSEX_RX_BUFFER_SIZE];
+  uint8_t rxLength = 0;
+  bool rxActive = false;
+  bool rxOverflow = false;
+
+  uint8_t replyBuffer[SYSEX_REPLY_BUFFER_SIZE];
+  const uint8_t* txData = nullptr;
+  uint16_t txLength = 0;
+  uint16_t txPos = 0;
+  uint8_t txHeaderPos = 0;
+  byte txCommand = 0;
+  bool txMsbPending = false;
+  bool txTrace = false;          // the event trace resumes when the reply ends
+  bool traceClear = false;
+  TxStage txStage = TX_IDLE;
+  midiEventPacket_t txPacket = {0, 0, 0, 0};  // built but not yet taken by USB (header 0: none)
+
+  Sync* sync = nullptr;
+};
+
+#endif  // SYSEX_HANDLER_H
@@ -0,0 +1,94 @@
+/**
+ * MIDI BytePulse - Throughput Meter
+ *
+ * Messages and bytes per port are counted where they cross the device edge
+ * and summed over a one-second window that slides in 250 ms steps: counting
+ * is a single add, and readings are worked out once per step. Load is
+ * the byte rate as a share of 31250 baud (10 bits a byte); on USB the same
+ * scale tells how many DIN cables the traffic would fill. Readings hold
+ * their peak for METER_PEAK_HOLD_MS so a short flood stays visible.
+ */
+
+#ifndef THROUGHPUT_METER_H
+#define THROUGHPUT_METER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define METER_WINDOWS          4      // steps in the one-second window
+#define METER_STEP_MS          250
+#define METER_PEAK_HOLD_MS     2000
+#define METER_OVERLOAD_PERCENT 90     // readings from here on are flagged
+
+// MIDI bytes in a USB-MIDI packet, two bits per code index
+#define USB_PACKET_LENGTHS     0x7AFFE7E0UL
+
+enum MeterPort {
+  METER_DIN_IN = 0,
+  METER_DIN_OUT,
+  METER_USB,            // both directions
+  METER_PORT_COUNT
+};
+
+struct MeterReading {
+  uint16_t messagesPerSecond;
+  uint16_t loadPercent;
+};
+
+class ThroughputMeter {
+public:
+  static void begin();
+  static void update();
+
+  static inline void countMessage(uint8_t port) {
+    #if THROUGHPUT_METER_ENABLED
+    messages[port]++;
+    #endif
+  }
+
+  static inline void countBytes(uint8_t port, uint8_t count) {
+    #if THROUGHPUT_METER_ENABLED
+    bytes[port] += count;
+    #endif
+  }
+
+  // One USB-MIDI packet either way; SysEx counts as a message at its end
+  static inline void countPacket(uint8_t header) {
+    #if THROUGHPUT_METER_ENABLED
+    uint8_t cin = header & 0x0F;
+    bytes[METER_USB] += (USB_PACKET_LENGTHS >> (2 * cin)) & 0x03;
+    if (cin >= 0x02 && cin != 0x04) messages[METER_USB]++;
+    #endif
+  }
+
+  // One whole message written to the DIN OUT UART from an interrupt
+  static inline void countDirect(uint8_t count) {
+    #if THROUGHPUT_METER_ENABLED
+    directMessages++;
+    directBytes += count;
+    #endif
+  }
+
+  // Held peak readings, refreshed every METER_STEP_MS
+  static const MeterReading& reading(uint8_t port) { return held[port]; }
+  static bool overloaded(uint8_t port) { return held[port].loadPercent >= METER_OVERLOAD_PERCENT; }
+  static uint8_t steps() { return stepCount; }
+
+  static uint16_t loadPercent(uint32_t bytesPerSecond);
+
+private:
+  static uint16_t messages[METER_PORT_COUNT];
+  static uint16_t bytes[METER_PORT_COUNT];
+  static volatile uint8_t directMessages;
+  static volatile uint8_t directBytes;
+
+  static uint16_t messageSteps[METER_PORT_COUNT][METER_WINDOWS];
+  static uint16_t byteSteps[METER_PORT_COUNT][METER_WINDOWS];
+  static uint8_t step;
+  static uint8_t stepCount;       // bumped on each new reading
+  static unsigned long stepStartMs;
+  static MeterReading held[METER_PORT_COUNT];
+  static unsigned long heldMs[METER_PORT_COUNT];
+};
+
+#endif  // THROUGHPUT_METER_H
@@ -0,0 +1,79 @@
+/**
+ * MIDI BytePulse - Message Transform Stage
+ *
+ * Optional per-source-port rewrite applied before routing: channel remap,
+ * note transpose / range / split and velocity and CC curves. Everything is
+ * precomputed into 128-entry lookup tables so each message costs the same
+ * handful of cycles. Compiled in with MIDI_TRANSFORM_ENABLED (config.h).
+ */
+
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <Arduino.h>
+#include "Routing.h"
+
+#define TRANSFORM_NOTE_DROP   0x80
+#define TRANSFORM_SPLIT_OFF   0x7F
+#define TRANSFORM_CC_NONE     0x7F
+
+enum TransformCurve {
+  CURVE_LINEAR = 0,
+  CURVE_SOFT   = 1,
+  CURVE_HARD   = 2,
+  CURVE_COUNT
+};
+
+struct TransformSettings {
+  bool enabled;
+  int8_t transpose;
+  uint8_t noteLow;          // notes outside noteLow..noteHigh are dropped
+  uint8_t noteHigh;
+  uint8_t splitNote;        // incoming notes >= splitNote go to splitChannel
+  uint8_t splitChannel;     // 0-15, TRANSFORM_SPLIT_OFF disables the split
+  uint8_t velocityCurve;    // TransformCurve, Note On velocities
+  uint8_t ccNumber;         // controller shaped by ccCurve, TRANSFORM_CC_NONE for none
+  uint8_t ccCurve;
+  uint8_t channelMap[16];
+};
+
+class Transform {
+public:
+  static void begin();
+  static void configure(uint8_t port, const TransformSettings& settings);
+
+  // Rewrites a channel message in place; returns false when it is dropped
+  static inline bool apply(uint8_t port, byte& status, byte& data1, byte& data2) {
+    if (!settings[port].enabled || status >= 0xF0) return true;
+
+    const TransformSettings& s = settings[port];
+    byte type = status & 0xF0;
+    byte channel = s.channelMap[status & 0x0F];
+
+    if (type <= 0xA0) {
+      byte note = noteMap[port][data1];
+      if (note & TRANSFORM_NOTE_DROP) return false;
+      if (data1 >= s.splitNote) channel = s.splitChannel;
+      data1 = note;
+      if (type == 0x90 && data2 != 0) data2 = curve(s.velocityCurve, data2);
+    } else if (type == 0xB0 && data1 == s.ccNumber) {
+      data2 = curve(s.ccCurve, data2);
+    }
+
+    status = type | channel;
+    return true;
+  }
+
+private:
+  static TransformSettings settings[PORT_COUNT];
+  static uint8_t noteMap[PORT_COUNT][128];
+
+  static inline byte curve(uint8_t index, byte value) {
+    if (index == CURVE_LINEAR || index >= CURVE_COUNT) return value;
+    return pgm_read_byte(&curveTables[index - 1][value & 0x7F]);
+  }
+
+  static const uint8_t curveTables[CURVE_COUNT - 1][128];
+};
+
+#endif  // TRANSFORM_H
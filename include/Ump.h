@@ -0,0 +1,119 @@
+/**
+ * MIDI BytePulse - Universal MIDI Packet Codec
+ *
+ * Translates USB-MIDI 1.0 event packets into UMP words for the optional
+ * USB MIDI 2.0 interface (see UmpUSB): channel voice as MIDI 1.0 Channel
+ * Voice (type 2), system and realtime as System messages (type 1) and SysEx
+ * as 64-bit Data messages (type 3, six bytes per packet). Jitter Reduction
+ * Clock / Timestamp utility messages count in 1/31250 s (32 us) ticks.
+ */
+
+#ifndef UMP_H
+#define UMP_H
+
+#include <Arduino.h>
+#include "MidiCodec.h"
+
+#define UMP_MAX_WORDS  4   // longest output of one USB-MIDI packet (SysEx end)
+
+#define UMP_SYSEX_COMPLETE  0x0
+#define UMP_SYSEX_START     0x1
+#define UMP_SYSEX_CONTINUE  0x2
+#define UMP_SYSEX_END       0x3
+
+// SysEx7 bytes waiting for a full six-byte packet
+struct UmpSysEx {
+  uint8_t data[6];
+  uint8_t count;
+  bool open;       // F0 seen, F7 not yet
+  bool started;    // a Start packet went out for this message
+};
+
+class Ump {
+public:
+  static inline uint16_t jrTicks(unsigned long us) { return (uint16_t)(us >> 5); }
+  static inline uint32_t jrClock(uint16_t ticks) { return 0x00100000UL | ticks; }
+  static inline uint32_t jrTimestamp(uint16_t ticks) { return 0x00200000UL | ticks; }
+
+  static inline uint8_t messageType(uint32_t word) { return word >> 28; }
+
+  // Encodes one USB-MIDI 1.0 packet; returns the number of words written
+  static uint8_t fromPacket(uint8_t group, uint8_t cin, const uint8_t* bytes,
+                            UmpSysEx& sysEx, uint32_t* words) {
+    cin &= 0x0F;
+
+    if (cin >= 0x08 && cin <= 0x0E) {
+      words[0] = message(0x2, group, bytes[0], bytes[1], bytes[2]);
+      return 1;
+    }
+
+    uint8_t length;
+    if (cin == 0x04) length = 3;
+    else if (cin >= 0x05 && cin <= 0x07) length = cin - 0x04;
+    else if (cin == 0x02 || cin == 0x03) length = cin;
+    else if (cin == 0x0F) length = 1;
+    else return 0;
+
+    // CIN 4, 6 and 7 are always SysEx; 5 and F only while one is open
+    bool inSysEx = sysEx.open || bytes[0] == 0xF0 || cin == 0x04 || cin == 0x06 || cin == 0x07;
+    if (!inSysEx || (cin == 0x0F && bytes[0] >= 0xF8)) {
+      if (bytes[0] < 0xF1 || bytes[0] == 0xF7) return 0;
+      words[0] = message(0x1, group, bytes[0], length > 1 ? bytes[1] : 0, length > 2 ? bytes[2] : 0);
+      return 1;
+    }
+
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < length; i++) {
+      uint8_t data = bytes[i];
+      if (data == 0xF0) {
+        sysEx.open = true;
+        sysEx.started = false;
+        sysEx.count = 0;
+      } else if (data == 0xF7) {
+        if (sysEx.open) count += sysExPacket(group, sysEx, true, words + count);
+        sysEx.open = false;
+      } else if (sysEx.open) {
+        if (sysEx.count == 6) count += sysExPacket(group, sysEx, false, words + count);
+        sysEx.data[sysEx.count++] = data;
+      }
+    }
+    return count;
+  }
+
+  // Decodes a type 1 or 2 packet back to MIDI 1.0 bytes; returns the length
+  static uint8_t toBytes(uint32_t word, uint8_t* bytes) {
+    uint8_t type = messageType(word);
+    if (type != 0x1 && type != 0x2) return 0;
+
+    bytes[0] = word >> 16;
+    bytes[1] = (word >> 8) & 0x7F;
+    bytes[2] = word & 0x7F;
+
+    return MidiCodec::dataLength(bytes[0]) + 1;
+  }
+
+private:
+  static inline uint32_t message(uint8_t type, uint8_t group, uint8_t status, uint8_t data1, uint8_t data2) {
+    return ((uint32_t)type << 28) | ((uint32_t)(group & 0x0F) << 24) |
+           ((uint32_t)status << 16) | ((uint16_t)data1 << 8) | data2;
+  }
+
+  static uint8_t sysExPacket(uint8_t group, UmpSysEx& sysEx, bool last, uint32_t* words) {
+    uint8_t status;
+    if (last) status = sysEx.started ? UMP_SYSEX_END : UMP_SYSEX_COMPLETE;
+    else status = sysEx.started ? UMP_SYSEX_CONTINUE : UMP_SYSEX_START;
+
+    uint8_t b[6] = {0, 0, 0, 0, 0, 0};
+    for (uint8_t i = 0; i < sysEx.count; i++) b[i] = sysEx.data[i];
+
+    words[0] = ((uint32_t)0x3 << 28) | ((uint32_t)(group & 0x0F) << 24) |
+               ((uint32_t)status << 20) | ((uint32_t)sysEx.count << 16) | ((uint16_t)b[0] << 8) | b[1];
+    words[1] = ((uint32_t)b[2] << 24) | ((uint32_t)b[3] << 16) | ((uint16_t)b[4] << 8) | b[5];
+
+    sysEx.started = true;
+    sysEx.count = 0;
+    return 2;
+  }
+};
+
+#endif  // UMP_H
@@ -0,0 +1,38 @@
+/**
+ * MIDI BytePulse - USB MIDI 2.0 (UMP) Endpoint
+ *
+ * Optional second USB MIDI interface, compiled in with MIDI_UMP_ENABLED
+ * (config.h). Alternate setting 1 of its MIDI Streaming interface carries
+ * Universal MIDI Packets on a bulk IN endpoint: everything sent to the USB
+ * MIDI 1.0 interface (UsbMidi.h) is mirrored here as MIDI 1.0 protocol UMP,
+ * each cable on the group of the same number and each message preceded by a
+ * JR Timestamp of when the device received (or released) it, so a host can
+ * undo USB frame scheduling. A JR Clock goes out whenever nothing else has
+ * for UMP_JR_CLOCK_MS.
+ *
+ * Device to host only: MIDI 1.0 hosts keep using the USB MIDI 1.0 interface.
+ */
+
+#ifndef UMP_USB_H
+#define UMP_USB_H
+
+#include <Arduino.h>
+#include "UsbMidi.h"
+#include "Ump.h"
+
+#define UMP_JR_CLOCK_MS  200
+
+class UmpUSB {
+public:
+  static void update();
+  static void send(const midiEventPacket_t& event, unsigned long timestampUs);
+  static void flush();
+
+private:
+  static UmpSysEx sysEx[USB_MIDI_CABLES];  // SysEx may interleave across groups
+  static unsigned long lastSendMs;
+
+  static bool write(const uint32_t* words, uint8_t count);
+};
+
+#endif  // UMP_USB_H
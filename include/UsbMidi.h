@@ -0,0 +1,48 @@
+/**
+ * MIDI BytePulse - USB MIDI Interface
+ *
+ * The USB MIDI 1.0 function, in place of the MIDIUSB library whose
+ * descriptor declares a single cable. USB_MIDI_CABLES (config.h) embedded
+ * jack pairs share one bulk endpoint pair and show up on the host as
+ * separate ports; the cable number in each packet header is the routing key:
+ *   DIN      to DIN OUT as the routing matrix allows, DIN IN comes back here
+ *   Clock    clock and transport from the clock bus only
+ *   Control  SysEx remote queries and their replies
+ * With one cable all three are cable 0. Host clock is accepted on any cable.
+ */
+
+#ifndef USB_MIDI_H
+#define USB_MIDI_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define USB_CABLE_DIN      0
+#if USB_MIDI_CABLES > 1
+#define USB_CABLE_CLOCK    1
+#define USB_CABLE_CONTROL  2
+#else
+#define USB_CABLE_CLOCK    0
+#define USB_CABLE_CONTROL  0
+#endif
+
+// Packet header: cable number in the high nibble, code index in the low one
+#define USB_MIDI_HEADER(cable, cin)  (uint8_t)(((cable) << 4) | (cin))
+
+typedef struct {
+  uint8_t header;
+  uint8_t byte1;
+  uint8_t byte2;
+  uint8_t byte3;
+} midiEventPacket_t;
+
+class UsbMidi {
+public:
+  static midiEventPacket_t read();
+  static size_t sendMIDI(const midiEventPacket_t& event);
+  static void flush();
+
+  static inline uint8_t cable(const midiEventPacket_t& event) { return event.header >> 4; }
+};
+
+#endif  // USB_MIDI_H
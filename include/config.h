@@ -20,6 +20,10 @@
 #define SYNC_IN_PIN           7
 #define SYNC_IN_DETECT_PIN    6
 
+// Pulses per quarter note on SYNC IN (1, 2, 3, 4, 6, 8, 12 or 24); missing
+// MIDI clock ticks are interpolated from the pulse period
+#define SYNC_IN_PPQN          24
+
 // LED
 #define LED_BEAT_PIN       10
 
@@ -30,8 +34,65 @@
 // Push Button
 #define BUTTON_PIN         16
 
+// SysEx remote queries (USB)
+#define SYSEX_MANUFACTURER_ID  0x7D   // non-commercial / educational ID
+#define SYSEX_DEVICE_ID        0x42
+
+// USB MIDI ports: 1 = one port for everything, 3 = DIN, Clock and Control
+#define USB_MIDI_CABLES        3
+
+// Build variants, picked per PlatformIO environment with -DBUILD_VARIANT
+//   VARIANT_CLOCK         clock, transport and thru only: no SysEx, MTC, meter or animations
+//   VARIANT_BRIDGE        the full MIDI interface ([env:sparkfun_promicro16])
+//   VARIANT_INSTRUMENTED  the bridge plus the event trace and the clock analyzers
+#define VARIANT_CLOCK         1
+#define VARIANT_BRIDGE        2
+#define VARIANT_INSTRUMENTED  3
+
+#ifndef BUILD_VARIANT
+#define BUILD_VARIANT  VARIANT_BRIDGE
+#endif
+
+#define VARIANT_HAS_BRIDGE    (BUILD_VARIANT >= VARIANT_BRIDGE)
+#define VARIANT_HAS_ANALYSIS  (BUILD_VARIANT >= VARIANT_INSTRUMENTED)
+
+// Optional features: the variant decides, a -D build flag overrides
+#ifndef MIDI_TRANSFORM_ENABLED
+#define MIDI_TRANSFORM_ENABLED  false   // channel remap / transpose / curves, ~300 bytes SRAM
+#endif
+#ifndef IDLE_SLEEP_ENABLED
+#define IDLE_SLEEP_ENABLED      VARIANT_HAS_BRIDGE    // idle sleep when a loop pass leaves nothing queued
+#endif
+#ifndef MIDI_UMP_ENABLED
+#define MIDI_UMP_ENABLED        false   // USB MIDI 2.0 (UMP) interface with JR Timestamps, one more USB endpoint
+#endif
+#ifndef SYSEX_ENABLED
+#define SYSEX_ENABLED           VARIANT_HAS_BRIDGE    // remote queries and settings on the USB Control cable, ~130 bytes SRAM
+#endif
+#ifndef MTC_ENABLED
+#define MTC_ENABLED             VARIANT_HAS_BRIDGE    // MIDI Time Code from the clock bus
+#endif
+#ifndef DISPLAY_ANIMATIONS_ENABLED
+#define DISPLAY_ANIMATIONS_ENABLED  VARIANT_HAS_BRIDGE  // splash, idle and play animations; off: beat dot only
+#endif
+#ifndef THROUGHPUT_METER_ENABLED
+#define THROUGHPUT_METER_ENABLED  VARIANT_HAS_BRIDGE  // messages/s and load per port on the display, ~80 bytes SRAM
+#endif
+#ifndef CLOCK_ANALYSIS_ENABLED
+#define CLOCK_ANALYSIS_ENABLED  VARIANT_HAS_ANALYSIS  // clock source comparison and jitter analyzer, read over SysEx
+#endif
+#ifndef EVENT_TRACE_ENABLED
+#define EVENT_TRACE_ENABLED     VARIANT_HAS_ANALYSIS  // ring of the last 32 transport / fault events for SysEx dumps, ~270 bytes SRAM
+#endif
+
+#if (CLOCK_ANALYSIS_ENABLED || EVENT_TRACE_ENABLED || MIDI_TRANSFORM_ENABLED) && !SYSEX_ENABLED
+#error "the clock analyzers, the event trace and the transform stage are set up and read over SysEx"
+#endif
+
 // Debug
+#ifndef SERIAL_DEBUG
 #define SERIAL_DEBUG        false
+#endif
 #define DEBUG_BAUD_RATE    115200
 
 #if SERIAL_DEBUG
@@ -0,0 +1,358 @@
+/**
+ * MIDI BytePulse - Clock Distribution Bus Implementation
+ */
+
+#include "ClockBus.h"
+#include "MidiHandler.h"
+#include "MidiMerge.h"
+#include "Mtc.h"
+#include "Routing.h"
+#include "Scheduler.h"
+#include "Stats.h"
+#include "Settings.h"
+#include "ThroughputMeter.h"
+#include "config.h"
+#include "UsbMidi.h"
+
+volatile uint8_t* ClockBus::syncOutPort = nullptr;
+uint8_t ClockBus::syncOutMask = 0;
+volatile uint8_t ClockBus::pendingDIN = 0;
+volatile uint8_t ClockBus::pendingUSB = 0;
+volatile unsigned long ClockBus::pendingSinceUs = 0;
+unsigned long ClockBus::lastTickUs = 0;
+unsigned long ClockBus::periodUs = 0;
+uint8_t ClockBus::grooveSteps = 0;
+uint8_t ClockBus::grooveOffsets[GROOVE_MAX_STEPS];
+uint8_t ClockBus::grooveTick = 0;
+int16_t ClockBus::outputOffsetUs[CLOCK_OUTPUT_COUNT];
+uint8_t ClockBus::predictedOutputs = 0;
+
+void ClockBus::begin() {
+  pinMode(SYNC_OUT_PIN, OUTPUT);
+  pinMode(SYNC_OUT_DETECT_PIN, INPUT_PULLUP);
+  digitalWrite(SYNC_OUT_PIN, LOW);
+  
+  // Direct port access so edges can be driven from the scheduler interrupt
+  syncOutPort = portOutputRegister(digitalPinToPort(SYNC_OUT_PIN));
+  syncOutMask = digitalPinToBitMask(SYNC_OUT_PIN);
+  
+  pendingDIN = 0;
+  pendingUSB = 0;
+  lastTickUs = 0;
+  periodUs = 0;
+  grooveSteps = 0;
+  grooveTick = 0;
+  predictedOutputs = 0;
+  setGroove(Settings::data.grooveSteps, Settings::data.grooveOffsets);
+  for (uint8_t i = 0; i < CLOCK_OUTPUT_COUNT; i++) {
+    outputOffsetUs[i] = 0;
+    setOutputOffset(i, Settings::data.outputOffsetUs[i]);
+  }
+}
+
+uint8_t ClockBus::outputsFor(ClockSource source, byte status) {
+  uint8_t routes = 0;
+  switch (source) {
+    case CLOCK_SOURCE_DIN: routes = Routing::destinations(PORT_DIN, status); break;
+    case CLOCK_SOURCE_USB: routes = Routing::destinations(PORT_USB, status); break;
+    case CLOCK_SOURCE_SYNC_IN: routes = ROUTE_TO_DIN | ROUTE_TO_USB; break;
+    default: break;
+  }
+  
+  uint8_t outputs = 0;
+  if (routes & ROUTE_TO_DIN) outputs |= OUTPUT_DIN;
+  if (routes & ROUTE_TO_USB) outputs |= OUTPUT_USB;
+  return outputs;
+}
+
+void ClockBus::countForwards(ClockSource source, uint8_t outputs) {
+  if (source == CLOCK_SOURCE_DIN) {
+    if (outputs & OUTPUT_USB) Stats::countForward(Stats::counters.dinToUSB);
+    if (outputs & OUTPUT_DIN) Stats::countForward(Stats::counters.dinToDIN);
+  } else if (source == CLOCK_SOURCE_USB && (outputs & OUTPUT_DIN)) {
+    Stats::countForward(Stats::counters.usbToDIN);
+  }
+}
+
+void ClockBus::tick(ClockSource source, unsigned long timestampUs) {
+  unsigned long entryUs = micros();
+  uint8_t outputs = outputsFor(source, 0xF8);
+  if (isSyncOutConnected()) outputs |= OUTPUT_SYNC;
+  
+  unsigned long interval = timestampUs - lastTickUs;
+  if (lastTickUs != 0 && interval < CLOCK_PERIOD_MAX_US) {
+    periodUs = (periodUs == 0) ? interval : (periodUs * 3 + interval) / 4;
+  }
+  lastTickUs = timestampUs;
+  
+  countForwards(source, outputs);
+  recordSkew(CLOCK_SKEW_INPUT, entryUs - timestampUs);
+  #if MTC_ENABLED
+  Mtc::tick(timestampUs);
+  #endif
+  
+  unsigned long delayUs = grooveDelay(grooveTick);
+  if (grooveSteps > 0 && ++grooveTick >= grooveSteps * CLOCK_TICKS_PER_STEP) grooveTick = 0;
+  unsigned long nextDelayUs = grooveDelay(grooveTick);
+  
+  uint8_t immediate = 0;
+  for (uint8_t i = 0; i < CLOCK_OUTPUT_COUNT; i++) {
+    uint8_t output = 1 << i;
+    if (!(outputs & output)) continue;
+    
+    // This tick was already sent from the prediction, unless there was none
+    // (first ticks after a start or a tempo stall). A prediction made before
+    // the offset turned positive still stands for this one tick.
+    int16_t offsetUs = outputOffsetUs[i];
+    if (offsetUs >= 0) {
+      if (predictedOutputs & output) {
+        predictedOutputs &= ~output;
+      } else {
+        dispatch(output, timestampUs + delayUs + offsetUs, immediate);
+      }
+      continue;
+    }
+    
+    if (!(predictedOutputs & output)) {
+      dispatch(output, timestampUs + delayUs, immediate);
+    }
+    if (periodUs != 0) {
+      // Never a whole period early: the prediction stays after this tick
+      unsigned long leadUs = (unsigned long)(-(long)offsetUs);
+      if (leadUs >= periodUs) leadUs = periodUs - 1;
+      dispatch(output, timestampUs + periodUs + nextDelayUs - leadUs, immediate);
+      predictedOutputs |= output;
+    } else {
+      predictedOutputs &= ~output;
+    }
+  }
+  
+  if (immediate) release(immediate);
+}
+
+void ClockBus::dispatch(uint8_t outputs, unsigned long dueUs, uint8_t& immediate) {
+  if ((long)(dueUs - micros()) > SCHEDULER_EARLY_US && Scheduler::at(dueUs, releaseScheduled, outputs)) {
+    return;
+  }
+  
+  // Due now, or the queue is full (late is better than missing). An output
+  // already due in this pass goes out first, so two ticks stay two.
+  uint8_t twice = immediate & outputs;
+  if (twice) {
+    release(twice);
+    immediate &= ~twice;
+  }
+  immediate |= outputs;
+}
+
+unsigned long ClockBus::grooveDelay(uint8_t position) {
+  if (grooveSteps == 0 || periodUs == 0) return 0;
+  
+  uint8_t step = position / CLOCK_TICKS_PER_STEP;
+  uint8_t phase = position % CLOCK_TICKS_PER_STEP;
+  uint8_t next = (step + 1 < grooveSteps) ? step + 1 : 0;
+  
+  // Offset of this tick in 1/128 ticks, interpolated between the step offsets
+  int16_t offset = grooveOffsets[step] * CLOCK_TICKS_PER_STEP
+                 + ((int16_t)grooveOffsets[next] - grooveOffsets[step]) * phase;
+  return ((unsigned long)offset * periodUs) / 128;
+}
+
+void ClockBus::release(uint8_t outputs) {
+  unsigned long releaseUs = micros();
+  
+  if (outputs & OUTPUT_SYNC) {
+    uint8_t oldSREG = SREG;
+    noInterrupts();
+    *syncOutPort |= syncOutMask;
+    SREG = oldSREG;
+    Scheduler::cancel(endPulse);
+    Scheduler::at(releaseUs + Settings::data.syncPulseWidthUs, endPulse, 0);
+    recordSkew(CLOCK_SKEW_SYNC_OUT, micros() - releaseUs);
+  }
+  
+  if (outputs & OUTPUT_DIN) {
+    uint8_t backlog = MidiMerge::txBacklog();
+    MidiMerge::sendRealtime(0xF8);
+    recordSkew(CLOCK_SKEW_DIN, micros() - releaseUs + (unsigned long)backlog * CLOCK_DIN_BYTE_US);
+  }
+  
+  if (outputs & OUTPUT_USB) {
+    midiEventPacket_t clockEvent = {USB_MIDI_HEADER(USB_CABLE_CLOCK, 0x0F), 0xF8, 0, 0};
+    MIDIHandler::sendMessage(clockEvent, releaseUs);
+    MIDIHandler::flushBuffer();
+    recordSkew(CLOCK_SKEW_USB, micros() - releaseUs);
+  }
+}
+
+void ClockBus::releaseScheduled(uint8_t outputs) {
+  // Interrupt context: USB, and DIN while the UART is busy, are left to update()
+  unsigned long releaseUs = micros();
+  
+  if (outputs & OUTPUT_SYNC) {
+    *syncOutPort |= syncOutMask;
+    Scheduler::cancel(endPulse);
+    Scheduler::at(releaseUs + Settings::data.syncPulseWidthUs, endPulse, 0);
+    recordSkew(CLOCK_SKEW_SYNC_OUT, micros() - releaseUs);
+  }
+  
+  if (outputs & OUTPUT_DIN) {
+    // Idle line and nothing buffered in HardwareSerial: the byte can go straight
+    // out. MidiMerge::transmit() writes with interrupts off, so it cannot be mid-write
+    const uint8_t idle = _BV(UDRE1) | _BV(TXC1);
+    if ((UCSR1A & idle) == idle && !(UCSR1B & _BV(UDRIE1)) && !MidiMerge::realtimePending()) {
+      UCSR1A |= _BV(TXC1);
+      UDR1 = 0xF8;
+      ThroughputMeter::countDirect(1);
+      recordSkew(CLOCK_SKEW_DIN, micros() - releaseUs);
+    } else {
+      pendingDIN++;
+      pendingSinceUs = releaseUs;
+    }
+  }
+  
+  if (outputs & OUTPUT_USB) {
+    pendingUSB++;
+    pendingSinceUs = releaseUs;
+  }
+}
+
+void ClockBus::endPulse(uint8_t unused) {
+  *syncOutPort &= ~syncOutMask;
+}
+
+void ClockBus::transport(ClockSource source, byte status) {
+  uint8_t outputs = outputsFor(source, status);
+  
+  if (status == 0xFC) {
+    cancelPending();
+    periodUs = 0;
+    resetPosition();
+    #if MTC_ENABLED
+    Mtc::hold();
+    #endif
+  } else if (status == 0xFA) {
+    cancelPending();
+    resetPosition();
+    #if MTC_ENABLED
+    Mtc::locate(0);
+    #endif
+  }
+  
+  if (outputs & OUTPUT_DIN) {
+    MidiMerge::sendRealtime(status);
+  }
+  
+  if (outputs & OUTPUT_USB) {
+    midiEventPacket_t event = {USB_MIDI_HEADER(USB_CABLE_CLOCK, 0x0F), status, 0, 0};
+    MIDIHandler::sendMessage(event);
+  }
+  
+  countForwards(source, outputs);
+}
+
+void ClockBus::songPosition(ClockSource source, uint16_t position) {
+  uint8_t outputs = outputsFor(source, 0xF2);
+  byte lsb = position & 0x7F;
+  byte msb = (position >> 7) & 0x7F;
+  
+  if (outputs & OUTPUT_DIN) {
+    MidiMerge::sendCommon(0xF2, lsb, msb);
+  }
+  
+  if (outputs & OUTPUT_USB) {
+    midiEventPacket_t event = {USB_MIDI_HEADER(USB_CABLE_CLOCK, 0x03), 0xF2, lsb, msb};
+    MIDIHandler::sendMessage(event);
+  }
+  
+  countForwards(source, outputs);
+  #if MTC_ENABLED
+  Mtc::locateTicks((uint32_t)position * CLOCK_TICKS_PER_STEP);
+  #endif
+}
+
+void ClockBus::sourceLost() {
+  // The clock went away without a Stop: nothing it set up may still fire
+  cancelPending();
+  periodUs = 0;
+  resetPosition();
+  #if MTC_ENABLED
+  Mtc::hold();
+  #endif
+}
+
+void ClockBus::cancelPending() {
+  // Drop delayed and predicted ticks so none follow a Stop or a restart
+  noInterrupts();
+  Scheduler::cancel(releaseScheduled);
+  Scheduler::cancel(endPulse);
+  *syncOutPort &= ~syncOutMask;
+  pendingDIN = 0;
+  pendingUSB = 0;
+  interrupts();
+}
+
+void ClockBus::resetPosition() {
+  grooveTick = 0;
+  lastTickUs = 0;
+  predictedOutputs = 0;
+}
+
+void ClockBus::locate(uint32_t ticks) {
+  grooveTick = (grooveSteps > 0) ? ticks % (grooveSteps * CLOCK_TICKS_PER_STEP) : 0;
+}
+
+void ClockBus::update() {
+  if (pendingDIN == 0 && pendingUSB == 0) return;
+  
+  noInterrupts();
+  uint8_t din = pendingDIN;
+  uint8_t usb = pendingUSB;
+  unsigned long sinceUs = pendingSinceUs;
+  pendingDIN = 0;
+  pendingUSB = 0;
+  interrupts();
+  
+  while (din--) {
+    uint8_t backlog = MidiMerge::txBacklog();
+    MidiMerge::sendRealtime(0xF8);
+    recordSkew(CLOCK_SKEW_DIN, micros() - sinceUs + (unsigned long)backlog * CLOCK_DIN_BYTE_US);
+  }
+  
+  if (usb > 0) {
+    midiEventPacket_t clockEvent = {USB_MIDI_HEADER(USB_CABLE_CLOCK, 0x0F), 0xF8, 0, 0};
+    while (usb--) {
+      MIDIHandler::sendMessage(clockEvent, sinceUs);
+    }
+    MIDIHandler::flushBuffer();
+    recordSkew(CLOCK_SKEW_USB, micros() - sinceUs);
+  }
+}
+
+bool ClockBus::setGroove(uint8_t steps, const uint8_t* offsets) {
+  if (steps > GROOVE_MAX_STEPS) return false;
+  
+  for (uint8_t i = 0; i < steps; i++) {
+    grooveOffsets[i] = offsets[i] & 0x7F;
+  }
+  grooveSteps = steps;
+  grooveTick = 0;
+  return true;
+}
+
+void ClockBus::setOutputOffset(uint8_t output, int16_t offsetUs) {
+  if (output >= CLOCK_OUTPUT_COUNT) return;
+  outputOffsetUs[output] = offsetUs;
+}
+
+void ClockBus::recordSkew(uint8_t index, unsigned long elapsedUs) {
+  uint16_t value = (elapsedUs > 0xFFFF) ? 0xFFFF : elapsedUs;
+  Stats::counters.clockSkewLastUs[index] = value;
+  if (value > Stats::counters.clockSkewMaxUs[index]) {
+    Stats::counters.clockSkewMaxUs[index] = value;
+  }
+}
+
+bool ClockBus::isSyncOutConnected() {
+  return digitalRead(SYNC_OUT_DETECT_PIN) == HIGH;
+}
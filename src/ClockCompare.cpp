@@ -0,0 +1,110 @@
+/**
+ * MIDI BytePulse - Clock Source Comparison Implementation
+ */
+
+#include "ClockCompare.h"
+
+#if CLOCK_ANALYSIS_ENABLED
+
+bool ClockCompare::enabled = false;
+ClockCompare::Track ClockCompare::tracks[3];
+ClockSource ClockCompare::lastReference = CLOCK_SOURCE_NONE;
+
+void ClockCompare::setEnabled(bool enable) {
+  // Enabling always starts a fresh measurement
+  memset(tracks, 0, sizeof(tracks));
+  lastReference = CLOCK_SOURCE_NONE;
+  enabled = enable;
+}
+
+bool ClockCompare::isPresent(uint8_t index, unsigned long nowUs) {
+  return tracks[index].active && (long)(nowUs - tracks[index].lastUs) < (long)COMPARE_TIMEOUT_US;
+}
+
+ClockSource ClockCompare::reference(unsigned long nowUs) {
+  // Same priority as Sync
+  if (isPresent(CLOCK_SOURCE_SYNC_IN - 1, nowUs)) return CLOCK_SOURCE_SYNC_IN;
+  if (isPresent(CLOCK_SOURCE_USB - 1, nowUs)) return CLOCK_SOURCE_USB;
+  if (isPresent(CLOCK_SOURCE_DIN - 1, nowUs)) return CLOCK_SOURCE_DIN;
+  return CLOCK_SOURCE_NONE;
+}
+
+void ClockCompare::record(ClockSource source, unsigned long timestampUs, uint8_t ticks) {
+  if (source == CLOCK_SOURCE_NONE) return;
+  Track& track = tracks[source - 1];
+  
+  if (!isPresent(source - 1, timestampUs) || timestampUs - track.firstUs > COMPARE_MAX_SPAN_US) {
+    track.firstUs = timestampUs;
+    track.intervals = 0;
+    track.active = true;
+    track.phaseValid = false;
+  } else {
+    track.intervals += ticks;
+  }
+  track.lastUs = timestampUs;
+  
+  ClockSource ref = reference(timestampUs);
+  if (ref != lastReference) {
+    for (uint8_t i = 0; i < 3; i++) tracks[i].phaseValid = false;
+    lastReference = ref;
+  }
+  if (ref == source || ref == CLOCK_SOURCE_NONE) return;
+  
+  const Track& refTrack = tracks[ref - 1];
+  if (refTrack.intervals == 0) return;
+  long periodUs = (refTrack.lastUs - refTrack.firstUs) / refTrack.intervals;
+  if (periodUs == 0) return;
+  
+  long offsetUs = (long)(timestampUs - refTrack.lastUs) % periodUs;
+  
+  if (!track.phaseValid) {
+    if (offsetUs > periodUs / 2) offsetUs -= periodUs;
+    else if (offsetUs < -periodUs / 2) offsetUs += periodUs;
+    track.phaseUs = offsetUs;
+    track.phaseValid = true;
+    return;
+  }
+  
+  // Unwrap towards the running value, so a phase near half a tick doesn't flip
+  if (offsetUs - track.phaseUs > periodUs / 2) offsetUs -= periodUs;
+  else if (offsetUs - track.phaseUs < -periodUs / 2) offsetUs += periodUs;
+  track.phaseUs += (offsetUs - track.phaseUs) / 8;
+  
+  if (track.phaseUs > periodUs / 2) track.phaseUs -= periodUs;
+  else if (track.phaseUs < -periodUs / 2) track.phaseUs += periodUs;
+}
+
+uint8_t ClockCompare::snapshot(uint8_t* buffer) {
+  CompareResult result;
+  memset(&result, 0, sizeof(result));
+  
+  unsigned long nowUs = micros();
+  ClockSource ref = reference(nowUs);
+  result.reference = ref;
+  
+  for (uint8_t i = 0; i < 3; i++) {
+    if (!isPresent(i, nowUs)) continue;
+    const Track& track = tracks[i];
+    result.sources[i].intervals = track.intervals;
+    if (ref == CLOCK_SOURCE_NONE || i == ref - 1) continue;
+    
+    if (track.phaseValid) result.sources[i].phaseUs = track.phaseUs;
+    
+    // (nB / spanB) / (nA / spanA) - 1, kept in integers: a double is a float on AVR
+    const Track& refTrack = tracks[ref - 1];
+    int64_t refSpan = refTrack.lastUs - refTrack.firstUs;
+    int64_t span = track.lastUs - track.firstUs;
+    int64_t diff = (int64_t)track.intervals * refSpan - (int64_t)refTrack.intervals * span;
+    int64_t denom = (int64_t)refTrack.intervals * span;
+    if (denom < 10) continue;
+    
+    if (diff > denom / 100) result.sources[i].driftDeciPpm = COMPARE_DRIFT_LIMIT;
+    else if (diff < -denom / 100) result.sources[i].driftDeciPpm = -COMPARE_DRIFT_LIMIT;
+    else result.sources[i].driftDeciPpm = diff * 1000000 / (denom / 10);
+  }
+  
+  memcpy(buffer, &result, sizeof(result));
+  return sizeof(result);
+}
+
+#endif  // CLOCK_ANALYSIS_ENABLED
@@ -1,65 +1,272 @@
 #include "Display.h"
 #include "config.h"
+#include "ThroughputMeter.h"
 
 using ace_tmi::SimpleTmi1637Interface;
-using ace_segment::Tm1637Module;
+
+#define TM1637_CMD_DATA_FIXED   0x44   // write, fixed address
+#define TM1637_CMD_ADDRESS      0xC0
+#define TM1637_CMD_DISPLAY_ON   0x88
+
+#define SEGMENT_DP  0b10000000
+
+// Glyphs for ' ' (0x20) to '_' (0x5F); lower case folds onto upper case
+static const uint8_t GLYPHS[64] PROGMEM = {
+  0, 0, 0, 0, 0, 0, 0, 0,                          //  !"#$%&'
+  0, 0, 0, 0, 0, 0b01000000, SEGMENT_DP, 0,        // ()*+,-./
+  0b00111111, 0b00000110, 0b01011011, 0b01001111,  // 0123
+  0b01100110, 0b01101101, 0b01111101, 0b00000111,  // 4567
+  0b01111111, 0b01101111, 0, 0, 0, 0, 0, 0,        // 89:;<=>?
+  0,          0b01110111, 0b01111100, 0b00111001,  // @ABC
+  0b01011110, 0b01111001, 0b01110001, 0b00111101,  // DEFG
+  0b01110110, 0b00000110, 0b00011110, 0,           // HIJK
+  0b00111000, 0,          0b01010100, 0b01011100,  // LMNO
+  0b01110011, 0,          0,          0b01101101,  // PQRS
+  0b01111000, 0b00011100, 0,          0,           // TUVW
+  0,          0b01101110, 0,          0,           // XYZ[
+  0, 0, 0, 0b00001000                              // \]^_
+};
+
+#if DISPLAY_ANIMATIONS_ENABLED
+static const uint8_t SPLASH_SEGMENTS[7] PROGMEM = {
+  0b00000001, 0b00000010, 0b00000100, 0b00001000,
+  0b00010000, 0b00100000, 0b01000000
+};
+
+static const uint8_t CHAOTIC_PATTERN[16] PROGMEM = {
+  0b00000001, 0b00100001, 0b00100000, 0b00110000,
+  0b00010000, 0b00011000, 0b00001000, 0b00001100,
+  0b00000100, 0b00000110, 0b00000010, 0b01000010,
+  0b01000000, 0b01100000, 0b01010000, 0b01001000
+};
+
+static const uint8_t ROTATE_PATTERN[4] PROGMEM = {
+  0b00000001, 0b00000010, 0b00001000, 0b00100000
+};
+#endif
+
+#if THROUGHPUT_METER_ENABLED
+// Meter port letters, indexed by MeterPort: i, o, u
+static const uint8_t METER_LABELS[3] PROGMEM = {
+  0b00010000, 0b01011100, 0b00011100
+};
+
+// Three digits, right aligned; a decimal point after digit `point` (-1: none)
+static void meterDigits(uint8_t* digits, uint16_t value, int8_t point) {
+  for (int8_t i = 2; i >= 0; i--) {
+    digits[i] = (i == 2 || value > 0 || i <= point) ? Display::glyph('0' + value % 10) : 0;
+    value /= 10;
+  }
+  if (point >= 0) digits[point] |= SEGMENT_DP;
+}
+#endif
+
+uint8_t Display::glyph(char c) {
+  if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+  if (c < ' ' || c > '_') return 0;
+  return pgm_read_byte(&GLYPHS[c - ' ']);
+}
 
 void Display::begin() {
   tmiInterface = new SimpleTmi1637Interface(DISPLAY_DIO_PIN, DISPLAY_CLK_PIN, 100);
-  ledModule = new Tm1637Module<SimpleTmi1637Interface, 4>(*tmiInterface);
-  
   tmiInterface->begin();
-  ledModule->begin();
-  ledModule->setBrightness(2);
-  
-  uint8_t segments[7] = {
-    0b00000001, 0b00000010, 0b00000100, 0b00001000,
-    0b00010000, 0b00100000, 0b01000000
-  };
-  
-  for (int frame = 0; frame < 10; frame++) {
-    for (int digit = 0; digit < 4; digit++) {
-      int segmentIdx = frame - digit;
+
+  // The data command sticks, so every later write is just address + pattern
+  writeCommand(TM1637_CMD_DATA_FIXED);
+  for (uint8_t i = 0; i < DISPLAY_DIGITS; i++) {
+    writeDigit(i, 0);
+    shown[i] = 0;
+    frame[i] = 0;
+  }
+  writeCommand(TM1637_CMD_DISPLAY_ON | DISPLAY_BRIGHTNESS);
+
+  memset(layers, 0, sizeof(layers));
+  activeLayers = 0;
+  showLayer(DISPLAY_LAYER_BASE);
+
+  #if DISPLAY_ANIMATIONS_ENABLED
+  // Startup animation is played from flush() so MIDI is never held up by it
+  splashActive = true;
+  splashStartTime = millis();
+  splashFrame = 0xFF;
+  #endif
+}
+
+void Display::writeCommand(uint8_t command) {
+  tmiInterface->startCondition();
+  tmiInterface->write(command);
+  tmiInterface->stopCondition();
+}
+
+void Display::writeDigit(uint8_t digit, uint8_t pattern) {
+  tmiInterface->startCondition();
+  tmiInterface->write(TM1637_CMD_ADDRESS | digit);
+  tmiInterface->write(pattern);
+  tmiInterface->stopCondition();
+}
+
+void Display::showLayer(DisplayLayer layer) {
+  activeLayers |= (1 << layer);
+  frameDirty = true;
+}
+
+void Display::hideLayer(DisplayLayer layer) {
+  if (activeLayers & (1 << layer)) {
+    activeLayers &= ~(1 << layer);
+    frameDirty = true;
+  }
+}
+
+void Display::setLayerText(DisplayLayer layer, const char* text) {
+  for (uint8_t i = 0; i < DISPLAY_DIGITS; i++) {
+    layers[layer][i] = glyph(text[i]);
+  }
+  showLayer(layer);
+}
+
+void Display::compose() {
+  uint8_t top = DISPLAY_LAYER_BASE;
+  for (uint8_t layer = DISPLAY_LAYER_COUNT - 1; layer > DISPLAY_LAYER_BASE; layer--) {
+    if (activeLayers & (1 << layer)) {
+      top = layer;
+      break;
+    }
+  }
+  memcpy(frame, layers[top], DISPLAY_DIGITS);
+  frameDirty = false;
+}
+
+#if DISPLAY_ANIMATIONS_ENABLED
+// Splash timeline: segment sweep (10 x 100ms), decimal point walk (4 x 150ms),
+// two full blinks (4 x 100ms)
+bool Display::updateSplash(unsigned long now) {
+  unsigned long elapsed = now - splashStartTime;
+  uint8_t step;
+
+  if (elapsed < 1000) {
+    step = elapsed / 100;
+  } else if (elapsed < 1600) {
+    step = 10 + (elapsed - 1000) / 150;
+  } else if (elapsed < 2000) {
+    step = 14 + (elapsed - 1600) / 100;
+  } else {
+    return false;
+  }
+
+  if (step == splashFrame) return true;
+  splashFrame = step;
+
+  for (int digit = 0; digit < DISPLAY_DIGITS; digit++) {
+    uint8_t pattern = 0b00000000;
+
+    if (step < 10) {
+      int segmentIdx = step - digit;
       if (segmentIdx >= 0 && segmentIdx < 7) {
-        ledModule->setPatternAt(digit, segments[segmentIdx]);
-      } else {
-        ledModule->setPatternAt(digit, 0b00000000);
+        pattern = pgm_read_byte(&SPLASH_SEGMENTS[segmentIdx]);
       }
+    } else if (step < 14) {
+      if (digit == step - 10) pattern = SEGMENT_DP;
+    } else if ((step - 14) % 2 == 0) {
+      pattern = 0xFF;
     }
-    ledModule->flush();
-    delay(100);
+
+    layers[DISPLAY_LAYER_BASE][digit] = pattern;
   }
-  
-  for (int dp = 0; dp < 4; dp++) {
-    for (int digit = 0; digit < 4; digit++) {
-      ledModule->setPatternAt(digit, digit == dp ? 0b10000000 : 0b00000000);
+  frameDirty = true;
+
+  return true;
+}
+#endif
+
+void Display::updateBase(unsigned long now) {
+  uint8_t* base = layers[DISPLAY_LAYER_BASE];
+
+  #if DISPLAY_ANIMATIONS_ENABLED
+  if (splashActive) {
+    if (isPlaying || (activeLayers & ~(1 << DISPLAY_LAYER_BASE))) {
+      // Clock activity, a message or the button cuts the splash short
+      splashActive = false;
+    } else if (updateSplash(now)) {
+      return;
+    } else {
+      splashActive = false;
     }
-    ledModule->flush();
-    delay(150);
+    memset(base, 0, DISPLAY_DIGITS);
+    frameDirty = true;
   }
-  
-  for (int blink = 0; blink < 2; blink++) {
-    for (int digit = 0; digit < 4; digit++) {
-      ledModule->setPatternAt(digit, 0xFF);
+  #endif
+
+  if (isIdle && (unsigned long)(now - lastIdleAnimTime) >= 100) {
+    lastIdleAnimTime = now;
+
+    #if DISPLAY_ANIMATIONS_ENABLED
+    for (int i = 0; i < DISPLAY_DIGITS; i++) {
+      uint8_t step = (idleAnimFrame + (i * 4)) % 16;
+      base[i] = pgm_read_byte(&CHAOTIC_PATTERN[step]);
+    }
+
+    idleAnimFrame = (idleAnimFrame + 1) % 16;
+    #else
+    memset(base, 0, DISPLAY_DIGITS);
+    #endif
+    frameDirty = true;
+  }
+
+  if (isPlaying && !isIdle && animationNeedsUpdate) {
+    animationNeedsUpdate = false;
+
+    #if DISPLAY_ANIMATIONS_ENABLED
+    uint8_t pattern = pgm_read_byte(&ROTATE_PATTERN[idleAnimFrame % 4]);
+    #else
+    uint8_t pattern = 0;  // beat dot only
+    #endif
+    for (int i = 0; i < DISPLAY_DIGITS; i++) {
+      base[i] = (i == currentBeat) ? (pattern | SEGMENT_DP) : pattern;
     }
-    ledModule->flush();
-    delay(100);
-    
-    for (int digit = 0; digit < 4; digit++) {
-      ledModule->setPatternAt(digit, 0x00);
+
+    idleAnimFrame = (idleAnimFrame + 1);
+    if (idleAnimFrame >= 16) idleAnimFrame = 0;
+    frameDirty = true;
+  }
+}
+
+#if THROUGHPUT_METER_ENABLED
+void Display::updateMeter(unsigned long now) {
+  uint8_t port = meterPage / 2;
+  uint8_t blink = ThroughputMeter::overloaded(port) ? (now / DISPLAY_BLINK_MS) & 1 : 0;
+  if (!meterDirty && meterStep == ThroughputMeter::steps() && meterBlink == blink) return;
+  meterDirty = false;
+  meterStep = ThroughputMeter::steps();
+  meterBlink = blink;
+
+  const MeterReading& reading = ThroughputMeter::reading(port);
+  uint8_t* meter = layers[DISPLAY_LAYER_METER];
+  meter[0] = blink ? 0 : pgm_read_byte(&METER_LABELS[port]);
+
+  if (meterPage % 2 == 0) {
+    meter[0] |= SEGMENT_DP;
+    meterDigits(meter + 1, reading.loadPercent, -1);
+  } else {
+    uint16_t rate = reading.messagesPerSecond;
+    if (rate < 1000) {
+      meterDigits(meter + 1, rate, -1);
+    } else if (rate < 10000) {
+      meterDigits(meter + 1, rate / 10, 0);    // 1.23 = 1230/s
+    } else {
+      meterDigits(meter + 1, rate / 100, 1);   // 12.3 = 12300/s
     }
-    ledModule->flush();
-    delay(100);
   }
+  frameDirty = true;
 }
+#endif
 
 void Display::setBPM(uint16_t bpm) {
   bpm = constrain(bpm, 20, 400);
-  
+
   if (abs((int)bpm - (int)currentBPM) > 2) {
     currentBPM = bpm;
   }
-  
+
   isPlaying = true;
   isIdle = false;
 }
@@ -70,29 +277,25 @@ void Display::showPlay() {
 }
 
 void Display::showStop() {
-  if (ledModule) {
-    showingMIDIMessage = true;
-    midiMessageTime = millis();
+  if (tmiInterface) {
+    messageTime = millis();
     isIdle = false;
-    ledModule->setPatternAt(0, 0b01101101);
-    ledModule->setPatternAt(1, 0b01111000);
-    ledModule->setPatternAt(2, 0b01011100);
-    ledModule->setPatternAt(3, 0b01110011);
+    setLayerText(DISPLAY_LAYER_MESSAGE, "StoP");
   }
   currentBeat = 0;
 }
 
 void Display::advanceAnimation() {
-  if (isPlaying && !isIdle && !showingMIDIMessage) {
+  if (isPlaying && !isIdle) {
     static uint8_t clockCounter = 0;
     static uint8_t stepCounter = 0;
-    
+
     clockCounter++;
-    
+
     if (clockCounter >= 6) {
       clockCounter = 0;
       animationNeedsUpdate = true;
-      
+
       stepCounter++;
       if (stepCounter >= 4) {
         stepCounter = 0;
@@ -107,90 +310,78 @@ void Display::setBeat(uint8_t beat) {
 }
 
 void Display::showBPM() {
-  if (!ledModule) return;
-  
+  if (!tmiInterface || isMeterShown()) return;
+
   if (!isPlaying) {
     showIdle();
     return;
   }
-  
+
   uint16_t bpm = currentBPM;
-  uint8_t digit1 = (bpm / 100) % 10;
-  uint8_t digit2 = (bpm / 10) % 10;
-  uint8_t digit3 = bpm % 10;
-  
-  uint8_t tWithDecimal = charToSegment('t') | 0b10000000;
-  ledModule->setPatternAt(0, tWithDecimal);
-  ledModule->setPatternAt(1, charToSegment('0' + digit1));
-  ledModule->setPatternAt(2, charToSegment('0' + digit2));
-  ledModule->setPatternAt(3, charToSegment('0' + digit3));
-  ledModule->flush();
+  uint8_t* overlay = layers[DISPLAY_LAYER_OVERLAY];
+  overlay[0] = glyph('t') | SEGMENT_DP;
+  overlay[1] = glyph('0' + (bpm / 100) % 10);
+  overlay[2] = glyph('0' + (bpm / 10) % 10);
+  overlay[3] = glyph('0' + bpm % 10);
+  showLayer(DISPLAY_LAYER_OVERLAY);
 }
 
 void Display::showIdle() {
-  if (!ledModule) return;
-  
-  ledModule->setPatternAt(0, charToSegment('I'));
-  ledModule->setPatternAt(1, charToSegment('d'));
-  ledModule->setPatternAt(2, charToSegment('L'));
-  ledModule->setPatternAt(3, charToSegment('e'));
-  ledModule->flush();
+  if (!tmiInterface) return;
+
+  setLayerText(DISPLAY_LAYER_OVERLAY, "IdLE");
 }
 
 void Display::setButtonPressed(bool pressed) {
   buttonPressed = pressed;
-}
+  unsigned long now = millis();
+  if (!pressed) {
+    hideLayer(DISPLAY_LAYER_OVERLAY);
+    releaseTime = now;
+    return;
+  }
 
-uint8_t Display::charToSegment(char c) {
-  switch (c) {
-    case '0': return 0b00111111;
-    case '1': return 0b00000110;
-    case '2': return 0b01011011;
-    case '3': return 0b01001111;
-    case '4': return 0b01100110;
-    case '5': return 0b01101101;
-    case '6': return 0b01111101;
-    case '7': return 0b00000111;
-    case '8': return 0b01111111;
-    case '9': return 0b01101111;
-    case 'A': case 'a': return 0b01110111;
-    case 'B': case 'b': return 0b01111100;
-    case 'C': case 'c': return 0b00111001;
-    case 'D': case 'd': return 0b01011110;
-    case 'E': case 'e': return 0b01111001;
-    case 'F': case 'f': return 0b01110001;
-    case 'I': case 'i': return 0b00000110;
-    case 'L': case 'l': return 0b00111000;
-    case 'N': case 'n': return 0b01010100;
-    case 'o': case 'O': return 0b01011100;
-    case 'P': case 'p': return 0b01110011;
-    case 't': case 'T': return 0b01111000;
-    case 'Y': case 'y': return 0b01101110;
-    case '.': return 0b10000000;
-    case '#': return 0b00000000;
-    default: return 0b00000000;
+  #if THROUGHPUT_METER_ENABLED
+  // A double press toggles the meter, a single press there turns the page
+  if (doublePressArmed && (unsigned long)(now - releaseTime) < DISPLAY_DOUBLE_PRESS_MS) {
+    doublePressArmed = false;
+    if (isMeterShown()) {
+      hideLayer(DISPLAY_LAYER_METER);
+    } else {
+      meterPage = 0;
+      meterDirty = true;
+      showLayer(DISPLAY_LAYER_METER);
+    }
+    return;
+  }
+  doublePressArmed = true;
+
+  if (isMeterShown()) {
+    meterPage = (meterPage + 1) % DISPLAY_METER_PAGES;
+    meterDirty = true;
   }
+  #endif
 }
 
 void Display::showMIDIMessage(const char* type, uint8_t data, uint8_t channel) {
-  if (ledModule && isIdle) {
-    showingMIDIMessage = true;
-    midiMessageTime = millis();
-    
+  if (tmiInterface && isIdle) {
+    messageTime = millis();
+
     char hex1 = (data >> 4) < 10 ? '0' + (data >> 4) : 'A' + (data >> 4) - 10;
     char hex2 = (data & 0x0F) < 10 ? '0' + (data & 0x0F) : 'A' + (data & 0x0F) - 10;
     char channelHex = channel < 10 ? '0' + channel : 'A' + channel - 10;
-    uint8_t nWithDecimal = charToSegment('n') | 0b10000000;
-    
-    ledModule->setPatternAt(0, charToSegment(channelHex));
-    ledModule->setPatternAt(1, nWithDecimal);
-    ledModule->setPatternAt(2, charToSegment(hex1));
-    ledModule->setPatternAt(3, charToSegment(hex2));
+
+    uint8_t* message = layers[DISPLAY_LAYER_MESSAGE];
+    message[0] = glyph(channelHex);
+    message[1] = glyph('n') | SEGMENT_DP;
+    message[2] = glyph(hex1);
+    message[3] = glyph(hex2);
+    showLayer(DISPLAY_LAYER_MESSAGE);
   }
 }
 
 void Display::clear() {
-  if (ledModule) {
+  if (tmiInterface) {
     isIdle = true;
     isPlaying = false;
     idleAnimFrame = 0;
@@ -200,66 +391,37 @@ void Display::clear() {
 }
 
 void Display::flush() {
-  if (ledModule) {
-    unsigned long now = millis();
-    if ((unsigned long)(now - lastFlushTime) >= 20) {
-      lastFlushTime = now;
-      ledModule->flushIncremental();
-    }
-    
-    if (buttonPressed) {
+  if (!tmiInterface) return;
+
+  unsigned long now = millis();
+
+  if ((activeLayers & (1 << DISPLAY_LAYER_MESSAGE)) &&
+      (unsigned long)(now - messageTime) >= DISPLAY_MESSAGE_MS) {
+    hideLayer(DISPLAY_LAYER_MESSAGE);
+  }
+
+  updateBase(now);
+
+  #if THROUGHPUT_METER_ENABLED
+  if (isMeterShown()) updateMeter(now);
+  #endif
+
+  if (frameDirty) {
+    compose();
+  }
+
+  if ((unsigned long)(now - lastWriteTime) < DISPLAY_WRITE_INTERVAL_MS) return;
+
+  // Send the next digit that differs from the module, scanning round-robin
+  // so a busy digit can't starve the others
+  for (uint8_t n = 0; n < DISPLAY_DIGITS; n++) {
+    uint8_t digit = (scanDigit + n) % DISPLAY_DIGITS;
+    if (frame[digit] != shown[digit]) {
+      writeDigit(digit, frame[digit]);
+      shown[digit] = frame[digit];
+      scanDigit = (digit + 1) % DISPLAY_DIGITS;
+      lastWriteTime = now;
       return;
     }
-    
-    if (showingMIDIMessage && (unsigned long)(now - midiMessageTime) >= 500) {
-      showingMIDIMessage = false;
-      for (int i = 0; i < 4; i++) {
-        ledModule->setPatternAt(i, 0b00000000);
-      }
-    }
-    
-    if (isIdle && (unsigned long)(now - lastIdleAnimTime) >= 100) {
-      lastIdleAnimTime = now;
-      
-      if (!showingMIDIMessage) {
-        const uint8_t chaoticPattern[16] = {
-          0b00000001, 0b00100001, 0b00100000, 0b00110000,
-          0b00010000, 0b00011000, 0b00001000, 0b00001100,
-          0b00000100, 0b00000110, 0b00000010, 0b01000010,
-          0b01000000, 0b01100000, 0b01010000, 0b01001000
-        };
-        
-        for (int i = 0; i < 4; i++) {
-          uint8_t frame = (idleAnimFrame + (i * 4)) % 16;
-          ledModule->setPatternAt(i, chaoticPattern[frame]);
-        }
-        
-        idleAnimFrame = (idleAnimFrame + 1) % 16;
-      }
-    }
-    
-    if (isPlaying && !isIdle && !showingMIDIMessage && animationNeedsUpdate) {
-      animationNeedsUpdate = false;
-      
-      const uint8_t rotatePattern[4] = {
-        0b00000001, 0b00000010, 0b00001000, 0b00100000
-      };
-      
-      uint8_t decimalDigit = currentBeat;
-      
-      for (int i = 0; i < 4; i++) {
-        uint8_t frame = idleAnimFrame % 4;
-        uint8_t pattern = rotatePattern[frame];
-        
-        if (i == decimalDigit) {
-          pattern |= 0b10000000;
-        }
-        
-        ledModule->setPatternAt(i, pattern);
-      }
-      
-      idleAnimFrame = (idleAnimFrame + 1);
-      if (idleAnimFrame >= 16) idleAnimFrame = 0;
-    }
   }
 }
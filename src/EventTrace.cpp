@@ -0,0 +1,84 @@
+/**
+ * MIDI BytePulse - Event Trace Implementation
+ */
+
+#include "EventTrace.h"
+
+#if EVENT_TRACE_ENABLED
+
+static_assert((EVENT_TRACE_SIZE & (EVENT_TRACE_SIZE - 1)) == 0, "EVENT_TRACE_SIZE must be a power of two");
+static_assert(EVENT_TRACE_SIZE <= 128, "record count must fit the dump header");
+
+EventTraceDump EventTrace::dump;
+uint8_t EventTrace::head = 0;
+volatile bool EventTrace::frozen = false;
+uint8_t EventTrace::lostWhileFrozen = 0;
+
+void EventTrace::record(unsigned long timeUs, uint8_t type, uint8_t source, uint16_t value, bool repeats) {
+  // Interrupt handlers log too
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+
+  EventRecord& newest = dump.records[(head - 1) & (EVENT_TRACE_SIZE - 1)];
+  if (frozen) {
+    if (lostWhileFrozen != 0xFF) lostWhileFrozen++;
+  } else if (repeats && dump.count > 0 && newest.type == type && newest.source == source) {
+    if (newest.value != 0xFFFF) newest.value++;
+  } else {
+    EventRecord& entry = dump.records[head];
+    entry.timeUs = timeUs;
+    entry.type = type;
+    entry.source = source;
+    entry.value = value;
+    head = (head + 1) & (EVENT_TRACE_SIZE - 1);
+    if (dump.count < EVENT_TRACE_SIZE) dump.count++;
+    if (dump.logged != 0xFFFF) dump.logged++;
+  }
+
+  SREG = oldSREG;
+}
+
+void EventTrace::reverse(uint8_t first, uint8_t last) {
+  while (first + 1 < last) {
+    last--;
+    EventRecord swap = dump.records[first];
+    dump.records[first] = dump.records[last];
+    dump.records[last] = swap;
+    first++;
+  }
+}
+
+const uint8_t* EventTrace::freeze(uint16_t& length) {
+  noInterrupts();
+  frozen = true;
+  dump.lost = lostWhileFrozen;
+  lostWhileFrozen = 0;
+  interrupts();
+
+  dump.nowUs = micros();
+
+  // A full ring starts at head: rotate it to the front, the next record
+  // overwrites the oldest at 0 again
+  if (head != 0 && dump.count == EVENT_TRACE_SIZE) {
+    reverse(0, head);
+    reverse(head, EVENT_TRACE_SIZE);
+    reverse(0, EVENT_TRACE_SIZE);
+  }
+  head = dump.count & (EVENT_TRACE_SIZE - 1);
+
+  length = offsetof(EventTraceDump, records) + dump.count * sizeof(EventRecord);
+  return (const uint8_t*)&dump;
+}
+
+void EventTrace::resume(bool clear) {
+  noInterrupts();
+  if (clear) {
+    dump.count = 0;
+    dump.logged = 0;
+    head = 0;
+  }
+  frozen = false;
+  interrupts();
+}
+
+#endif  // EVENT_TRACE_ENABLED
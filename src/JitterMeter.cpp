@@ -0,0 +1,138 @@
+/**
+ * MIDI BytePulse - Clock Jitter Analyzer Implementation
+ */
+
+#include "JitterMeter.h"
+
+#if CLOCK_ANALYSIS_ENABLED
+
+bool JitterMeter::enabled = false;
+ClockSource JitterMeter::source = CLOCK_SOURCE_NONE;
+unsigned long JitterMeter::lastUs = 0;
+unsigned long JitterMeter::expectedUs = 0;
+unsigned long JitterMeter::baseUs = 0;
+uint16_t JitterMeter::count = 0;
+int32_t JitterMeter::sum = 0;
+uint64_t JitterMeter::sumSquares = 0;
+unsigned long JitterMeter::minUs = 0;
+unsigned long JitterMeter::maxUs = 0;
+uint16_t JitterMeter::missing = 0;
+uint16_t JitterMeter::extra = 0;
+uint16_t JitterMeter::histogram[JITTER_BINS];
+
+void JitterMeter::clear() {
+  lastUs = 0;
+  expectedUs = 0;
+  baseUs = 0;
+  count = 0;
+  sum = 0;
+  sumSquares = 0;
+  minUs = 0xFFFFFFFFUL;
+  maxUs = 0;
+  missing = 0;
+  extra = 0;
+  memset(histogram, 0, sizeof(histogram));
+}
+
+void JitterMeter::setEnabled(bool enable) {
+  // Enabling always starts a fresh measurement
+  clear();
+  enabled = enable;
+}
+
+void JitterMeter::follow(ClockSource newSource) {
+  // Stop / Start of the same source keeps the statistics, the gap is skipped
+  if (newSource != CLOCK_SOURCE_NONE && newSource != source) {
+    clear();
+    source = newSource;
+  }
+  lastUs = 0;
+}
+
+void JitterMeter::record(unsigned long timestampUs, uint8_t ticks) {
+  unsigned long previousUs = lastUs;
+  lastUs = timestampUs;
+  if (previousUs == 0) return;
+  
+  unsigned long intervalUs = timestampUs - previousUs;
+  if (ticks > 1) intervalUs /= ticks;
+  
+  if (expectedUs == 0) {
+    expectedUs = intervalUs;
+    baseUs = intervalUs;
+    return;
+  }
+  
+  // A gap or a doubled tick says more about the sender than jitter does
+  if (intervalUs > expectedUs + expectedUs / 2) {
+    uint16_t lost = (intervalUs + expectedUs / 2) / expectedUs - 1;
+    missing = (missing > 0xFFFF - lost) ? 0xFFFF : missing + lost;
+    return;
+  }
+  if (intervalUs < expectedUs / 2) {
+    if (extra < 0xFFFF) extra++;
+    return;
+  }
+  
+  long deviationUs = (long)(intervalUs - expectedUs);
+  int8_t bin = (deviationUs >> JITTER_BIN_SHIFT) + JITTER_BINS / 2;
+  if (deviationUs < -(long)(JITTER_BINS / 2 << JITTER_BIN_SHIFT)) bin = 0;
+  else if (deviationUs >= (long)(JITTER_BINS / 2 << JITTER_BIN_SHIFT)) bin = JITTER_BINS - 1;
+  if (histogram[bin] < 0xFFFF) histogram[bin]++;
+  
+  expectedUs = (expectedUs * 3 + intervalUs) / 4;
+  
+  if (count == JITTER_MAX_COUNT) return;
+  
+  long offsetUs = constrain((long)(intervalUs - baseUs), -0xFFFFL, 0xFFFFL);
+  uint32_t magnitude = offsetUs < 0 ? -offsetUs : offsetUs;
+  count++;
+  sum += offsetUs;
+  sumSquares += magnitude * magnitude;
+  if (intervalUs < minUs) minUs = intervalUs;
+  if (intervalUs > maxUs) maxUs = intervalUs;
+}
+
+static uint32_t squareRoot(uint64_t value) {
+  uint64_t result = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+  while (bit > value) bit >>= 2;
+  while (bit) {
+    if (value >= result + bit) {
+      value -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return result;
+}
+
+uint8_t JitterMeter::snapshot(uint8_t* buffer) {
+  JitterResult result;
+  memset(&result, 0, sizeof(result));
+  
+  result.source = source;
+  result.count = count;
+  result.missing = missing;
+  result.extra = extra;
+  memcpy(result.histogram, histogram, sizeof(histogram));
+  
+  if (count) {
+    // Mean offset in 1/16 us, variance in 1/256 us^2
+    int64_t mean16 = (int64_t)sum * 16 / count;
+    int64_t variance256 = (int64_t)(sumSquares * 256 / count) - mean16 * mean16;
+    if (variance256 < 0) variance256 = 0;
+    
+    result.meanNs = baseUs * 1000 + mean16 * 1000 / 16;
+    result.stdDevNs = (uint64_t)squareRoot(variance256) * 1000 / 16;
+    result.minUs = minUs;
+    result.maxUs = maxUs;
+  }
+  
+  memcpy(buffer, &result, sizeof(result));
+  return sizeof(result);
+}
+
+#endif  // CLOCK_ANALYSIS_ENABLED
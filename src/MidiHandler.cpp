@@ -2,47 +2,89 @@
  * MIDI BytePulse - MIDI Handler Implementation
  */
 
-#include "MIDIHandler.h"
+#include "MidiHandler.h"
 #include "Sync.h"
 #include "Display.h"
-#include <MIDI.h>
-#include <MIDIUSB.h>
+#include "Stats.h"
+#include "Routing.h"
+#include "Transform.h"
+#include "MidiMerge.h"
+#include "CycleProbe.h"
+#include "MidiCodec.h"
+#include "UmpUSB.h"
+#include "ThroughputMeter.h"
+#include "EventTrace.h"
+#include "config.h"
 
-MIDI_CREATE_INSTANCE(HardwareSerial, Serial1, MIDI_DIN);
+// A multiple of 3, so every chunk but the last fills whole USB SysEx packets
+#define DIN_SYSEX_CHUNK  48
+#define DIN_BYTE_US      320   // one byte on the wire at 31250 baud
+
+typedef MidiParser<MIDIHandler, DIN_SYSEX_CHUNK> DinParser;
 
 Sync* MIDIHandler::sync = nullptr;
 Display* MIDIHandler::display = nullptr;
+unsigned long MIDIHandler::rxTimeUs = 0;
+const byte* MIDIHandler::usbSysEx = nullptr;
+uint8_t MIDIHandler::usbSysExLength = 0;
+bool MIDIHandler::usbSysExLast = false;
 
-void MIDIHandler::sendMessage(const midiEventPacket_t& event) {
-  MidiUSB.sendMIDI(event);
+bool MIDIHandler::sendMessage(const midiEventPacket_t& event, unsigned long timestampUs) {
+  // The UMP copy only goes with an accepted packet, so a retry does not double it
+  if (UsbMidi::sendMIDI(event) != sizeof(midiEventPacket_t)) {
+    Stats::count(Stats::counters.usbSendFailures);
+    return false;
+  }
+  
+  #if MIDI_UMP_ENABLED
+  UmpUSB::send(event, timestampUs);
+  #endif
+  return true;
 }
 
 void MIDIHandler::flushBuffer() {
-  MidiUSB.flush();
+  UsbMidi::flush();
+  
+  #if MIDI_UMP_ENABLED
+  UmpUSB::flush();
+  #endif
 }
 
 void MIDIHandler::begin() {
-  MIDI_DIN.begin(MIDI_CHANNEL_OMNI);
-  MIDI_DIN.turnThruOff();
-  
-  MIDI_DIN.setHandleNoteOn(handleNoteOn);
-  MIDI_DIN.setHandleNoteOff(handleNoteOff);
-  MIDI_DIN.setHandleAfterTouchPoly(handleAfterTouchPoly);
-  MIDI_DIN.setHandleControlChange(handleControlChange);
-  MIDI_DIN.setHandleProgramChange(handleProgramChange);
-  MIDI_DIN.setHandleAfterTouchChannel(handleAfterTouchChannel);
-  MIDI_DIN.setHandlePitchBend(handlePitchBend);
-  MIDI_DIN.setHandleSystemExclusive(handleSystemExclusive);
-  MIDI_DIN.setHandleClock(handleClock);
-  MIDI_DIN.setHandleStart(handleStart);
-  MIDI_DIN.setHandleContinue(handleContinue);
-  MIDI_DIN.setHandleStop(handleStop);
-  MIDI_DIN.setHandleActiveSensing(handleActiveSensing);
-  MIDI_DIN.setHandleSystemReset(handleSystemReset);
+  Serial1.begin(31250);
+  DinParser::reset();
+  usbSysExLength = 0;
 }
 
 void MIDIHandler::update() {
-  MIDI_DIN.read();
+  // A full ring buffer means HardwareSerial is already dropping bytes. The
+  // UART's own overrun flag is no use here: its RX interrupt reads UDR1 first.
+  if (Serial1.available() >= SERIAL_RX_BUFFER_SIZE - 1) {
+    Stats::count(Stats::counters.rxBufferFull);
+    EventTrace::repeat(EVENT_RX_FULL, CLOCK_SOURCE_DIN);
+  }
+  
+  // DIN waits for a host that is slow to read, but not to the point of an
+  // overrun; past half the RX buffer the rest of the chunk is dropped
+  if (usbSysExLength > 0 && !sendSysExToUSB() && Serial1.available() >= SERIAL_RX_BUFFER_SIZE / 2) {
+    usbSysExLength = 0;
+  }
+  
+  int available = Serial1.available();
+  int pending = available;
+  
+  #if MIDI_UMP_ENABLED
+  unsigned long nowUs = micros();
+  #endif
+  
+  for (; pending > 0 && usbSysExLength == 0; pending--) {
+    #if MIDI_UMP_ENABLED
+    // Arrival of this byte, assuming the backlog came in back to back
+    rxTimeUs = nowUs - (unsigned long)(pending - 1) * DIN_BYTE_US;
+    #endif
+    DinParser::parse(Serial1.read());
+  }
+  ThroughputMeter::countBytes(METER_DIN_IN, available - pending);
 }
 
 void MIDIHandler::setSync(Sync* s) {
@@ -53,163 +95,171 @@ void MIDIHandler::setDisplay(Display* d) {
   display = d;
 }
 
-void MIDIHandler::forwardDINtoUSB(byte channel, byte type, byte data1, byte data2) {
-  midiEventPacket_t event;
-  event.header = type >> 4;
-  event.byte1 = type | (channel - 1);
-  event.byte2 = data1;
-  event.byte3 = data2;
+void MIDIHandler::forwardFromDIN(byte status, byte data1, byte data2) {
+  #if MIDI_TRANSFORM_ENABLED
+  if (status < 0xF0 && !Transform::apply(PORT_DIN, status, data1, data2)) return;
+  #endif
   
-  sendMessage(event);
-}
-
-void MIDIHandler::forwardUSBtoDIN(const midiEventPacket_t& event) {
-  byte status = event.byte1;
-  byte type = status & 0xF0;
-  byte channel = (status & 0x0F) + 1;
+  uint8_t routes = Routing::destinations(PORT_DIN, status);
   
-  switch (type) {
-    case 0x80:
-      MIDI_DIN.sendNoteOff(event.byte2, event.byte3, channel);
-      break;
-    case 0x90:
-      MIDI_DIN.sendNoteOn(event.byte2, event.byte3, channel);
-      break;
-    case 0xA0:
-      MIDI_DIN.sendAfterTouch(event.byte2, event.byte3, channel);
-      break;
-    case 0xB0:
-      MIDI_DIN.sendControlChange(event.byte2, event.byte3, channel);
-      break;
-    case 0xC0:
-      MIDI_DIN.sendProgramChange(event.byte2, channel);
-      break;
-    case 0xD0:
-      MIDI_DIN.sendAfterTouch(event.byte2, channel);
-      break;
-    case 0xE0: {
-      int pitchBend = event.byte2 | (event.byte3 << 7);
-      MIDI_DIN.sendPitchBend(pitchBend, channel);
-      break;
-    }
+  if (routes & ROUTE_TO_USB) {
+    // Code index: the status nibble, or 2/3/5 for 2/3/1-byte system common
+    byte length = MidiCodec::dataLength(status);
+    midiEventPacket_t event;
+    event.header = USB_MIDI_HEADER(USB_CABLE_DIN, (status < 0xF0) ? status >> 4 : (length ? length + 1 : 0x05));
+    event.byte1 = status;
+    event.byte2 = data1;
+    event.byte3 = data2;
+    
+    Stats::countForward(Stats::counters.dinToUSB);
+    sendMessage(event, rxTimeUs);
   }
-}
-
-void MIDIHandler::handleNoteOn(byte channel, byte note, byte velocity) {
-  forwardDINtoUSB(channel, 0x90, note, velocity);
-  if (display && sync && !sync->isClockRunning()) {
-    display->showMIDIMessage("n.", note, channel - 1);  // channel is 1-16, convert to 0-15
+  
+  if ((routes & ROUTE_TO_DIN) && MidiMerge::send(MERGE_SOURCE_DIN, status, data1, data2)) {
+    Stats::countForward(Stats::counters.dinToDIN);
   }
 }
 
-void MIDIHandler::handleNoteOff(byte channel, byte note, byte velocity) {
-  forwardDINtoUSB(channel, 0x80, note, velocity);
-  // Don't show note off on display
-}
-
-void MIDIHandler::handleAfterTouchPoly(byte channel, byte note, byte pressure) {
-  forwardDINtoUSB(channel, 0xA0, note, pressure);
-}
-
-void MIDIHandler::handleControlChange(byte channel, byte controller, byte value) {
-  forwardDINtoUSB(channel, 0xB0, controller, value);
-  // Don't show CC on display
-}
-
-void MIDIHandler::handleProgramChange(byte channel, byte program) {
-  forwardDINtoUSB(channel, 0xC0, program, 0);
-  // Don't show PC on display
-}
-
-void MIDIHandler::handleAfterTouchChannel(byte channel, byte pressure) {
-  forwardDINtoUSB(channel, 0xD0, pressure, 0);
-}
-
-void MIDIHandler::handlePitchBend(byte channel, int bend) {
-  byte lsb = bend & 0x7F;
-  byte msb = (bend >> 7) & 0x7F;
-  forwardDINtoUSB(channel, 0xE0, lsb, msb);
-}
-
-void MIDIHandler::handleSystemExclusive(byte* data, unsigned size) {
-  midiEventPacket_t event;
-  event.header = 0x04;
+void MIDIHandler::forwardRealtimeFromDIN(byte type) {
+  uint8_t routes = Routing::destinations(PORT_DIN, type);
   
-  for (unsigned i = 0; i < size; i += 3) {
-    event.byte1 = (i < size) ? data[i] : 0;
-    event.byte2 = (i + 1 < size) ? data[i + 1] : 0;
-    event.byte3 = (i + 2 < size) ? data[i + 2] : 0;
-    
-    if (i + 3 >= size) {
-      if (i + 1 >= size) event.header = 0x05;
-      else if (i + 2 >= size) event.header = 0x06;
-      else event.header = 0x07;
-    }
-    
+  Stats::count(Stats::counters.realtime);
+  
+  if (routes & ROUTE_TO_USB) {
+    midiEventPacket_t event = {USB_MIDI_HEADER(USB_CABLE_DIN, 0x0F), type, 0, 0};
+    Stats::countForward(Stats::counters.dinToUSB);
     sendMessage(event);
   }
-  MidiUSB.flush();
+  
+  if (routes & ROUTE_TO_DIN) {
+    Stats::countForward(Stats::counters.dinToDIN);
+    MidiMerge::sendRealtime(type);
+  }
 }
 
-void MIDIHandler::handleClock() {
-  midiEventPacket_t event = {0x0F, 0xF8, 0, 0};
-  MidiUSB.sendMIDI(event);
+void MIDIHandler::forwardUSBtoDIN(const midiEventPacket_t& event) {
+  CYCLE_PROBE(PROBE_FORWARD_USB_TO_DIN);
+  byte cin = event.header & 0x0F;
+  byte status = event.byte1;
+  byte data1 = event.byte2;
+  byte data2 = event.byte3;
   
-  static uint8_t clockCounter = 0;
-  if (++clockCounter >= 6) {
-    clockCounter = 0;
+  // SysEx fragments (a single-byte CIN 0x5 may also be a system common message)
+  if ((cin >= 0x04 && cin <= 0x07) && !(cin == 0x05 && status >= 0xF1 && status != 0xF7)) {
+    if (Routing::destinations(PORT_USB, 0xF0) & ROUTE_TO_DIN) {
+      byte length = (cin == 0x04) ? 3 : cin - 0x04;
+      const byte chunk[3] = {status, data1, data2};
+      if (MidiMerge::sendSysExChunk(MERGE_SOURCE_USB, chunk, length) && chunk[length - 1] == 0xF7) {
+        Stats::countForward(Stats::counters.usbToDIN);
+      }
+    }
+    return;
   }
   
-  if (sync) {
-    sync->handleClock(CLOCK_SOURCE_DIN);
+  if (status < 0x80 || status == 0xF0 || status == 0xF7) return;
+  if (status == 0xF2 || status == 0xF8 || (status >= 0xFA && status <= 0xFC)) return;  // sent by the clock bus
+  
+  #if MIDI_TRANSFORM_ENABLED
+  if (!Transform::apply(PORT_USB, status, data1, data2)) return;
+  #endif
+  
+  if (!(Routing::destinations(PORT_USB, status) & ROUTE_TO_DIN)) return;
+  
+  if (status >= 0xF8) {
+    Stats::countForward(Stats::counters.usbToDIN);
+    MidiMerge::sendRealtime(status);
+  } else if (MidiMerge::send(MERGE_SOURCE_USB, status, data1, data2)) {
+    Stats::countForward(Stats::counters.usbToDIN);
   }
 }
 
-void MIDIHandler::handleStart() {
-  midiEventPacket_t event = {0x0F, 0xFA, 0, 0};
-  MidiUSB.sendMIDI(event);
+void MIDIHandler::channelMessage(byte status, byte data1, byte data2) {
+  ThroughputMeter::countMessage(METER_DIN_IN);
   
-  if (display) {
-    display->showPlay();
-  }
+  forwardFromDIN(status, data1, data2);
   
-  if (sync) {
-    sync->handleStart(CLOCK_SOURCE_DIN);
+  // Only Note On is shown; others would flood the display
+  if ((status & 0xF0) == 0x90 && data2 && display && sync && !sync->isClockRunning()) {
+    display->showMIDIMessage("n.", data1, status & 0x0F);
   }
 }
 
-void MIDIHandler::handleContinue() {
-  midiEventPacket_t event = {0x0F, 0xFB, 0, 0};
-  MidiUSB.sendMIDI(event);
+void MIDIHandler::systemCommon(byte status, byte data1, byte data2) {
+  ThroughputMeter::countMessage(METER_DIN_IN);
   
-  if (display) {
-    display->showPlay();
+  // Song Position Pointer is forwarded by the clock bus, like transport
+  if (status == 0xF2) {
+    if (sync) sync->handleSongPosition(CLOCK_SOURCE_DIN, data1 | (data2 << 7));
+    return;
   }
+  forwardFromDIN(status, data1, data2);
+}
+
+void MIDIHandler::realtime(byte status) {
+  ThroughputMeter::countMessage(METER_DIN_IN);
   
-  if (sync) {
-    sync->handleStart(CLOCK_SOURCE_DIN);
+  // Clock and transport are forwarded by the clock bus once Sync accepts them
+  switch (status) {
+    case 0xF8:
+      if (sync) sync->handleClock(CLOCK_SOURCE_DIN);
+      break;
+    case 0xFA:
+      if (display) display->showPlay();
+      if (sync) sync->handleStart(CLOCK_SOURCE_DIN);
+      break;
+    case 0xFB:
+      if (display) display->showPlay();
+      if (sync) sync->handleContinue(CLOCK_SOURCE_DIN);
+      break;
+    case 0xFC:
+      if (display) display->showStop();
+      if (sync) sync->handleStop(CLOCK_SOURCE_DIN);
+      break;
+    default:
+      forwardRealtimeFromDIN(status);  // Active Sensing, System Reset
+      break;
   }
 }
 
-void MIDIHandler::handleStop() {
-  midiEventPacket_t event = {0x0F, 0xFC, 0, 0};
-  MidiUSB.sendMIDI(event);
+void MIDIHandler::sysEx(const byte* data, uint8_t length, bool last) {
+  if (last) ThroughputMeter::countMessage(METER_DIN_IN);
+  uint8_t routes = Routing::destinations(PORT_DIN, 0xF0);
   
-  if (display) {
-    display->showStop();
+  if ((routes & ROUTE_TO_DIN) && MidiMerge::sendSysExChunk(MERGE_SOURCE_DIN, data, length) && last) {
+    Stats::countForward(Stats::counters.dinToDIN);
   }
   
-  if (sync) {
-    sync->handleStop(CLOCK_SOURCE_DIN);
-  }
+  if (!(routes & ROUTE_TO_USB)) return;
+  
+  usbSysEx = data;
+  usbSysExLength = length;
+  usbSysExLast = last;
+  sendSysExToUSB();
 }
 
-void MIDIHandler::handleActiveSensing() {
-  midiEventPacket_t event = {0x0F, 0xFE, 0, 0};
-  MidiUSB.sendMIDI(event);
+bool MIDIHandler::sendSysExToUSB() {
+  midiEventPacket_t event;
+  
+  while (usbSysExLength > 0) {
+    uint8_t remaining = usbSysExLength;
+    event.header = USB_MIDI_HEADER(USB_CABLE_DIN, (usbSysExLast && remaining <= 3) ? 0x04 + remaining : 0x04);
+    event.byte1 = usbSysEx[0];
+    event.byte2 = (remaining > 1) ? usbSysEx[1] : 0;
+    event.byte3 = (remaining > 2) ? usbSysEx[2] : 0;
+    if (!sendMessage(event, rxTimeUs)) return false;
+    
+    uint8_t sent = (remaining > 3) ? 3 : remaining;
+    usbSysEx += sent;
+    usbSysExLength -= sent;
+  }
+  
+  if (usbSysExLast) {
+    Stats::countForward(Stats::counters.dinToUSB);
+    flushBuffer();
+  }
+  return true;
 }
 
-void MIDIHandler::handleSystemReset() {
-  midiEventPacket_t event = {0x0F, 0xFF, 0, 0};
-  MidiUSB.sendMIDI(event);
+void MIDIHandler::error() {
+  Stats::count(Stats::counters.parserErrors);
 }
@@ -0,0 +1,301 @@
+/**
+ * MIDI BytePulse - DIN OUT Merge Engine Implementation
+ */
+
+#include "MidiMerge.h"
+#include "Stats.h"
+#include "ThroughputMeter.h"
+#include "EventTrace.h"
+
+MidiMerge::Queue MidiMerge::queues[MERGE_SOURCE_COUNT];
+byte MidiMerge::dinBuffer[MERGE_DIN_QUEUE_SIZE];
+byte MidiMerge::usbBuffer[MERGE_USB_QUEUE_SIZE];
+byte MidiMerge::localBuffer[MERGE_LOCAL_QUEUE_SIZE];
+byte MidiMerge::realtime[MERGE_REALTIME_SIZE];
+uint8_t MidiMerge::realtimeHead = 0;
+uint8_t MidiMerge::realtimeTail = 0;
+byte MidiMerge::common[3];
+uint8_t MidiMerge::commonLength = 0;
+uint8_t MidiMerge::lockedSource = MERGE_SOURCE_NONE;
+uint8_t MidiMerge::nextSource = 0;
+bool MidiMerge::txStalled = false;
+
+void MidiMerge::begin() {
+  queues[MERGE_SOURCE_DIN].buffer = dinBuffer;
+  queues[MERGE_SOURCE_DIN].mask = MERGE_DIN_QUEUE_SIZE - 1;
+  queues[MERGE_SOURCE_USB].buffer = usbBuffer;
+  queues[MERGE_SOURCE_USB].mask = MERGE_USB_QUEUE_SIZE - 1;
+  queues[MERGE_SOURCE_LOCAL].buffer = localBuffer;
+  queues[MERGE_SOURCE_LOCAL].mask = MERGE_LOCAL_QUEUE_SIZE - 1;
+  
+  for (uint8_t source = 0; source < MERGE_SOURCE_COUNT; source++) {
+    queues[source].head = 0;
+    queues[source].tail = 0;
+    queues[source].inSysEx = false;
+    queues[source].dropSysEx = false;
+    queues[source].lastWrite = 0;
+  }
+  
+  realtimeHead = 0;
+  realtimeTail = 0;
+  commonLength = 0;
+  lockedSource = MERGE_SOURCE_NONE;
+  nextSource = 0;
+  txStalled = false;
+}
+
+uint8_t MidiMerge::txFree() {
+  // Keep the UART buffer short so realtime bytes never wait behind a backlog
+  int queued = (SERIAL_TX_BUFFER_SIZE - 1) - Serial1.availableForWrite();
+  return (queued >= MERGE_TX_LIMIT) ? 0 : MERGE_TX_LIMIT - queued;
+}
+
+uint8_t MidiMerge::txBacklog() {
+  // Bytes that will reach the wire before a realtime byte sent now
+  uint8_t pending = (realtimeHead - realtimeTail) & (MERGE_REALTIME_SIZE - 1);
+  return (SERIAL_TX_BUFFER_SIZE - 1) - Serial1.availableForWrite() + pending + commonLength;
+}
+
+uint8_t MidiMerge::freeSpace(uint8_t source) {
+  return queues[source].mask - used(queues[source]);
+}
+
+bool MidiMerge::isIdle() {
+  // Bytes already in the UART buffer drain from its interrupt
+  if (realtimeHead != realtimeTail || commonLength > 0) return false;
+  for (uint8_t source = 0; source < MERGE_SOURCE_COUNT; source++) {
+    if (used(queues[source]) > 0) return false;
+  }
+  return true;
+}
+
+void MidiMerge::transmit(byte data) {
+  // The clock bus writes UDR1 from its interrupt when the line is idle; one
+  // landing between HardwareSerial's UDRE test and its UDR write would be lost
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  Serial1.write(data);
+  SREG = oldSREG;
+  ThroughputMeter::countBytes(METER_DIN_OUT, 1);
+  if (data >= 0x80 && data != 0xF7) ThroughputMeter::countMessage(METER_DIN_OUT);
+}
+
+void MidiMerge::push(Queue& q, byte data) {
+  q.buffer[q.head] = data;
+  q.head = (q.head + 1) & q.mask;
+}
+
+void MidiMerge::closeSysEx(uint8_t source) {
+  // Room for the F7 is always kept free while a SysEx is open
+  Queue& q = queues[source];
+  if (q.inSysEx) {
+    push(q, 0xF7);
+    q.inSysEx = false;
+  }
+}
+
+bool MidiMerge::send(uint8_t source, byte status, byte data1, byte data2) {
+  Queue& q = queues[source];
+  uint8_t length = messageLength(status);
+  
+  // Any new status byte ends a SysEx the source left open
+  closeSysEx(source);
+  q.dropSysEx = false;
+  
+  if (q.mask - used(q) < length) {
+    Stats::count(Stats::counters.mergeDrops);
+    EventTrace::repeat(EVENT_MERGE_DROP, source);
+    return false;
+  }
+  
+  push(q, status);
+  if (length > 1) push(q, data1);
+  if (length > 2) push(q, data2);
+  q.lastWrite = millis();
+  return true;
+}
+
+bool MidiMerge::sendSysEx(uint8_t source, const byte* data, uint16_t length) {
+  Queue& q = queues[source];
+  
+  closeSysEx(source);
+  q.dropSysEx = false;
+  
+  // Whole message or nothing: a SysEx is never split
+  if (length == 0 || length > (uint16_t)(q.mask - used(q))) {
+    Stats::count(Stats::counters.mergeDrops);
+    EventTrace::repeat(EVENT_MERGE_DROP, source);
+    return false;
+  }
+  
+  for (uint16_t i = 0; i < length; i++) {
+    push(q, data[i]);
+  }
+  q.lastWrite = millis();
+  return true;
+}
+
+bool MidiMerge::sendSysExChunk(uint8_t source, const byte* data, uint8_t length) {
+  Queue& q = queues[source];
+  if (length == 0) return false;
+  
+  if (data[0] == 0xF0) {
+    closeSysEx(source);
+    q.dropSysEx = false;
+  } else if (!q.inSysEx) {
+    return false;  // continuation of a SysEx we are not forwarding
+  }
+  
+  bool ends = (data[length - 1] == 0xF7);
+  uint8_t needed = length + (ends ? 0 : 1);  // keep room for a closing F7
+  
+  if (q.mask - used(q) < needed) {
+    // Terminate what is already queued and discard the rest of this SysEx
+    closeSysEx(source);
+    q.dropSysEx = true;
+    Stats::count(Stats::counters.mergeDrops);
+    EventTrace::repeat(EVENT_MERGE_DROP, source);
+    return false;
+  }
+  
+  for (uint8_t i = 0; i < length; i++) {
+    push(q, data[i]);
+  }
+  q.inSysEx = !ends;
+  q.lastWrite = millis();
+  return true;
+}
+
+void MidiMerge::sendRealtime(byte status) {
+  // Realtime bytes may go anywhere in the stream, so they skip the queues;
+  // outside a SysEx they stay behind a waiting system common message
+  bool commonFirst = commonLength > 0 && lockedSource == MERGE_SOURCE_NONE;
+  if (realtimeHead == realtimeTail && !commonFirst && Serial1.availableForWrite() > 0) {
+    transmit(status);
+    return;
+  }
+  
+  uint8_t next = (realtimeHead + 1) & (MERGE_REALTIME_SIZE - 1);
+  if (next == realtimeTail) {
+    Stats::count(Stats::counters.mergeDrops);
+    EventTrace::repeat(EVENT_MERGE_DROP, MERGE_SOURCE_NONE);
+    return;
+  }
+  realtime[realtimeHead] = status;
+  realtimeHead = next;
+}
+
+void MidiMerge::sendCommon(byte status, byte data1, byte data2) {
+  // One slot: a newer Song Position supersedes one still waiting on a SysEx
+  if (commonLength > 0) {
+    Stats::count(Stats::counters.mergeDrops);
+    EventTrace::repeat(EVENT_MERGE_DROP, MERGE_SOURCE_NONE);
+  }
+  common[0] = status;
+  common[1] = data1;
+  common[2] = data2;
+  commonLength = messageLength(status);
+}
+
+bool MidiMerge::flushCommon() {
+  if (Serial1.availableForWrite() < commonLength) return false;
+  for (uint8_t i = 0; i < commonLength; i++) {
+    transmit(common[i]);
+  }
+  commonLength = 0;
+  return true;
+}
+
+void MidiMerge::stall() {
+  // One stall per episode, not per loop pass spent waiting
+  if (txStalled) return;
+  txStalled = true;
+  Stats::count(Stats::counters.txStalls);
+}
+
+bool MidiMerge::drainSysEx(uint8_t source) {
+  Queue& q = queues[source];
+  
+  while (used(q) > 0) {
+    if (txFree() == 0) {
+      stall();
+      return false;
+    }
+    byte data = q.buffer[q.tail];
+    q.tail = (q.tail + 1) & q.mask;
+    transmit(data);
+    txStalled = false;
+    
+    if (data == 0xF7) {
+      lockedSource = MERGE_SOURCE_NONE;
+      return true;
+    }
+  }
+  
+  // Source stopped mid-SysEx: terminate it so the other sources are not starved
+  if (q.inSysEx && (millis() - q.lastWrite) > MERGE_SYSEX_TIMEOUT_MS && txFree() > 0) {
+    transmit(0xF7);
+    q.inSysEx = false;
+    q.dropSysEx = true;
+    lockedSource = MERGE_SOURCE_NONE;
+    return true;
+  }
+  
+  return false;
+}
+
+void MidiMerge::update() {
+  // A system common message goes ahead of everything sent after it, but
+  // waits for the end of a SysEx; realtime bytes go anywhere
+  if (commonLength > 0 && lockedSource == MERGE_SOURCE_NONE && !flushCommon()) return;
+  
+  while (realtimeTail != realtimeHead && Serial1.availableForWrite() > 0) {
+    transmit(realtime[realtimeTail]);
+    realtimeTail = (realtimeTail + 1) & (MERGE_REALTIME_SIZE - 1);
+  }
+  
+  if (lockedSource != MERGE_SOURCE_NONE && !drainSysEx(lockedSource)) {
+    return;
+  }
+  if (commonLength > 0 && !flushCommon()) return;
+  
+  // Round-robin, one whole message per source per turn
+  uint8_t idle = 0;
+  while (idle < MERGE_SOURCE_COUNT) {
+    uint8_t source = nextSource;
+    Queue& q = queues[source];
+    nextSource = (nextSource + 1) % MERGE_SOURCE_COUNT;
+    
+    if (used(q) == 0) {
+      idle++;
+      continue;
+    }
+    idle = 0;
+    
+    byte status = q.buffer[q.tail];
+    
+    if (status == 0xF0) {
+      lockedSource = source;
+      if (!drainSysEx(source)) return;
+      continue;
+    }
+    
+    if (status < 0x80) {
+      q.tail = (q.tail + 1) & q.mask;  // never expected, resync on the next status
+      continue;
+    }
+    
+    uint8_t length = messageLength(status);
+    if (txFree() < length) {
+      nextSource = source;  // keep its turn
+      stall();
+      return;
+    }
+    
+    for (uint8_t i = 0; i < length; i++) {
+      transmit(q.buffer[q.tail]);
+      q.tail = (q.tail + 1) & q.mask;
+    }
+    txStalled = false;
+  }
+}
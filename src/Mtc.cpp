@@ -0,0 +1,315 @@
+/**
+ * MIDI BytePulse - MIDI Time Code Generator Implementation
+ */
+
+#include "Mtc.h"
+#include "ClockBus.h"
+#include "MidiHandler.h"
+#include "MidiMerge.h"
+#include "Scheduler.h"
+#include "Settings.h"
+#include "ThroughputMeter.h"
+#include "EventTrace.h"
+#include "UsbMidi.h"
+
+#if MTC_ENABLED
+
+#define MTC_DROP_FRAME_NUMERATOR  1001000000UL   // 29.97 fps: 1001 / 30000 s per frame
+
+uint8_t Mtc::rate = MTC_RATE_OFF;
+volatile bool Mtc::running = false;
+MtcTime Mtc::time;
+volatile uint8_t Mtc::piece = 0;
+unsigned long Mtc::nextDueUs = 0;
+uint32_t Mtc::fraction = 0;
+unsigned long Mtc::stepUs = 0;
+uint32_t Mtc::stepRemainder = 0;
+uint32_t Mtc::stepDivisor = 1;
+long Mtc::resumeOffsetUs = 0;
+volatile unsigned long Mtc::lastTickUs = 0;
+volatile unsigned long Mtc::periodUs = 0;
+bool Mtc::locateDeferred = false;
+uint32_t Mtc::deferredTicks = 0;
+byte Mtc::fullFrame[10];
+uint8_t Mtc::fullFrameSent = sizeof(Mtc::fullFrame);
+Mtc::Pending Mtc::pending[MTC_PENDING_SIZE];
+volatile uint8_t Mtc::pendingHead = 0;
+volatile uint8_t Mtc::pendingTail = 0;
+volatile uint8_t Mtc::pendingDIN = 0;
+
+static inline uint8_t framesPerSecond(uint8_t rate) {
+  return (rate == MTC_RATE_24) ? 24 : (rate == MTC_RATE_25) ? 25 : 30;
+}
+
+// One quarter frame lasts numerator / divisor microseconds
+static inline uint32_t stepNumerator(uint8_t rate) {
+  return (rate == MTC_RATE_2997_DROP) ? MTC_DROP_FRAME_NUMERATOR : 1000000UL;
+}
+
+static inline uint32_t stepDivisorFor(uint8_t rate) {
+  return (rate == MTC_RATE_2997_DROP) ? 120000UL : 4UL * framesPerSecond(rate);
+}
+
+void Mtc::begin() {
+  pendingHead = 0;
+  pendingTail = 0;
+  pendingDIN = 0;
+  lastTickUs = 0;
+  periodUs = 0;
+  running = false;
+  locateDeferred = false;
+  fullFrameSent = sizeof(fullFrame);
+  rate = Settings::data.mtcRate;
+  if (rate >= MTC_RATE_COUNT) rate = MTC_RATE_OFF;
+  if (rate != MTC_RATE_OFF) seek(0);
+}
+
+bool Mtc::setRate(uint8_t newRate) {
+  if (newRate >= MTC_RATE_COUNT) return false;
+  Scheduler::cancel(release);
+  running = false;
+  rate = newRate;
+  locate(0);
+  return true;
+}
+
+void Mtc::seek(uint64_t positionUs) {
+  Scheduler::cancel(release);
+  running = false;
+
+  stepDivisor = stepDivisorFor(rate);
+  uint32_t numerator = stepNumerator(rate);
+  stepUs = numerator / stepDivisor;
+  stepRemainder = numerator % stepDivisor;
+
+  // Quarter frames restart with piece 0 of the first 2-frame block at or after the position
+  uint32_t quarter = (positionUs * stepDivisor + numerator - 1) / numerator;
+  quarter = (quarter + 7) & ~7UL;
+  uint64_t quarterUs = (uint64_t)quarter * numerator;
+  fraction = quarterUs % stepDivisor;
+  resumeOffsetUs = (long)(quarterUs / stepDivisor - positionUs);
+
+  piece = 0;
+  frameToTime(rate, quarter / 4, time);
+}
+
+void Mtc::locate(uint64_t positionUs) {
+  if (rate == MTC_RATE_OFF) return;
+  locateDeferred = false;
+  seek(positionUs);
+  sendFullFrame();
+}
+
+void Mtc::locateTicks(uint32_t ticks) {
+  if (rate == MTC_RATE_OFF) return;
+
+  // No tempo yet to turn ticks into time: tick() locates once it has one
+  if (periodUs == 0) {
+    locateDeferred = true;
+    deferredTicks = ticks;
+    return;
+  }
+  locate((uint64_t)ticks * periodUs);
+}
+
+void Mtc::tick(unsigned long timestampUs) {
+  if (rate == MTC_RATE_OFF) return;
+
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  unsigned long interval = timestampUs - lastTickUs;
+  if (lastTickUs != 0 && interval < CLOCK_PERIOD_MAX_US) {
+    periodUs = (periodUs == 0) ? interval : (periodUs * 3 + interval) / 4;
+  }
+  lastTickUs = timestampUs;
+  SREG = oldSREG;
+
+  // Ticks that come before the period is known move the position on
+  if (locateDeferred) {
+    if (periodUs == 0) {
+      deferredTicks++;
+      return;
+    }
+    locate((uint64_t)deferredTicks * periodUs);
+  }
+
+  if (running) return;
+
+  // First tick after a locate or a hold: song time resumes here
+  nextDueUs = timestampUs + resumeOffsetUs;
+  running = true;
+  Scheduler::at(nextDueUs, release, 0);
+}
+
+void Mtc::hold() {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  if (running) {
+    Scheduler::cancel(release);
+    holdAt(nextDueUs);
+    EventTrace::log(EVENT_MTC_HOLD, CLOCK_SOURCE_NONE, 0);
+  }
+  SREG = oldSREG;
+}
+
+void Mtc::holdAt(unsigned long dueUs) {
+  // A Continue's first tick stands for the tick after the last one we saw
+  running = false;
+  resumeOffsetUs = (long)(dueUs - (lastTickUs + periodUs));
+}
+
+void Mtc::release(uint8_t unused) {
+  // Interrupt context
+  unsigned long dueUs = nextDueUs;
+
+  // Song time stops with the clock: run on at most one period past the next tick
+  unsigned long limitUs = periodUs ? 2 * periodUs : CLOCK_PERIOD_MAX_US;
+  if ((long)(dueUs - lastTickUs) > (long)limitUs) {
+    holdAt(dueUs);
+    EventTrace::log(EVENT_MTC_HOLD, CLOCK_SOURCE_NONE, 1);
+    return;
+  }
+
+  uint8_t data = quarterFrame(rate, time, piece);
+  bool dinSent = pendingDIN == 0 && writeDIN(data);
+  uint8_t next = (pendingHead + 1) & (MTC_PENDING_SIZE - 1);
+  if (next != pendingTail) {
+    pending[pendingHead].data = data;
+    pending[pendingHead].dinSent = dinSent;
+    pending[pendingHead].dueUs = dueUs;
+    pendingHead = next;
+    if (!dinSent) pendingDIN++;
+  }
+
+  if (++piece >= 8) {
+    piece = 0;
+    advanceTwoFrames(rate, time);
+  }
+
+  nextDueUs = dueUs + stepUs;
+  fraction += stepRemainder;
+  if (fraction >= stepDivisor) {
+    fraction -= stepDivisor;
+    nextDueUs++;
+  }
+  Scheduler::at(nextDueUs, release, 0);
+}
+
+bool Mtc::writeDIN(uint8_t data) {
+  // Interrupt context. Idle line and nothing buffered in HardwareSerial: F1
+  // goes straight to the shift register and the data byte into the transmit
+  // buffer it leaves empty, both ahead of anything loop() writes next
+  const uint8_t idle = _BV(UDRE1) | _BV(TXC1);
+  if ((UCSR1A & idle) != idle || (UCSR1B & _BV(UDRIE1)) || !MidiMerge::mayCutIn(MERGE_SOURCE_LOCAL)) {
+    return false;
+  }
+  UCSR1A |= _BV(TXC1);
+  UDR1 = 0xF1;
+  while (!(UCSR1A & _BV(UDRE1))) {}
+  UDR1 = data;
+  ThroughputMeter::countDirect(2);
+  return true;
+}
+
+void Mtc::update() {
+  bool framed = fullFrameSent >= sizeof(fullFrame) || sendFullFrameToUSB();
+  if (pendingHead == pendingTail) return;
+
+  while (pendingTail != pendingHead) {
+    const Pending& quarter = pending[pendingTail];
+    if (!quarter.dinSent) {
+      MidiMerge::send(MERGE_SOURCE_LOCAL, 0xF1, quarter.data, 0);
+      noInterrupts();
+      pendingDIN--;
+      interrupts();
+    }
+    // Not ahead of a full frame the host has yet to take; DIN does not wait for USB
+    if (framed) {
+      midiEventPacket_t event = {USB_MIDI_HEADER(USB_CABLE_CLOCK, 0x02), 0xF1, quarter.data, 0};
+      MIDIHandler::sendMessage(event, quarter.dueUs);
+    }
+    pendingTail = (pendingTail + 1) & (MTC_PENDING_SIZE - 1);
+  }
+  MIDIHandler::flushBuffer();
+}
+
+void Mtc::sendFullFrame() {
+  const byte frame[sizeof(fullFrame)] = {
+    0xF0, 0x7F, 0x7F, 0x01, 0x01,
+    (byte)(((rate - 1) << 5) | time.hours), time.minutes, time.seconds, time.frames,
+    0xF7
+  };
+  MidiMerge::sendSysEx(MERGE_SOURCE_LOCAL, frame, sizeof(frame));
+
+  memcpy(fullFrame, frame, sizeof(frame));
+  fullFrameSent = 0;
+  sendFullFrameToUSB();
+}
+
+bool Mtc::sendFullFrameToUSB() {
+  // Whatever the endpoint turns away goes from update() on a later pass
+  midiEventPacket_t event;
+  while (fullFrameSent < sizeof(fullFrame)) {
+    uint8_t remaining = sizeof(fullFrame) - fullFrameSent;
+    event.header = USB_MIDI_HEADER(USB_CABLE_CLOCK, (remaining <= 3) ? 0x04 + remaining : 0x04);
+    event.byte1 = fullFrame[fullFrameSent];
+    event.byte2 = (remaining > 1) ? fullFrame[fullFrameSent + 1] : 0;
+    event.byte3 = (remaining > 2) ? fullFrame[fullFrameSent + 2] : 0;
+    if (!MIDIHandler::sendMessage(event)) return false;
+    fullFrameSent += (remaining > 3) ? 3 : remaining;
+  }
+  MIDIHandler::flushBuffer();
+  return true;
+}
+
+void Mtc::frameToTime(uint8_t rate, uint32_t frame, MtcTime& time) {
+  uint8_t fps = framesPerSecond(rate);
+
+  // Drop frame: labels 0 and 1 are skipped each minute except every tenth,
+  // 18 labels per 17982 frames
+  if (rate == MTC_RATE_2997_DROP) {
+    uint32_t tens = frame / 17982;
+    uint16_t rest = frame % 17982;
+    frame += 18 * tens + ((rest >= 2) ? 2 * ((rest - 2) / 1798) : 0);
+  }
+
+  time.frames = frame % fps;
+  frame /= fps;
+  time.seconds = frame % 60;
+  frame /= 60;
+  time.minutes = frame % 60;
+  time.hours = (frame / 60) % 24;
+}
+
+void Mtc::advanceTwoFrames(uint8_t rate, MtcTime& time) {
+  uint8_t fps = framesPerSecond(rate);
+  time.frames += 2;
+  if (time.frames < fps) return;
+
+  time.frames -= fps;
+  if (++time.seconds >= 60) {
+    time.seconds = 0;
+    if (++time.minutes >= 60) {
+      time.minutes = 0;
+      if (++time.hours >= 24) time.hours = 0;
+    }
+    if (rate == MTC_RATE_2997_DROP && time.minutes % 10 != 0) time.frames += 2;
+  }
+}
+
+uint8_t Mtc::quarterFrame(uint8_t rate, const MtcTime& time, uint8_t piece) {
+  uint8_t nibble;
+  switch (piece) {
+    case 0: nibble = time.frames & 0x0F; break;
+    case 1: nibble = time.frames >> 4; break;
+    case 2: nibble = time.seconds & 0x0F; break;
+    case 3: nibble = time.seconds >> 4; break;
+    case 4: nibble = time.minutes & 0x0F; break;
+    case 5: nibble = time.minutes >> 4; break;
+    case 6: nibble = time.hours & 0x0F; break;
+    default: nibble = (time.hours >> 4) | ((rate - 1) << 1); break;
+  }
+  return (piece << 4) | nibble;
+}
+
+#endif  // MTC_ENABLED
@@ -0,0 +1,73 @@
+/**
+ * MIDI BytePulse - Idle Sleep and CPU Duty Cycle Implementation
+ */
+
+#include "Power.h"
+#include "MidiMerge.h"
+#include "ClockBus.h"
+#include "Mtc.h"
+#include "Stats.h"
+#include "config.h"
+#include <avr/sleep.h>
+
+volatile bool Power::sleeping = false;
+volatile unsigned long Power::wakeEventUs = 0;
+unsigned long Power::lastActivityMs = 0;
+unsigned long Power::windowStartUs = 0;
+unsigned long Power::windowSleptUs = 0;
+
+void Power::begin() {
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  windowStartUs = micros();
+  windowSleptUs = 0;
+}
+
+void Power::account(unsigned long nowUs) {
+  unsigned long elapsedUs = nowUs - windowStartUs;
+  if (elapsedUs < POWER_WINDOW_US) return;
+  
+  uint16_t busy = (elapsedUs - windowSleptUs) / (elapsedUs / 1000);
+  if (busy > 1000) busy = 1000;
+  Stats::counters.busyPermille = busy;
+  if (busy > Stats::counters.busyPeakPermille) Stats::counters.busyPeakPermille = busy;
+  
+  windowStartUs = nowUs;
+  windowSleptUs = 0;
+}
+
+void Power::idle(bool workPending) {
+  unsigned long startUs = micros();
+  account(startUs);
+  
+  #if IDLE_SLEEP_ENABLED
+  if (workPending || millis() - lastActivityMs < POWER_USB_HOLD_MS) return;
+  
+  // Checked with interrupts off: anything queued after this wakes the sleep
+  noInterrupts();
+  if (Serial1.available() || !MidiMerge::isIdle() || ClockBus::isPending() || Mtc::isPending()) {
+    interrupts();
+    return;
+  }
+  wakeEventUs = 0;
+  sleeping = true;
+  sleep_enable();
+  interrupts();  // SEI holds interrupts off for one more instruction: the SLEEP
+  sleep_cpu();
+  sleep_disable();
+  sleeping = false;
+  
+  unsigned long wakeUs = micros();
+  unsigned long sleptUs = wakeUs - startUs;
+  windowSleptUs += sleptUs;
+  if (sleptUs > Stats::counters.sleepMaxUs) {
+    Stats::counters.sleepMaxUs = min(sleptUs, 0xFFFFUL);
+  }
+  
+  noInterrupts();
+  unsigned long eventUs = wakeEventUs;
+  interrupts();
+  if (eventUs && wakeUs - eventUs > Stats::counters.wakeLatencyMaxUs) {
+    Stats::counters.wakeLatencyMaxUs = min(wakeUs - eventUs, 0xFFFFUL);
+  }
+  #endif
+}
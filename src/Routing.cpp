@@ -0,0 +1,61 @@
+/**
+ * MIDI BytePulse - Routing / Filter Matrix Implementation
+ */
+
+#include "Routing.h"
+#include "Settings.h"
+
+RouteRule Routing::rules[PORT_COUNT][PORT_COUNT];
+uint8_t Routing::typeRoutes[PORT_COUNT][ROUTE_TYPE_COUNT];
+uint8_t Routing::channelRoutes[PORT_COUNT][16];
+
+void Routing::begin() {
+  // Rules as saved, or the defaults (see Settings::defaults)
+  for (uint8_t source = 0; source < PORT_COUNT; source++) {
+    for (uint8_t destination = 0; destination < PORT_COUNT; destination++) {
+      setRule(source, destination, Settings::data.routeTypes[source][destination],
+              Settings::data.routeChannels[source][destination]);
+    }
+  }
+  compile();
+}
+
+void Routing::setRule(uint8_t source, uint8_t destination, uint32_t typeMask, uint16_t channelMask) {
+  if (source >= PORT_COUNT || destination >= PORT_COUNT) return;
+  rules[source][destination].typeMask = typeMask & ROUTE_TYPES_ALL;
+  rules[source][destination].channelMask = channelMask;
+}
+
+uint8_t Routing::getRules(uint8_t* buffer) {
+  memcpy(buffer, rules, sizeof(rules));
+  return sizeof(rules);
+}
+
+void Routing::compile() {
+  uint8_t types[PORT_COUNT][ROUTE_TYPE_COUNT];
+  uint8_t channels[PORT_COUNT][16];
+
+  for (uint8_t source = 0; source < PORT_COUNT; source++) {
+    for (uint8_t t = 0; t < ROUTE_TYPE_COUNT; t++) {
+      uint8_t mask = 0;
+      for (uint8_t destination = 0; destination < PORT_COUNT; destination++) {
+        if (rules[source][destination].typeMask & (1UL << t)) mask |= (1 << destination);
+      }
+      types[source][t] = mask;
+    }
+
+    for (uint8_t ch = 0; ch < 16; ch++) {
+      uint8_t mask = 0;
+      for (uint8_t destination = 0; destination < PORT_COUNT; destination++) {
+        if (rules[source][destination].channelMask & (1 << ch)) mask |= (1 << destination);
+      }
+      channels[source][ch] = mask;
+    }
+  }
+
+  // Swap the tables in one go so the hot path never sees a half-built matrix
+  noInterrupts();
+  memcpy(typeRoutes, types, sizeof(types));
+  memcpy(channelRoutes, channels, sizeof(channels));
+  interrupts();
+}
@@ -0,0 +1,92 @@
+/**
+ * MIDI BytePulse - Scheduled Output Queue Implementation
+ */
+
+#include "Scheduler.h"
+#include "Stats.h"
+#include "EventTrace.h"
+
+Scheduler::Event Scheduler::queue[SCHEDULER_QUEUE_SIZE];
+volatile uint8_t Scheduler::count = 0;
+
+ISR(TIMER1_COMPA_vect) {
+  Scheduler::service();
+}
+
+void Scheduler::begin() {
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = _BV(CS11);  // normal mode, clk/8: 0.5 us per count at 16 MHz
+  TIMSK1 &= ~_BV(OCIE1A);
+  count = 0;
+  interrupts();
+}
+
+bool Scheduler::at(unsigned long dueUs, ScheduledCallback callback, uint8_t arg) {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  
+  if (count >= SCHEDULER_QUEUE_SIZE) {
+    SREG = oldSREG;
+    Stats::count(Stats::counters.schedulerDrops);
+    EventTrace::repeat(EVENT_SCHEDULER_DROP, 0);
+    return false;
+  }
+  
+  // Keep the queue sorted by due time; the head is always the next event
+  uint8_t i = count;
+  while (i > 0 && (long)(queue[i - 1].dueUs - dueUs) > 0) {
+    queue[i] = queue[i - 1];
+    i--;
+  }
+  queue[i].dueUs = dueUs;
+  queue[i].callback = callback;
+  queue[i].arg = arg;
+  count++;
+  
+  if (i == 0) arm();
+  SREG = oldSREG;
+  return true;
+}
+
+void Scheduler::cancel(ScheduledCallback callback) {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    if (queue[i].callback != callback) queue[kept++] = queue[i];
+  }
+  count = kept;
+  arm();
+  
+  SREG = oldSREG;
+}
+
+void Scheduler::service() {
+  while (count > 0 && (long)(queue[0].dueUs - micros()) <= SCHEDULER_EARLY_US) {
+    Event event = queue[0];
+    count--;
+    for (uint8_t i = 0; i < count; i++) {
+      queue[i] = queue[i + 1];
+    }
+    event.callback(event.arg);  // may schedule follow-up events
+  }
+  arm();
+}
+
+void Scheduler::arm() {
+  // Interrupts are off here
+  if (count == 0) {
+    TIMSK1 &= ~_BV(OCIE1A);
+    return;
+  }
+  
+  long remaining = (long)(queue[0].dueUs - micros());
+  if (remaining < 2) remaining = 2;
+  if (remaining > SCHEDULER_WINDOW_US) remaining = SCHEDULER_WINDOW_US;
+  
+  OCR1A = TCNT1 + (uint16_t)(remaining * 2);
+  TIFR1 = _BV(OCF1A);
+  TIMSK1 |= _BV(OCIE1A);
+}
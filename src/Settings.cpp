@@ -0,0 +1,131 @@
+/**
+ * MIDI BytePulse - Persistent Settings Implementation
+ */
+
+#include "Settings.h"
+#include "ClockBus.h"
+#include "Stats.h"
+#include "config.h"
+#include <avr/eeprom.h>
+
+static_assert(sizeof(SettingsRecord) <= SETTINGS_SLOT_SIZE, "settings record does not fit its slot");
+static_assert(SETTINGS_SLOT_SIZE * SETTINGS_SLOT_COUNT <= E2END + 1, "settings log does not fit the EEPROM");
+
+SettingsData Settings::data;
+SettingsRecord Settings::staged;
+uint8_t Settings::slot = SETTINGS_SLOT_COUNT - 1;   // the first save goes to slot 0
+uint16_t Settings::sequence = 0;
+uint8_t Settings::savePos = sizeof(SettingsRecord);
+bool Settings::dirty = false;
+unsigned long Settings::changedMs = 0;
+
+static inline uint8_t* slotAddress(uint8_t index) {
+  return (uint8_t*)((uintptr_t)index * SETTINGS_SLOT_SIZE);
+}
+
+// Sequence numbers wrap; a is newer when it is less than half the range ahead
+static inline bool isNewer(uint16_t a, uint16_t b) {
+  return (int16_t)(a - b) > 0;
+}
+
+void Settings::defaults() {
+  memset(&data, 0, sizeof(data));
+  data.syncInPPQN = SYNC_IN_PPQN;
+  data.timeoutPeriods = 3;
+  data.syncPulseWidthUs = CLOCK_PULSE_WIDTH_US;
+
+  // DIN IN -> USB everything, USB -> DIN OUT channel messages and
+  // clock/transport, no DIN IN -> DIN OUT thru
+  data.routeTypes[PORT_DIN][PORT_USB] = ROUTE_TYPES_ALL;
+  data.routeTypes[PORT_USB][PORT_DIN] = ROUTE_TYPES_CHANNEL | ROUTE_TYPES_TRANSPORT;
+  for (uint8_t source = 0; source < PORT_COUNT; source++) {
+    for (uint8_t destination = 0; destination < PORT_COUNT; destination++) {
+      data.routeChannels[source][destination] = ROUTE_CHANNELS_ALL;
+    }
+  }
+}
+
+void Settings::load() {
+  unsigned long startUs = micros();
+  defaults();
+
+  // Slots holding a record of this version, newest first, from the headers alone
+  uint8_t order[SETTINGS_SLOT_COUNT];
+  uint16_t sequences[SETTINGS_SLOT_COUNT];
+  uint8_t count = 0;
+
+  for (uint8_t i = 0; i < SETTINGS_SLOT_COUNT; i++) {
+    if (eeprom_read_byte(slotAddress(i)) != SETTINGS_VERSION) continue;
+    uint16_t recordSequence = eeprom_read_word((const uint16_t*)(slotAddress(i) + offsetof(SettingsRecord, sequence)));
+
+    uint8_t pos = count++;
+    while (pos > 0 && isNewer(recordSequence, sequences[pos - 1])) {
+      order[pos] = order[pos - 1];
+      sequences[pos] = sequences[pos - 1];
+      pos--;
+    }
+    order[pos] = i;
+    sequences[pos] = recordSequence;
+  }
+
+  // Usually the newest checks out; a torn save falls back to the one before
+  for (uint8_t i = 0; i < count; i++) {
+    if (readSlot(order[i], staged)) {
+      data = staged.data;
+      slot = order[i];
+      sequence = staged.sequence;
+      break;
+    }
+  }
+
+  Stats::counters.settingsLoadUs = micros() - startUs;
+}
+
+void Settings::reset() {
+  defaults();
+  changed();
+}
+
+void Settings::changed() {
+  dirty = true;
+  changedMs = millis();
+}
+
+void Settings::update() {
+  if (isSaving()) {
+    // One byte per pass, once the EEPROM has finished the previous one
+    if (!eeprom_is_ready()) return;
+    eeprom_update_byte(slotAddress(slot) + savePos, ((const uint8_t*)&staged)[savePos]);
+    savePos++;
+    return;
+  }
+
+  if (!dirty || millis() - changedMs < SETTINGS_SAVE_DELAY_MS) return;
+  dirty = false;
+
+  slot = (slot + 1) % SETTINGS_SLOT_COUNT;
+  staged.version = SETTINGS_VERSION;
+  staged.reserved = 0;
+  staged.sequence = ++sequence;
+  staged.data = data;
+  staged.crc = crc((const uint8_t*)&staged, offsetof(SettingsRecord, crc));
+  staged.unused[0] = staged.unused[1] = 0xFF;
+  savePos = 0;
+}
+
+uint16_t Settings::crc(const uint8_t* bytes, uint8_t length) {
+  uint16_t value = 0xFFFF;
+  for (uint8_t i = 0; i < length; i++) {
+    value ^= (uint16_t)bytes[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      value = (value & 0x8000) ? (value << 1) ^ 0x1021 : value << 1;
+    }
+  }
+  return value;
+}
+
+bool Settings::readSlot(uint8_t index, SettingsRecord& record) {
+  eeprom_read_block(&record, slotAddress(index), sizeof(record));
+  return record.version == SETTINGS_VERSION &&
+         record.crc == crc((const uint8_t*)&record, offsetof(SettingsRecord, crc));
+}
@@ -0,0 +1,27 @@
+/**
+ * MIDI BytePulse - Pipeline Counters Implementation
+ */
+
+#include "Stats.h"
+
+StatsCounters Stats::counters;
+
+void Stats::reset() {
+  noInterrupts();
+  uint32_t bootReadyUs = counters.bootReadyUs;
+  uint32_t firstForwardUs = counters.firstForwardUs;
+  uint16_t settingsLoadUs = counters.settingsLoadUs;
+  memset(&counters, 0, sizeof(counters));
+  counters.bootReadyUs = bootReadyUs;
+  counters.firstForwardUs = firstForwardUs;
+  counters.settingsLoadUs = settingsLoadUs;
+  interrupts();
+}
+
+uint8_t Stats::snapshot(uint8_t* buffer) {
+  // Copy under a short critical section so a dump never sees half an update
+  noInterrupts();
+  memcpy(buffer, &counters, sizeof(counters));
+  interrupts();
+  return sizeof(counters);
+}
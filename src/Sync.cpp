@@ -1,31 +1,31 @@
 #include "Sync.h"
 #include "Display.h"
 #include "config.h"
-#include <MIDIUSB.h>
-#include <MIDI.h>
+#include "ClockBus.h"
+#include "Stats.h"
+#include "CycleProbe.h"
+#include "ClockCompare.h"
+#include "JitterMeter.h"
+#include "Settings.h"
+#include "Mtc.h"
+#include "EventTrace.h"
 
-extern midi::MidiInterface<midi::SerialMIDI<HardwareSerial>> MIDI_DIN;
-
-#define PULSE_WIDTH_US 5000
 #define PULSE_WIDTH_MIN_MS 10
 #define PULSE_WIDTH_MAX_MS 100
 unsigned long ledPulseWidth = PULSE_WIDTH_MIN_MS;
 #define PPQN 24
+#define SYNC_IN_LEAD_US 2000   // hand interpolated ticks to the scheduler this early
 
 void Sync::begin() {
-  pinMode(SYNC_OUT_PIN, OUTPUT);
-  pinMode(SYNC_OUT_DETECT_PIN, INPUT_PULLUP);
   pinMode(SYNC_IN_PIN, INPUT_PULLUP);
   pinMode(SYNC_IN_DETECT_PIN, INPUT_PULLUP);
   pinMode(LED_BEAT_PIN, OUTPUT);
-  digitalWrite(SYNC_OUT_PIN, LOW);
   digitalWrite(LED_BEAT_PIN, LOW);
   
   ppqnCounter = 0;
   isPlaying = false;
   usbIsPlaying = false;
   syncInIsPlaying = false;
-  clockState = false;
   ledState = false;
   activeSource = CLOCK_SOURCE_NONE;
   lastUSBClockTime = 0;
@@ -38,6 +38,8 @@ void Sync::begin() {
   prevSyncInTime = 0;
   avgSyncInInterval = 0;
   syncInPulseTime = 0;
+  syncInPPQN = Settings::data.syncInPPQN;
+  interpolateRemaining = 0;
   beatPosition = 0;
   lastBeatTime = 0;
   currentBPM = 0;
@@ -46,12 +48,19 @@ void Sync::begin() {
 
 void Sync::handleSyncInPulse() {
   if (!isSyncInConnected()) return;
-  syncInPulseTime = millis();
+  syncInPulseTime = micros();
+  if (!syncInIsPlaying) EventTrace::logAt(syncInPulseTime, EVENT_SYNC_IN_EDGE, CLOCK_SOURCE_SYNC_IN);
 }
 
 void Sync::handleClock(ClockSource source) {
+  CYCLE_PROBE(PROBE_SYNC_HANDLE_CLOCK);
+  unsigned long timestampUs = micros();
   unsigned long now = millis();
   
+  Stats::count(Stats::counters.clockTicks[source]);
+  ClockCompare::tick(source, timestampUs);
+  if (!(stoppedSources & (1 << source))) songTicks[source]++;
+  
   if (source == CLOCK_SOURCE_DIN && (activeSource == CLOCK_SOURCE_USB || activeSource == CLOCK_SOURCE_SYNC_IN)) {
     return;
   }
@@ -72,7 +81,7 @@ void Sync::handleClock(ClockSource source) {
     
     prevUSBClockTime = now;
     lastUSBClockTime = now;
-    activeSource = CLOCK_SOURCE_USB;
+    setActiveSource(CLOCK_SOURCE_USB);
   }
   
   if (source == CLOCK_SOURCE_DIN && activeSource != CLOCK_SOURCE_USB) {
@@ -88,13 +97,13 @@ void Sync::handleClock(ClockSource source) {
     
     prevDINClockTime = now;
     lastDINClockTime = now;
-    activeSource = CLOCK_SOURCE_DIN;
+    setActiveSource(CLOCK_SOURCE_DIN);
   }
   
   if (source == CLOCK_SOURCE_USB && !usbIsPlaying) {
     usbIsPlaying = true;
     isPlaying = true;
-    activeSource = CLOCK_SOURCE_USB;
+    setActiveSource(CLOCK_SOURCE_USB);
     ppqnCounter = 0;
     lastUSBClockTime = millis();
     prevUSBClockTime = 0;
@@ -108,7 +117,7 @@ void Sync::handleClock(ClockSource source) {
   if (source == CLOCK_SOURCE_DIN && activeSource != CLOCK_SOURCE_USB) {
     if (!isPlaying) {
       isPlaying = true;
-      activeSource = CLOCK_SOURCE_DIN;
+      setActiveSource(CLOCK_SOURCE_DIN);
       ppqnCounter = 0;
       lastDINClockTime = millis();
       prevDINClockTime = 0;
@@ -118,16 +127,14 @@ void Sync::handleClock(ClockSource source) {
   
   if (!isPlaying) return;
   
+  outputTicks++;
+  JitterMeter::tick(timestampUs);
+  ClockBus::tick(source, timestampUs);
+  
   if (display) {
     display->advanceAnimation();
   }
   
-  if (isSyncOutConnected()) {
-    digitalWrite(SYNC_OUT_PIN, HIGH);
-    clockState = true;
-    lastPulseTime = micros();
-  }
-  
   if (ppqnCounter == 0) {
     unsigned long now = millis();
     if (!ledState) {
@@ -177,59 +184,83 @@ void Sync::handleClock(ClockSource source) {
 }
 
 void Sync::handleStart(ClockSource source) {
+  startPlayback(source, 0xFA);
+}
+
+void Sync::handleContinue(ClockSource source) {
+  startPlayback(source, 0xFB);
+}
+
+void Sync::startPlayback(ClockSource source, byte status) {
+  stoppedSources &= ~(1 << source);
+  if (status == 0xFA) songTicks[source] = 0;
+  EventTrace::log((status == 0xFA) ? EVENT_START : EVENT_CONTINUE, source, acceptsTransport(source));
+  if (!acceptsTransport(source)) return;
+  
   if (source == CLOCK_SOURCE_USB) {
     usbIsPlaying = true;
-    activeSource = CLOCK_SOURCE_USB;
     lastUSBClockTime = millis();
     prevUSBClockTime = 0;
     avgUSBClockInterval = 0;
-    isPlaying = true;
-    ppqnCounter = 0;
-    beatPosition = 0;
-    lastBeatTime = 0;
-    lastDisplayedBPM = 0;
-    
-    MIDI_DIN.sendRealTime(midi::Start);
-    
-    if (onClockStart) {
-      onClockStart();
-    }
-    
-    return;
   }
+  setActiveSource(source);
+  isPlaying = true;
+  lastBeatTime = 0;
+  lastDisplayedBPM = 0;
   
-  if (source == CLOCK_SOURCE_DIN && usbIsPlaying) {
-    return;
+  // Continue keeps the beat phase; outputs somewhere else are relocated first
+  uint32_t ticks = songTicks[source];
+  if (status == 0xFB && outputTicks != ticks) {
+    ClockBus::songPosition(source, ticks / CLOCK_TICKS_PER_STEP);
   }
+  outputTicks = ticks;
+  setPhase(ticks);
+  ClockBus::locate(ticks);
   
-  if (source == CLOCK_SOURCE_DIN && !usbIsPlaying) {
-    activeSource = CLOCK_SOURCE_DIN;
-    isPlaying = true;
-    ppqnCounter = 0;
-    beatPosition = 0;
-    lastBeatTime = 0;
-    lastDisplayedBPM = 0;
-    
-    MIDI_DIN.sendRealTime(midi::Start);
-    
-    if (onClockStart) {
-      onClockStart();
-    }
+  ClockBus::transport(source, status);
+  
+  if (onClockStart) {
+    onClockStart();
   }
 }
 
+void Sync::handleSongPosition(ClockSource source, uint16_t position) {
+  songTicks[source] = (uint32_t)position * CLOCK_TICKS_PER_STEP;
+  EventTrace::log(EVENT_SONG_POSITION, source, position);
+  if (!acceptsTransport(source)) return;
+  
+  outputTicks = songTicks[source];
+  setPhase(outputTicks);
+  ClockBus::locate(outputTicks);
+  ClockBus::songPosition(source, position);
+}
+
+bool Sync::acceptsTransport(ClockSource source) const {
+  // DIN transport is ignored while USB plays
+  return source == CLOCK_SOURCE_USB || (source == CLOCK_SOURCE_DIN && !usbIsPlaying);
+}
+
+void Sync::setPhase(uint32_t ticks) {
+  // ticks is the position of the next clock tick
+  ppqnCounter = ticks % PPQN;
+  beatPosition = ((ticks + PPQN - 1) / PPQN) % 4;
+}
+
 void Sync::handleStop(ClockSource source) {
+  stoppedSources |= 1 << source;
+  EventTrace::log(EVENT_STOP, source, acceptsTransport(source));
+  
   if (source == CLOCK_SOURCE_USB) {
     usbIsPlaying = false;
     isPlaying = false;
-    activeSource = CLOCK_SOURCE_NONE;
+    setActiveSource(CLOCK_SOURCE_NONE);
     avgUSBClockInterval = 0;
     prevUSBClockTime = 0;
     ppqnCounter = 0;
     beatPosition = 0;
     lastBeatTime = 0;
     
-    MIDI_DIN.sendRealTime(midi::Stop);
+    ClockBus::transport(source, 0xFC);
     
     if (onClockStop) {
       onClockStop();
@@ -243,18 +274,16 @@ void Sync::handleStop(ClockSource source) {
   }
   
   if (source == CLOCK_SOURCE_DIN && !usbIsPlaying) {
-    activeSource = CLOCK_SOURCE_NONE;
+    setActiveSource(CLOCK_SOURCE_NONE);
     isPlaying = false;
     ppqnCounter = 0;
     beatPosition = 0;
     lastBeatTime = 0;
     
-    digitalWrite(SYNC_OUT_PIN, LOW);
     digitalWrite(LED_BEAT_PIN, LOW);
-    clockState = false;
     ledState = false;
     
-    MIDI_DIN.sendRealTime(midi::Stop);
+    ClockBus::transport(source, 0xFC);
     
     if (onClockStop) {
       onClockStop();
@@ -263,16 +292,26 @@ void Sync::handleStop(ClockSource source) {
 }
 
 void Sync::update() {
-  unsigned long currentTime = micros();
+  CYCLE_PROBE(PROBE_SYNC_UPDATE);
+  noInterrupts();
+  unsigned long pulseTime = syncInPulseTime;
+  syncInPulseTime = 0;
+  interrupts();
   
-  if (syncInPulseTime > 0) {
-    unsigned long pulseTime = syncInPulseTime;
-    syncInPulseTime = 0;
+  if (pulseTime > 0) {
+    ClockCompare::tick(CLOCK_SOURCE_SYNC_IN, pulseTime, PPQN / syncInPPQN);
     
     if (!syncInIsPlaying) {
       syncInIsPlaying = true;
       isPlaying = true;
-      activeSource = CLOCK_SOURCE_SYNC_IN;
+      EventTrace::logAt(pulseTime, EVENT_START, CLOCK_SOURCE_SYNC_IN, 1);
+      setActiveSource(CLOCK_SOURCE_SYNC_IN);
+      ClockBus::resetPosition();
+      #if MTC_ENABLED
+      Mtc::locate(0);
+      #endif
+      songTicks[CLOCK_SOURCE_SYNC_IN] = 0;
+      outputTicks = 0;
       ppqnCounter = 0;
       lastSyncInTime = pulseTime;
       prevSyncInTime = 0;
@@ -286,71 +325,52 @@ void Sync::update() {
       }
     }
     
-    sendMIDIClock();
-    
-    if (display) {
-      display->advanceAnimation();
+    if (prevSyncInTime > 0) {
+      unsigned long interval = pulseTime - prevSyncInTime;
+      avgSyncInInterval = (avgSyncInInterval == 0) ? interval : (avgSyncInInterval * 3 + interval) / 4;
     }
-    
-    if (isSyncOutConnected()) {
-      digitalWrite(SYNC_OUT_PIN, HIGH);
-      clockState = true;
-      lastPulseTime = currentTime;
+    prevSyncInTime = pulseTime;
+    lastSyncInTime = pulseTime;
+    if (activeSource == CLOCK_SOURCE_SYNC_IN) {
+      JitterMeter::tick(pulseTime, PPQN / syncInPPQN);
     }
     
-    if (syncInIsPlaying) {
-      if (prevSyncInTime > 0) {
-        unsigned long interval = pulseTime - prevSyncInTime;
-        avgSyncInInterval = (avgSyncInInterval == 0) ? interval : (avgSyncInInterval * 3 + interval) / 4;
-      }
-      prevSyncInTime = pulseTime;
-      lastSyncInTime = pulseTime;
-      
-      if (ppqnCounter == 0) {
-        digitalWrite(LED_BEAT_PIN, HIGH);
-        ledState = true;
-        if (!clockState) lastPulseTime = currentTime;
-        
-        unsigned long now = millis();
-        if (beatPosition == 3) {
-          if (lastBeatTime > 0) {
-            unsigned long interval = now - lastBeatTime;
-            currentBPM = 240000UL / interval;
-            
-            #if SERIAL_DEBUG
-            if (abs((int)currentBPM - (int)lastDisplayedBPM) > 2) {
-              DEBUG_PRINT("BPM: ");
-              DEBUG_PRINTLN(currentBPM);
-              lastDisplayedBPM = currentBPM;
-              
-              if (onBPMUpdate) {
-                onBPMUpdate(currentBPM);
-              }
-            }
-            #else
-            if (abs((int)currentBPM - (int)lastDisplayedBPM) > 2) {
-              lastDisplayedBPM = currentBPM;
-              if (onBPMUpdate) {
-                onBPMUpdate(currentBPM);
-              }
-            }
-            #endif
-          }
-          lastBeatTime = now;
-        }
-        beatPosition = (beatPosition + 1) % 4;
-      }
-      
-      ppqnCounter++;
-      if (ppqnCounter >= PPQN) ppqnCounter = 0;
+    // Ticks the interpolation did not reach (the tempo went up, or no period
+    // was known yet) are dropped rather than sent in a burst; the counters
+    // skip them so the pulse still lands on its beat
+    byte ticksPerPulse = PPQN / syncInPPQN;
+    byte skipped = (ticksPerPulse - ppqnCounter % ticksPerPulse) % ticksPerPulse;
+    songTicks[CLOCK_SOURCE_SYNC_IN] += skipped;
+    ppqnCounter = (ppqnCounter + skipped) % PPQN;
+    interpolateRemaining = 0;
+    
+    handleSyncInTick(pulseTime);
+    
+    // Armed once the pulse period is known
+    if (avgSyncInInterval > 0) {
+      interpolateRemaining = ticksPerPulse - 1;
+      interpolateStepUs = avgSyncInInterval / ticksPerPulse;
+      interpolateNextUs = pulseTime + interpolateStepUs;
     }
   }
   
+  // Interpolated ticks are handed to the clock bus just before they are due;
+  // the scheduler releases them on time
+  if (interpolateRemaining > 0 &&
+      (long)(interpolateNextUs - micros()) <= SYNC_IN_LEAD_US) {
+    interpolateRemaining--;
+    handleSyncInTick(interpolateNextUs);
+    interpolateNextUs += interpolateStepUs;
+  }
+  
   if (syncInIsPlaying) {
     if (!isSyncInConnected()) {
+      EventTrace::log(EVENT_UNPLUGGED, CLOCK_SOURCE_SYNC_IN);
       syncInIsPlaying = false;
+      interpolateRemaining = 0;
       if (activeSource == CLOCK_SOURCE_SYNC_IN) {
-        activeSource = CLOCK_SOURCE_NONE;
+        ClockBus::sourceLost();
+        setActiveSource(CLOCK_SOURCE_NONE);
         isPlaying = false;
         ppqnCounter = 0;
         avgSyncInInterval = 0;
@@ -363,10 +383,13 @@ void Sync::update() {
         }
       }
     }
-    else if (avgSyncInInterval > 0 && (millis() - lastSyncInTime) > (avgSyncInInterval * 3)) {
+    else if (avgSyncInInterval > 0 && (micros() - lastSyncInTime) > (avgSyncInInterval * Settings::data.timeoutPeriods)) {
+      EventTrace::log(EVENT_TIMEOUT, CLOCK_SOURCE_SYNC_IN, (micros() - lastSyncInTime) / 1000);
       syncInIsPlaying = false;
+      interpolateRemaining = 0;
       if (activeSource == CLOCK_SOURCE_SYNC_IN) {
-        activeSource = CLOCK_SOURCE_NONE;
+        ClockBus::sourceLost();
+        setActiveSource(CLOCK_SOURCE_NONE);
         isPlaying = false;
         ppqnCounter = 0;
         beatPosition = 0;
@@ -381,10 +404,6 @@ void Sync::update() {
   
   checkUSBTimeout();
   
-  if (clockState && (currentTime - lastPulseTime >= PULSE_WIDTH_US)) {
-    digitalWrite(SYNC_OUT_PIN, LOW);
-    clockState = false;
-  }
   // LED beat pulse using millis for stability, with dynamic width
   if (ledState && (millis() - lastPulseTime >= ledPulseWidth)) {
     digitalWrite(LED_BEAT_PIN, LOW);
@@ -392,14 +411,74 @@ void Sync::update() {
   }
 }
 
+void Sync::handleSyncInTick(unsigned long timestampUs) {
+  Stats::count(Stats::counters.clockTicks[CLOCK_SOURCE_SYNC_IN]);
+  songTicks[CLOCK_SOURCE_SYNC_IN]++;
+  outputTicks++;
+  
+  ClockBus::tick(CLOCK_SOURCE_SYNC_IN, timestampUs);
+  
+  if (display) {
+    display->advanceAnimation();
+  }
+  
+  if (ppqnCounter == 0) {
+    unsigned long now = millis();
+    digitalWrite(LED_BEAT_PIN, HIGH);
+    ledState = true;
+    lastPulseTime = now;
+    
+    if (beatPosition == 3) {
+      if (lastBeatTime > 0) {
+        unsigned long interval = now - lastBeatTime;
+        currentBPM = 240000UL / interval;
+        
+        #if SERIAL_DEBUG
+        if (abs((int)currentBPM - (int)lastDisplayedBPM) > 2) {
+          DEBUG_PRINT("BPM: ");
+          DEBUG_PRINTLN(currentBPM);
+          lastDisplayedBPM = currentBPM;
+          
+          if (onBPMUpdate) {
+            onBPMUpdate(currentBPM);
+          }
+        }
+        #else
+        if (abs((int)currentBPM - (int)lastDisplayedBPM) > 2) {
+          lastDisplayedBPM = currentBPM;
+          if (onBPMUpdate) {
+            onBPMUpdate(currentBPM);
+          }
+        }
+        #endif
+      }
+      lastBeatTime = now;
+    }
+    beatPosition = (beatPosition + 1) % 4;
+  }
+  
+  ppqnCounter++;
+  if (ppqnCounter >= PPQN) ppqnCounter = 0;
+}
+
+bool Sync::setSyncInPPQN(byte ppqn) {
+  // Only divisors of 24 keep beats on real pulses
+  if (ppqn == 0 || ppqn > PPQN || (PPQN % ppqn) != 0) return false;
+  syncInPPQN = ppqn;
+  interpolateRemaining = 0;
+  return true;
+}
+
 void Sync::checkUSBTimeout() {
   if (!usbIsPlaying || avgUSBClockInterval == 0) return;
   
   unsigned long now = millis();
-  if ((now - lastUSBClockTime) > (avgUSBClockInterval * 3)) {
+  if ((now - lastUSBClockTime) > (avgUSBClockInterval * Settings::data.timeoutPeriods)) {
+    EventTrace::log(EVENT_TIMEOUT, CLOCK_SOURCE_USB, now - lastUSBClockTime);
     usbIsPlaying = false;
     isPlaying = false;
-    activeSource = CLOCK_SOURCE_NONE;
+    if (activeSource == CLOCK_SOURCE_USB) ClockBus::sourceLost();
+    setActiveSource(CLOCK_SOURCE_NONE);
     avgUSBClockInterval = 0;
     prevUSBClockTime = 0;
     ppqnCounter = 0;
@@ -412,16 +491,19 @@ void Sync::checkUSBTimeout() {
   }
 }
 
-bool Sync::isSyncOutConnected() {
-  return digitalRead(SYNC_OUT_DETECT_PIN) == HIGH;
-}
-
 bool Sync::isSyncInConnected() {
   return digitalRead(SYNC_IN_DETECT_PIN) == HIGH;
 }
 
-void Sync::sendMIDIClock() {
-  midiEventPacket_t clockEvent = {0x0F, 0xF8, 0, 0};
-  MidiUSB.sendMIDI(clockEvent);
-  MIDI_DIN.sendRealTime(midi::Clock);
+void Sync::setActiveSource(ClockSource source) {
+  if (source != activeSource && source != CLOCK_SOURCE_NONE) {
+    Stats::count(Stats::counters.sourceSwitches);
+  }
+  if (source != activeSource) {
+    #if CLOCK_ANALYSIS_ENABLED
+    JitterMeter::follow(source);
+    #endif
+    EventTrace::log(EVENT_SOURCE, source, activeSource);
+  }
+  activeSource = source;
 }
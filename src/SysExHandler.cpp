@@ -0,0 +1,345 @@
+/**
+ * MIDI BytePulse - SysEx Remote Queries Implementation
+ */
+
+#include "SysExHandler.h"
+#include "MidiHandler.h"
+#include "Stats.h"
+#include "Routing.h"
+#include "Transform.h"
+#include "ClockBus.h"
+#include "Sync.h"
+#include "ClockCompare.h"
+#include "JitterMeter.h"
+#include "Settings.h"
+#include "Mtc.h"
+#include "EventTrace.h"
+#include "config.h"
+
+#if SYSEX_ENABLED
+
+void SysExHandler::begin() {
+  rxLength = 0;
+  rxActive = false;
+  rxOverflow = false;
+  txStage = TX_IDLE;
+  txPacket.header = 0;
+}
+
+void SysExHandler::handleUSBPacket(const midiEventPacket_t& event) {
+  byte length;
+  switch (event.header & 0x0F) {
+    case 0x04: length = 3; break;  // SysEx start / continue
+    case 0x05: length = 1; break;  // SysEx end with 1 byte
+    case 0x06: length = 2; break;  // SysEx end with 2 bytes
+    case 0x07: length = 3; break;  // SysEx end with 3 bytes
+    default: return;
+  }
+
+  receiveByte(event.byte1);
+  if (length > 1) receiveByte(event.byte2);
+  if (length > 2) receiveByte(event.byte3);
+}
+
+void SysExHandler::receiveByte(byte data) {
+  if (data == 0xF0) {
+    rxActive = true;
+    rxOverflow = false;
+    rxLength = 0;
+    return;
+  }
+
+  if (data == 0xF7) {
+    if (rxActive && !rxOverflow) {
+      dispatch();
+    }
+    rxActive = false;
+    return;
+  }
+
+  if (data & 0x80) {
+    rxActive = false;
+    Stats::count(Stats::counters.parserErrors);
+    return;
+  }
+
+  if (!rxActive) return;
+
+  if (rxLength < SYSEX_RX_BUFFER_SIZE) {
+    rxBuffer[rxLength++] = data;
+  } else {
+    rxOverflow = true;
+  }
+}
+
+static_assert(sizeof(RouteRule) * PORT_COUNT * PORT_COUNT <= SYSEX_REPLY_BUFFER_SIZE, "routing dump does not fit the reply buffer");
+#if CLOCK_ANALYSIS_ENABLED
+static_assert(sizeof(CompareResult) <= SYSEX_REPLY_BUFFER_SIZE, "comparison dump does not fit the reply buffer");
+static_assert(sizeof(JitterResult) <= SYSEX_REPLY_BUFFER_SIZE, "jitter dump does not fit the reply buffer");
+#endif
+static_assert(sizeof(SettingsData) <= SYSEX_REPLY_BUFFER_SIZE, "settings dump does not fit the reply buffer");
+
+void SysExHandler::dispatch() {
+  if (rxLength < 3) return;
+  if (rxBuffer[0] != SYSEX_MANUFACTURER_ID || rxBuffer[1] != SYSEX_DEVICE_ID) return;
+  if (txStage != TX_IDLE) return;  // one reply in flight at a time
+
+  byte command = rxBuffer[2];
+
+  switch (command) {
+    case SYSEX_CMD_GET_COUNTERS: {
+      uint8_t length = Stats::snapshot(replyBuffer);
+      startReply(command, replyBuffer, length);
+      break;
+    }
+    case SYSEX_CMD_RESET_COUNTERS:
+      Stats::reset();
+      startReply(command, nullptr, 0);
+      break;
+      
+    case SYSEX_CMD_SET_ROUTE: {
+      // F0 7D 42 03 <src> <dst> <type mask: 4 septets> <channel mask: 3 septets> F7
+      if (rxLength < 12 || rxBuffer[3] >= PORT_COUNT || rxBuffer[4] >= PORT_COUNT) return;
+      uint32_t typeMask = readSeptets(5, 4) & ROUTE_TYPES_ALL;
+      uint16_t channelMask = readSeptets(9, 3);
+      Routing::setRule(rxBuffer[3], rxBuffer[4], typeMask, channelMask);
+      Routing::compile();
+      Settings::data.routeTypes[rxBuffer[3]][rxBuffer[4]] = typeMask;
+      Settings::data.routeChannels[rxBuffer[3]][rxBuffer[4]] = channelMask;
+      Settings::changed();
+      startReply(command, nullptr, 0);
+      break;
+    }
+      
+    case SYSEX_CMD_GET_ROUTES: {
+      uint8_t length = Routing::getRules(replyBuffer);
+      startReply(command, replyBuffer, length);
+      break;
+    }
+      
+    #if MIDI_TRANSFORM_ENABLED
+    case SYSEX_CMD_SET_TRANSFORM: {
+      // F0 7D 42 05 <port> <enable> <transpose+64> <low> <high> <split note> <split ch>
+      //             <velocity curve> <cc number> <cc curve> <16 x channel map> F7
+      if (rxLength < 29) return;
+      TransformSettings settings;
+      settings.enabled = rxBuffer[4] != 0;
+      settings.transpose = (int8_t)rxBuffer[5] - 64;
+      settings.noteLow = rxBuffer[6];
+      settings.noteHigh = rxBuffer[7];
+      settings.splitNote = rxBuffer[8];
+      settings.splitChannel = rxBuffer[9];
+      settings.velocityCurve = rxBuffer[10];
+      settings.ccNumber = rxBuffer[11];
+      settings.ccCurve = rxBuffer[12];
+      memcpy(settings.channelMap, &rxBuffer[13], 16);
+      Transform::configure(rxBuffer[3], settings);
+      startReply(command, nullptr, 0);
+      break;
+    }
+    #endif
+      
+    case SYSEX_CMD_SET_GROOVE:
+      // F0 7D 42 06 <steps, 0 = off> <offset per 16th step, 1/128 of a 16th> F7
+      if (rxLength < 4 || rxLength < 4 + rxBuffer[3]) return;
+      if (!ClockBus::setGroove(rxBuffer[3], &rxBuffer[4])) return;
+      Settings::data.grooveSteps = rxBuffer[3];
+      for (uint8_t i = 0; i < rxBuffer[3]; i++) {
+        Settings::data.grooveOffsets[i] = rxBuffer[4 + i];
+      }
+      Settings::changed();
+      startReply(command, nullptr, 0);
+      break;
+      
+    case SYSEX_CMD_SET_OFFSET: {
+      // F0 7D 42 07 <output: 0 SYNC OUT, 1 DIN, 2 USB> <offset us + 32768: 3 septets> F7
+      if (rxLength < 7 || rxBuffer[3] >= CLOCK_OUTPUT_COUNT) return;
+      int16_t offsetUs = constrain((int32_t)readSeptets(4, 3) - 32768, -32768L, 32767L);
+      ClockBus::setOutputOffset(rxBuffer[3], offsetUs);
+      Settings::data.outputOffsetUs[rxBuffer[3]] = offsetUs;
+      Settings::changed();
+      startReply(command, nullptr, 0);
+      break;
+    }
+      
+    case SYSEX_CMD_SET_SYNC_PPQN:
+      // F0 7D 42 08 <pulses per quarter note: 1, 2, 3, 4, 6, 8, 12, 24> F7
+      if (rxLength < 4 || !sync || !sync->setSyncInPPQN(rxBuffer[3])) return;
+      Settings::data.syncInPPQN = rxBuffer[3];
+      Settings::changed();
+      startReply(command, nullptr, 0);
+      break;
+      
+    #if CLOCK_ANALYSIS_ENABLED
+    case SYSEX_CMD_SET_COMPARE:
+      // F0 7D 42 09 <0 = off, 1 = start a new measurement> F7
+      if (rxLength < 4) return;
+      ClockCompare::setEnabled(rxBuffer[3] != 0);
+      startReply(command, nullptr, 0);
+      break;
+      
+    case SYSEX_CMD_GET_COMPARE: {
+      uint8_t length = ClockCompare::snapshot(replyBuffer);
+      startReply(command, replyBuffer, length);
+      break;
+    }
+      
+    case SYSEX_CMD_SET_JITTER:
+      // F0 7D 42 0B <0 = off, 1 = start a new measurement> F7
+      if (rxLength < 4) return;
+      JitterMeter::setEnabled(rxBuffer[3] != 0);
+      startReply(command, nullptr, 0);
+      break;
+      
+    case SYSEX_CMD_GET_JITTER: {
+      uint8_t length = JitterMeter::snapshot(replyBuffer);
+      startReply(command, replyBuffer, length);
+      break;
+    }
+    #endif
+      
+    case SYSEX_CMD_SET_TIMING: {
+      // F0 7D 42 0D <SYNC OUT pulse width us: 3 septets> <clock timeout, tick periods> F7
+      if (rxLength < 7) return;
+      uint32_t pulseWidthUs = readSeptets(3, 3);
+      if (pulseWidthUs < SETTINGS_PULSE_MIN_US || pulseWidthUs > SETTINGS_PULSE_MAX_US) return;
+      if (rxBuffer[6] < SETTINGS_TIMEOUT_MIN || rxBuffer[6] > SETTINGS_TIMEOUT_MAX) return;
+      Settings::data.syncPulseWidthUs = pulseWidthUs;
+      Settings::data.timeoutPeriods = rxBuffer[6];
+      Settings::changed();
+      startReply(command, nullptr, 0);
+      break;
+    }
+      
+    case SYSEX_CMD_GET_SETTINGS:
+      memcpy(replyBuffer, &Settings::data, sizeof(SettingsData));
+      startReply(command, replyBuffer, sizeof(SettingsData));
+      break;
+      
+    #if MTC_ENABLED
+    case SYSEX_CMD_SET_MTC:
+      // F0 7D 42 10 <0 off, 1 24 fps, 2 25 fps, 3 29.97 drop-frame, 4 30 fps> F7
+      if (rxLength < 4 || !Mtc::setRate(rxBuffer[3])) return;
+      Settings::data.mtcRate = rxBuffer[3];
+      Settings::changed();
+      startReply(command, nullptr, 0);
+      break;
+    #endif
+      
+    case SYSEX_CMD_RESET_SETTINGS:
+      Settings::reset();
+      applySettings();
+      startReply(command, nullptr, 0);
+      break;
+      
+    #if EVENT_TRACE_ENABLED
+    case SYSEX_CMD_GET_TRACE: {
+      // F0 7D 42 11 [1 = clear once sent] F7
+      uint16_t length;
+      const uint8_t* trace = EventTrace::freeze(length);
+      traceClear = rxLength >= 4 && rxBuffer[3] != 0;
+      startReply(command, trace, length);
+      txTrace = true;
+      break;
+    }
+    #endif
+  }
+}
+
+void SysExHandler::applySettings() {
+  Routing::begin();
+  ClockBus::setGroove(Settings::data.grooveSteps, Settings::data.grooveOffsets);
+  for (uint8_t i = 0; i < CLOCK_OUTPUT_COUNT; i++) {
+    ClockBus::setOutputOffset(i, Settings::data.outputOffsetUs[i]);
+  }
+  if (sync) sync->setSyncInPPQN(Settings::data.syncInPPQN);
+  #if MTC_ENABLED
+  Mtc::setRate(Settings::data.mtcRate);
+  #endif
+}
+
+uint32_t SysExHandler::readSeptets(uint8_t offset, uint8_t count) {
+  // Little-endian, 7 bits per byte
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    value |= (uint32_t)rxBuffer[offset + i] << (7 * i);
+  }
+  return value;
+}
+
+void SysExHandler::startReply(byte command, const uint8_t* data, uint16_t length) {
+  txCommand = command | 0x40;
+  txData = data;
+  txLength = length;
+  txPos = 0;
+  txHeaderPos = 0;
+  txMsbPending = true;
+  txTrace = false;
+  txStage = TX_HEADER;
+}
+
+int16_t SysExHandler::nextReplyByte() {
+  switch (txStage) {
+    case TX_HEADER: {
+      byte header[4] = {0xF0, SYSEX_MANUFACTURER_ID, SYSEX_DEVICE_ID, txCommand};
+      byte data = header[txHeaderPos++];
+      if (txHeaderPos >= sizeof(header)) {
+        txStage = (txLength > 0) ? TX_PAYLOAD : TX_END;
+      }
+      return data;
+    }
+
+    case TX_PAYLOAD: {
+      if (txMsbPending) {
+        txMsbPending = false;
+        byte msbs = 0;
+        for (uint8_t i = 0; i < 7 && txPos + i < txLength; i++) {
+          if (txData[txPos + i] & 0x80) msbs |= (1 << i);
+        }
+        return msbs;
+      }
+
+      byte data = txData[txPos++] & 0x7F;
+      if (txPos >= txLength) {
+        txStage = TX_END;
+      } else if (txPos % 7 == 0) {
+        txMsbPending = true;
+      }
+      return data;
+    }
+
+    case TX_END:
+      txStage = TX_IDLE;
+      #if EVENT_TRACE_ENABLED
+      if (txTrace) EventTrace::resume(traceClear);
+      #endif
+      return 0xF7;
+
+    default:
+      return -1;
+  }
+}
+
+void SysExHandler::update() {
+  for (uint8_t packet = 0; packet < SYSEX_PACKETS_PER_PASS && isReplying(); packet++) {
+    if (txPacket.header == 0) {
+      txPacket = {USB_MIDI_HEADER(USB_CABLE_CONTROL, 0x04), 0, 0, 0};
+      byte* bytes[3] = {&txPacket.byte1, &txPacket.byte2, &txPacket.byte3};
+
+      for (uint8_t i = 0; i < 3; i++) {
+        int16_t data = nextReplyByte();
+        *bytes[i] = (byte)data;
+        if (data == 0xF7) {
+          txPacket.header = USB_MIDI_HEADER(USB_CABLE_CONTROL, 0x05 + i);  // SysEx ends with 1, 2 or 3 bytes
+          break;
+        }
+      }
+    }
+
+    // Tried again next pass when the endpoint is full
+    if (!MIDIHandler::sendMessage(txPacket)) return;
+    txPacket.header = 0;
+  }
+}
+
+#endif  // SYSEX_ENABLED
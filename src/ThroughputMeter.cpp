@@ -0,0 +1,84 @@
+/**
+ * MIDI BytePulse - Throughput Meter Implementation
+ */
+
+#include "ThroughputMeter.h"
+
+#if THROUGHPUT_METER_ENABLED
+
+uint16_t ThroughputMeter::messages[METER_PORT_COUNT];
+uint16_t ThroughputMeter::bytes[METER_PORT_COUNT];
+volatile uint8_t ThroughputMeter::directMessages = 0;
+volatile uint8_t ThroughputMeter::directBytes = 0;
+uint16_t ThroughputMeter::messageSteps[METER_PORT_COUNT][METER_WINDOWS];
+uint16_t ThroughputMeter::byteSteps[METER_PORT_COUNT][METER_WINDOWS];
+uint8_t ThroughputMeter::step = 0;
+uint8_t ThroughputMeter::stepCount = 0;
+unsigned long ThroughputMeter::stepStartMs = 0;
+MeterReading ThroughputMeter::held[METER_PORT_COUNT];
+unsigned long ThroughputMeter::heldMs[METER_PORT_COUNT];
+
+void ThroughputMeter::begin() {
+  memset(messages, 0, sizeof(messages));
+  memset(bytes, 0, sizeof(bytes));
+  memset(messageSteps, 0, sizeof(messageSteps));
+  memset(byteSteps, 0, sizeof(byteSteps));
+  memset(held, 0, sizeof(held));
+  directMessages = 0;
+  directBytes = 0;
+  step = 0;
+  stepStartMs = millis();
+}
+
+uint16_t ThroughputMeter::loadPercent(uint32_t bytesPerSecond) {
+  // 3125 bytes a second fill 31250 baud
+  uint32_t percent = (bytesPerSecond * 4 + 62) / 125;
+  return (percent > 999) ? 999 : percent;
+}
+
+void ThroughputMeter::update() {
+  unsigned long now = millis();
+  if ((unsigned long)(now - stepStartMs) < METER_STEP_MS) return;
+  stepStartMs += METER_STEP_MS;
+  if ((unsigned long)(now - stepStartMs) >= METER_STEP_MS) stepStartMs = now;  // loop stalled
+
+  // Bytes the clock bus and MTC wrote from their interrupts
+  noInterrupts();
+  messages[METER_DIN_OUT] += directMessages;
+  bytes[METER_DIN_OUT] += directBytes;
+  directMessages = 0;
+  directBytes = 0;
+  interrupts();
+
+  step = (step + 1) % METER_WINDOWS;
+  for (uint8_t port = 0; port < METER_PORT_COUNT; port++) {
+    messageSteps[port][step] = messages[port];
+    byteSteps[port][step] = bytes[port];
+    messages[port] = 0;
+    bytes[port] = 0;
+
+    uint32_t messageSum = 0;
+    uint32_t byteSum = 0;
+    for (uint8_t i = 0; i < METER_WINDOWS; i++) {
+      messageSum += messageSteps[port][i];
+      byteSum += byteSteps[port][i];
+    }
+
+    MeterReading current;
+    current.messagesPerSecond = (messageSum > 0xFFFF) ? 0xFFFF : messageSum;
+    current.loadPercent = loadPercent(byteSum);
+
+    // Reaching the peak again restarts the hold; once it runs out the reading follows again
+    MeterReading& peak = held[port];
+    if (current.loadPercent >= peak.loadPercent || current.messagesPerSecond >= peak.messagesPerSecond) {
+      if (current.loadPercent > peak.loadPercent) peak.loadPercent = current.loadPercent;
+      if (current.messagesPerSecond > peak.messagesPerSecond) peak.messagesPerSecond = current.messagesPerSecond;
+      heldMs[port] = now;
+    } else if ((unsigned long)(now - heldMs[port]) >= METER_PEAK_HOLD_MS) {
+      peak = current;
+    }
+  }
+  stepCount++;
+}
+
+#endif  // THROUGHPUT_METER_ENABLED
@@ -0,0 +1,74 @@
+/**
+ * MIDI BytePulse - Message Transform Stage Implementation
+ */
+
+#include "Transform.h"
+
+TransformSettings Transform::settings[PORT_COUNT];
+uint8_t Transform::noteMap[PORT_COUNT][128];
+
+// Velocity / CC curves, index 1..127 never maps to 0 so Note On stays Note On
+const uint8_t Transform::curveTables[CURVE_COUNT - 1][128] PROGMEM = {
+  {  // CURVE_SOFT: 127 * sqrt(v / 127)
+      0,  11,  16,  20,  23,  25,  28,  30,  32,  34,  36,  37,  39,  41,  42,  44,
+     45,  46,  48,  49,  50,  52,  53,  54,  55,  56,  57,  59,  60,  61,  62,  63,
+     64,  65,  66,  67,  68,  69,  69,  70,  71,  72,  73,  74,  75,  76,  76,  77,
+     78,  79,  80,  80,  81,  82,  83,  84,  84,  85,  86,  87,  87,  88,  89,  89,
+     90,  91,  92,  92,  93,  94,  94,  95,  96,  96,  97,  98,  98,  99, 100, 100,
+    101, 101, 102, 103, 103, 104, 105, 105, 106, 106, 107, 108, 108, 109, 109, 110,
+    110, 111, 112, 112, 113, 113, 114, 114, 115, 115, 116, 117, 117, 118, 118, 119,
+    119, 120, 120, 121, 121, 122, 122, 123, 123, 124, 124, 125, 125, 126, 126, 127
+  },
+  {  // CURVE_HARD: 127 * (v / 127)^2
+      0,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,
+      2,   2,   3,   3,   3,   3,   4,   4,   5,   5,   5,   6,   6,   7,   7,   8,
+      8,   9,   9,  10,  10,  11,  11,  12,  13,  13,  14,  15,  15,  16,  17,  17,
+     18,  19,  20,  20,  21,  22,  23,  24,  25,  26,  26,  27,  28,  29,  30,  31,
+     32,  33,  34,  35,  36,  37,  39,  40,  41,  42,  43,  44,  45,  47,  48,  49,
+     50,  52,  53,  54,  56,  57,  58,  60,  61,  62,  64,  65,  67,  68,  70,  71,
+     73,  74,  76,  77,  79,  80,  82,  84,  85,  87,  88,  90,  92,  94,  95,  97,
+     99, 101, 102, 104, 106, 108, 110, 112, 113, 115, 117, 119, 121, 123, 125, 127
+  }
+};
+
+void Transform::begin() {
+  TransformSettings identity;
+  identity.enabled = false;
+  identity.transpose = 0;
+  identity.noteLow = 0;
+  identity.noteHigh = 127;
+  identity.splitNote = 128;
+  identity.splitChannel = 0;
+  identity.velocityCurve = CURVE_LINEAR;
+  identity.ccNumber = TRANSFORM_CC_NONE;
+  identity.ccCurve = CURVE_LINEAR;
+  for (uint8_t ch = 0; ch < 16; ch++) {
+    identity.channelMap[ch] = ch;
+  }
+  
+  for (uint8_t port = 0; port < PORT_COUNT; port++) {
+    configure(port, identity);
+  }
+}
+
+void Transform::configure(uint8_t port, const TransformSettings& newSettings) {
+  if (port >= PORT_COUNT) return;
+  
+  settings[port] = newSettings;
+  for (uint8_t ch = 0; ch < 16; ch++) {
+    settings[port].channelMap[ch] &= 0x0F;
+  }
+  if (newSettings.splitChannel > 15) {
+    settings[port].splitNote = 128;  // never reached by a 7-bit note
+    settings[port].splitChannel = 0;
+  }
+  
+  for (int note = 0; note < 128; note++) {
+    int out = note + newSettings.transpose;
+    if (note < newSettings.noteLow || note > newSettings.noteHigh || out < 0 || out > 127) {
+      noteMap[port][note] = TRANSFORM_NOTE_DROP;
+    } else {
+      noteMap[port][note] = out;
+    }
+  }
+}
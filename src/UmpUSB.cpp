@@ -0,0 +1,118 @@
+/**
+ * MIDI BytePulse - USB MIDI 2.0 (UMP) Endpoint Implementation
+ */
+
+#include "UmpUSB.h"
+#include "config.h"
+
+#if MIDI_UMP_ENABLED
+
+#include <PluggableUSB.h>
+
+#define CS_INTERFACE       0x24
+#define CS_ENDPOINT        0x25
+#define CS_GR_TRM_BLOCK    0x26
+#define MS_GENERAL_2_0     0x02
+
+// Group Terminal Block list, fetched by MIDI 2.0 hosts for alternate setting 1
+static const uint8_t GROUP_TERMINAL_BLOCKS[] PROGMEM = {
+  5, CS_GR_TRM_BLOCK, 0x01, 18, 0,   // header, total length
+  13, CS_GR_TRM_BLOCK, 0x02,
+  1,          // block ID
+  0x01,       // IN only (device to host)
+  0, USB_MIDI_CABLES,  // first group, number of groups (one per cable)
+  0,          // no block name
+  0x02,       // MIDI 1.0 protocol, up to 64-bit packets, JR Timestamps
+  0, 0, 0, 0  // bandwidth not fixed
+};
+
+class UmpInterface : public PluggableUSBModule {
+public:
+  UmpInterface() : PluggableUSBModule(1, 2, endpointTypes) {
+    endpointTypes[0] = EP_TYPE_BULK_IN;
+    PluggableUSB().plug(this);
+  }
+
+  uint8_t endpoint() const { return pluggedEndpoint; }
+
+protected:
+  bool setup(USBSetup& setup) { return false; }
+
+  int getInterface(uint8_t* interfaceCount) {
+    *interfaceCount += 2;
+    const uint8_t control = pluggedInterface;
+    const uint8_t streaming = pluggedInterface + 1;
+    
+    const uint8_t descriptor[] = {
+      8, 0x0B, control, 2, 0x01, 0x00, 0x00, 0,       // interface association
+      
+      9, 0x04, control, 0, 0, 0x01, 0x01, 0x00, 0,    // Audio Control
+      9, CS_INTERFACE, 0x01, 0x00, 0x01, 9, 0, 1, streaming,
+      
+      // Alternate setting 0: MIDI 1.0 without endpoints, as the spec requires
+      9, 0x04, streaming, 0, 0, 0x01, 0x03, 0x00, 0,
+      7, CS_INTERFACE, 0x01, 0x00, 0x01, 7, 0,
+      
+      // Alternate setting 1: UMP
+      9, 0x04, streaming, 1, 1, 0x01, 0x03, 0x00, 0,
+      7, CS_INTERFACE, 0x01, 0x00, 0x02, 7, 0,
+      7, 0x05, (uint8_t)USB_ENDPOINT_IN(pluggedEndpoint), USB_ENDPOINT_TYPE_BULK, USB_EP_SIZE, 0, 0,
+      5, CS_ENDPOINT, MS_GENERAL_2_0, 1, 1
+    };
+    return USB_SendControl(0, descriptor, sizeof(descriptor));
+  }
+
+  int getDescriptor(USBSetup& setup) {
+    if (setup.wValueH != CS_GR_TRM_BLOCK || setup.wValueL != 1) return 0;
+    if (setup.wIndex != pluggedInterface + 1) return 0;
+    return USB_SendControl(TRANSFER_PGM, GROUP_TERMINAL_BLOCKS, sizeof(GROUP_TERMINAL_BLOCKS));
+  }
+
+private:
+  EPTYPE_DESCRIPTOR_SIZE endpointTypes[1];
+};
+
+static UmpInterface umpInterface;
+
+UmpSysEx UmpUSB::sysEx[USB_MIDI_CABLES];
+unsigned long UmpUSB::lastSendMs = 0;
+
+bool UmpUSB::write(const uint32_t* words, uint8_t count) {
+  // The endpoint only drains while a host has alternate setting 1 selected;
+  // until then packets are dropped here rather than blocking in USB_Send
+  uint8_t endpoint = umpInterface.endpoint();
+  if (USB_SendSpace(endpoint) < count * 4) return false;
+  
+  // UMP words go out least significant byte first, as AVR stores them
+  USB_Send(endpoint, words, count * 4);
+  lastSendMs = millis();
+  return true;
+}
+
+void UmpUSB::send(const midiEventPacket_t& event, unsigned long timestampUs) {
+  uint32_t words[UMP_MAX_WORDS + 1];
+  const uint8_t bytes[3] = {event.byte1, event.byte2, event.byte3};
+  
+  uint8_t group = UsbMidi::cable(event);
+  if (group >= USB_MIDI_CABLES) return;
+  
+  uint8_t count = Ump::fromPacket(group, event.header, bytes, sysEx[group], words + 1);
+  if (count == 0) return;  // SysEx bytes still waiting for a full packet
+  
+  words[0] = Ump::jrTimestamp(Ump::jrTicks(timestampUs));
+  write(words, count + 1);
+}
+
+void UmpUSB::update() {
+  if (millis() - lastSendMs < UMP_JR_CLOCK_MS) return;
+  
+  uint32_t clock = Ump::jrClock(Ump::jrTicks(micros()));
+  if (!write(&clock, 1)) lastSendMs = millis();  // retry after the interval, not every pass
+  USB_Flush(umpInterface.endpoint());
+}
+
+void UmpUSB::flush() {
+  USB_Flush(umpInterface.endpoint());
+}
+
+#endif  // MIDI_UMP_ENABLED
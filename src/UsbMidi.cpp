@@ -0,0 +1,135 @@
+/**
+ * MIDI BytePulse - USB MIDI Interface Implementation
+ */
+
+#include "UsbMidi.h"
+#include "ThroughputMeter.h"
+#include <PluggableUSB.h>
+
+static_assert(USB_MIDI_CABLES == 1 || USB_MIDI_CABLES == 3, "USB_MIDI_CABLES must be 1 or 3");
+
+#define CS_INTERFACE       0x24
+#define CS_ENDPOINT        0x25
+#define MS_MIDI_IN_JACK    0x02
+#define MS_MIDI_OUT_JACK   0x03
+#define MS_GENERAL         0x01
+#define JACK_EMBEDDED      0x01
+#define JACK_EXTERNAL      0x02
+
+#define JACK_STRING_BASE   0x10    // above the core's manufacturer, product and serial strings
+#define JACK_NAME_MAX      7
+
+// Host side port names, in cable order
+static const char JACK_NAMES[3][JACK_NAME_MAX + 1] PROGMEM = {"DIN", "Clock", "Control"};
+
+// Four jacks per cable: embedded IN, external IN, embedded OUT, external OUT
+static inline uint8_t jackId(uint8_t cable, uint8_t jack) {
+  return cable * 4 + jack + 1;
+}
+
+static inline uint8_t jackName(uint8_t cable) {
+  return (USB_MIDI_CABLES > 1) ? JACK_STRING_BASE + cable : 0;
+}
+
+class UsbMidiInterface : public PluggableUSBModule {
+public:
+  UsbMidiInterface() : PluggableUSBModule(2, 2, endpointTypes) {
+    endpointTypes[0] = EP_TYPE_BULK_OUT;
+    endpointTypes[1] = EP_TYPE_BULK_IN;
+    PluggableUSB().plug(this);
+  }
+
+  uint8_t outEndpoint() const { return pluggedEndpoint; }
+  uint8_t inEndpoint() const { return pluggedEndpoint + 1; }
+
+protected:
+  bool setup(USBSetup& setup) { return false; }
+
+  int getInterface(uint8_t* interfaceCount) {
+    *interfaceCount += 2;
+    const uint8_t control = pluggedInterface;
+    const uint8_t streaming = pluggedInterface + 1;
+    const uint16_t jackLength = 7 + USB_MIDI_CABLES * (6 + 6 + 9 + 9);
+
+    const uint8_t header[] = {
+      8, 0x0B, control, 2, 0x01, 0x00, 0x00, 0,       // interface association
+
+      9, 0x04, control, 0, 0, 0x01, 0x01, 0x00, 0,    // Audio Control
+      9, CS_INTERFACE, 0x01, 0x00, 0x01, 9, 0, 1, streaming,
+
+      9, 0x04, streaming, 0, 2, 0x01, 0x03, 0x00, 0,  // MIDI Streaming
+      7, CS_INTERFACE, MS_GENERAL, 0x00, 0x01, (uint8_t)jackLength, (uint8_t)(jackLength >> 8)
+    };
+    int sent = USB_SendControl(0, header, sizeof(header));
+    if (sent < 0) return -1;
+
+    for (uint8_t cable = 0; cable < USB_MIDI_CABLES; cable++) {
+      const uint8_t jacks[] = {
+        6, CS_INTERFACE, MS_MIDI_IN_JACK, JACK_EMBEDDED, jackId(cable, 0), jackName(cable),
+        6, CS_INTERFACE, MS_MIDI_IN_JACK, JACK_EXTERNAL, jackId(cable, 1), 0,
+        9, CS_INTERFACE, MS_MIDI_OUT_JACK, JACK_EMBEDDED, jackId(cable, 2), 1, jackId(cable, 1), 1, jackName(cable),
+        9, CS_INTERFACE, MS_MIDI_OUT_JACK, JACK_EXTERNAL, jackId(cable, 3), 1, jackId(cable, 0), 1, 0
+      };
+      if (USB_SendControl(0, jacks, sizeof(jacks)) < 0) return -1;
+      sent += sizeof(jacks);
+    }
+
+    // Host to device lands on the embedded IN jacks, the embedded OUT jacks feed the host
+    uint8_t endpoint[9 + 4 + USB_MIDI_CABLES] = {
+      9, 0x05, (uint8_t)USB_ENDPOINT_OUT(outEndpoint()), USB_ENDPOINT_TYPE_BULK, USB_EP_SIZE, 0, 0, 0, 0,
+      4 + USB_MIDI_CABLES, CS_ENDPOINT, MS_GENERAL, USB_MIDI_CABLES
+    };
+    for (uint8_t cable = 0; cable < USB_MIDI_CABLES; cable++) endpoint[13 + cable] = jackId(cable, 0);
+    if (USB_SendControl(0, endpoint, sizeof(endpoint)) < 0) return -1;
+
+    endpoint[2] = USB_ENDPOINT_IN(inEndpoint());
+    for (uint8_t cable = 0; cable < USB_MIDI_CABLES; cable++) endpoint[13 + cable] = jackId(cable, 2);
+    if (USB_SendControl(0, endpoint, sizeof(endpoint)) < 0) return -1;
+
+    return sent + 2 * sizeof(endpoint);
+  }
+
+  int getDescriptor(USBSetup& setup) {
+    // Jack names, UTF-16LE from the ASCII table
+    uint8_t cable = setup.wValueL - JACK_STRING_BASE;
+    if (USB_MIDI_CABLES == 1 || setup.wValueH != USB_STRING_DESCRIPTOR_TYPE || cable >= USB_MIDI_CABLES) return 0;
+
+    uint8_t descriptor[2 + 2 * JACK_NAME_MAX];
+    uint8_t length = 2;
+    for (const char* c = JACK_NAMES[cable]; pgm_read_byte(c); c++) {
+      descriptor[length++] = pgm_read_byte(c);
+      descriptor[length++] = 0;
+    }
+    descriptor[0] = length;
+    descriptor[1] = USB_STRING_DESCRIPTOR_TYPE;
+    return USB_SendControl(0, descriptor, length);
+  }
+
+private:
+  EPTYPE_DESCRIPTOR_SIZE endpointTypes[2];
+};
+
+static UsbMidiInterface usbMidiInterface;
+
+midiEventPacket_t UsbMidi::read() {
+  midiEventPacket_t packet = {0, 0, 0, 0};
+  uint8_t endpoint = usbMidiInterface.outEndpoint();
+  if (USB_Available(endpoint) >= sizeof(packet)) {
+    USB_Recv(endpoint, &packet, sizeof(packet));
+    ThroughputMeter::countPacket(packet.header);
+  }
+  return packet;
+}
+
+size_t UsbMidi::sendMIDI(const midiEventPacket_t& event) {
+  // Dropped rather than blocking in USB_Send while no host drains the endpoint
+  uint8_t endpoint = usbMidiInterface.inEndpoint();
+  if (USB_SendSpace(endpoint) < sizeof(event)) return 0;
+  if (USB_Send(endpoint, &event, sizeof(event)) != sizeof(event)) return 0;
+  ThroughputMeter::countPacket(event.header);
+  return sizeof(event);
+}
+
+void UsbMidi::flush() {
+  USB_Flush(usbMidiInterface.inEndpoint());
+}
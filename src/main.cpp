@@ -3,15 +3,35 @@
  */
 
 #include <Arduino.h>
-#include <MIDIUSB.h>
 #include "config.h"
-#include "MIDIHandler.h"
+#include "UsbMidi.h"
+#include "MidiHandler.h"
 #include "Sync.h"
 #include "Display.h"
+#include "SysExHandler.h"
+#include "Stats.h"
+#include "Routing.h"
+#include "Transform.h"
+#include "MidiMerge.h"
+#include "ClockBus.h"
+#include "Scheduler.h"
+#include "CycleProbe.h"
+#include "UmpUSB.h"
+#include "Power.h"
+#include "Settings.h"
+#include "Mtc.h"
+#include "ThroughputMeter.h"
 
 MIDIHandler midiHandler;
 Sync sync;
 Display display;
+#if SYSEX_ENABLED
+SysExHandler sysexHandler;
+#endif
+
+#if CYCLE_PROBES
+volatile uint8_t benchUSBMailbox[5];
+#endif
 
 uint16_t getCurrentBPM() {
   return sync.getCurrentBPM();
@@ -26,20 +46,71 @@ void onClockStopped() {
 }
 
 void syncInInterrupt() {
+  CYCLE_PROBE(PROBE_SYNC_IN_ISR);
+  Power::wakeEvent();
   sync.handleSyncInPulse();
 }
 
+#if SYSEX_ENABLED && USB_MIDI_CABLES == 1
+// With one cable DIN and Control share it: a SysEx addressed to this device
+// is answered here and kept off DIN OUT
+static bool deviceSysEx = false;
+
+static bool isDeviceSysEx(const midiEventPacket_t& packet) {
+  byte cin = packet.header & 0x0F;
+  if (cin < 0x04 || cin > 0x07) return false;
+  if (packet.byte1 == 0xF0) {
+    deviceSysEx = packet.byte2 == SYSEX_MANUFACTURER_ID && packet.byte3 == SYSEX_DEVICE_ID;
+  }
+  bool device = deviceSysEx;
+  if (cin != 0x04) deviceSysEx = false;  // SysEx ends in this packet
+  return device;
+}
+#endif
+
 void processUSBMIDI() {
-  while (true) {
-    midiEventPacket_t rx = MidiUSB.read();
+  // Leave packets in the USB endpoint while the merge queue is nearly full
+  while (MidiMerge::freeSpace(MERGE_SOURCE_USB) >= 4) {
+    midiEventPacket_t rx = UsbMidi::read();
+    
+    #if CYCLE_PROBES
+    if (rx.header == 0 && benchUSBMailbox[0]) {
+      rx = {benchUSBMailbox[1], benchUSBMailbox[2], benchUSBMailbox[3], benchUSBMailbox[4]};
+      benchUSBMailbox[0] = 0;
+    }
+    #endif
     
     if (rx.header == 0) break;
+    Power::keepAwake();
 
-    // Always forward to DIN OUT
-    midiHandler.forwardUSBtoDIN(rx);
+    // The cable picks the port: only the DIN cable reaches DIN OUT, as
+    // allowed by the routing matrix, and only the Control cable is queried
+    byte cable = UsbMidi::cable(rx);
+    bool toDIN = (cable == USB_CABLE_DIN);
+    #if SYSEX_ENABLED && USB_MIDI_CABLES == 1
+    toDIN = toDIN && !isDeviceSysEx(rx);
+    #endif
+    if (toDIN) {
+      midiHandler.forwardUSBtoDIN(rx);
+    }
 
-    // Also handle sync/clock logic for real-time messages
-    if (rx.header == 0x0F) {
+    // Remote queries are answered here
+    byte cin = rx.header & 0x0F;
+    if (cin >= 0x04 && cin <= 0x07) {
+      #if SYSEX_ENABLED
+      if (cable == USB_CABLE_CONTROL) sysexHandler.handleUSBPacket(rx);
+      #endif
+      continue;
+    }
+
+    // Song position and clock are followed from any cable
+    if (cin == 0x03 && rx.byte1 == 0xF2) {
+      sync.handleSongPosition(CLOCK_SOURCE_USB, rx.byte2 | (rx.byte3 << 7));
+      continue;
+    }
+    
+    if (cin == 0x0F) {
+      Stats::count(Stats::counters.realtime);
       switch (rx.byte1) {
         case 0xF8: 
           sync.handleClock(CLOCK_SOURCE_USB);
@@ -48,7 +119,7 @@ void processUSBMIDI() {
           sync.handleStart(CLOCK_SOURCE_USB);
           break;
         case 0xFB: 
-          sync.handleStart(CLOCK_SOURCE_USB);
+          sync.handleContinue(CLOCK_SOURCE_USB);
           break;
         case 0xFC: 
           sync.handleStop(CLOCK_SOURCE_USB);
@@ -66,23 +137,49 @@ void setup() {
   DEBUG_PRINTLN("BPM monitoring active (change threshold: >2 BPM)");
   #endif
   
-  pinMode(BUTTON_PIN, INPUT_PULLUP);
-
-  display.begin();
-  display.clear(); 
+  // Saved settings come first, every module starts from them
+  Settings::load();
   
+  // MIDI, USB and sync paths go live first; the display splash runs from loop()
   sync.begin();
   sync.setDisplay(&display); 
   sync.onBPMUpdate = onBPMChanged; 
   sync.onClockStop = onClockStopped; 
   midiHandler.setSync(&sync);
   midiHandler.setDisplay(&display);
+  Routing::begin();
+  MidiMerge::begin();
+  Scheduler::begin();
+  ClockBus::begin();
+  #if MTC_ENABLED
+  Mtc::begin();
+  #endif
+  #if THROUGHPUT_METER_ENABLED
+  ThroughputMeter::begin();
+  #endif
+  #if MIDI_TRANSFORM_ENABLED
+  Transform::begin();
+  #endif
   midiHandler.begin();
+  #if SYSEX_ENABLED
+  sysexHandler.setSync(&sync);
+  sysexHandler.begin();
+  #endif
   
   attachInterrupt(digitalPinToInterrupt(SYNC_IN_PIN), syncInInterrupt, RISING);
+  
+  pinMode(BUTTON_PIN, INPUT_PULLUP);
+  
+  display.begin();
+  display.clear(); 
+  
+  Power::begin();
+  
+  Stats::counters.bootReadyUs = micros();
 }
 
 void loop() {
+  CYCLE_PROBE(PROBE_LOOP);
   static bool lastButtonState = HIGH;
   static bool buttonState = HIGH;
   static unsigned long lastDebounceTime = 0;
@@ -112,6 +209,27 @@ void loop() {
   midiHandler.update();
   processUSBMIDI();
   sync.update();
+  ClockBus::update();
+  #if MTC_ENABLED
+  Mtc::update();
+  #endif
+  MidiMerge::update();
+  #if SYSEX_ENABLED
+  sysexHandler.update();
+  Settings::update();
+  #endif
+  #if THROUGHPUT_METER_ENABLED
+  ThroughputMeter::update();
+  #endif
   display.flush();
+  #if MIDI_UMP_ENABLED
+  UmpUSB::update();
+  #endif
   midiHandler.flushBuffer();
+  
+  #if SYSEX_ENABLED
+  Power::idle(sysexHandler.isReplying());
+  #else
+  Power::idle(false);
+  #endif
 }
@@ -0,0 +1,167 @@
+#include <unity.h>
+#include <stdint.h>
+
+// Clock distribution bus from ClockBus.cpp
+enum ClockSource { CLOCK_SOURCE_NONE, CLOCK_SOURCE_SYNC_IN, CLOCK_SOURCE_DIN, CLOCK_SOURCE_USB };
+enum MidiPort { PORT_DIN = 0, PORT_USB = 1, PORT_COUNT };
+enum ClockSkew { CLOCK_SKEW_INPUT = 0, CLOCK_SKEW_SYNC_OUT, CLOCK_SKEW_DIN, CLOCK_SKEW_USB, CLOCK_SKEW_COUNT };
+
+#define ROUTE_TO_DIN  (1 << PORT_DIN)
+#define ROUTE_TO_USB  (1 << PORT_USB)
+#define CLOCK_DIN_BYTE_US 320
+
+// Routes for 0xF8 per source port, as loaded by Routing::begin()
+uint8_t clockRoutes[PORT_COUNT];
+
+// Simulated outputs: the order and time each one fired
+enum Output { OUT_SYNC = 1, OUT_DIN = 2, OUT_USB = 3 };
+uint8_t fired[8];
+uint8_t firedCount;
+bool syncOutConnected;
+unsigned long clockUs;
+uint8_t txBacklog;
+uint16_t skewLast[CLOCK_SKEW_COUNT];
+uint16_t skewMax[CLOCK_SKEW_COUNT];
+
+unsigned long micros() { return clockUs; }
+
+void recordSkew(uint8_t index, unsigned long elapsedUs) {
+    uint16_t value = (elapsedUs > 0xFFFF) ? 0xFFFF : elapsedUs;
+    skewLast[index] = value;
+    if (value > skewMax[index]) skewMax[index] = value;
+}
+
+uint8_t routesFor(ClockSource source) {
+    switch (source) {
+        case CLOCK_SOURCE_DIN: return clockRoutes[PORT_DIN];
+        case CLOCK_SOURCE_USB: return clockRoutes[PORT_USB];
+        case CLOCK_SOURCE_SYNC_IN: return ROUTE_TO_DIN | ROUTE_TO_USB;
+        default: return 0;
+    }
+}
+
+// Each output advances the simulated clock by the time it takes on the target
+void tick(ClockSource source, unsigned long timestampUs) {
+    unsigned long entryUs = micros();
+    uint8_t routes = routesFor(source);
+    recordSkew(CLOCK_SKEW_INPUT, entryUs - timestampUs);
+    if (syncOutConnected) {
+        clockUs += 2;
+        fired[firedCount++] = OUT_SYNC;
+        recordSkew(CLOCK_SKEW_SYNC_OUT, micros() - entryUs);
+    }
+    if (routes & ROUTE_TO_DIN) {
+        uint8_t backlog = txBacklog;
+        clockUs += 4;
+        fired[firedCount++] = OUT_DIN;
+        recordSkew(CLOCK_SKEW_DIN, micros() - entryUs + (unsigned long)backlog * CLOCK_DIN_BYTE_US);
+    }
+    if (routes & ROUTE_TO_USB) {
+        clockUs += 30;
+        fired[firedCount++] = OUT_USB;
+        recordSkew(CLOCK_SKEW_USB, micros() - entryUs);
+    }
+}
+
+// Test SYNC IN ticks reach every output in the fixed order
+void test_sync_in_fans_out_in_order() {
+    tick(CLOCK_SOURCE_SYNC_IN, clockUs);
+    TEST_ASSERT_EQUAL_UINT8(3, firedCount);
+    TEST_ASSERT_EQUAL_UINT8(OUT_SYNC, fired[0]);
+    TEST_ASSERT_EQUAL_UINT8(OUT_DIN, fired[1]);
+    TEST_ASSERT_EQUAL_UINT8(OUT_USB, fired[2]);
+}
+
+// Test DIN clock is not echoed back to DIN OUT by default
+void test_din_clock_not_echoed() {
+    tick(CLOCK_SOURCE_DIN, clockUs);
+    TEST_ASSERT_EQUAL_UINT8(2, firedCount);
+    TEST_ASSERT_EQUAL_UINT8(OUT_SYNC, fired[0]);
+    TEST_ASSERT_EQUAL_UINT8(OUT_USB, fired[1]);
+}
+
+// Test USB clock now reaches DIN OUT and not USB
+void test_usb_clock_reaches_din() {
+    tick(CLOCK_SOURCE_USB, clockUs);
+    TEST_ASSERT_EQUAL_UINT8(2, firedCount);
+    TEST_ASSERT_EQUAL_UINT8(OUT_SYNC, fired[0]);
+    TEST_ASSERT_EQUAL_UINT8(OUT_DIN, fired[1]);
+}
+
+// Test unplugged SYNC OUT is skipped and leaves its skew untouched
+void test_sync_out_disconnected() {
+    syncOutConnected = false;
+    tick(CLOCK_SOURCE_SYNC_IN, clockUs);
+    TEST_ASSERT_EQUAL_UINT8(OUT_DIN, fired[0]);
+    TEST_ASSERT_EQUAL_UINT16(0, skewLast[CLOCK_SKEW_SYNC_OUT]);
+}
+
+// Test skews are measured from entry into the bus
+void test_skew_measured_from_entry() {
+    unsigned long received = clockUs;
+    clockUs += 100;  // loop latency before the tick is accepted
+    tick(CLOCK_SOURCE_SYNC_IN, received);
+    TEST_ASSERT_EQUAL_UINT16(100, skewLast[CLOCK_SKEW_INPUT]);
+    TEST_ASSERT_EQUAL_UINT16(2, skewLast[CLOCK_SKEW_SYNC_OUT]);
+    TEST_ASSERT_EQUAL_UINT16(6, skewLast[CLOCK_SKEW_DIN]);
+    TEST_ASSERT_EQUAL_UINT16(36, skewLast[CLOCK_SKEW_USB]);
+}
+
+// Test DIN skew includes the bytes already waiting in the UART
+void test_din_skew_includes_backlog() {
+    txBacklog = 3;
+    tick(CLOCK_SOURCE_SYNC_IN, clockUs);
+    TEST_ASSERT_EQUAL_UINT16(6 + 3 * CLOCK_DIN_BYTE_US, skewLast[CLOCK_SKEW_DIN]);
+}
+
+// Test the worst case is kept while the last value follows each tick
+void test_skew_max_kept() {
+    txBacklog = 10;
+    tick(CLOCK_SOURCE_SYNC_IN, clockUs);
+    txBacklog = 0;
+    tick(CLOCK_SOURCE_SYNC_IN, clockUs);
+    TEST_ASSERT_EQUAL_UINT16(6, skewLast[CLOCK_SKEW_DIN]);
+    TEST_ASSERT_EQUAL_UINT16(6 + 10 * CLOCK_DIN_BYTE_US, skewMax[CLOCK_SKEW_DIN]);
+}
+
+// Test long delays saturate instead of wrapping
+void test_skew_saturates() {
+    unsigned long received = clockUs;
+    clockUs += 100000;
+    tick(CLOCK_SOURCE_SYNC_IN, received);
+    TEST_ASSERT_EQUAL_UINT16(0xFFFF, skewLast[CLOCK_SKEW_INPUT]);
+}
+
+void setUp(void) {
+    clockRoutes[PORT_DIN] = ROUTE_TO_USB;
+    clockRoutes[PORT_USB] = ROUTE_TO_DIN;
+    firedCount = 0;
+    syncOutConnected = true;
+    clockUs = 5000;
+    txBacklog = 0;
+    for (int i = 0; i < CLOCK_SKEW_COUNT; i++) {
+        skewLast[i] = 0;
+        skewMax[i] = 0;
+    }
+}
+
+void tearDown(void) {
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    
+    // Fan-out tests
+    RUN_TEST(test_sync_in_fans_out_in_order);
+    RUN_TEST(test_din_clock_not_echoed);
+    RUN_TEST(test_usb_clock_reaches_din);
+    RUN_TEST(test_sync_out_disconnected);
+    
+    // Skew measurement tests
+    RUN_TEST(test_skew_measured_from_entry);
+    RUN_TEST(test_din_skew_includes_backlog);
+    RUN_TEST(test_skew_max_kept);
+    RUN_TEST(test_skew_saturates);
+    
+    return UNITY_END();
+}
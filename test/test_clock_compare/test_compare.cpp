@@ -0,0 +1,156 @@
+#include <unity.h>
+#include <stdint.h>
+#include <string.h>
+
+// Drift and phase arithmetic from ClockCompare.cpp
+// (micros() timestamps are 32-bit on AVR)
+#define COMPARE_DRIFT_LIMIT 100000L
+
+struct Track {
+    uint32_t firstUs;
+    uint32_t lastUs;
+    uint32_t intervals;
+    int32_t phaseUs;
+    bool phaseValid;
+};
+
+Track ref;
+Track src;
+
+void tick(Track& track, uint32_t timestampUs, uint8_t ticks) {
+    if (track.lastUs == 0) {
+        track.firstUs = timestampUs;
+        track.intervals = 0;
+    } else {
+        track.intervals += ticks;
+    }
+    track.lastUs = timestampUs;
+}
+
+void phase(uint32_t timestampUs) {
+    if (ref.intervals == 0) return;
+    int32_t periodUs = (ref.lastUs - ref.firstUs) / ref.intervals;
+    if (periodUs == 0) return;
+
+    int32_t offsetUs = (int32_t)(timestampUs - ref.lastUs) % periodUs;
+
+    if (!src.phaseValid) {
+        if (offsetUs > periodUs / 2) offsetUs -= periodUs;
+        else if (offsetUs < -periodUs / 2) offsetUs += periodUs;
+        src.phaseUs = offsetUs;
+        src.phaseValid = true;
+        return;
+    }
+
+    if (offsetUs - src.phaseUs > periodUs / 2) offsetUs -= periodUs;
+    else if (offsetUs - src.phaseUs < -periodUs / 2) offsetUs += periodUs;
+    src.phaseUs += (offsetUs - src.phaseUs) / 8;
+
+    if (src.phaseUs > periodUs / 2) src.phaseUs -= periodUs;
+    else if (src.phaseUs < -periodUs / 2) src.phaseUs += periodUs;
+}
+
+int32_t drift() {
+    int64_t refSpan = ref.lastUs - ref.firstUs;
+    int64_t span = src.lastUs - src.firstUs;
+    int64_t diff = (int64_t)src.intervals * refSpan - (int64_t)ref.intervals * span;
+    int64_t denom = (int64_t)ref.intervals * span;
+    if (denom < 10) return 0;
+    if (diff > denom / 100) return COMPARE_DRIFT_LIMIT;
+    if (diff < -denom / 100) return -COMPARE_DRIFT_LIMIT;
+    return diff * 1000000 / (denom / 10);
+}
+
+// Both clocks tick `count` times; src is `offsetUs` behind the reference
+void run(uint32_t refPeriodUs, uint32_t periodUs, uint32_t offsetUs, int count) {
+    for (int i = 0; i < count; i++) {
+        tick(ref, 1000000UL + i * refPeriodUs, 1);
+        uint32_t t = 1000000UL + offsetUs + i * periodUs;
+        tick(src, t, 1);
+        phase(t);
+    }
+}
+
+void setUp(void) {
+    memset(&ref, 0, sizeof(ref));
+    memset(&src, 0, sizeof(src));
+}
+
+void tearDown(void) {}
+
+void test_same_tempo_no_drift(void) {
+    run(20833, 20833, 500, 480);
+    TEST_ASSERT_EQUAL_INT32(0, drift());
+}
+
+void test_slow_source_negative_drift(void) {
+    // 20834 against 20833 us: 48.0 ppm slow
+    run(20833, 20834, 0, 2400);
+    TEST_ASSERT_INT32_WITHIN(2, -480, drift());
+}
+
+void test_fast_source_positive_drift(void) {
+    run(20000, 19999, 0, 2400);
+    TEST_ASSERT_INT32_WITHIN(2, 500, drift());
+}
+
+void test_different_tempo_saturates(void) {
+    run(20833, 25000, 0, 100);
+    TEST_ASSERT_EQUAL_INT32(-COMPARE_DRIFT_LIMIT, drift());
+}
+
+void test_pulse_counts_several_ticks(void) {
+    // A 4 PPQN source: one pulse per 6 reference ticks
+    for (int i = 0; i < 600; i++) tick(ref, 1000000UL + i * 20833, 1);
+    for (int i = 0; i < 100; i++) tick(src, 1000000UL + i * 124998, 6);
+    TEST_ASSERT_EQUAL_INT32(0, drift());
+}
+
+void test_phase_late_source(void) {
+    run(20833, 20833, 2000, 96);
+    TEST_ASSERT_INT32_WITHIN(2, 2000, src.phaseUs);
+}
+
+void test_phase_wraps_to_nearest_tick(void) {
+    // 19 ms late is 1.8 ms early against the following tick
+    run(20833, 20833, 19000, 96);
+    TEST_ASSERT_INT32_WITHIN(2, -1833, src.phaseUs);
+}
+
+void test_phase_near_half_tick_does_not_flip(void) {
+    // Alternating either side of half a tick averages to half a tick
+    run(20000, 20000, 10000, 1);
+    for (int i = 1; i < 64; i++) {
+        tick(ref, 1000000UL + i * 20000, 1);
+        uint32_t t = 1000000UL + i * 20000 + ((i & 1) ? 9900 : 10100);
+        tick(src, t, 1);
+        phase(t);
+    }
+    TEST_ASSERT_TRUE(src.phaseUs > 9800 || src.phaseUs < -9800);
+}
+
+void test_phase_across_micros_wrap(void) {
+    ref.lastUs = 0;
+    for (int i = 0; i < 48; i++) {
+        tick(ref, 0xFFFF0000UL + i * 20833, 1);
+        uint32_t t = 0xFFFF0000UL + 1500 + i * 20833;
+        tick(src, t, 1);
+        phase(t);
+    }
+    TEST_ASSERT_INT32_WITHIN(2, 1500, src.phaseUs);
+    TEST_ASSERT_EQUAL_INT32(0, drift());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_same_tempo_no_drift);
+    RUN_TEST(test_slow_source_negative_drift);
+    RUN_TEST(test_fast_source_positive_drift);
+    RUN_TEST(test_different_tempo_saturates);
+    RUN_TEST(test_pulse_counts_several_ticks);
+    RUN_TEST(test_phase_late_source);
+    RUN_TEST(test_phase_wraps_to_nearest_tick);
+    RUN_TEST(test_phase_near_half_tick_does_not_flip);
+    RUN_TEST(test_phase_across_micros_wrap);
+    return UNITY_END();
+}
@@ -0,0 +1,239 @@
+#include <unity.h>
+#include <stdint.h>
+#include <string.h>
+
+// Layer compositor and change-only transmission from Display.cpp
+// (millis() timestamps are 32-bit on AVR)
+#define DISPLAY_DIGITS             4
+#define DISPLAY_MESSAGE_MS         500
+#define DISPLAY_WRITE_INTERVAL_MS  10
+
+enum DisplayLayer {
+  DISPLAY_LAYER_BASE = 0,
+  DISPLAY_LAYER_METER,
+  DISPLAY_LAYER_MESSAGE,
+  DISPLAY_LAYER_OVERLAY,
+  DISPLAY_LAYER_COUNT
+};
+
+uint8_t layers[DISPLAY_LAYER_COUNT][DISPLAY_DIGITS];
+uint8_t activeLayers;
+uint8_t frame[DISPLAY_DIGITS];
+uint8_t shown[DISPLAY_DIGITS];
+bool frameDirty;
+uint8_t scanDigit;
+uint32_t lastWriteTime;
+uint32_t messageTime;
+
+// Digits written to the module, in order
+uint8_t writtenDigit[64];
+uint8_t writtenPattern[64];
+int writeCount;
+
+void writeDigit(uint8_t digit, uint8_t pattern) {
+    writtenDigit[writeCount] = digit;
+    writtenPattern[writeCount] = pattern;
+    writeCount++;
+}
+
+void showLayer(DisplayLayer layer) {
+    activeLayers |= (1 << layer);
+    frameDirty = true;
+}
+
+void hideLayer(DisplayLayer layer) {
+    if (activeLayers & (1 << layer)) {
+        activeLayers &= ~(1 << layer);
+        frameDirty = true;
+    }
+}
+
+void setLayer(DisplayLayer layer, uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    layers[layer][0] = a;
+    layers[layer][1] = b;
+    layers[layer][2] = c;
+    layers[layer][3] = d;
+    showLayer(layer);
+}
+
+void compose() {
+    uint8_t top = DISPLAY_LAYER_BASE;
+    for (uint8_t layer = DISPLAY_LAYER_COUNT - 1; layer > DISPLAY_LAYER_BASE; layer--) {
+        if (activeLayers & (1 << layer)) {
+            top = layer;
+            break;
+        }
+    }
+    memcpy(frame, layers[top], DISPLAY_DIGITS);
+    frameDirty = false;
+}
+
+void flush(uint32_t now) {
+    if ((activeLayers & (1 << DISPLAY_LAYER_MESSAGE)) &&
+        (uint32_t)(now - messageTime) >= DISPLAY_MESSAGE_MS) {
+        hideLayer(DISPLAY_LAYER_MESSAGE);
+    }
+    if (frameDirty) {
+        compose();
+    }
+    if ((uint32_t)(now - lastWriteTime) < DISPLAY_WRITE_INTERVAL_MS) return;
+    for (uint8_t n = 0; n < DISPLAY_DIGITS; n++) {
+        uint8_t digit = (scanDigit + n) % DISPLAY_DIGITS;
+        if (frame[digit] != shown[digit]) {
+            writeDigit(digit, frame[digit]);
+            shown[digit] = frame[digit];
+            scanDigit = (digit + 1) % DISPLAY_DIGITS;
+            lastWriteTime = now;
+            return;
+        }
+    }
+}
+
+// Runs flush() every millisecond from `from` up to (not including) `to`
+uint32_t runUntil(uint32_t from, uint32_t to) {
+    for (uint32_t t = from; t != to; t++) flush(t);
+    return to;
+}
+
+void setUp(void) {
+    memset(layers, 0, sizeof(layers));
+    memset(frame, 0, sizeof(frame));
+    memset(shown, 0, sizeof(shown));
+    activeLayers = 0;
+    frameDirty = false;
+    scanDigit = 0;
+    lastWriteTime = 0;
+    messageTime = 0;
+    writeCount = 0;
+    showLayer(DISPLAY_LAYER_BASE);
+}
+
+void tearDown(void) {}
+
+// Only the base layer active: the frame is the base layer
+void test_base_layer_shown_alone() {
+    setLayer(DISPLAY_LAYER_BASE, 1, 2, 3, 4);
+    compose();
+    TEST_ASSERT_EQUAL_UINT8(1, frame[0]);
+    TEST_ASSERT_EQUAL_UINT8(4, frame[3]);
+}
+
+// The meter covers the base animation, a message covers both, the overlay all
+void test_higher_layers_win() {
+    setLayer(DISPLAY_LAYER_BASE, 1, 1, 1, 1);
+    setLayer(DISPLAY_LAYER_METER, 4, 4, 4, 4);
+    compose();
+    TEST_ASSERT_EQUAL_UINT8(4, frame[0]);
+
+    setLayer(DISPLAY_LAYER_MESSAGE, 2, 2, 2, 2);
+    compose();
+    TEST_ASSERT_EQUAL_UINT8(2, frame[0]);
+
+    setLayer(DISPLAY_LAYER_OVERLAY, 3, 3, 3, 3);
+    compose();
+    TEST_ASSERT_EQUAL_UINT8(3, frame[0]);
+}
+
+// Releasing the button reveals whatever is underneath, untouched
+void test_hiding_overlay_reveals_message() {
+    setLayer(DISPLAY_LAYER_BASE, 1, 1, 1, 1);
+    setLayer(DISPLAY_LAYER_MESSAGE, 2, 2, 2, 2);
+    setLayer(DISPLAY_LAYER_OVERLAY, 3, 3, 3, 3);
+    hideLayer(DISPLAY_LAYER_OVERLAY);
+    compose();
+    TEST_ASSERT_EQUAL_UINT8(2, frame[0]);
+
+    hideLayer(DISPLAY_LAYER_MESSAGE);
+    compose();
+    TEST_ASSERT_EQUAL_UINT8(1, frame[0]);
+}
+
+// Animation under a message keeps running without reaching the module
+void test_base_updates_hidden_under_message() {
+    setLayer(DISPLAY_LAYER_MESSAGE, 2, 2, 2, 2);
+    messageTime = 1000;
+    uint32_t t = runUntil(1000, 1100);
+    int writes = writeCount;
+
+    setLayer(DISPLAY_LAYER_BASE, 5, 5, 5, 5);
+    runUntil(t, 1400);
+    TEST_ASSERT_EQUAL_INT(writes, writeCount);
+}
+
+// A steady frame produces no bus traffic at all
+void test_unchanged_frame_sends_nothing() {
+    setLayer(DISPLAY_LAYER_BASE, 0, 0, 0, 0);
+    runUntil(100, 1000);
+    TEST_ASSERT_EQUAL_INT(0, writeCount);
+}
+
+// Only digits that differ from the module are written
+void test_only_changed_digits_sent() {
+    setLayer(DISPLAY_LAYER_BASE, 0, 7, 0, 9);
+    runUntil(100, 200);
+    TEST_ASSERT_EQUAL_INT(2, writeCount);
+    TEST_ASSERT_EQUAL_UINT8(1, writtenDigit[0]);
+    TEST_ASSERT_EQUAL_UINT8(7, writtenPattern[0]);
+    TEST_ASSERT_EQUAL_UINT8(3, writtenDigit[1]);
+    TEST_ASSERT_EQUAL_UINT8(9, writtenPattern[1]);
+}
+
+// At most one digit per write slot
+void test_one_digit_per_interval() {
+    setLayer(DISPLAY_LAYER_BASE, 1, 2, 3, 4);
+    flush(100);
+    flush(101);
+    flush(109);
+    TEST_ASSERT_EQUAL_INT(1, writeCount);
+    flush(110);
+    TEST_ASSERT_EQUAL_INT(2, writeCount);
+    runUntil(111, 200);
+    TEST_ASSERT_EQUAL_INT(4, writeCount);
+}
+
+// A digit that keeps changing can't starve the others
+void test_round_robin_scan() {
+    setLayer(DISPLAY_LAYER_BASE, 1, 2, 0, 0);
+    flush(100);
+    TEST_ASSERT_EQUAL_UINT8(0, writtenDigit[0]);
+
+    layers[DISPLAY_LAYER_BASE][0] = 9;
+    frameDirty = true;
+    flush(110);
+    TEST_ASSERT_EQUAL_UINT8(1, writtenDigit[1]);
+    flush(120);
+    TEST_ASSERT_EQUAL_UINT8(0, writtenDigit[2]);
+    TEST_ASSERT_EQUAL_UINT8(9, writtenPattern[2]);
+}
+
+// Messages expire after 500 ms, across a millis() wrap
+void test_message_expires_across_wrap() {
+    setLayer(DISPLAY_LAYER_BASE, 1, 1, 1, 1);
+    messageTime = 0xFFFFFF00UL;
+    lastWriteTime = messageTime;
+    setLayer(DISPLAY_LAYER_MESSAGE, 2, 2, 2, 2);
+
+    flush(messageTime + 499);
+    TEST_ASSERT_TRUE(activeLayers & (1 << DISPLAY_LAYER_MESSAGE));
+    TEST_ASSERT_EQUAL_UINT8(2, frame[0]);
+
+    flush(messageTime + 500);
+    TEST_ASSERT_FALSE(activeLayers & (1 << DISPLAY_LAYER_MESSAGE));
+    TEST_ASSERT_EQUAL_UINT8(1, frame[0]);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_base_layer_shown_alone);
+    RUN_TEST(test_higher_layers_win);
+    RUN_TEST(test_hiding_overlay_reveals_message);
+    RUN_TEST(test_base_updates_hidden_under_message);
+    RUN_TEST(test_unchanged_frame_sends_nothing);
+    RUN_TEST(test_only_changed_digits_sent);
+    RUN_TEST(test_one_digit_per_interval);
+    RUN_TEST(test_round_robin_scan);
+    RUN_TEST(test_message_expires_across_wrap);
+
+    return UNITY_END();
+}
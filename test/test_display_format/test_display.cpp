@@ -1,40 +1,28 @@
 #include <unity.h>
 
-// Character to 7-segment conversion from Display.cpp
+// Glyph table and lookup from Display.cpp
+#define SEGMENT_DP  0b10000000
+
+static const uint8_t GLYPHS[64] = {
+  0, 0, 0, 0, 0, 0, 0, 0,                          //  !"#$%&'
+  0, 0, 0, 0, 0, 0b01000000, SEGMENT_DP, 0,        // ()*+,-./
+  0b00111111, 0b00000110, 0b01011011, 0b01001111,  // 0123
+  0b01100110, 0b01101101, 0b01111101, 0b00000111,  // 4567
+  0b01111111, 0b01101111, 0, 0, 0, 0, 0, 0,        // 89:;<=>?
+  0,          0b01110111, 0b01111100, 0b00111001,  // @ABC
+  0b01011110, 0b01111001, 0b01110001, 0b00111101,  // DEFG
+  0b01110110, 0b00000110, 0b00011110, 0,           // HIJK
+  0b00111000, 0,          0b01010100, 0b01011100,  // LMNO
+  0b01110011, 0,          0,          0b01101101,  // PQRS
+  0b01111000, 0b00011100, 0,          0,           // TUVW
+  0,          0b01101110, 0,          0,           // XYZ[
+  0, 0, 0, 0b00001000                              // \]^_
+};
+
 uint8_t charToSegment(char c) {
-    switch (c) {
-        case '0': return 0b00111111;
-        case '1': return 0b00000110;
-        case '2': return 0b01011011;
-        case '3': return 0b01001111;
-        case '4': return 0b01100110;
-        case '5': return 0b01101101;
-        case '6': return 0b01111101;
-        case '7': return 0b00000111;
-        case '8': return 0b01111111;
-        case '9': return 0b01101111;
-        case 'A': case 'a': return 0b01110111;
-        case 'B': case 'b': return 0b01111100;
-        case 'C': case 'c': return 0b00111001;
-        case 'D': case 'd': return 0b01011110;
-        case 'E': case 'e': return 0b01111001;
-        case 'F': case 'f': return 0b01110001;
-        case 'G': case 'g': return 0b00111101;
-        case 'H': case 'h': return 0b01110110;
-        case 'I': case 'i': return 0b00000110;
-        case 'J': case 'j': return 0b00011110;
-        case 'L': case 'l': return 0b00111000;
-        case 'N': case 'n': return 0b01010100;
-        case 'O': case 'o': return 0b01011100;
-        case 'P': case 'p': return 0b01110011;
-        case 'S': case 's': return 0b01101101;
-        case 'T': case 't': return 0b01111000;
-        case 'U': case 'u': return 0b00011100;
-        case 'Y': case 'y': return 0b01101110;
-        case '-': return 0b01000000;
-        case '_': return 0b00001000;
-        default: return 0b00000000;
-    }
+    if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+    if (c < ' ' || c > '_') return 0;
+    return GLYPHS[c - ' '];
 }
 
 // BPM formatting helper
@@ -88,6 +76,9 @@ void test_char_to_segment_special() {
     TEST_ASSERT_EQUAL_UINT8(0b00001000, charToSegment('_'));
     TEST_ASSERT_EQUAL_UINT8(0b00000000, charToSegment('?')); // Unknown char
     TEST_ASSERT_EQUAL_UINT8(0b00000000, charToSegment(' ')); // Space
+    TEST_ASSERT_EQUAL_UINT8(0b10000000, charToSegment('.')); // Decimal point
+    TEST_ASSERT_EQUAL_UINT8(0b00000000, charToSegment('\n')); // Below table
+    TEST_ASSERT_EQUAL_UINT8(0b00000000, charToSegment('~')); // Above table
 }
 
 // Test BPM formatting for 120 BPM
@@ -157,6 +148,7 @@ void test_char_case_insensitive() {
     TEST_ASSERT_EQUAL(charToSegment('A'), charToSegment('a'));
     TEST_ASSERT_EQUAL(charToSegment('E'), charToSegment('e'));
     TEST_ASSERT_EQUAL(charToSegment('T'), charToSegment('t'));
+    TEST_ASSERT_EQUAL(charToSegment('Z'), charToSegment('z'));
 }
 
 void setUp(void) {
@@ -0,0 +1,171 @@
+#include <unity.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Trace ring, repeats and in-place ordering from EventTrace.cpp
+#define EVENT_TRACE_SIZE  32
+
+enum { EVENT_START = 1, EVENT_STOP = 3, EVENT_MERGE_DROP = 11 };
+
+struct EventRecord {
+    uint32_t timeUs;
+    uint8_t type;
+    uint8_t source;
+    uint16_t value;
+};
+
+struct EventTraceDump {
+    uint32_t nowUs;
+    uint16_t logged;
+    uint8_t count;
+    uint8_t lost;
+    EventRecord records[EVENT_TRACE_SIZE];
+};
+
+EventTraceDump dump;
+uint8_t head;
+bool frozen;
+uint8_t lostWhileFrozen;
+
+void record(uint32_t timeUs, uint8_t type, uint8_t source, uint16_t value, bool repeats) {
+    EventRecord& newest = dump.records[(head - 1) & (EVENT_TRACE_SIZE - 1)];
+    if (frozen) {
+        if (lostWhileFrozen != 0xFF) lostWhileFrozen++;
+    } else if (repeats && dump.count > 0 && newest.type == type && newest.source == source) {
+        if (newest.value != 0xFFFF) newest.value++;
+    } else {
+        EventRecord& entry = dump.records[head];
+        entry.timeUs = timeUs;
+        entry.type = type;
+        entry.source = source;
+        entry.value = value;
+        head = (head + 1) & (EVENT_TRACE_SIZE - 1);
+        if (dump.count < EVENT_TRACE_SIZE) dump.count++;
+        if (dump.logged != 0xFFFF) dump.logged++;
+    }
+}
+
+void reverse(uint8_t first, uint8_t last) {
+    while (first + 1 < last) {
+        last--;
+        EventRecord swap = dump.records[first];
+        dump.records[first] = dump.records[last];
+        dump.records[last] = swap;
+        first++;
+    }
+}
+
+uint16_t freeze(void) {
+    frozen = true;
+    dump.lost = lostWhileFrozen;
+    lostWhileFrozen = 0;
+    if (head != 0 && dump.count == EVENT_TRACE_SIZE) {
+        reverse(0, head);
+        reverse(head, EVENT_TRACE_SIZE);
+        reverse(0, EVENT_TRACE_SIZE);
+    }
+    head = dump.count & (EVENT_TRACE_SIZE - 1);
+    return offsetof(EventTraceDump, records) + dump.count * sizeof(EventRecord);
+}
+
+void resume(bool clear) {
+    if (clear) {
+        dump.count = 0;
+        dump.logged = 0;
+        head = 0;
+    }
+    frozen = false;
+}
+
+void setUp(void) {
+    memset(&dump, 0, sizeof(dump));
+    head = 0;
+    frozen = false;
+    lostWhileFrozen = 0;
+}
+
+void tearDown(void) {}
+
+void test_record_layout_is_packed(void) {
+    TEST_ASSERT_EQUAL(8, sizeof(EventRecord));
+    TEST_ASSERT_EQUAL(8, offsetof(EventTraceDump, records));
+}
+
+void test_partial_ring_dumps_in_order(void) {
+    for (uint8_t i = 0; i < 5; i++) record(100 * i, EVENT_START, i, 0, false);
+    TEST_ASSERT_EQUAL(8 + 5 * 8, freeze());
+    for (uint8_t i = 0; i < 5; i++) TEST_ASSERT_EQUAL(100 * i, dump.records[i].timeUs);
+}
+
+void test_full_ring_rotated_oldest_first(void) {
+    // 45 events: the 32 newest are 13..44, the oldest of them at head
+    for (uint8_t i = 0; i < 45; i++) record(i, EVENT_START, 0, i, false);
+    TEST_ASSERT_EQUAL(8 + EVENT_TRACE_SIZE * 8, freeze());
+    for (uint8_t i = 0; i < EVENT_TRACE_SIZE; i++) TEST_ASSERT_EQUAL(13 + i, dump.records[i].value);
+    TEST_ASSERT_EQUAL(45, dump.logged);
+
+    // After the dump the oldest is overwritten next, as before
+    resume(false);
+    record(45, EVENT_STOP, 0, 45, false);
+    TEST_ASSERT_EQUAL(45, dump.records[0].value);
+    freeze();
+    TEST_ASSERT_EQUAL(14, dump.records[0].value);
+    TEST_ASSERT_EQUAL(45, dump.records[EVENT_TRACE_SIZE - 1].value);
+}
+
+void test_repeats_count_up_in_one_record(void) {
+    record(10, EVENT_START, 3, 1, false);
+    for (uint8_t i = 0; i < 200; i++) record(20 + i, EVENT_MERGE_DROP, 1, 1, true);
+    record(300, EVENT_MERGE_DROP, 0, 1, true);   // another source starts a new record
+    TEST_ASSERT_EQUAL(3, dump.count);
+    TEST_ASSERT_EQUAL(200, dump.records[1].value);
+    TEST_ASSERT_EQUAL(20, dump.records[1].timeUs);   // when the run started
+    TEST_ASSERT_EQUAL(1, dump.records[2].value);
+}
+
+void test_repeat_after_another_event_is_new(void) {
+    record(10, EVENT_MERGE_DROP, 1, 1, true);
+    record(20, EVENT_STOP, 3, 1, false);
+    record(30, EVENT_MERGE_DROP, 1, 1, true);
+    TEST_ASSERT_EQUAL(3, dump.count);
+}
+
+void test_events_during_dump_are_counted(void) {
+    record(10, EVENT_START, 3, 1, false);
+    freeze();
+    record(20, EVENT_STOP, 3, 1, false);
+    record(30, EVENT_START, 3, 1, false);
+    TEST_ASSERT_EQUAL(1, dump.count);
+    resume(false);
+    freeze();
+    TEST_ASSERT_EQUAL(2, dump.lost);
+    resume(false);
+    freeze();
+    TEST_ASSERT_EQUAL(0, dump.lost);
+}
+
+void test_clear_after_dump(void) {
+    for (uint8_t i = 0; i < 40; i++) record(i, EVENT_START, 0, i, false);
+    freeze();
+    resume(true);
+    TEST_ASSERT_EQUAL(8, freeze());
+    resume(false);
+    record(50, EVENT_STOP, 2, 1, false);
+    freeze();
+    TEST_ASSERT_EQUAL(1, dump.count);
+    TEST_ASSERT_EQUAL(1, dump.logged);
+    TEST_ASSERT_EQUAL(50, dump.records[0].timeUs);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_record_layout_is_packed);
+    RUN_TEST(test_partial_ring_dumps_in_order);
+    RUN_TEST(test_full_ring_rotated_oldest_first);
+    RUN_TEST(test_repeats_count_up_in_one_record);
+    RUN_TEST(test_repeat_after_another_event_is_new);
+    RUN_TEST(test_events_during_dump_are_counted);
+    RUN_TEST(test_clear_after_dump);
+    return UNITY_END();
+}
@@ -0,0 +1,219 @@
+#include <unity.h>
+#include <stdint.h>
+
+// Scheduler queue from Scheduler.cpp, groove warp from ClockBus.cpp
+// (micros() timestamps are 32-bit on AVR)
+#define SCHEDULER_QUEUE_SIZE  16
+#define SCHEDULER_EARLY_US    4
+#define CLOCK_TICKS_PER_STEP  6
+#define GROOVE_MAX_STEPS      16
+
+typedef void (*ScheduledCallback)(uint8_t arg);
+
+struct Event {
+    uint32_t dueUs;
+    ScheduledCallback callback;
+    uint8_t arg;
+};
+
+Event queue[SCHEDULER_QUEUE_SIZE];
+uint8_t count;
+uint16_t schedulerDrops;
+uint32_t nowUs;
+
+bool at(uint32_t dueUs, ScheduledCallback callback, uint8_t arg) {
+    if (count >= SCHEDULER_QUEUE_SIZE) { schedulerDrops++; return false; }
+    uint8_t i = count;
+    while (i > 0 && (int32_t)(queue[i - 1].dueUs - dueUs) > 0) {
+        queue[i] = queue[i - 1];
+        i--;
+    }
+    queue[i].dueUs = dueUs;
+    queue[i].callback = callback;
+    queue[i].arg = arg;
+    count++;
+    return true;
+}
+
+void cancel(ScheduledCallback callback) {
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (queue[i].callback != callback) queue[kept++] = queue[i];
+    }
+    count = kept;
+}
+
+void service() {
+    while (count > 0 && (int32_t)(queue[0].dueUs - nowUs) <= SCHEDULER_EARLY_US) {
+        Event event = queue[0];
+        count--;
+        for (uint8_t i = 0; i < count; i++) queue[i] = queue[i + 1];
+        event.callback(event.arg);
+    }
+}
+
+uint8_t grooveSteps;
+uint8_t grooveOffsets[GROOVE_MAX_STEPS];
+uint8_t grooveTick;
+unsigned long periodUs;
+
+unsigned long grooveDelay() {
+    if (grooveSteps == 0) return 0;
+    uint8_t step = grooveTick / CLOCK_TICKS_PER_STEP;
+    uint8_t phase = grooveTick % CLOCK_TICKS_PER_STEP;
+    uint8_t next = (step + 1 < grooveSteps) ? step + 1 : 0;
+    if (++grooveTick >= grooveSteps * CLOCK_TICKS_PER_STEP) grooveTick = 0;
+    int16_t offset = grooveOffsets[step] * CLOCK_TICKS_PER_STEP
+                   + ((int16_t)grooveOffsets[next] - grooveOffsets[step]) * phase;
+    return ((unsigned long)offset * periodUs) / 128;
+}
+
+uint8_t firedArgs[SCHEDULER_QUEUE_SIZE];
+uint8_t firedCount;
+void record(uint8_t arg) { firedArgs[firedCount++] = arg; }
+void other(uint8_t arg) { }
+
+// Test events fire in due order regardless of insertion order
+void test_events_sorted_by_due_time() {
+    at(3000, record, 3);
+    at(1000, record, 1);
+    at(2000, record, 2);
+    nowUs = 5000;
+    service();
+    TEST_ASSERT_EQUAL_UINT8(3, firedCount);
+    TEST_ASSERT_EQUAL_UINT8(1, firedArgs[0]);
+    TEST_ASSERT_EQUAL_UINT8(2, firedArgs[1]);
+    TEST_ASSERT_EQUAL_UINT8(3, firedArgs[2]);
+}
+
+// Test nothing fires before it is due
+void test_not_fired_early() {
+    at(1000, record, 1);
+    nowUs = 990;
+    service();
+    TEST_ASSERT_EQUAL_UINT8(0, firedCount);
+    nowUs = 997;
+    service();
+    TEST_ASSERT_EQUAL_UINT8(1, firedCount);
+}
+
+// Test ordering survives the micros() wrap
+void test_due_time_wraps() {
+    at(0xFFFFFF00UL, record, 1);
+    at(0x00000100UL, record, 2);
+    TEST_ASSERT_EQUAL_UINT8(1, queue[0].arg);
+    nowUs = 0xFFFFFFF0UL;
+    service();
+    TEST_ASSERT_EQUAL_UINT8(1, firedCount);
+}
+
+// Test cancel removes only the given callback
+void test_cancel_by_callback() {
+    at(1000, record, 1);
+    at(1100, other, 0);
+    at(1200, record, 2);
+    cancel(record);
+    TEST_ASSERT_EQUAL_UINT8(1, count);
+    TEST_ASSERT_TRUE(queue[0].callback == other);
+}
+
+// Test a full queue refuses and counts the event
+void test_full_queue_counts_drop() {
+    for (uint8_t i = 0; i < SCHEDULER_QUEUE_SIZE; i++) TEST_ASSERT_TRUE(at(1000 + i, record, i));
+    TEST_ASSERT_FALSE(at(5000, record, 99));
+    TEST_ASSERT_EQUAL_UINT16(1, schedulerDrops);
+}
+
+// Test no template means no delay
+void test_groove_off_no_delay() {
+    periodUs = 20833;
+    for (int i = 0; i < 24; i++) TEST_ASSERT_EQUAL_UINT32(0, grooveDelay());
+}
+
+// Test swing delays the even 16th and ramps in and out of it
+void test_swing_delays_even_sixteenths() {
+    // 66% swing: the second 16th of each pair starts 0.32 of a 16th late
+    grooveSteps = 2;
+    grooveOffsets[0] = 0;
+    grooveOffsets[1] = 41;
+    periodUs = 12800;  // 16th = 76800 us
+    unsigned long delays[12];
+    for (int i = 0; i < 12; i++) delays[i] = grooveDelay();
+    
+    TEST_ASSERT_EQUAL_UINT32(0, delays[0]);
+    TEST_ASSERT_EQUAL_UINT32(41 * 6 * 12800 / 128, delays[6]);
+    TEST_ASSERT_EQUAL_UINT32(delays[6] / 2, delays[3]);
+    TEST_ASSERT_EQUAL_UINT32(delays[6] / 6, delays[11]);
+    TEST_ASSERT_EQUAL_UINT32(0, grooveDelay());  // pattern repeats
+}
+
+// Test warped tick times stay strictly increasing
+void test_warped_clock_monotonic() {
+    grooveSteps = 4;
+    grooveOffsets[0] = 0;
+    grooveOffsets[1] = 100;
+    grooveOffsets[2] = 10;
+    grooveOffsets[3] = 127;
+    periodUs = 10000;
+    unsigned long previous = 0;
+    for (int i = 1; i <= 48; i++) {
+        unsigned long t = i * periodUs + grooveDelay();
+        TEST_ASSERT_TRUE(t > previous);
+        previous = t;
+    }
+}
+
+// Test delayed ticks scheduled through the queue come out in tick order
+void test_groove_through_scheduler() {
+    grooveSteps = 2;
+    grooveOffsets[0] = 0;
+    grooveOffsets[1] = 64;
+    periodUs = 10000;
+    for (uint8_t i = 0; i < 12; i++) {
+        unsigned long received = (i + 1) * periodUs;
+        unsigned long delay = grooveDelay();
+        if (delay == 0) {
+            nowUs = received;
+            service();
+            record(i);
+        } else {
+            at(received + delay, record, i);
+        }
+    }
+    nowUs = 200000;
+    service();
+    TEST_ASSERT_EQUAL_UINT8(12, firedCount);
+    for (uint8_t i = 0; i < 12; i++) TEST_ASSERT_EQUAL_UINT8(i, firedArgs[i]);
+}
+
+void setUp(void) {
+    count = 0;
+    schedulerDrops = 0;
+    nowUs = 0;
+    firedCount = 0;
+    grooveSteps = 0;
+    grooveTick = 0;
+    periodUs = 0;
+}
+
+void tearDown(void) {
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    
+    // Scheduler tests
+    RUN_TEST(test_events_sorted_by_due_time);
+    RUN_TEST(test_not_fired_early);
+    RUN_TEST(test_due_time_wraps);
+    RUN_TEST(test_cancel_by_callback);
+    RUN_TEST(test_full_queue_counts_drop);
+    
+    // Groove tests
+    RUN_TEST(test_groove_off_no_delay);
+    RUN_TEST(test_swing_delays_even_sixteenths);
+    RUN_TEST(test_warped_clock_monotonic);
+    RUN_TEST(test_groove_through_scheduler);
+    
+    return UNITY_END();
+}
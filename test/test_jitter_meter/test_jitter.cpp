@@ -0,0 +1,192 @@
+#include <unity.h>
+#include <stdint.h>
+#include <string.h>
+
+// Interval statistics from JitterMeter.cpp
+// (micros() timestamps are 32-bit on AVR)
+#define JITTER_BINS      16
+#define JITTER_BIN_SHIFT 7
+#define JITTER_MAX_COUNT 0xFFFF
+
+uint32_t lastUs, expectedUs, baseUs, minUs, maxUs;
+uint16_t count, missing, extra;
+int32_t sum;
+uint64_t sumSquares;
+uint16_t histogram[JITTER_BINS];
+
+void record(uint32_t timestampUs, uint8_t ticks) {
+    uint32_t previousUs = lastUs;
+    lastUs = timestampUs;
+    if (previousUs == 0) return;
+
+    uint32_t intervalUs = timestampUs - previousUs;
+    if (ticks > 1) intervalUs /= ticks;
+
+    if (expectedUs == 0) {
+        expectedUs = intervalUs;
+        baseUs = intervalUs;
+        return;
+    }
+
+    if (intervalUs > expectedUs + expectedUs / 2) {
+        uint16_t lost = (intervalUs + expectedUs / 2) / expectedUs - 1;
+        missing = (missing > 0xFFFF - lost) ? 0xFFFF : missing + lost;
+        return;
+    }
+    if (intervalUs < expectedUs / 2) {
+        if (extra < 0xFFFF) extra++;
+        return;
+    }
+
+    int32_t deviationUs = (int32_t)(intervalUs - expectedUs);
+    int8_t bin = (deviationUs >> JITTER_BIN_SHIFT) + JITTER_BINS / 2;
+    if (deviationUs < -(int32_t)(JITTER_BINS / 2 << JITTER_BIN_SHIFT)) bin = 0;
+    else if (deviationUs >= (int32_t)(JITTER_BINS / 2 << JITTER_BIN_SHIFT)) bin = JITTER_BINS - 1;
+    if (histogram[bin] < 0xFFFF) histogram[bin]++;
+
+    expectedUs = (expectedUs * 3 + intervalUs) / 4;
+
+    if (count == JITTER_MAX_COUNT) return;
+
+    int32_t offsetUs = (int32_t)(intervalUs - baseUs);
+    if (offsetUs > 0xFFFF) offsetUs = 0xFFFF;
+    if (offsetUs < -0xFFFF) offsetUs = -0xFFFF;
+    uint32_t magnitude = offsetUs < 0 ? -offsetUs : offsetUs;
+    count++;
+    sum += offsetUs;
+    sumSquares += magnitude * magnitude;
+    if (intervalUs < minUs) minUs = intervalUs;
+    if (intervalUs > maxUs) maxUs = intervalUs;
+}
+
+uint32_t squareRoot(uint64_t value) {
+    uint64_t result = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > value) bit >>= 2;
+    while (bit) {
+        if (value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return result;
+}
+
+uint32_t meanNs() {
+    int64_t mean16 = (int64_t)sum * 16 / count;
+    return baseUs * 1000 + mean16 * 1000 / 16;
+}
+
+uint32_t stdDevNs() {
+    int64_t mean16 = (int64_t)sum * 16 / count;
+    int64_t variance256 = (int64_t)(sumSquares * 256 / count) - mean16 * mean16;
+    if (variance256 < 0) variance256 = 0;
+    return (uint64_t)squareRoot(variance256) * 1000 / 16;
+}
+
+void setUp(void) {
+    lastUs = expectedUs = baseUs = maxUs = 0;
+    minUs = 0xFFFFFFFFUL;
+    count = missing = extra = 0;
+    sum = 0;
+    sumSquares = 0;
+    memset(histogram, 0, sizeof(histogram));
+}
+
+void tearDown(void) {}
+
+void test_steady_clock(void) {
+    for (int i = 0; i < 100; i++) record(1000 + i * 20833, 1);
+    TEST_ASSERT_EQUAL(98, count);   // first interval seeds the average
+    TEST_ASSERT_EQUAL(20833000, meanNs());
+    TEST_ASSERT_EQUAL(0, stdDevNs());
+    TEST_ASSERT_EQUAL(98, histogram[8]);
+}
+
+void test_alternating_jitter(void) {
+    // +-200 us around 20000: standard deviation 200 us
+    uint32_t t = 1000;
+    record(t, 1);
+    t += 20000;
+    record(t, 1);
+    for (int i = 0; i < 200; i++) {
+        t += (i & 1) ? 20200 : 19800;
+        record(t, 1);
+    }
+    TEST_ASSERT_EQUAL(200, count);
+    TEST_ASSERT_EQUAL(20000000, meanNs());
+    TEST_ASSERT_UINT32_WITHIN(100, 200000, stdDevNs());
+    TEST_ASSERT_EQUAL(19800, minUs);
+    TEST_ASSERT_EQUAL(20200, maxUs);
+}
+
+void test_fractional_mean(void) {
+    // 20833 and 20834 alternating: mean 20833.5 us
+    uint32_t t = 1000;
+    record(t, 1);
+    t += 20833;
+    record(t, 1);
+    for (int i = 0; i < 100; i++) {
+        t += (i & 1) ? 20834 : 20833;
+        record(t, 1);
+    }
+    TEST_ASSERT_EQUAL(20833500, meanNs());
+}
+
+void test_gap_counts_missing_ticks(void) {
+    uint32_t t = 1000;
+    for (int i = 0; i < 10; i++, t += 20000) record(t, 1);
+    record(t + 40000, 1);   // 60 ms after the last tick: two lost
+    TEST_ASSERT_EQUAL(2, missing);
+    TEST_ASSERT_EQUAL(8, count);
+}
+
+void test_doubled_tick_counts_extra(void) {
+    uint32_t t = 1000;
+    for (int i = 0; i < 10; i++, t += 20000) record(t, 1);
+    record(t - 20000 + 500, 1);
+    TEST_ASSERT_EQUAL(1, extra);
+}
+
+void test_histogram_bins_and_clamp(void) {
+    uint32_t t = 1000;
+    record(t, 1);
+    t += 20000;
+    record(t, 1);
+    t += 20000 - 130;   // bin 6: [-256, -128)
+    record(t, 1);
+    TEST_ASSERT_EQUAL(1, histogram[6]);
+    t += expectedUs + 5000;   // beyond +1024 us
+    record(t, 1);
+    TEST_ASSERT_EQUAL(1, histogram[15]);
+}
+
+void test_sync_pulse_divided_per_tick(void) {
+    // 4 PPQN pulses worth 6 ticks each
+    for (int i = 0; i < 20; i++) record(1000 + i * 125000, 6);
+    TEST_ASSERT_EQUAL(18, count);
+    TEST_ASSERT_EQUAL(20833000, meanNs());
+}
+
+void test_count_freezes_at_limit(void) {
+    uint32_t t = 1000;
+    for (uint32_t i = 0; i < 70000; i++, t += 1000) record(t, 1);
+    TEST_ASSERT_EQUAL(JITTER_MAX_COUNT, count);
+    TEST_ASSERT_EQUAL(0xFFFF, histogram[8]);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_steady_clock);
+    RUN_TEST(test_alternating_jitter);
+    RUN_TEST(test_fractional_mean);
+    RUN_TEST(test_gap_counts_missing_ticks);
+    RUN_TEST(test_doubled_tick_counts_extra);
+    RUN_TEST(test_histogram_bins_and_clamp);
+    RUN_TEST(test_sync_pulse_divided_per_tick);
+    RUN_TEST(test_count_freezes_at_limit);
+    return UNITY_END();
+}
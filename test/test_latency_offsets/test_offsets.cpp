@@ -0,0 +1,211 @@
+#include <unity.h>
+#include <stdint.h>
+
+// Per-output latency offsets from ClockBus.cpp (groove off)
+// (micros() timestamps are 32-bit on AVR)
+#define CLOCK_PERIOD_MAX_US  250000
+#define SCHEDULER_EARLY_US   4
+
+enum ClockOutput { CLOCK_OUTPUT_SYNC = 0, CLOCK_OUTPUT_DIN, CLOCK_OUTPUT_USB, CLOCK_OUTPUT_COUNT };
+
+int16_t outputOffsetUs[CLOCK_OUTPUT_COUNT];
+uint8_t predictedOutputs;
+uint32_t lastTickUs;
+uint32_t periodUs;
+uint32_t nowUs;
+
+// Every output event, in the order it was handed out: (output, due time)
+uint8_t sentOutput[256];
+uint32_t sentDue[256];
+int sentCount;
+
+void send(uint8_t outputs, uint32_t dueUs) {
+    for (uint8_t i = 0; i < CLOCK_OUTPUT_COUNT; i++) {
+        if (outputs & (1 << i)) {
+            sentOutput[sentCount] = i;
+            sentDue[sentCount] = dueUs;
+            sentCount++;
+        }
+    }
+}
+
+// Ticks due now collect in one mask and go out together once per tick
+void dispatch(uint8_t outputs, uint32_t dueUs, uint8_t& immediate) {
+    if ((int32_t)(dueUs - nowUs) > SCHEDULER_EARLY_US) { send(outputs, dueUs); return; }
+    uint8_t twice = immediate & outputs;
+    if (twice) {
+        send(twice, nowUs);
+        immediate &= ~twice;
+    }
+    immediate |= outputs;
+}
+
+void tick(uint32_t timestampUs, uint8_t outputs) {
+    nowUs = timestampUs;
+    uint32_t interval = timestampUs - lastTickUs;
+    if (lastTickUs != 0 && interval < CLOCK_PERIOD_MAX_US) {
+        periodUs = (periodUs == 0) ? interval : (periodUs * 3 + interval) / 4;
+    }
+    lastTickUs = timestampUs;
+    
+    uint8_t immediate = 0;
+    for (uint8_t i = 0; i < CLOCK_OUTPUT_COUNT; i++) {
+        uint8_t output = 1 << i;
+        if (!(outputs & output)) continue;
+        int16_t offsetUs = outputOffsetUs[i];
+        if (offsetUs >= 0) {
+            if (predictedOutputs & output) predictedOutputs &= ~output;
+            else dispatch(output, timestampUs + offsetUs, immediate);
+            continue;
+        }
+        if (!(predictedOutputs & output)) dispatch(output, timestampUs, immediate);
+        if (periodUs != 0) {
+            uint32_t leadUs = (uint32_t)(-(int32_t)offsetUs);
+            if (leadUs >= periodUs) leadUs = periodUs - 1;
+            dispatch(output, timestampUs + periodUs - leadUs, immediate);
+            predictedOutputs |= output;
+        } else {
+            predictedOutputs &= ~output;
+        }
+    }
+    if (immediate) send(immediate, nowUs);
+}
+
+void setOutputOffset(uint8_t output, int16_t offsetUs) {
+    outputOffsetUs[output] = offsetUs;
+}
+
+int countFor(uint8_t output) {
+    int n = 0;
+    for (int i = 0; i < sentCount; i++) if (sentOutput[i] == output) n++;
+    return n;
+}
+
+// Last due time handed out for an output
+uint32_t lastDue(uint8_t output) {
+    for (int i = sentCount - 1; i >= 0; i--) if (sentOutput[i] == output) return sentDue[i];
+    return 0;
+}
+
+#define ALL_OUTPUTS 0x07
+#define PERIOD 20000UL
+
+// Test zero offsets send every output at the tick itself
+void test_zero_offsets_immediate() {
+    tick(1000, ALL_OUTPUTS);
+    TEST_ASSERT_EQUAL_INT(3, sentCount);
+    for (int i = 0; i < 3; i++) TEST_ASSERT_EQUAL_UINT32(1000, sentDue[i]);
+}
+
+// Test positive offsets delay only their own output
+void test_positive_offset_delays() {
+    setOutputOffset(CLOCK_OUTPUT_DIN, 1500);
+    tick(1000, ALL_OUTPUTS);
+    TEST_ASSERT_EQUAL_UINT32(1000, lastDue(CLOCK_OUTPUT_SYNC));
+    TEST_ASSERT_EQUAL_UINT32(2500, lastDue(CLOCK_OUTPUT_DIN));
+    TEST_ASSERT_EQUAL_UINT32(1000, lastDue(CLOCK_OUTPUT_USB));
+}
+
+// Test negative offsets fire ahead of each tick once the period is known
+void test_negative_offset_fires_early() {
+    setOutputOffset(CLOCK_OUTPUT_SYNC, -3000);
+    for (uint32_t n = 1; n <= 10; n++) tick(n * PERIOD, 1 << CLOCK_OUTPUT_SYNC);
+    // Tick 11 is predicted from tick 10
+    TEST_ASSERT_EQUAL_UINT32(11 * PERIOD - 3000, lastDue(CLOCK_OUTPUT_SYNC));
+}
+
+// Test early firing never adds or loses a tick
+void test_negative_offset_one_per_tick() {
+    setOutputOffset(CLOCK_OUTPUT_USB, -5000);
+    for (uint32_t n = 1; n <= 24; n++) tick(n * PERIOD, ALL_OUTPUTS);
+    // 24 ticks plus the prediction for tick 25
+    TEST_ASSERT_EQUAL_INT(24, countFor(CLOCK_OUTPUT_SYNC));
+    TEST_ASSERT_EQUAL_INT(25, countFor(CLOCK_OUTPUT_USB));
+}
+
+// Test early and delayed outputs line up on the same downbeat
+void test_outputs_aligned_to_downbeat() {
+    // SYNC OUT gear sounds 2 ms after its edge, DIN gear 1 ms before the USB host
+    setOutputOffset(CLOCK_OUTPUT_SYNC, -2000);
+    setOutputOffset(CLOCK_OUTPUT_DIN, 1000);
+    for (uint32_t n = 1; n <= 8; n++) tick(n * PERIOD, ALL_OUTPUTS);
+    TEST_ASSERT_EQUAL_UINT32(9 * PERIOD, lastDue(CLOCK_OUTPUT_SYNC) + 2000);
+    TEST_ASSERT_EQUAL_UINT32(8 * PERIOD, lastDue(CLOCK_OUTPUT_DIN) - 1000);
+}
+
+// Test the first tick goes out at once while no period is known
+void test_first_tick_without_prediction() {
+    setOutputOffset(CLOCK_OUTPUT_DIN, -4000);
+    tick(1000, 1 << CLOCK_OUTPUT_DIN);
+    TEST_ASSERT_EQUAL_INT(1, sentCount);
+    TEST_ASSERT_EQUAL_UINT32(1000, sentDue[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, predictedOutputs);
+}
+
+// Test changing a negative offset keeps the prediction in place
+void test_offset_change_keeps_count() {
+    setOutputOffset(CLOCK_OUTPUT_SYNC, -1000);
+    for (uint32_t n = 1; n <= 4; n++) tick(n * PERIOD, 1 << CLOCK_OUTPUT_SYNC);
+    setOutputOffset(CLOCK_OUTPUT_SYNC, -3000);
+    for (uint32_t n = 5; n <= 8; n++) tick(n * PERIOD, 1 << CLOCK_OUTPUT_SYNC);
+    TEST_ASSERT_EQUAL_INT(9, countFor(CLOCK_OUTPUT_SYNC));
+}
+
+// Test a lead of a period or more is capped and loses no tick
+void test_lead_beyond_period_keeps_count() {
+    setOutputOffset(CLOCK_OUTPUT_DIN, -25000);
+    for (uint32_t n = 1; n <= 8; n++) tick(n * PERIOD, 1 << CLOCK_OUTPUT_DIN);
+    TEST_ASSERT_EQUAL_INT(9, countFor(CLOCK_OUTPUT_DIN));
+    TEST_ASSERT_EQUAL_UINT32(8 * PERIOD, lastDue(CLOCK_OUTPUT_DIN));  // tick 9 right behind tick 8
+}
+
+// Test two ticks due in the same pass both go out
+void test_unpredicted_and_prediction_both_sent() {
+    setOutputOffset(CLOCK_OUTPUT_SYNC, -3000);
+    lastTickUs = 1000;
+    periodUs = 2;  // prediction lands inside SCHEDULER_EARLY_US of the tick
+    tick(1002, 1 << CLOCK_OUTPUT_SYNC);
+    TEST_ASSERT_EQUAL_INT(2, countFor(CLOCK_OUTPUT_SYNC));
+}
+
+// Test an offset turned positive mid-run does not double the predicted tick
+void test_offset_turning_positive_not_doubled() {
+    setOutputOffset(CLOCK_OUTPUT_USB, -4000);
+    for (uint32_t n = 1; n <= 4; n++) tick(n * PERIOD, 1 << CLOCK_OUTPUT_USB);
+    setOutputOffset(CLOCK_OUTPUT_USB, 1000);
+    for (uint32_t n = 5; n <= 8; n++) tick(n * PERIOD, 1 << CLOCK_OUTPUT_USB);
+    // Ticks 1-4, the prediction for 5, then 6-8 delayed
+    TEST_ASSERT_EQUAL_INT(8, countFor(CLOCK_OUTPUT_USB));
+    TEST_ASSERT_EQUAL_UINT32(8 * PERIOD + 1000, lastDue(CLOCK_OUTPUT_USB));
+}
+
+void setUp(void) {
+    for (int i = 0; i < CLOCK_OUTPUT_COUNT; i++) outputOffsetUs[i] = 0;
+    predictedOutputs = 0;
+    lastTickUs = 0;
+    periodUs = 0;
+    nowUs = 0;
+    sentCount = 0;
+}
+
+void tearDown(void) {
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_zero_offsets_immediate);
+    RUN_TEST(test_positive_offset_delays);
+    
+    // Predictive early firing tests
+    RUN_TEST(test_negative_offset_fires_early);
+    RUN_TEST(test_negative_offset_one_per_tick);
+    RUN_TEST(test_outputs_aligned_to_downbeat);
+    RUN_TEST(test_first_tick_without_prediction);
+    RUN_TEST(test_offset_change_keeps_count);
+    RUN_TEST(test_lead_beyond_period_keeps_count);
+    RUN_TEST(test_unpredicted_and_prediction_both_sent);
+    RUN_TEST(test_offset_turning_positive_not_doubled);
+    
+    return UNITY_END();
+}
@@ -0,0 +1,398 @@
+#include <unity.h>
+#include <stdint.h>
+
+// DIN OUT merge engine from MidiMerge.cpp
+#define MERGE_DIN_QUEUE_SIZE    128
+#define MERGE_USB_QUEUE_SIZE    64
+#define MERGE_REALTIME_SIZE     8
+#define MERGE_TX_LIMIT          12
+#define MERGE_SYSEX_TIMEOUT_MS  100
+
+enum MergeSource { MERGE_SOURCE_DIN = 0, MERGE_SOURCE_USB = 1, MERGE_SOURCE_COUNT, MERGE_SOURCE_NONE = 0xFF };
+
+struct Queue {
+    uint8_t* buffer;
+    uint8_t mask;
+    uint8_t head;
+    uint8_t tail;
+    bool inSysEx;
+    bool dropSysEx;
+    unsigned long lastWrite;
+};
+
+Queue queues[MERGE_SOURCE_COUNT];
+uint8_t dinBuffer[MERGE_DIN_QUEUE_SIZE];
+uint8_t usbBuffer[MERGE_USB_QUEUE_SIZE];
+uint8_t realtime[MERGE_REALTIME_SIZE];
+uint8_t realtimeHead, realtimeTail;
+uint8_t common[3];
+uint8_t commonLength;
+uint8_t lockedSource, nextSource;
+uint16_t mergeDrops;
+uint16_t txStalls;
+bool txStalled;
+
+// Simulated UART: everything written lands in wire[], txQueued bytes are still in flight
+uint8_t wire[512];
+int wireLength;
+int txQueued;
+unsigned long now;
+
+void uartWrite(uint8_t data) { wire[wireLength++] = data; txQueued++; }
+uint8_t txFree() { return (txQueued >= MERGE_TX_LIMIT) ? 0 : MERGE_TX_LIMIT - txQueued; }
+uint8_t used(const Queue& q) { return (q.head - q.tail) & q.mask; }
+
+uint8_t messageLength(uint8_t status) {
+    if (status >= 0xF4) return 1;
+    if (status == 0xF1 || status == 0xF3) return 2;
+    if (status == 0xF2) return 3;
+    uint8_t type = status & 0xF0;
+    return (type == 0xC0 || type == 0xD0) ? 2 : 3;
+}
+
+void push(Queue& q, uint8_t data) {
+    q.buffer[q.head] = data;
+    q.head = (q.head + 1) & q.mask;
+}
+
+void closeSysEx(uint8_t source) {
+    Queue& q = queues[source];
+    if (q.inSysEx) {
+        push(q, 0xF7);
+        q.inSysEx = false;
+    }
+}
+
+bool send(uint8_t source, uint8_t status, uint8_t data1, uint8_t data2) {
+    Queue& q = queues[source];
+    uint8_t length = messageLength(status);
+    closeSysEx(source);
+    q.dropSysEx = false;
+    if (q.mask - used(q) < length) { mergeDrops++; return false; }
+    push(q, status);
+    if (length > 1) push(q, data1);
+    if (length > 2) push(q, data2);
+    q.lastWrite = now;
+    return true;
+}
+
+bool sendSysEx(uint8_t source, const uint8_t* data, uint16_t length) {
+    Queue& q = queues[source];
+    closeSysEx(source);
+    q.dropSysEx = false;
+    if (length == 0 || length > (uint16_t)(q.mask - used(q))) { mergeDrops++; return false; }
+    for (uint16_t i = 0; i < length; i++) push(q, data[i]);
+    q.lastWrite = now;
+    return true;
+}
+
+bool sendSysExChunk(uint8_t source, const uint8_t* data, uint8_t length) {
+    Queue& q = queues[source];
+    if (length == 0) return false;
+    if (data[0] == 0xF0) {
+        closeSysEx(source);
+        q.dropSysEx = false;
+    } else if (!q.inSysEx) {
+        return false;
+    }
+    bool ends = (data[length - 1] == 0xF7);
+    uint8_t needed = length + (ends ? 0 : 1);
+    if (q.mask - used(q) < needed) {
+        closeSysEx(source);
+        q.dropSysEx = true;
+        mergeDrops++;
+        return false;
+    }
+    for (uint8_t i = 0; i < length; i++) push(q, data[i]);
+    q.inSysEx = !ends;
+    q.lastWrite = now;
+    return true;
+}
+
+void sendRealtime(uint8_t status) {
+    bool commonFirst = commonLength > 0 && lockedSource == MERGE_SOURCE_NONE;
+    if (realtimeHead == realtimeTail && !commonFirst && txQueued < 63) { uartWrite(status); return; }
+    uint8_t next = (realtimeHead + 1) & (MERGE_REALTIME_SIZE - 1);
+    if (next == realtimeTail) { mergeDrops++; return; }
+    realtime[realtimeHead] = status;
+    realtimeHead = next;
+}
+
+void sendCommon(uint8_t status, uint8_t data1, uint8_t data2) {
+    if (commonLength > 0) mergeDrops++;
+    common[0] = status;
+    common[1] = data1;
+    common[2] = data2;
+    commonLength = messageLength(status);
+}
+
+bool flushCommon() {
+    if (63 - txQueued < commonLength) return false;
+    for (uint8_t i = 0; i < commonLength; i++) uartWrite(common[i]);
+    commonLength = 0;
+    return true;
+}
+
+void stall() {
+    if (txStalled) return;
+    txStalled = true;
+    txStalls++;
+}
+
+bool drainSysEx(uint8_t source) {
+    Queue& q = queues[source];
+    while (used(q) > 0) {
+        if (txFree() == 0) { stall(); return false; }
+        uint8_t data = q.buffer[q.tail];
+        q.tail = (q.tail + 1) & q.mask;
+        uartWrite(data);
+        txStalled = false;
+        if (data == 0xF7) { lockedSource = MERGE_SOURCE_NONE; return true; }
+    }
+    if (q.inSysEx && (now - q.lastWrite) > MERGE_SYSEX_TIMEOUT_MS && txFree() > 0) {
+        uartWrite(0xF7);
+        q.inSysEx = false;
+        q.dropSysEx = true;
+        lockedSource = MERGE_SOURCE_NONE;
+        return true;
+    }
+    return false;
+}
+
+void update() {
+    if (commonLength > 0 && lockedSource == MERGE_SOURCE_NONE && !flushCommon()) return;
+    while (realtimeTail != realtimeHead && txQueued < 63) {
+        uartWrite(realtime[realtimeTail]);
+        realtimeTail = (realtimeTail + 1) & (MERGE_REALTIME_SIZE - 1);
+    }
+    if (lockedSource != MERGE_SOURCE_NONE && !drainSysEx(lockedSource)) return;
+    if (commonLength > 0 && !flushCommon()) return;
+    uint8_t idle = 0;
+    while (idle < MERGE_SOURCE_COUNT) {
+        uint8_t source = nextSource;
+        Queue& q = queues[source];
+        nextSource = (nextSource + 1) % MERGE_SOURCE_COUNT;
+        if (used(q) == 0) { idle++; continue; }
+        idle = 0;
+        uint8_t status = q.buffer[q.tail];
+        if (status == 0xF0) {
+            lockedSource = source;
+            if (!drainSysEx(source)) return;
+            continue;
+        }
+        if (status < 0x80) { q.tail = (q.tail + 1) & q.mask; continue; }
+        uint8_t length = messageLength(status);
+        if (txFree() < length) { nextSource = source; stall(); return; }
+        for (uint8_t i = 0; i < length; i++) {
+            uartWrite(q.buffer[q.tail]);
+            q.tail = (q.tail + 1) & q.mask;
+        }
+        txStalled = false;
+    }
+}
+
+// Drain the simulated UART completely, running the merge until nothing is left
+void runUntilIdle() {
+    for (int pass = 0; pass < 200; pass++) {
+        txQueued = 0;
+        update();
+    }
+}
+
+// Test every message on the wire starts with a status byte at the expected boundaries
+void test_messages_never_interleaved() {
+    for (uint8_t i = 0; i < 10; i++) {
+        send(MERGE_SOURCE_DIN, 0x90, i, 100);
+        send(MERGE_SOURCE_USB, 0xB1, i, 0);
+    }
+    runUntilIdle();
+    TEST_ASSERT_EQUAL_INT(60, wireLength);
+    for (int i = 0; i < wireLength; i += 3) {
+        TEST_ASSERT_TRUE(wire[i] == 0x90 || wire[i] == 0xB1);
+    }
+}
+
+// Test sources alternate one message per turn
+void test_round_robin_fairness() {
+    for (uint8_t i = 0; i < 4; i++) send(MERGE_SOURCE_DIN, 0x90, i, 1);
+    for (uint8_t i = 0; i < 4; i++) send(MERGE_SOURCE_USB, 0xC2, i, 0);
+    runUntilIdle();
+    TEST_ASSERT_EQUAL_UINT8(0x90, wire[0]);
+    TEST_ASSERT_EQUAL_UINT8(0xC2, wire[3]);
+    TEST_ASSERT_EQUAL_UINT8(0x90, wire[5]);
+    TEST_ASSERT_EQUAL_UINT8(0xC2, wire[8]);
+}
+
+// Test a message waits whole when the UART has no room for all of it
+void test_tx_limit_keeps_message_whole() {
+    txQueued = MERGE_TX_LIMIT - 2;
+    send(MERGE_SOURCE_DIN, 0x90, 60, 100);
+    update();
+    TEST_ASSERT_EQUAL_INT(0, wireLength);
+    txQueued = 0;
+    update();
+    TEST_ASSERT_EQUAL_INT(3, wireLength);
+}
+
+// Test a backed-up UART counts one stall however many passes it lasts
+void test_stall_counted_once_per_episode() {
+    txQueued = MERGE_TX_LIMIT;
+    send(MERGE_SOURCE_DIN, 0x90, 60, 100);
+    for (int pass = 0; pass < 50; pass++) update();
+    TEST_ASSERT_EQUAL_UINT16(1, txStalls);
+    
+    txQueued = 0;
+    update();  // room again: the next full buffer is a new stall
+    TEST_ASSERT_EQUAL_INT(3, wireLength);
+    txQueued = MERGE_TX_LIMIT;
+    send(MERGE_SOURCE_DIN, 0x90, 61, 100);
+    update();
+    update();
+    TEST_ASSERT_EQUAL_UINT16(2, txStalls);
+}
+
+// Test realtime bytes go straight out even while messages are queued
+void test_realtime_cuts_in() {
+    txQueued = MERGE_TX_LIMIT;
+    send(MERGE_SOURCE_DIN, 0x90, 60, 100);
+    sendRealtime(0xF8);
+    TEST_ASSERT_EQUAL_INT(1, wireLength);
+    TEST_ASSERT_EQUAL_UINT8(0xF8, wire[0]);
+}
+
+// Test a SysEx holds the output until its F7 is written
+void test_sysex_locks_output() {
+    uint8_t sysex[20] = {0xF0};
+    for (int i = 1; i < 19; i++) sysex[i] = i;
+    sysex[19] = 0xF7;
+    sendSysEx(MERGE_SOURCE_DIN, sysex, sizeof(sysex));
+    send(MERGE_SOURCE_USB, 0x91, 1, 2);
+    
+    update();  // first 12 bytes of the SysEx
+    TEST_ASSERT_EQUAL_UINT8(MERGE_SOURCE_DIN, lockedSource);
+    txQueued = 0;
+    update();
+    TEST_ASSERT_EQUAL_INT(23, wireLength);
+    TEST_ASSERT_EQUAL_UINT8(0xF7, wire[19]);
+    TEST_ASSERT_EQUAL_UINT8(0x91, wire[20]);
+}
+
+// Test a Song Position waits out a SysEx while the clock behind it keeps cutting in
+void test_song_position_waits_out_sysex() {
+    uint8_t sysex[40] = {0xF0};
+    sysex[39] = 0xF7;
+    sendSysEx(MERGE_SOURCE_DIN, sysex, sizeof(sysex));
+    send(MERGE_SOURCE_USB, 0x91, 1, 2);
+    update();  // SysEx under way
+    TEST_ASSERT_EQUAL_UINT8(MERGE_SOURCE_DIN, lockedSource);
+    
+    sendCommon(0xF2, 0x10, 0x00);
+    for (int i = 0; i < 10; i++) sendRealtime(0xF8);  // more than the realtime ring holds
+    TEST_ASSERT_EQUAL_INT(12 + 10, wireLength);
+    TEST_ASSERT_EQUAL_UINT8(0xF8, wire[21]);
+    TEST_ASSERT_EQUAL_UINT16(0, mergeDrops);
+    
+    runUntilIdle();
+    TEST_ASSERT_EQUAL_UINT8(0xF7, wire[49]);
+    TEST_ASSERT_EQUAL_UINT8(0xF2, wire[50]);  // ahead of the queued message
+    TEST_ASSERT_EQUAL_UINT8(0x91, wire[53]);
+}
+
+// Test outside a SysEx the Continue sent after a Song Position stays behind it
+void test_song_position_stays_ahead_of_continue() {
+    txQueued = 62;
+    sendCommon(0xF2, 0x10, 0x00);
+    sendRealtime(0xFB);
+    TEST_ASSERT_EQUAL_INT(0, wireLength);
+    txQueued = 0;
+    update();
+    TEST_ASSERT_EQUAL_INT(4, wireLength);
+    TEST_ASSERT_EQUAL_UINT8(0xF2, wire[0]);
+    TEST_ASSERT_EQUAL_UINT8(0xFB, wire[3]);
+}
+
+// Test a full queue drops the whole message and counts it
+void test_full_queue_drops_whole_message() {
+    for (int i = 0; i < 21; i++) TEST_ASSERT_TRUE(send(MERGE_SOURCE_USB, 0x90, 1, 1));
+    TEST_ASSERT_FALSE(send(MERGE_SOURCE_USB, 0x90, 1, 1));
+    TEST_ASSERT_EQUAL_UINT16(1, mergeDrops);
+    TEST_ASSERT_EQUAL_UINT8(63, used(queues[MERGE_SOURCE_USB]));
+}
+
+// Test an oversized SysEx is refused rather than split
+void test_oversized_sysex_refused() {
+    uint8_t sysex[100] = {0xF0};
+    sysex[99] = 0xF7;
+    TEST_ASSERT_FALSE(sendSysEx(MERGE_SOURCE_USB, sysex, sizeof(sysex)));
+    TEST_ASSERT_EQUAL_UINT8(0, used(queues[MERGE_SOURCE_USB]));
+}
+
+// Test a USB SysEx that overflows is terminated and the rest discarded
+void test_chunk_overflow_terminates() {
+    const uint8_t start[3] = {0xF0, 0x01, 0x02};
+    const uint8_t body[3] = {0x03, 0x04, 0x05};
+    TEST_ASSERT_TRUE(sendSysExChunk(MERGE_SOURCE_USB, start, 3));
+    while (sendSysExChunk(MERGE_SOURCE_USB, body, 3));
+    TEST_ASSERT_TRUE(queues[MERGE_SOURCE_USB].dropSysEx);
+    TEST_ASSERT_FALSE(sendSysExChunk(MERGE_SOURCE_USB, body, 3));
+    
+    runUntilIdle();
+    TEST_ASSERT_EQUAL_UINT8(0xF0, wire[0]);
+    TEST_ASSERT_EQUAL_UINT8(0xF7, wire[wireLength - 1]);
+}
+
+// Test a SysEx abandoned mid-stream is closed after the timeout
+void test_stalled_sysex_times_out() {
+    const uint8_t start[3] = {0xF0, 0x01, 0x02};
+    sendSysExChunk(MERGE_SOURCE_USB, start, 3);
+    runUntilIdle();
+    send(MERGE_SOURCE_DIN, 0x80, 60, 0);
+    runUntilIdle();
+    TEST_ASSERT_EQUAL_INT(3, wireLength);
+    
+    now += MERGE_SYSEX_TIMEOUT_MS + 1;
+    runUntilIdle();
+    TEST_ASSERT_EQUAL_INT(7, wireLength);
+    TEST_ASSERT_EQUAL_UINT8(0xF7, wire[3]);
+    TEST_ASSERT_EQUAL_UINT8(0x80, wire[4]);
+}
+
+void setUp(void) {
+    queues[MERGE_SOURCE_DIN] = {dinBuffer, MERGE_DIN_QUEUE_SIZE - 1, 0, 0, false, false, 0};
+    queues[MERGE_SOURCE_USB] = {usbBuffer, MERGE_USB_QUEUE_SIZE - 1, 0, 0, false, false, 0};
+    realtimeHead = realtimeTail = 0;
+    commonLength = 0;
+    lockedSource = MERGE_SOURCE_NONE;
+    nextSource = 0;
+    mergeDrops = 0;
+    txStalls = 0;
+    txStalled = false;
+    wireLength = 0;
+    txQueued = 0;
+    now = 1000;
+}
+
+void tearDown(void) {
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    
+    // Atomicity tests
+    RUN_TEST(test_messages_never_interleaved);
+    RUN_TEST(test_round_robin_fairness);
+    RUN_TEST(test_tx_limit_keeps_message_whole);
+    RUN_TEST(test_stall_counted_once_per_episode);
+    RUN_TEST(test_realtime_cuts_in);
+    RUN_TEST(test_sysex_locks_output);
+    RUN_TEST(test_song_position_waits_out_sysex);
+    RUN_TEST(test_song_position_stays_ahead_of_continue);
+    
+    // Overflow tests
+    RUN_TEST(test_full_queue_drops_whole_message);
+    RUN_TEST(test_oversized_sysex_refused);
+    RUN_TEST(test_chunk_overflow_terminates);
+    RUN_TEST(test_stalled_sysex_times_out);
+    
+    return UNITY_END();
+}
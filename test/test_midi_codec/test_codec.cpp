@@ -0,0 +1,318 @@
+#include <unity.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef uint8_t byte;
+
+// DIN byte parser from MidiCodec.h
+class MidiCodec {
+public:
+    // Data bytes that follow a status byte (SysEx and single-byte messages: 0)
+    static inline uint8_t dataLength(byte status) {
+        if (status < 0xF0) return ((status & 0xE0) == 0xC0) ? 1 : 2;
+        if (status == 0xF1 || status == 0xF3) return 1;
+        if (status == 0xF2) return 2;
+        return 0;
+    }
+};
+
+template <class Handler, uint8_t SysExChunk>
+class MidiParser {
+public:
+    static void reset() {
+        status = 0;
+        received = 0;
+        sysExLength = 0;
+        inSysEx = false;
+    }
+
+    static inline void parse(byte data) {
+        if (data >= 0xF8) {
+            // Realtime cuts into anything without disturbing it
+            if (data != 0xF9 && data != 0xFD) Handler::realtime(data);
+        } else if (data & 0x80) {
+            parseStatus(data);
+        } else if (inSysEx) {
+            appendSysEx(data);
+        } else {
+            parseData(data);
+        }
+    }
+
+private:
+    static byte status;       // status the next data bytes belong to (0: none)
+    static byte data1;
+    static uint8_t received;  // data bytes of the current message so far
+    static bool inSysEx;
+    static uint8_t sysExLength;
+    static byte sysExBuffer[SysExChunk];
+
+    static void appendSysEx(byte data) {
+        sysExBuffer[sysExLength++] = data;
+        if (sysExLength == SysExChunk) {
+            Handler::sysEx(sysExBuffer, sysExLength, false);
+            sysExLength = 0;
+        }
+    }
+
+    static void endSysEx() {
+        // Room for the F7 is guaranteed: a full buffer is always passed on at once
+        sysExBuffer[sysExLength++] = 0xF7;
+        Handler::sysEx(sysExBuffer, sysExLength, true);
+        sysExLength = 0;
+        inSysEx = false;
+    }
+
+    static void parseStatus(byte data) {
+        if (inSysEx) {
+            endSysEx();
+            if (data == 0xF7) return;
+            Handler::error();  // SysEx cut short by another status byte
+        } else if (received) {
+            Handler::error();  // previous message incomplete
+        }
+        received = 0;
+
+        if (data == 0xF0) {
+            status = 0;
+            inSysEx = true;
+            appendSysEx(data);
+        } else if (data < 0xF0 || data == 0xF1 || data == 0xF2 || data == 0xF3) {
+            status = data;
+        } else {
+            // Tune Request, stray F7 and undefined F4/F5 also cancel running status
+            status = 0;
+            if (data == 0xF6) Handler::systemCommon(data, 0, 0);
+            else if (data == 0xF7) Handler::error();
+        }
+    }
+
+    static void parseData(byte data) {
+        if (!status) {
+            Handler::error();  // data byte without a status
+            return;
+        }
+
+        if (received == 0 && MidiCodec::dataLength(status) == 2) {
+            data1 = data;
+            received = 1;
+            return;
+        }
+
+        byte first = received ? data1 : data;
+        byte second = received ? data : 0;
+        received = 0;
+
+        if (status < 0xF0) {
+            Handler::channelMessage(status, first, second);
+        } else {
+            Handler::systemCommon(status, first, second);
+            status = 0;  // no running status for system common messages
+        }
+    }
+};
+
+template <class Handler, uint8_t SysExChunk> byte MidiParser<Handler, SysExChunk>::status = 0;
+template <class Handler, uint8_t SysExChunk> byte MidiParser<Handler, SysExChunk>::data1 = 0;
+template <class Handler, uint8_t SysExChunk> uint8_t MidiParser<Handler, SysExChunk>::received = 0;
+template <class Handler, uint8_t SysExChunk> bool MidiParser<Handler, SysExChunk>::inSysEx = false;
+template <class Handler, uint8_t SysExChunk> uint8_t MidiParser<Handler, SysExChunk>::sysExLength = 0;
+template <class Handler, uint8_t SysExChunk> byte MidiParser<Handler, SysExChunk>::sysExBuffer[SysExChunk];
+
+// Handler policy that records what the parser dispatches
+struct Message {
+    uint8_t kind;
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+};
+
+enum { CHANNEL, COMMON, REALTIME };
+
+Message messages[32];
+int messageCount;
+uint8_t sysExBytes[256];
+int sysExLength;
+int sysExChunks;
+bool sysExDone;
+int errors;
+
+struct Recorder {
+    static void channelMessage(byte status, byte data1, byte data2) { record(CHANNEL, status, data1, data2); }
+    static void systemCommon(byte status, byte data1, byte data2) { record(COMMON, status, data1, data2); }
+    static void realtime(byte status) { record(REALTIME, status, 0, 0); }
+    static void sysEx(const byte* data, uint8_t length, bool last) {
+        memcpy(sysExBytes + sysExLength, data, length);
+        sysExLength += length;
+        sysExChunks++;
+        sysExDone = last;
+    }
+    static void error() { errors++; }
+    static void record(uint8_t kind, uint8_t status, uint8_t data1, uint8_t data2) {
+        messages[messageCount++] = {kind, status, data1, data2};
+    }
+};
+
+typedef MidiParser<Recorder, 6> Parser;
+
+void feed(const uint8_t* data, int length) {
+    for (int i = 0; i < length; i++) Parser::parse(data[i]);
+}
+
+void assertMessage(int index, uint8_t kind, uint8_t status, uint8_t data1, uint8_t data2) {
+    TEST_ASSERT_EQUAL_UINT8(kind, messages[index].kind);
+    TEST_ASSERT_EQUAL_HEX8(status, messages[index].status);
+    TEST_ASSERT_EQUAL_UINT8(data1, messages[index].data1);
+    TEST_ASSERT_EQUAL_UINT8(data2, messages[index].data2);
+}
+
+// Test two- and three-byte channel messages
+void test_channel_messages() {
+    const uint8_t bytes[] = {0x90, 60, 100, 0xC3, 5, 0xE1, 0x00, 0x40};
+    feed(bytes, sizeof(bytes));
+    TEST_ASSERT_EQUAL_INT(3, messageCount);
+    assertMessage(0, CHANNEL, 0x90, 60, 100);
+    assertMessage(1, CHANNEL, 0xC3, 5, 0);
+    assertMessage(2, CHANNEL, 0xE1, 0x00, 0x40);
+    TEST_ASSERT_EQUAL_INT(0, errors);
+}
+
+// Test running status repeats the last channel status
+void test_running_status() {
+    const uint8_t bytes[] = {0x90, 60, 100, 62, 100, 64, 0, 0xD0, 10, 20};
+    feed(bytes, sizeof(bytes));
+    TEST_ASSERT_EQUAL_INT(5, messageCount);
+    assertMessage(1, CHANNEL, 0x90, 62, 100);
+    assertMessage(2, CHANNEL, 0x90, 64, 0);
+    assertMessage(4, CHANNEL, 0xD0, 20, 0);
+}
+
+// Test realtime bytes inside a message neither break it nor reset it
+void test_realtime_inside_message() {
+    const uint8_t bytes[] = {0x90, 0xF8, 60, 0xFE, 100, 62, 0xFA, 100};
+    feed(bytes, sizeof(bytes));
+    TEST_ASSERT_EQUAL_INT(5, messageCount);
+    assertMessage(0, REALTIME, 0xF8, 0, 0);
+    assertMessage(1, REALTIME, 0xFE, 0, 0);
+    assertMessage(2, CHANNEL, 0x90, 60, 100);
+    assertMessage(3, REALTIME, 0xFA, 0, 0);
+    assertMessage(4, CHANNEL, 0x90, 62, 100);
+    TEST_ASSERT_EQUAL_INT(0, errors);
+}
+
+// Test undefined realtime bytes are ignored
+void test_undefined_realtime_ignored() {
+    const uint8_t bytes[] = {0xF9, 0xFD, 0xFF};
+    feed(bytes, sizeof(bytes));
+    TEST_ASSERT_EQUAL_INT(1, messageCount);
+    assertMessage(0, REALTIME, 0xFF, 0, 0);
+}
+
+// Test system common messages and that they cancel running status
+void test_system_common() {
+    const uint8_t bytes[] = {0x90, 60, 100, 0xF2, 0x10, 0x20, 0xF1, 0x35, 0xF6, 62, 0xF3, 7};
+    feed(bytes, sizeof(bytes));
+    TEST_ASSERT_EQUAL_INT(5, messageCount);
+    assertMessage(1, COMMON, 0xF2, 0x10, 0x20);
+    assertMessage(2, COMMON, 0xF1, 0x35, 0);
+    assertMessage(3, COMMON, 0xF6, 0, 0);
+    assertMessage(4, COMMON, 0xF3, 7, 0);
+    TEST_ASSERT_EQUAL_INT(1, errors);  // the 62 after Tune Request has no status
+}
+
+// Test SysEx is passed on in buffer-sized chunks ending with the F7
+void test_sysex_chunks() {
+    const uint8_t bytes[] = {0xF0, 0x7D, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0xF7};
+    feed(bytes, sizeof(bytes));
+    TEST_ASSERT_EQUAL_INT(2, sysExChunks);
+    TEST_ASSERT_TRUE(sysExDone);
+    TEST_ASSERT_EQUAL_INT(sizeof(bytes), sysExLength);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(bytes, sysExBytes, sizeof(bytes));
+    TEST_ASSERT_EQUAL_INT(0, messageCount);
+}
+
+// Test a SysEx filling the buffer exactly still ends with its own chunk
+void test_sysex_exact_chunk() {
+    const uint8_t bytes[] = {0xF0, 0x7D, 1, 2, 3, 4, 0xF7};
+    feed(bytes, sizeof(bytes));
+    TEST_ASSERT_EQUAL_INT(2, sysExChunks);
+    TEST_ASSERT_TRUE(sysExDone);
+    TEST_ASSERT_EQUAL_HEX8(0xF7, sysExBytes[6]);
+}
+
+// Test realtime inside SysEx goes out without entering the SysEx data
+void test_realtime_inside_sysex() {
+    const uint8_t bytes[] = {0xF0, 1, 0xF8, 2, 0xF7};
+    feed(bytes, sizeof(bytes));
+    TEST_ASSERT_EQUAL_INT(1, messageCount);
+    assertMessage(0, REALTIME, 0xF8, 0, 0);
+    TEST_ASSERT_EQUAL_INT(4, sysExLength);
+    TEST_ASSERT_EQUAL_HEX8(2, sysExBytes[2]);
+}
+
+// Test a status byte cutting a SysEx short terminates it and counts an error
+void test_sysex_cut_short() {
+    const uint8_t bytes[] = {0xF0, 1, 2, 0x90, 60, 100};
+    feed(bytes, sizeof(bytes));
+    TEST_ASSERT_TRUE(sysExDone);
+    TEST_ASSERT_EQUAL_HEX8(0xF7, sysExBytes[sysExLength - 1]);
+    TEST_ASSERT_EQUAL_INT(1, errors);
+    TEST_ASSERT_EQUAL_INT(1, messageCount);
+    assertMessage(0, CHANNEL, 0x90, 60, 100);
+}
+
+// Test stray data, incomplete messages and a lone F7 count as errors
+void test_errors() {
+    const uint8_t bytes[] = {60, 100, 0x90, 60, 0xB0, 7, 127, 0xF7, 1};
+    feed(bytes, sizeof(bytes));
+    TEST_ASSERT_EQUAL_INT(5, errors);
+    TEST_ASSERT_EQUAL_INT(1, messageCount);
+    assertMessage(0, CHANNEL, 0xB0, 7, 127);
+}
+
+// Test data lengths per status
+void test_data_length() {
+    TEST_ASSERT_EQUAL_UINT8(2, MidiCodec::dataLength(0x80));
+    TEST_ASSERT_EQUAL_UINT8(1, MidiCodec::dataLength(0xC5));
+    TEST_ASSERT_EQUAL_UINT8(1, MidiCodec::dataLength(0xDF));
+    TEST_ASSERT_EQUAL_UINT8(2, MidiCodec::dataLength(0xEF));
+    TEST_ASSERT_EQUAL_UINT8(1, MidiCodec::dataLength(0xF1));
+    TEST_ASSERT_EQUAL_UINT8(2, MidiCodec::dataLength(0xF2));
+    TEST_ASSERT_EQUAL_UINT8(0, MidiCodec::dataLength(0xF6));
+    TEST_ASSERT_EQUAL_UINT8(0, MidiCodec::dataLength(0xF8));
+}
+
+void setUp(void) {
+    Parser::reset();
+    messageCount = 0;
+    sysExLength = 0;
+    sysExChunks = 0;
+    sysExDone = false;
+    errors = 0;
+}
+
+void tearDown(void) {
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    
+    // Message tests
+    RUN_TEST(test_channel_messages);
+    RUN_TEST(test_running_status);
+    RUN_TEST(test_realtime_inside_message);
+    RUN_TEST(test_undefined_realtime_ignored);
+    RUN_TEST(test_system_common);
+    RUN_TEST(test_data_length);
+    
+    // SysEx tests
+    RUN_TEST(test_sysex_chunks);
+    RUN_TEST(test_sysex_exact_chunk);
+    RUN_TEST(test_realtime_inside_sysex);
+    RUN_TEST(test_sysex_cut_short);
+    
+    // Error tests
+    RUN_TEST(test_errors);
+    
+    return UNITY_END();
+}
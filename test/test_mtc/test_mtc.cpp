@@ -0,0 +1,210 @@
+#include <unity.h>
+#include <stdint.h>
+
+// Time code arithmetic from Mtc.cpp
+enum MtcRate { MTC_RATE_OFF = 0, MTC_RATE_24, MTC_RATE_25, MTC_RATE_2997_DROP, MTC_RATE_30, MTC_RATE_COUNT };
+
+struct MtcTime {
+    uint8_t hours;
+    uint8_t minutes;
+    uint8_t seconds;
+    uint8_t frames;
+};
+
+uint8_t framesPerSecond(uint8_t rate) {
+    return (rate == MTC_RATE_24) ? 24 : (rate == MTC_RATE_25) ? 25 : 30;
+}
+
+uint32_t stepNumerator(uint8_t rate) {
+    return (rate == MTC_RATE_2997_DROP) ? 1001000000UL : 1000000UL;
+}
+
+uint32_t stepDivisorFor(uint8_t rate) {
+    return (rate == MTC_RATE_2997_DROP) ? 120000UL : 4UL * framesPerSecond(rate);
+}
+
+void frameToTime(uint8_t rate, uint32_t frame, MtcTime& time) {
+    uint8_t fps = framesPerSecond(rate);
+    if (rate == MTC_RATE_2997_DROP) {
+        uint32_t tens = frame / 17982;
+        uint16_t rest = frame % 17982;
+        frame += 18 * tens + ((rest >= 2) ? 2 * ((rest - 2) / 1798) : 0);
+    }
+    time.frames = frame % fps;
+    frame /= fps;
+    time.seconds = frame % 60;
+    frame /= 60;
+    time.minutes = frame % 60;
+    time.hours = (frame / 60) % 24;
+}
+
+void advanceTwoFrames(uint8_t rate, MtcTime& time) {
+    uint8_t fps = framesPerSecond(rate);
+    time.frames += 2;
+    if (time.frames < fps) return;
+    time.frames -= fps;
+    if (++time.seconds >= 60) {
+        time.seconds = 0;
+        if (++time.minutes >= 60) {
+            time.minutes = 0;
+            if (++time.hours >= 24) time.hours = 0;
+        }
+        if (rate == MTC_RATE_2997_DROP && time.minutes % 10 != 0) time.frames += 2;
+    }
+}
+
+uint8_t quarterFrame(uint8_t rate, const MtcTime& time, uint8_t piece) {
+    uint8_t nibble;
+    switch (piece) {
+        case 0: nibble = time.frames & 0x0F; break;
+        case 1: nibble = time.frames >> 4; break;
+        case 2: nibble = time.seconds & 0x0F; break;
+        case 3: nibble = time.seconds >> 4; break;
+        case 4: nibble = time.minutes & 0x0F; break;
+        case 5: nibble = time.minutes >> 4; break;
+        case 6: nibble = time.hours & 0x0F; break;
+        default: nibble = (time.hours >> 4) | ((rate - 1) << 1); break;
+    }
+    return (piece << 4) | nibble;
+}
+
+// seek(): first quarter frame of the 2-frame block at or after a position
+uint32_t firstQuarter(uint8_t rate, uint64_t positionUs, long& offsetUs) {
+    uint32_t numerator = stepNumerator(rate);
+    uint32_t divisor = stepDivisorFor(rate);
+    uint32_t quarter = (positionUs * divisor + numerator - 1) / numerator;
+    quarter = (quarter + 7) & ~7UL;
+    offsetUs = (long)((uint64_t)quarter * numerator / divisor - positionUs);
+    return quarter;
+}
+
+void assertTime(uint8_t h, uint8_t m, uint8_t s, uint8_t f, const MtcTime& time) {
+    TEST_ASSERT_EQUAL(h, time.hours);
+    TEST_ASSERT_EQUAL(m, time.minutes);
+    TEST_ASSERT_EQUAL(s, time.seconds);
+    TEST_ASSERT_EQUAL(f, time.frames);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_non_drop_frame_labels(void) {
+    MtcTime time;
+    frameToTime(MTC_RATE_25, 25 * 3600 + 25 * 61 + 7, time);
+    assertTime(1, 1, 1, 7, time);
+    frameToTime(MTC_RATE_24, 24 * 86400UL, time);
+    assertTime(0, 0, 0, 0, time);  // wraps after 24 hours
+}
+
+void test_drop_frame_skips_labels_each_minute(void) {
+    MtcTime time;
+    frameToTime(MTC_RATE_2997_DROP, 1799, time);
+    assertTime(0, 0, 59, 29, time);
+    frameToTime(MTC_RATE_2997_DROP, 1800, time);
+    assertTime(0, 1, 0, 2, time);
+    frameToTime(MTC_RATE_2997_DROP, 17982, time);
+    assertTime(0, 10, 0, 0, time);  // every tenth minute keeps 0 and 1
+    frameToTime(MTC_RATE_2997_DROP, 17982 * 6, time);
+    assertTime(1, 0, 0, 0, time);
+}
+
+void test_two_frame_steps_match_labels(void) {
+    // The incremental count used between quarter frames agrees with the
+    // direct conversion over an hour at every rate
+    for (uint8_t rate = MTC_RATE_24; rate < MTC_RATE_COUNT; rate++) {
+        MtcTime stepped, direct;
+        frameToTime(rate, 0, stepped);
+        for (uint32_t frame = 2; frame < 120000; frame += 2) {
+            advanceTwoFrames(rate, stepped);
+            frameToTime(rate, frame, direct);
+            if (stepped.frames != direct.frames || stepped.seconds != direct.seconds ||
+                stepped.minutes != direct.minutes || stepped.hours != direct.hours) {
+                TEST_FAIL_MESSAGE("stepped time code diverged");
+            }
+        }
+    }
+}
+
+void test_quarter_frame_pieces(void) {
+    MtcTime time = {0x17, 0x2B, 0x3A, 0x1D};  // 23:43:58:29
+    TEST_ASSERT_EQUAL_HEX8(0x0D, quarterFrame(MTC_RATE_30, time, 0));
+    TEST_ASSERT_EQUAL_HEX8(0x11, quarterFrame(MTC_RATE_30, time, 1));
+    TEST_ASSERT_EQUAL_HEX8(0x2A, quarterFrame(MTC_RATE_30, time, 2));
+    TEST_ASSERT_EQUAL_HEX8(0x33, quarterFrame(MTC_RATE_30, time, 3));
+    TEST_ASSERT_EQUAL_HEX8(0x4B, quarterFrame(MTC_RATE_30, time, 4));
+    TEST_ASSERT_EQUAL_HEX8(0x52, quarterFrame(MTC_RATE_30, time, 5));
+    TEST_ASSERT_EQUAL_HEX8(0x67, quarterFrame(MTC_RATE_30, time, 6));
+    TEST_ASSERT_EQUAL_HEX8(0x77, quarterFrame(MTC_RATE_30, time, 7));  // hours bit 4, rate code 3
+    TEST_ASSERT_EQUAL_HEX8(0x70, quarterFrame(MTC_RATE_24, {0, 0, 0, 0}, 7));
+    TEST_ASSERT_EQUAL_HEX8(0x74, quarterFrame(MTC_RATE_2997_DROP, {0, 0, 0, 0}, 7));
+}
+
+void test_quarter_frame_steps(void) {
+    TEST_ASSERT_EQUAL(10416, stepNumerator(MTC_RATE_24) / stepDivisorFor(MTC_RATE_24));
+    TEST_ASSERT_EQUAL(10000, stepNumerator(MTC_RATE_25) / stepDivisorFor(MTC_RATE_25));
+    TEST_ASSERT_EQUAL(8341, stepNumerator(MTC_RATE_2997_DROP) / stepDivisorFor(MTC_RATE_2997_DROP));
+    TEST_ASSERT_EQUAL(8333, stepNumerator(MTC_RATE_30) / stepDivisorFor(MTC_RATE_30));
+}
+
+void test_remainder_keeps_long_runs_exact(void) {
+    // An hour of 29.97 fps quarter frames lands on the exact time, not 0.67 us short per frame
+    for (uint8_t rate = MTC_RATE_24; rate < MTC_RATE_COUNT; rate++) {
+        uint32_t divisor = stepDivisorFor(rate);
+        uint32_t stepUs = stepNumerator(rate) / divisor;
+        uint32_t remainder = stepNumerator(rate) % divisor;
+        uint32_t dueUs = 0, fraction = 0;
+        uint32_t quarters = (rate == MTC_RATE_2997_DROP) ? 120000UL * 30 : divisor * 3600UL;
+        for (uint32_t i = 0; i < quarters; i++) {
+            dueUs += stepUs;
+            fraction += remainder;
+            if (fraction >= divisor) {
+                fraction -= divisor;
+                dueUs++;
+            }
+        }
+        uint32_t expectedUs = (rate == MTC_RATE_2997_DROP) ? 1001000000UL * 30 : 3600000000UL;
+        TEST_ASSERT_EQUAL_UINT32(expectedUs, dueUs);
+        TEST_ASSERT_EQUAL_UINT32(0, fraction);
+    }
+}
+
+void test_locate_starts_on_a_block(void) {
+    long offsetUs;
+    TEST_ASSERT_EQUAL(0, firstQuarter(MTC_RATE_25, 0, offsetUs));
+    TEST_ASSERT_EQUAL(0, offsetUs);
+    // 1 s at 25 fps is frame 25: the next block starts at frame 26
+    TEST_ASSERT_EQUAL(104, firstQuarter(MTC_RATE_25, 1000000, offsetUs));
+    TEST_ASSERT_EQUAL(40000, offsetUs);
+    TEST_ASSERT_EQUAL(96, firstQuarter(MTC_RATE_24, 1000000, offsetUs));
+    TEST_ASSERT_EQUAL(0, offsetUs);
+    // Offsets stay under one block (2 frames)
+    for (uint32_t positionUs = 0; positionUs < 5000000; positionUs += 12345) {
+        firstQuarter(MTC_RATE_2997_DROP, positionUs, offsetUs);
+        TEST_ASSERT_TRUE(offsetUs >= 0 && offsetUs < 66734);
+    }
+}
+
+// Test a Song Position late in a slow song, past 2^32 us (locateTicks())
+void test_locate_past_32_bit_microseconds(void) {
+    long offsetUs;
+    uint64_t positionUs = (uint64_t)(16383UL * 6) * 62500;  // last SPP at 40 BPM
+    uint32_t quarter = firstQuarter(MTC_RATE_25, positionUs, offsetUs);
+    TEST_ASSERT_EQUAL_UINT32(614368, quarter);
+    TEST_ASSERT_TRUE(offsetUs >= 0 && offsetUs < 80000);
+    MtcTime time;
+    frameToTime(MTC_RATE_25, quarter / 4, time);
+    assertTime(1, 42, 23, 17, time);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_non_drop_frame_labels);
+    RUN_TEST(test_drop_frame_skips_labels_each_minute);
+    RUN_TEST(test_two_frame_steps_match_labels);
+    RUN_TEST(test_quarter_frame_pieces);
+    RUN_TEST(test_quarter_frame_steps);
+    RUN_TEST(test_remainder_keeps_long_runs_exact);
+    RUN_TEST(test_locate_starts_on_a_block);
+    RUN_TEST(test_locate_past_32_bit_microseconds);
+    return UNITY_END();
+}
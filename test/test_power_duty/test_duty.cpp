@@ -0,0 +1,105 @@
+#include <unity.h>
+#include <stdint.h>
+
+// Duty cycle accounting from Power.cpp
+// (micros() timestamps are 32-bit on AVR)
+#define POWER_WINDOW_US 1000000UL
+
+uint32_t windowStartUs;
+uint32_t windowSleptUs;
+uint16_t busyPermille;
+uint16_t busyPeakPermille;
+uint16_t sleepMaxUs;
+
+void account(uint32_t nowUs) {
+    uint32_t elapsedUs = nowUs - windowStartUs;
+    if (elapsedUs < POWER_WINDOW_US) return;
+    
+    uint16_t busy = (elapsedUs - windowSleptUs) / (elapsedUs / 1000);
+    if (busy > 1000) busy = 1000;
+    busyPermille = busy;
+    if (busy > busyPeakPermille) busyPeakPermille = busy;
+    
+    windowStartUs = nowUs;
+    windowSleptUs = 0;
+}
+
+void slept(uint32_t sleptUs) {
+    windowSleptUs += sleptUs;
+    if (sleptUs > sleepMaxUs) {
+        sleepMaxUs = sleptUs < 0xFFFFUL ? sleptUs : 0xFFFFUL;
+    }
+}
+
+void setUp(void) {
+    windowStartUs = 0;
+    windowSleptUs = 0;
+    busyPermille = 0;
+    busyPeakPermille = 0;
+    sleepMaxUs = 0;
+}
+
+void tearDown(void) {}
+
+void test_no_update_inside_window(void) {
+    slept(400000);
+    account(999999);
+    TEST_ASSERT_EQUAL(0, busyPermille);
+    TEST_ASSERT_EQUAL(400000, windowSleptUs);
+}
+
+void test_busy_is_awake_share_of_window(void) {
+    slept(750000);
+    account(1000000);
+    TEST_ASSERT_EQUAL(250, busyPermille);
+    TEST_ASSERT_EQUAL(0, windowSleptUs);
+    TEST_ASSERT_EQUAL(1000000, windowStartUs);
+}
+
+void test_never_slept_is_full_duty(void) {
+    account(1000000);
+    TEST_ASSERT_EQUAL(1000, busyPermille);
+}
+
+void test_long_window_is_scaled(void) {
+    // A loop pass that overran the window still reports per mille
+    slept(1500000);
+    account(3000000);
+    TEST_ASSERT_EQUAL(500, busyPermille);
+}
+
+void test_peak_holds_highest_window(void) {
+    slept(100000);
+    account(1000000);
+    slept(900000);
+    account(2000000);
+    TEST_ASSERT_EQUAL(100, busyPermille);
+    TEST_ASSERT_EQUAL(900, busyPeakPermille);
+}
+
+void test_window_across_micros_wrap(void) {
+    windowStartUs = 0xFFF00000UL;
+    slept(500000);
+    account(0xFFF00000UL + 1000000);
+    TEST_ASSERT_EQUAL(500, busyPermille);
+}
+
+void test_sleep_max_saturates(void) {
+    slept(800);
+    slept(300);
+    TEST_ASSERT_EQUAL(800, sleepMaxUs);
+    slept(70000);
+    TEST_ASSERT_EQUAL(0xFFFF, sleepMaxUs);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_no_update_inside_window);
+    RUN_TEST(test_busy_is_awake_share_of_window);
+    RUN_TEST(test_never_slept_is_full_duty);
+    RUN_TEST(test_long_window_is_scaled);
+    RUN_TEST(test_peak_holds_highest_window);
+    RUN_TEST(test_window_across_micros_wrap);
+    RUN_TEST(test_sleep_max_saturates);
+    return UNITY_END();
+}
@@ -0,0 +1,158 @@
+#include <unity.h>
+
+// Routing matrix from Routing.cpp
+enum MidiPort { PORT_DIN = 0, PORT_USB = 1, PORT_COUNT };
+
+#define ROUTE_TO_DIN  (1 << PORT_DIN)
+#define ROUTE_TO_USB  (1 << PORT_USB)
+#define ROUTE_TYPE_COUNT     23
+#define ROUTE_TYPES_CHANNEL  0x0000007FUL
+#define ROUTE_TYPES_ALL      0x007FFFFFUL
+#define ROUTE_TYPES_TRANSPORT 0x000E8200UL
+#define ROUTE_CHANNELS_ALL   0xFFFF
+
+struct RouteRule {
+    uint32_t typeMask;
+    uint16_t channelMask;
+};
+
+RouteRule rules[PORT_COUNT][PORT_COUNT];
+uint8_t typeRoutes[PORT_COUNT][ROUTE_TYPE_COUNT];
+uint8_t channelRoutes[PORT_COUNT][16];
+
+uint8_t typeIndex(uint8_t status) {
+    return (status < 0xF0) ? (status >> 4) - 8 : (status & 0x0F) + 7;
+}
+
+void setRule(uint8_t source, uint8_t destination, uint32_t typeMask, uint16_t channelMask) {
+    rules[source][destination].typeMask = typeMask & ROUTE_TYPES_ALL;
+    rules[source][destination].channelMask = channelMask;
+}
+
+void compile() {
+    for (uint8_t source = 0; source < PORT_COUNT; source++) {
+        for (uint8_t t = 0; t < ROUTE_TYPE_COUNT; t++) {
+            uint8_t mask = 0;
+            for (uint8_t destination = 0; destination < PORT_COUNT; destination++) {
+                if (rules[source][destination].typeMask & (1UL << t)) mask |= (1 << destination);
+            }
+            typeRoutes[source][t] = mask;
+        }
+        for (uint8_t ch = 0; ch < 16; ch++) {
+            uint8_t mask = 0;
+            for (uint8_t destination = 0; destination < PORT_COUNT; destination++) {
+                if (rules[source][destination].channelMask & (1 << ch)) mask |= (1 << destination);
+            }
+            channelRoutes[source][ch] = mask;
+        }
+    }
+}
+
+uint8_t destinations(uint8_t source, uint8_t status) {
+    uint8_t mask = typeRoutes[source][typeIndex(status)];
+    if (status < 0xF0) mask &= channelRoutes[source][status & 0x0F];
+    return mask;
+}
+
+void loadDefaults() {
+    setRule(PORT_DIN, PORT_USB, ROUTE_TYPES_ALL, ROUTE_CHANNELS_ALL);
+    setRule(PORT_DIN, PORT_DIN, 0, ROUTE_CHANNELS_ALL);
+    setRule(PORT_USB, PORT_DIN, ROUTE_TYPES_CHANNEL | ROUTE_TYPES_TRANSPORT, ROUTE_CHANNELS_ALL);
+    setRule(PORT_USB, PORT_USB, 0, ROUTE_CHANNELS_ALL);
+    compile();
+}
+
+// Test type index covers every status byte without collisions
+void test_type_index_range() {
+    TEST_ASSERT_EQUAL_UINT8(0, typeIndex(0x80));
+    TEST_ASSERT_EQUAL_UINT8(6, typeIndex(0xEF));
+    TEST_ASSERT_EQUAL_UINT8(7, typeIndex(0xF0));
+    TEST_ASSERT_EQUAL_UINT8(15, typeIndex(0xF8));
+    TEST_ASSERT_EQUAL_UINT8(22, typeIndex(0xFF));
+}
+
+// Test defaults match the original hard-coded bridge
+void test_defaults_din_to_usb_everything() {
+    TEST_ASSERT_EQUAL_UINT8(ROUTE_TO_USB, destinations(PORT_DIN, 0x90));
+    TEST_ASSERT_EQUAL_UINT8(ROUTE_TO_USB, destinations(PORT_DIN, 0xF8));
+    TEST_ASSERT_EQUAL_UINT8(ROUTE_TO_USB, destinations(PORT_DIN, 0xF0));
+}
+
+void test_defaults_usb_to_din_channel_and_transport() {
+    TEST_ASSERT_EQUAL_UINT8(ROUTE_TO_DIN, destinations(PORT_USB, 0x9F));
+    TEST_ASSERT_EQUAL_UINT8(ROUTE_TO_DIN, destinations(PORT_USB, 0xE0));
+    TEST_ASSERT_EQUAL_UINT8(ROUTE_TO_DIN, destinations(PORT_USB, 0xF8));
+    TEST_ASSERT_EQUAL_UINT8(ROUTE_TO_DIN, destinations(PORT_USB, 0xFB));
+    TEST_ASSERT_EQUAL_UINT8(ROUTE_TO_DIN, destinations(PORT_USB, 0xF2));
+    TEST_ASSERT_EQUAL_UINT8(0, destinations(PORT_USB, 0xFE));
+    TEST_ASSERT_EQUAL_UINT8(0, destinations(PORT_USB, 0xF3));
+}
+
+void test_defaults_no_din_thru() {
+    TEST_ASSERT_FALSE(destinations(PORT_DIN, 0x90) & ROUTE_TO_DIN);
+}
+
+// Test filters
+void test_block_clock_echo() {
+    setRule(PORT_DIN, PORT_USB, ROUTE_TYPES_ALL & ~(1UL << typeIndex(0xF8)), ROUTE_CHANNELS_ALL);
+    compile();
+    TEST_ASSERT_EQUAL_UINT8(0, destinations(PORT_DIN, 0xF8));
+    TEST_ASSERT_EQUAL_UINT8(ROUTE_TO_USB, destinations(PORT_DIN, 0xFA));
+}
+
+void test_block_aftertouch() {
+    uint32_t types = ROUTE_TYPES_CHANNEL & ~(1UL << typeIndex(0xA0)) & ~(1UL << typeIndex(0xD0));
+    setRule(PORT_USB, PORT_DIN, types, ROUTE_CHANNELS_ALL);
+    compile();
+    TEST_ASSERT_EQUAL_UINT8(0, destinations(PORT_USB, 0xA3));
+    TEST_ASSERT_EQUAL_UINT8(0, destinations(PORT_USB, 0xD3));
+    TEST_ASSERT_EQUAL_UINT8(ROUTE_TO_DIN, destinations(PORT_USB, 0xB3));
+}
+
+void test_block_channel() {
+    setRule(PORT_USB, PORT_DIN, ROUTE_TYPES_CHANNEL, ROUTE_CHANNELS_ALL & ~(1 << 9));
+    compile();
+    TEST_ASSERT_EQUAL_UINT8(0, destinations(PORT_USB, 0x99));
+    TEST_ASSERT_EQUAL_UINT8(ROUTE_TO_DIN, destinations(PORT_USB, 0x98));
+}
+
+void test_channel_mask_ignored_for_system() {
+    setRule(PORT_DIN, PORT_USB, ROUTE_TYPES_ALL, 0);
+    compile();
+    TEST_ASSERT_EQUAL_UINT8(0, destinations(PORT_DIN, 0x90));
+    TEST_ASSERT_EQUAL_UINT8(ROUTE_TO_USB, destinations(PORT_DIN, 0xF8));
+}
+
+void test_din_thru_to_both_outputs() {
+    setRule(PORT_DIN, PORT_DIN, ROUTE_TYPES_ALL, ROUTE_CHANNELS_ALL);
+    compile();
+    TEST_ASSERT_EQUAL_UINT8(ROUTE_TO_DIN | ROUTE_TO_USB, destinations(PORT_DIN, 0x90));
+    TEST_ASSERT_EQUAL_UINT8(ROUTE_TO_DIN | ROUTE_TO_USB, destinations(PORT_DIN, 0xF8));
+}
+
+void setUp(void) {
+    loadDefaults();
+}
+
+void tearDown(void) {
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_type_index_range);
+    
+    // Default routing tests
+    RUN_TEST(test_defaults_din_to_usb_everything);
+    RUN_TEST(test_defaults_usb_to_din_channel_and_transport);
+    RUN_TEST(test_defaults_no_din_thru);
+    
+    // Filter tests
+    RUN_TEST(test_block_clock_echo);
+    RUN_TEST(test_block_aftertouch);
+    RUN_TEST(test_block_channel);
+    RUN_TEST(test_channel_mask_ignored_for_system);
+    RUN_TEST(test_din_thru_to_both_outputs);
+    
+    return UNITY_END();
+}
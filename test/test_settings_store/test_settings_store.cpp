@@ -0,0 +1,163 @@
+#include <unity.h>
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+
+// Slot log and record check from Settings.cpp, over a RAM EEPROM
+#define SETTINGS_VERSION     1
+#define SETTINGS_SLOT_SIZE   64
+#define SETTINGS_SLOT_COUNT  16
+
+struct Record {
+    uint8_t version;
+    uint8_t reserved;
+    uint16_t sequence;
+    uint8_t data[52];
+    uint16_t crc;
+    uint8_t unused[2];
+};
+
+uint8_t eeprom[SETTINGS_SLOT_SIZE * SETTINGS_SLOT_COUNT];
+
+uint16_t crc(const uint8_t* bytes, uint8_t length) {
+    uint16_t value = 0xFFFF;
+    for (uint8_t i = 0; i < length; i++) {
+        value ^= (uint16_t)bytes[i] << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            value = (value & 0x8000) ? (value << 1) ^ 0x1021 : value << 1;
+        }
+    }
+    return value;
+}
+
+bool isNewer(uint16_t a, uint16_t b) {
+    return (int16_t)(a - b) > 0;
+}
+
+void writeSlot(uint8_t index, uint16_t sequence, uint8_t marker) {
+    Record record;
+    memset(&record, 0, sizeof(record));
+    record.version = SETTINGS_VERSION;
+    record.sequence = sequence;
+    record.data[0] = marker;
+    record.crc = crc((const uint8_t*)&record, offsetof(Record, crc));
+    memcpy(eeprom + index * SETTINGS_SLOT_SIZE, &record, sizeof(record));
+}
+
+bool readSlot(uint8_t index, Record& record) {
+    memcpy(&record, eeprom + index * SETTINGS_SLOT_SIZE, sizeof(record));
+    return record.version == SETTINGS_VERSION &&
+           record.crc == crc((const uint8_t*)&record, offsetof(Record, crc));
+}
+
+// Slot of the newest valid record, -1 for defaults
+int load(void) {
+    uint8_t order[SETTINGS_SLOT_COUNT];
+    uint16_t sequences[SETTINGS_SLOT_COUNT];
+    uint8_t count = 0;
+
+    for (uint8_t i = 0; i < SETTINGS_SLOT_COUNT; i++) {
+        const uint8_t* slot = eeprom + i * SETTINGS_SLOT_SIZE;
+        if (slot[0] != SETTINGS_VERSION) continue;
+        uint16_t recordSequence = slot[2] | (slot[3] << 8);
+
+        uint8_t pos = count++;
+        while (pos > 0 && isNewer(recordSequence, sequences[pos - 1])) {
+            order[pos] = order[pos - 1];
+            sequences[pos] = sequences[pos - 1];
+            pos--;
+        }
+        order[pos] = i;
+        sequences[pos] = recordSequence;
+    }
+
+    Record record;
+    for (uint8_t i = 0; i < count; i++) {
+        if (readSlot(order[i], record)) return order[i];
+    }
+    return -1;
+}
+
+void setUp(void) {
+    memset(eeprom, 0xFF, sizeof(eeprom));
+}
+
+void tearDown(void) {}
+
+void test_record_fits_slot(void) {
+    TEST_ASSERT_EQUAL(60, sizeof(Record));
+    TEST_ASSERT_EQUAL(56, offsetof(Record, crc));
+}
+
+void test_crc_matches_ccitt_check_value(void) {
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc(check, sizeof(check)));
+}
+
+void test_erased_eeprom_loads_defaults(void) {
+    TEST_ASSERT_EQUAL(-1, load());
+}
+
+void test_newest_sequence_wins(void) {
+    writeSlot(0, 1, 0xA0);
+    writeSlot(1, 2, 0xA1);
+    writeSlot(2, 3, 0xA2);
+    TEST_ASSERT_EQUAL(2, load());
+}
+
+void test_sequence_wraparound(void) {
+    // 0xFFFE and 0xFFFF were written before the counter wrapped to 0 and 1
+    writeSlot(14, 0xFFFE, 0);
+    writeSlot(15, 0xFFFF, 0);
+    writeSlot(0, 0x0000, 0);
+    writeSlot(1, 0x0001, 0);
+    TEST_ASSERT_EQUAL(1, load());
+}
+
+void test_torn_save_falls_back_to_previous(void) {
+    writeSlot(4, 10, 0);
+    writeSlot(5, 11, 0);
+    writeSlot(6, 12, 0);
+    eeprom[6 * SETTINGS_SLOT_SIZE + 30] ^= 0x01;   // power lost mid-write
+    TEST_ASSERT_EQUAL(5, load());
+}
+
+void test_header_only_save_is_rejected(void) {
+    writeSlot(0, 7, 0);
+    // A new record whose version and sequence landed but nothing else
+    eeprom[SETTINGS_SLOT_SIZE] = SETTINGS_VERSION;
+    eeprom[SETTINGS_SLOT_SIZE + 2] = 8;
+    eeprom[SETTINGS_SLOT_SIZE + 3] = 0;
+    TEST_ASSERT_EQUAL(0, load());
+}
+
+void test_other_version_is_ignored(void) {
+    writeSlot(3, 20, 0);
+    writeSlot(4, 21, 0);
+    eeprom[4 * SETTINGS_SLOT_SIZE] = SETTINGS_VERSION + 1;
+    TEST_ASSERT_EQUAL(3, load());
+}
+
+void test_every_slot_used_in_turn(void) {
+    // A full ring of saves, then a few more overwriting the oldest slots
+    uint16_t sequence = 0;
+    for (uint8_t save = 0; save < SETTINGS_SLOT_COUNT + 3; save++) {
+        uint8_t slot = save % SETTINGS_SLOT_COUNT;
+        writeSlot(slot, ++sequence, save);
+        TEST_ASSERT_EQUAL(slot, load());
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_record_fits_slot);
+    RUN_TEST(test_crc_matches_ccitt_check_value);
+    RUN_TEST(test_erased_eeprom_loads_defaults);
+    RUN_TEST(test_newest_sequence_wins);
+    RUN_TEST(test_sequence_wraparound);
+    RUN_TEST(test_torn_save_falls_back_to_previous);
+    RUN_TEST(test_header_only_save_is_rejected);
+    RUN_TEST(test_other_version_is_ignored);
+    RUN_TEST(test_every_slot_used_in_turn);
+    return UNITY_END();
+}
@@ -0,0 +1,183 @@
+#include <unity.h>
+#include <stdint.h>
+
+// Song position tracking from Sync.cpp and ClockBus.cpp
+#define PPQN                  24
+#define CLOCK_TICKS_PER_STEP  6
+
+enum ClockSource { CLOCK_SOURCE_NONE, CLOCK_SOURCE_SYNC_IN, CLOCK_SOURCE_DIN, CLOCK_SOURCE_USB };
+
+uint32_t songTicks[4];
+uint32_t outputTicks;
+uint8_t stoppedSources;
+bool usbIsPlaying;
+uint8_t ppqnCounter;
+uint8_t beatPosition;
+int sentPosition;   // last Song Position Pointer sent to the outputs, -1 = none
+uint8_t grooveSteps;
+uint8_t grooveTick;
+
+void setPhase(uint32_t ticks) {
+    ppqnCounter = ticks % PPQN;
+    beatPosition = ((ticks + PPQN - 1) / PPQN) % 4;
+}
+
+void locate(uint32_t ticks) {
+    grooveTick = (grooveSteps > 0) ? ticks % (grooveSteps * CLOCK_TICKS_PER_STEP) : 0;
+}
+
+bool acceptsTransport(ClockSource source) {
+    return source == CLOCK_SOURCE_USB || (source == CLOCK_SOURCE_DIN && !usbIsPlaying);
+}
+
+// Clock tick with the playing source accepting it
+void clock(ClockSource source, bool accepted) {
+    if (!(stoppedSources & (1 << source))) songTicks[source]++;
+    if (!accepted) return;
+    outputTicks++;
+    if (ppqnCounter == 0) beatPosition = (beatPosition + 1) % 4;
+    if (++ppqnCounter >= PPQN) ppqnCounter = 0;
+}
+
+void startPlayback(ClockSource source, uint8_t status) {
+    stoppedSources &= ~(1 << source);
+    if (status == 0xFA) songTicks[source] = 0;
+    if (!acceptsTransport(source)) return;
+    if (source == CLOCK_SOURCE_USB) usbIsPlaying = true;
+
+    uint32_t ticks = songTicks[source];
+    if (status == 0xFB && outputTicks != ticks) sentPosition = ticks / CLOCK_TICKS_PER_STEP;
+    outputTicks = ticks;
+    setPhase(ticks);
+    locate(ticks);
+}
+
+void stop(ClockSource source) {
+    stoppedSources |= 1 << source;
+    if (source == CLOCK_SOURCE_USB) usbIsPlaying = false;
+    ppqnCounter = 0;
+    beatPosition = 0;
+}
+
+void songPosition(ClockSource source, uint16_t position) {
+    songTicks[source] = (uint32_t)position * CLOCK_TICKS_PER_STEP;
+    if (!acceptsTransport(source)) return;
+    outputTicks = songTicks[source];
+    setPhase(outputTicks);
+    locate(outputTicks);
+    sentPosition = position;
+}
+
+void setUp(void) {
+    for (uint8_t i = 0; i < 4; i++) songTicks[i] = 0;
+    outputTicks = 0;
+    stoppedSources = 0;
+    usbIsPlaying = false;
+    ppqnCounter = 0;
+    beatPosition = 0;
+    sentPosition = -1;
+    grooveSteps = 0;
+    grooveTick = 0;
+}
+
+void tearDown(void) {}
+
+void test_phase_of_a_position(void) {
+    setPhase(0);
+    TEST_ASSERT_EQUAL(0, ppqnCounter);
+    TEST_ASSERT_EQUAL(0, beatPosition);
+    setPhase(30);   // one beat and a 16th in: beat 2 is next
+    TEST_ASSERT_EQUAL(6, ppqnCounter);
+    TEST_ASSERT_EQUAL(2, beatPosition);
+    setPhase(96);   // bar 2, on the downbeat
+    TEST_ASSERT_EQUAL(0, ppqnCounter);
+    TEST_ASSERT_EQUAL(0, beatPosition);
+}
+
+void test_continue_matches_uninterrupted_playback(void) {
+    // Stop and Continue at every tick of two bars: the phase after the
+    // Continue is the one a run without the stop would have reached
+    for (uint8_t stopAt = 1; stopAt < 2 * 96; stopAt++) {
+        setUp();
+        startPlayback(CLOCK_SOURCE_USB, 0xFA);
+        for (uint8_t i = 0; i < stopAt; i++) clock(CLOCK_SOURCE_USB, true);
+        stop(CLOCK_SOURCE_USB);
+        startPlayback(CLOCK_SOURCE_USB, 0xFB);
+        uint8_t resumedCounter = ppqnCounter, resumedBeat = beatPosition;
+
+        setUp();
+        startPlayback(CLOCK_SOURCE_USB, 0xFA);
+        for (uint8_t i = 0; i < stopAt; i++) clock(CLOCK_SOURCE_USB, true);
+        TEST_ASSERT_EQUAL(ppqnCounter, resumedCounter);
+        TEST_ASSERT_EQUAL(beatPosition, resumedBeat);
+    }
+}
+
+void test_continue_in_place_sends_no_position(void) {
+    startPlayback(CLOCK_SOURCE_USB, 0xFA);
+    for (uint8_t i = 0; i < 30; i++) clock(CLOCK_SOURCE_USB, true);
+    stop(CLOCK_SOURCE_USB);
+    clock(CLOCK_SOURCE_USB, false);   // clock while stopped does not move the position
+    startPlayback(CLOCK_SOURCE_USB, 0xFB);
+    TEST_ASSERT_EQUAL(-1, sentPosition);
+    TEST_ASSERT_EQUAL(30, outputTicks);
+}
+
+void test_song_position_relocates(void) {
+    startPlayback(CLOCK_SOURCE_USB, 0xFA);
+    for (uint8_t i = 0; i < 30; i++) clock(CLOCK_SOURCE_USB, true);
+    stop(CLOCK_SOURCE_USB);
+    songPosition(CLOCK_SOURCE_USB, 32);
+    TEST_ASSERT_EQUAL(32, sentPosition);
+    TEST_ASSERT_EQUAL(192, outputTicks);
+    sentPosition = -1;
+    startPlayback(CLOCK_SOURCE_USB, 0xFB);
+    TEST_ASSERT_EQUAL(-1, sentPosition);   // the source already relocated the outputs
+    TEST_ASSERT_EQUAL(0, ppqnCounter);
+    TEST_ASSERT_EQUAL(0, beatPosition);
+}
+
+void test_positions_tracked_per_source(void) {
+    startPlayback(CLOCK_SOURCE_USB, 0xFA);
+    startPlayback(CLOCK_SOURCE_DIN, 0xFA);   // ignored while USB plays, but tracked
+    for (uint8_t i = 0; i < 48; i++) {
+        clock(CLOCK_SOURCE_USB, true);
+        if (i < 12) clock(CLOCK_SOURCE_DIN, false);
+    }
+    TEST_ASSERT_EQUAL(48, songTicks[CLOCK_SOURCE_USB]);
+    TEST_ASSERT_EQUAL(12, songTicks[CLOCK_SOURCE_DIN]);
+    songPosition(CLOCK_SOURCE_DIN, 8);       // not passed on while USB plays
+    TEST_ASSERT_EQUAL(-1, sentPosition);
+    TEST_ASSERT_EQUAL(48, songTicks[CLOCK_SOURCE_DIN]);
+}
+
+void test_continue_from_another_source_regenerates_position(void) {
+    startPlayback(CLOCK_SOURCE_USB, 0xFA);
+    for (uint8_t i = 0; i < 60; i++) clock(CLOCK_SOURCE_USB, true);
+    stop(CLOCK_SOURCE_USB);
+    // DIN resumes from its own position 0: the outputs are sent there first
+    startPlayback(CLOCK_SOURCE_DIN, 0xFB);
+    TEST_ASSERT_EQUAL(0, sentPosition);
+    TEST_ASSERT_EQUAL(0, outputTicks);
+}
+
+void test_groove_phase_follows_position(void) {
+    grooveSteps = 2;
+    songPosition(CLOCK_SOURCE_USB, 3);   // 18 ticks: second step of the 2-step pattern
+    TEST_ASSERT_EQUAL(6, grooveTick);
+    grooveSteps = 0;
+    locate(18);
+    TEST_ASSERT_EQUAL(0, grooveTick);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_phase_of_a_position);
+    RUN_TEST(test_continue_matches_uninterrupted_playback);
+    RUN_TEST(test_continue_in_place_sends_no_position);
+    RUN_TEST(test_song_position_relocates);
+    RUN_TEST(test_positions_tracked_per_source);
+    RUN_TEST(test_continue_from_another_source_regenerates_position);
+    RUN_TEST(test_groove_phase_follows_position);
+    return UNITY_END();
+}
@@ -0,0 +1,184 @@
+#include <unity.h>
+#include <string.h>
+
+// Saturating counters from Stats.h
+void count32(uint32_t& counter) {
+    if (counter != 0xFFFFFFFFUL) counter++;
+}
+
+void count16(uint16_t& counter) {
+    if (counter != 0xFFFF) counter++;
+}
+
+// SysEx reply encoding from SysExHandler.cpp:
+// F0 7D 42 <cmd|0x40> then one MSB byte ahead of every 7 raw bytes, then F7
+unsigned encodeReply(uint8_t command, const uint8_t* data, unsigned length, uint8_t* out) {
+    unsigned n = 0;
+    out[n++] = 0xF0;
+    out[n++] = 0x7D;
+    out[n++] = 0x42;
+    out[n++] = command | 0x40;
+    for (unsigned pos = 0; pos < length; pos += 7) {
+        uint8_t msbs = 0;
+        for (unsigned i = 0; i < 7 && pos + i < length; i++) {
+            if (data[pos + i] & 0x80) msbs |= (1 << i);
+        }
+        out[n++] = msbs;
+        for (unsigned i = 0; i < 7 && pos + i < length; i++) {
+            out[n++] = data[pos + i] & 0x7F;
+        }
+    }
+    out[n++] = 0xF7;
+    return n;
+}
+
+// Host-side decoder, as a monitoring script would implement it
+unsigned decodePayload(const uint8_t* in, unsigned length, uint8_t* out) {
+    unsigned n = 0;
+    for (unsigned pos = 0; pos < length; pos += 8) {
+        uint8_t msbs = in[pos];
+        for (unsigned i = 1; i < 8 && pos + i < length; i++) {
+            out[n++] = in[pos + i] | ((msbs & (1 << (i - 1))) ? 0x80 : 0);
+        }
+    }
+    return n;
+}
+
+// Request framing from SysExHandler::receiveByte()
+struct RequestParser {
+    uint8_t buffer[16];
+    uint8_t length;
+    bool active;
+    bool overflow;
+    int dispatched;
+
+    void reset() { length = 0; active = false; overflow = false; dispatched = -1; }
+
+    void receive(uint8_t data) {
+        if (data == 0xF0) { active = true; overflow = false; length = 0; return; }
+        if (data == 0xF7) {
+            if (active && !overflow && length >= 3 && buffer[0] == 0x7D && buffer[1] == 0x42) {
+                dispatched = buffer[2];
+            }
+            active = false;
+            return;
+        }
+        if (data & 0x80) { active = false; return; }
+        if (!active) return;
+        if (length < sizeof(buffer)) buffer[length++] = data;
+        else overflow = true;
+    }
+};
+
+RequestParser parser;
+
+void test_counter32_increments() {
+    uint32_t counter = 0;
+    count32(counter);
+    count32(counter);
+    TEST_ASSERT_EQUAL_UINT32(2, counter);
+}
+
+void test_counter32_saturates() {
+    uint32_t counter = 0xFFFFFFFEUL;
+    count32(counter);
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFFUL, counter);
+    count32(counter);
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFFUL, counter);
+}
+
+void test_counter16_saturates() {
+    uint16_t counter = 0xFFFE;
+    count16(counter);
+    count16(counter);
+    TEST_ASSERT_EQUAL_UINT16(0xFFFF, counter);
+}
+
+void test_reply_framing_empty_payload() {
+    uint8_t out[8];
+    unsigned n = encodeReply(0x02, NULL, 0, out);
+    const uint8_t expected[] = {0xF0, 0x7D, 0x42, 0x42, 0xF7};
+    TEST_ASSERT_EQUAL_UINT(5, n);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, out, 5);
+}
+
+void test_reply_payload_is_7bit_clean() {
+    uint8_t data[38];
+    for (unsigned i = 0; i < sizeof(data); i++) data[i] = 0xF0 + i;
+    uint8_t out[64];
+    unsigned n = encodeReply(0x01, data, sizeof(data), out);
+    for (unsigned i = 1; i < n - 1; i++) {
+        TEST_ASSERT_TRUE(out[i] < 0x80);
+    }
+}
+
+void test_reply_payload_roundtrip() {
+    uint8_t data[38];
+    for (unsigned i = 0; i < sizeof(data); i++) data[i] = (uint8_t)(i * 37 + 0x81);
+    uint8_t out[64];
+    unsigned n = encodeReply(0x01, data, sizeof(data), out);
+    // 38 bytes -> 6 groups -> 38 + 6 MSB bytes, plus 4 header bytes and F7
+    TEST_ASSERT_EQUAL_UINT(38 + 6 + 5, n);
+
+    uint8_t decoded[38];
+    unsigned length = decodePayload(out + 4, n - 5, decoded);
+    TEST_ASSERT_EQUAL_UINT(sizeof(data), length);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(data, decoded, sizeof(data));
+}
+
+void test_request_dispatches_command() {
+    const uint8_t request[] = {0xF0, 0x7D, 0x42, 0x01, 0xF7};
+    for (unsigned i = 0; i < sizeof(request); i++) parser.receive(request[i]);
+    TEST_ASSERT_EQUAL_INT(0x01, parser.dispatched);
+}
+
+void test_request_for_other_device_ignored() {
+    const uint8_t request[] = {0xF0, 0x7D, 0x10, 0x01, 0xF7};
+    for (unsigned i = 0; i < sizeof(request); i++) parser.receive(request[i]);
+    TEST_ASSERT_EQUAL_INT(-1, parser.dispatched);
+}
+
+void test_request_aborted_by_status_byte() {
+    const uint8_t request[] = {0xF0, 0x7D, 0x90, 0x42, 0x01, 0xF7};
+    for (unsigned i = 0; i < sizeof(request); i++) parser.receive(request[i]);
+    TEST_ASSERT_EQUAL_INT(-1, parser.dispatched);
+}
+
+void test_request_overflow_ignored() {
+    parser.receive(0xF0);
+    parser.receive(0x7D);
+    parser.receive(0x42);
+    parser.receive(0x01);
+    for (int i = 0; i < 20; i++) parser.receive(0x00);
+    parser.receive(0xF7);
+    TEST_ASSERT_EQUAL_INT(-1, parser.dispatched);
+}
+
+void setUp(void) {
+    parser.reset();
+}
+
+void tearDown(void) {
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    
+    // Counter tests
+    RUN_TEST(test_counter32_increments);
+    RUN_TEST(test_counter32_saturates);
+    RUN_TEST(test_counter16_saturates);
+    
+    // Reply encoding tests
+    RUN_TEST(test_reply_framing_empty_payload);
+    RUN_TEST(test_reply_payload_is_7bit_clean);
+    RUN_TEST(test_reply_payload_roundtrip);
+    
+    // Request parsing tests
+    RUN_TEST(test_request_dispatches_command);
+    RUN_TEST(test_request_for_other_device_ignored);
+    RUN_TEST(test_request_aborted_by_status_byte);
+    RUN_TEST(test_request_overflow_ignored);
+    
+    return UNITY_END();
+}
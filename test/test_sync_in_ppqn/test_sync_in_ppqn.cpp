@@ -0,0 +1,179 @@
+#include <unity.h>
+#include <stdint.h>
+
+// SYNC IN interpolation from Sync.cpp
+// (micros() timestamps are 32-bit on AVR)
+#define PPQN 24
+#define SYNC_IN_LEAD_US 2000
+
+uint8_t syncInPPQN;
+uint8_t interpolateRemaining;
+uint32_t interpolateNextUs;
+uint32_t interpolateStepUs;
+uint32_t prevSyncInTime;
+uint32_t avgSyncInInterval;
+uint8_t ppqnCounter;
+uint32_t nowUs;
+
+// Ticks handed to the clock bus, with the timestamp they were given
+uint32_t tickTimes[512];
+uint8_t tickCounters[512];
+int tickCount;
+uint8_t pulseCounters[64];
+int pulseCount;
+
+void handleSyncInTick(uint32_t timestampUs) {
+    tickTimes[tickCount] = timestampUs;
+    tickCounters[tickCount] = ppqnCounter;
+    tickCount++;
+    ppqnCounter++;
+    if (ppqnCounter >= PPQN) ppqnCounter = 0;
+}
+
+void pulse(uint32_t pulseTime) {
+    nowUs = pulseTime;
+    if (prevSyncInTime > 0) {
+        uint32_t interval = pulseTime - prevSyncInTime;
+        avgSyncInInterval = (avgSyncInInterval == 0) ? interval : (avgSyncInInterval * 3 + interval) / 4;
+    }
+    prevSyncInTime = pulseTime;
+    uint8_t ticksPerPulse = PPQN / syncInPPQN;
+    uint8_t skipped = (ticksPerPulse - ppqnCounter % ticksPerPulse) % ticksPerPulse;
+    ppqnCounter = (ppqnCounter + skipped) % PPQN;
+    interpolateRemaining = 0;
+    pulseCounters[pulseCount++] = ppqnCounter;
+    handleSyncInTick(pulseTime);
+    if (avgSyncInInterval > 0) {
+        interpolateRemaining = ticksPerPulse - 1;
+        interpolateStepUs = avgSyncInInterval / ticksPerPulse;
+        interpolateNextUs = pulseTime + interpolateStepUs;
+    }
+}
+
+// One loop pass at the given time
+void update(uint32_t time) {
+    nowUs = time;
+    if (interpolateRemaining > 0 &&
+        (int32_t)(interpolateNextUs - nowUs) <= SYNC_IN_LEAD_US) {
+        interpolateRemaining--;
+        handleSyncInTick(interpolateNextUs);
+        interpolateNextUs += interpolateStepUs;
+    }
+}
+
+bool setSyncInPPQN(uint8_t ppqn) {
+    if (ppqn == 0 || ppqn > PPQN || (PPQN % ppqn) != 0) return false;
+    syncInPPQN = ppqn;
+    interpolateRemaining = 0;
+    return true;
+}
+
+// Drive pulses every intervalUs with a loop pass every 100 us
+void run(uint32_t start, uint32_t intervalUs, int pulses) {
+    uint32_t t = start;
+    for (int p = 0; p < pulses; p++) {
+        pulse(t);
+        for (uint32_t u = t + 100; u < t + intervalUs; u += 100) update(u);
+        t += intervalUs;
+    }
+}
+
+// Test 24 PPQN input passes straight through
+void test_24_ppqn_no_interpolation() {
+    run(1000, 20000, 48);
+    TEST_ASSERT_EQUAL_INT(48, tickCount);
+}
+
+// Test 1 PPQN input yields 24 evenly spaced ticks per beat
+void test_1_ppqn_interpolated() {
+    setSyncInPPQN(1);
+    run(1000, 480000, 4);  // 125 BPM
+    // Only the first pulse goes out on the first beat: no period yet
+    TEST_ASSERT_EQUAL_INT(1 + 24 * 3, tickCount);
+    TEST_ASSERT_EQUAL_UINT32(481000, tickTimes[1]);
+    for (int i = 1; i < 72; i++) {
+        TEST_ASSERT_EQUAL_UINT32(20000, tickTimes[i + 1] - tickTimes[i]);
+    }
+}
+
+// Test real pulses stay on beat boundaries
+void test_pulses_land_on_beats() {
+    setSyncInPPQN(4);
+    run(1000, 125000, 16);
+    for (int i = 0; i < pulseCount; i++) {
+        TEST_ASSERT_EQUAL_UINT8(0, pulseCounters[i] % 6);
+    }
+    TEST_ASSERT_EQUAL_INT(1 + 6 * 15, tickCount);  // the first pulse has no period to split
+}
+
+// Test ticks are handed over ahead of their due time
+void test_ticks_scheduled_ahead() {
+    setSyncInPPQN(2);
+    run(1000, 250000, 2);
+    pulse(501000);
+    update(501000 + 20833 - SYNC_IN_LEAD_US);
+    TEST_ASSERT_EQUAL_UINT32(501000 + 20833, tickTimes[tickCount - 1]);
+}
+
+// Test a faster pulse drops the ticks it overtook and stays on the beat
+void test_speedup_drops_remaining() {
+    setSyncInPPQN(1);
+    run(1000, 480000, 2);
+    pulse(961000);
+    for (uint32_t u = 961100; u < 1361000; u += 100) update(u);
+    int before = tickCount;
+    pulse(1361000);  // next beat arrives 80 ms early
+    TEST_ASSERT_EQUAL_INT(1, tickCount - before);  // the pulse alone
+    TEST_ASSERT_EQUAL_UINT32(1361000, tickTimes[tickCount - 1]);
+    TEST_ASSERT_EQUAL_UINT8(0, tickCounters[tickCount - 1]);
+}
+
+// Test nothing is interpolated before a pulse period is known
+void test_first_pulse_not_interpolated() {
+    setSyncInPPQN(2);
+    pulse(1000);
+    for (uint32_t u = 1100; u < 300000; u += 100) update(u);
+    TEST_ASSERT_EQUAL_INT(1, tickCount);
+    pulse(300000);
+    TEST_ASSERT_EQUAL_UINT8(0, pulseCounters[1] % 12);
+    TEST_ASSERT_EQUAL_INT(2, tickCount);
+}
+
+// Test only divisors of 24 are accepted
+void test_ppqn_validation() {
+    TEST_ASSERT_TRUE(setSyncInPPQN(1));
+    TEST_ASSERT_TRUE(setSyncInPPQN(12));
+    TEST_ASSERT_FALSE(setSyncInPPQN(0));
+    TEST_ASSERT_FALSE(setSyncInPPQN(5));
+    TEST_ASSERT_FALSE(setSyncInPPQN(48));
+    TEST_ASSERT_EQUAL_UINT8(12, syncInPPQN);
+}
+
+void setUp(void) {
+    syncInPPQN = 24;
+    interpolateRemaining = 0;
+    interpolateNextUs = 0;
+    interpolateStepUs = 0;
+    prevSyncInTime = 0;
+    avgSyncInInterval = 0;
+    ppqnCounter = 0;
+    tickCount = 0;
+    pulseCount = 0;
+}
+
+void tearDown(void) {
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_24_ppqn_no_interpolation);
+    RUN_TEST(test_1_ppqn_interpolated);
+    RUN_TEST(test_pulses_land_on_beats);
+    RUN_TEST(test_ticks_scheduled_ahead);
+    RUN_TEST(test_speedup_drops_remaining);
+    RUN_TEST(test_first_pulse_not_interpolated);
+    RUN_TEST(test_ppqn_validation);
+    
+    return UNITY_END();
+}
@@ -0,0 +1,202 @@
+#include <unity.h>
+#include <stdint.h>
+#include <string.h>
+
+// Windowed rates and peak hold from ThroughputMeter.cpp
+#define METER_WINDOWS          4
+#define METER_STEP_MS          250
+#define METER_PEAK_HOLD_MS     2000
+#define METER_OVERLOAD_PERCENT 90
+#define USB_PACKET_LENGTHS     0x7AFFE7E0UL
+
+struct MeterReading {
+    uint16_t messagesPerSecond;
+    uint16_t loadPercent;
+};
+
+uint16_t messages;
+uint16_t bytes;
+uint16_t messageSteps[METER_WINDOWS];
+uint16_t byteSteps[METER_WINDOWS];
+uint8_t step;
+MeterReading held;
+unsigned long heldMs;
+
+uint16_t loadPercent(uint32_t bytesPerSecond) {
+    uint32_t percent = (bytesPerSecond * 4 + 62) / 125;
+    return (percent > 999) ? 999 : percent;
+}
+
+void countPacket(uint8_t header) {
+    uint8_t cin = header & 0x0F;
+    bytes += (USB_PACKET_LENGTHS >> (2 * cin)) & 0x03;
+    if (cin >= 0x02 && cin != 0x04) messages++;
+}
+
+void meterStep(unsigned long now) {
+    step = (step + 1) % METER_WINDOWS;
+    messageSteps[step] = messages;
+    byteSteps[step] = bytes;
+    messages = 0;
+    bytes = 0;
+
+    uint32_t messageSum = 0;
+    uint32_t byteSum = 0;
+    for (uint8_t i = 0; i < METER_WINDOWS; i++) {
+        messageSum += messageSteps[i];
+        byteSum += byteSteps[i];
+    }
+
+    MeterReading current;
+    current.messagesPerSecond = (messageSum > 0xFFFF) ? 0xFFFF : messageSum;
+    current.loadPercent = loadPercent(byteSum);
+
+    if (current.loadPercent >= held.loadPercent || current.messagesPerSecond >= held.messagesPerSecond) {
+        if (current.loadPercent > held.loadPercent) held.loadPercent = current.loadPercent;
+        if (current.messagesPerSecond > held.messagesPerSecond) held.messagesPerSecond = current.messagesPerSecond;
+        heldMs = now;
+    } else if ((unsigned long)(now - heldMs) >= METER_PEAK_HOLD_MS) {
+        held = current;
+    }
+}
+
+// One step of traffic: messages of `length` bytes
+void traffic(uint16_t count, uint8_t length, unsigned long now) {
+    messages += count;
+    bytes += count * length;
+    meterStep(now);
+}
+
+// Meter digits from Display.cpp, as characters ('.' after a digit for the point)
+void meterDigits(char* text, uint16_t value, int8_t point) {
+    uint8_t n = 0;
+    char digits[3];
+    for (int8_t i = 2; i >= 0; i--) {
+        digits[i] = (i == 2 || value > 0 || i <= point) ? '0' + value % 10 : ' ';
+        value /= 10;
+    }
+    for (int8_t i = 0; i < 3; i++) {
+        text[n++] = digits[i];
+        if (i == point) text[n++] = '.';
+    }
+    text[n] = 0;
+}
+
+void rateDigits(char* text, uint16_t rate) {
+    if (rate < 1000) meterDigits(text, rate, -1);
+    else if (rate < 10000) meterDigits(text, rate / 10, 0);
+    else meterDigits(text, rate / 100, 1);
+}
+
+void setUp(void) {
+    messages = 0;
+    bytes = 0;
+    memset(messageSteps, 0, sizeof(messageSteps));
+    memset(byteSteps, 0, sizeof(byteSteps));
+    step = 0;
+    memset(&held, 0, sizeof(held));
+    heldMs = 0;
+}
+
+void tearDown(void) {}
+
+void test_load_of_31250_baud(void) {
+    TEST_ASSERT_EQUAL(0, loadPercent(0));
+    TEST_ASSERT_EQUAL(100, loadPercent(3125));
+    TEST_ASSERT_EQUAL(50, loadPercent(1563));
+    TEST_ASSERT_EQUAL(1, loadPercent(16));
+    TEST_ASSERT_EQUAL(999, loadPercent(1000000));
+}
+
+void test_usb_packet_lengths(void) {
+    const uint8_t expected[16] = {0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1};
+    for (uint8_t cin = 0; cin < 16; cin++) {
+        bytes = 0;
+        countPacket(0x10 | cin);   // the cable does not matter
+        TEST_ASSERT_EQUAL(expected[cin], bytes);
+    }
+}
+
+void test_usb_sysex_counts_once(void) {
+    countPacket(0x04);   // F0 7D 42
+    countPacket(0x04);
+    countPacket(0x06);   // xx F7
+    TEST_ASSERT_EQUAL(1, messages);
+    TEST_ASSERT_EQUAL(8, bytes);
+}
+
+void test_window_covers_one_second(void) {
+    // Back-to-back 3-byte messages: 1041 a second fill DIN
+    unsigned long now = 0;
+    for (uint8_t i = 0; i < METER_WINDOWS - 1; i++) {
+        traffic(260, 3, now += METER_STEP_MS);
+    }
+    TEST_ASSERT_EQUAL(780, held.messagesPerSecond);
+    traffic(261, 3, now += METER_STEP_MS);
+    TEST_ASSERT_EQUAL(1041, held.messagesPerSecond);
+    TEST_ASSERT_EQUAL(100, held.loadPercent);
+    TEST_ASSERT_TRUE(held.loadPercent >= METER_OVERLOAD_PERCENT);
+}
+
+void test_peak_held_then_released(void) {
+    unsigned long now = 0;
+    for (uint8_t i = 0; i < METER_WINDOWS; i++) traffic(250, 3, now += METER_STEP_MS);
+    unsigned long peakMs = now;
+    TEST_ASSERT_EQUAL(1000, held.messagesPerSecond);
+
+    // Traffic stops: the peak stays for the hold time, then the reading follows
+    while (now + METER_STEP_MS - peakMs < METER_PEAK_HOLD_MS) {
+        traffic(0, 0, now += METER_STEP_MS);
+        TEST_ASSERT_EQUAL(1000, held.messagesPerSecond);
+    }
+    traffic(0, 0, now += METER_STEP_MS);
+    TEST_ASSERT_EQUAL(0, held.messagesPerSecond);
+    TEST_ASSERT_EQUAL(0, held.loadPercent);
+}
+
+void test_steady_load_keeps_the_hold(void) {
+    unsigned long now = 0;
+    for (uint8_t i = 0; i < 40; i++) traffic(250, 3, now += METER_STEP_MS);
+    traffic(0, 0, now += METER_STEP_MS);
+    // Ten seconds at the peak: the hold counts from the last step that reached it
+    TEST_ASSERT_EQUAL(1000, held.messagesPerSecond);
+}
+
+void test_new_peak_raises_the_reading(void) {
+    unsigned long now = 0;
+    for (uint8_t i = 0; i < METER_WINDOWS; i++) traffic(100, 1, now += METER_STEP_MS);
+    TEST_ASSERT_EQUAL(400, held.messagesPerSecond);
+    TEST_ASSERT_EQUAL(13, held.loadPercent);
+    traffic(100, 3, now += METER_STEP_MS);
+    TEST_ASSERT_EQUAL(400, held.messagesPerSecond);
+    TEST_ASSERT_EQUAL(19, held.loadPercent);
+}
+
+void test_meter_digits(void) {
+    char text[6];
+    meterDigits(text, 0, -1);
+    TEST_ASSERT_EQUAL_STRING("  0", text);
+    meterDigits(text, 42, -1);
+    TEST_ASSERT_EQUAL_STRING(" 42", text);
+    rateDigits(text, 999);
+    TEST_ASSERT_EQUAL_STRING("999", text);
+    rateDigits(text, 1041);
+    TEST_ASSERT_EQUAL_STRING("1.04", text);
+    rateDigits(text, 12345);
+    TEST_ASSERT_EQUAL_STRING("12.3", text);
+    rateDigits(text, 65535);
+    TEST_ASSERT_EQUAL_STRING("65.5", text);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_load_of_31250_baud);
+    RUN_TEST(test_usb_packet_lengths);
+    RUN_TEST(test_usb_sysex_counts_once);
+    RUN_TEST(test_window_covers_one_second);
+    RUN_TEST(test_peak_held_then_released);
+    RUN_TEST(test_steady_load_keeps_the_hold);
+    RUN_TEST(test_new_peak_raises_the_reading);
+    RUN_TEST(test_meter_digits);
+    return UNITY_END();
+}
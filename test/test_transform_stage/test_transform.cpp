@@ -0,0 +1,205 @@
+#include <unity.h>
+
+// Transform stage from Transform.h / Transform.cpp
+#define TRANSFORM_NOTE_DROP  0x80
+#define TRANSFORM_CC_NONE    0x7F
+
+struct TransformSettings {
+    bool enabled;
+    int8_t transpose;
+    uint8_t noteLow;
+    uint8_t noteHigh;
+    uint8_t splitNote;
+    uint8_t splitChannel;
+    uint8_t velocityCurve;
+    uint8_t ccNumber;
+    uint8_t ccCurve;
+    uint8_t channelMap[16];
+};
+
+TransformSettings settings;
+uint8_t noteMap[128];
+
+// Stand-in for the PROGMEM curves: curve 1 halves (never below 1), curve 2 is "fixed 100"
+uint8_t curve(uint8_t index, uint8_t value) {
+    if (index == 1) return value == 0 ? 0 : (value / 2 > 0 ? value / 2 : 1);
+    if (index == 2) return value == 0 ? 0 : 100;
+    return value;
+}
+
+void configure(const TransformSettings& newSettings) {
+    settings = newSettings;
+    if (newSettings.splitChannel > 15) {
+        settings.splitNote = 128;
+        settings.splitChannel = 0;
+    }
+    for (int note = 0; note < 128; note++) {
+        int out = note + newSettings.transpose;
+        if (note < newSettings.noteLow || note > newSettings.noteHigh || out < 0 || out > 127) {
+            noteMap[note] = TRANSFORM_NOTE_DROP;
+        } else {
+            noteMap[note] = out;
+        }
+    }
+}
+
+bool apply(uint8_t& status, uint8_t& data1, uint8_t& data2) {
+    if (!settings.enabled || status >= 0xF0) return true;
+    uint8_t type = status & 0xF0;
+    uint8_t channel = settings.channelMap[status & 0x0F];
+    if (type <= 0xA0) {
+        uint8_t note = noteMap[data1];
+        if (note & TRANSFORM_NOTE_DROP) return false;
+        if (data1 >= settings.splitNote) channel = settings.splitChannel;
+        data1 = note;
+        if (type == 0x90 && data2 != 0) data2 = curve(settings.velocityCurve, data2);
+    } else if (type == 0xB0 && data1 == settings.ccNumber) {
+        data2 = curve(settings.ccCurve, data2);
+    }
+    status = type | channel;
+    return true;
+}
+
+TransformSettings identity() {
+    TransformSettings s;
+    s.enabled = true;
+    s.transpose = 0;
+    s.noteLow = 0;
+    s.noteHigh = 127;
+    s.splitNote = 128;
+    s.splitChannel = 0x7F;
+    s.velocityCurve = 0;
+    s.ccNumber = TRANSFORM_CC_NONE;
+    s.ccCurve = 0;
+    for (uint8_t ch = 0; ch < 16; ch++) s.channelMap[ch] = ch;
+    return s;
+}
+
+void test_identity_passes_through() {
+    configure(identity());
+    uint8_t status = 0x93, data1 = 60, data2 = 100;
+    TEST_ASSERT_TRUE(apply(status, data1, data2));
+    TEST_ASSERT_EQUAL_HEX8(0x93, status);
+    TEST_ASSERT_EQUAL_UINT8(60, data1);
+    TEST_ASSERT_EQUAL_UINT8(100, data2);
+}
+
+void test_transpose_up_and_down() {
+    TransformSettings s = identity();
+    s.transpose = 12;
+    configure(s);
+    uint8_t status = 0x90, data1 = 60, data2 = 100;
+    apply(status, data1, data2);
+    TEST_ASSERT_EQUAL_UINT8(72, data1);
+
+    s.transpose = -12;
+    configure(s);
+    data1 = 60;
+    apply(status, data1, data2);
+    TEST_ASSERT_EQUAL_UINT8(48, data1);
+}
+
+void test_transpose_out_of_range_dropped() {
+    TransformSettings s = identity();
+    s.transpose = 12;
+    configure(s);
+    uint8_t status = 0x90, data1 = 120, data2 = 100;
+    TEST_ASSERT_FALSE(apply(status, data1, data2));
+}
+
+void test_note_range_filter() {
+    TransformSettings s = identity();
+    s.noteLow = 36;
+    s.noteHigh = 48;
+    configure(s);
+    uint8_t status = 0x80, data1 = 35, data2 = 0;
+    TEST_ASSERT_FALSE(apply(status, data1, data2));
+    data1 = 36;
+    TEST_ASSERT_TRUE(apply(status, data1, data2));
+}
+
+void test_channel_remap() {
+    TransformSettings s = identity();
+    s.channelMap[0] = 9;
+    configure(s);
+    uint8_t status = 0xB0, data1 = 7, data2 = 90;
+    apply(status, data1, data2);
+    TEST_ASSERT_EQUAL_HEX8(0xB9, status);
+}
+
+void test_split_moves_upper_notes() {
+    TransformSettings s = identity();
+    s.splitNote = 60;
+    s.splitChannel = 1;
+    configure(s);
+    uint8_t status = 0x90, data1 = 59, data2 = 100;
+    apply(status, data1, data2);
+    TEST_ASSERT_EQUAL_HEX8(0x90, status);
+    status = 0x90;
+    data1 = 60;
+    apply(status, data1, data2);
+    TEST_ASSERT_EQUAL_HEX8(0x91, status);
+}
+
+void test_velocity_curve_keeps_note_off() {
+    TransformSettings s = identity();
+    s.velocityCurve = 2;
+    configure(s);
+    uint8_t status = 0x90, data1 = 60, data2 = 10;
+    apply(status, data1, data2);
+    TEST_ASSERT_EQUAL_UINT8(100, data2);
+    data2 = 0;
+    apply(status, data1, data2);
+    TEST_ASSERT_EQUAL_UINT8(0, data2);
+}
+
+void test_cc_curve_only_on_selected_controller() {
+    TransformSettings s = identity();
+    s.ccNumber = 1;
+    s.ccCurve = 1;
+    configure(s);
+    uint8_t status = 0xB0, data1 = 1, data2 = 100;
+    apply(status, data1, data2);
+    TEST_ASSERT_EQUAL_UINT8(50, data2);
+    data1 = 7;
+    data2 = 100;
+    apply(status, data1, data2);
+    TEST_ASSERT_EQUAL_UINT8(100, data2);
+}
+
+void test_system_messages_untouched() {
+    TransformSettings s = identity();
+    s.transpose = 5;
+    configure(s);
+    uint8_t status = 0xF8, data1 = 0, data2 = 0;
+    TEST_ASSERT_TRUE(apply(status, data1, data2));
+    TEST_ASSERT_EQUAL_HEX8(0xF8, status);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_identity_passes_through);
+    
+    // Note table tests
+    RUN_TEST(test_transpose_up_and_down);
+    RUN_TEST(test_transpose_out_of_range_dropped);
+    RUN_TEST(test_note_range_filter);
+    
+    // Channel tests
+    RUN_TEST(test_channel_remap);
+    RUN_TEST(test_split_moves_upper_notes);
+    
+    // Curve tests
+    RUN_TEST(test_velocity_curve_keeps_note_off);
+    RUN_TEST(test_cc_curve_only_on_selected_controller);
+    RUN_TEST(test_system_messages_untouched);
+    
+    return UNITY_END();
+}
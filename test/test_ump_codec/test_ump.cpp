@@ -0,0 +1,261 @@
+#include <unity.h>
+#include <stdint.h>
+
+typedef uint8_t byte;
+
+// Data lengths from MidiCodec.h
+class MidiCodec {
+public:
+    static inline uint8_t dataLength(byte status) {
+        if (status < 0xF0) return ((status & 0xE0) == 0xC0) ? 1 : 2;
+        if (status == 0xF1 || status == 0xF3) return 1;
+        if (status == 0xF2) return 2;
+        return 0;
+    }
+};
+
+// UMP codec from Ump.h
+#define UMP_MAX_WORDS  4   // longest output of one USB-MIDI packet (SysEx end)
+
+#define UMP_SYSEX_COMPLETE  0x0
+#define UMP_SYSEX_START     0x1
+#define UMP_SYSEX_CONTINUE  0x2
+#define UMP_SYSEX_END       0x3
+
+// SysEx7 bytes waiting for a full six-byte packet
+struct UmpSysEx {
+    uint8_t data[6];
+    uint8_t count;
+    bool open;       // F0 seen, F7 not yet
+    bool started;    // a Start packet went out for this message
+};
+
+class Ump {
+public:
+    static inline uint16_t jrTicks(unsigned long us) { return (uint16_t)(us >> 5); }
+    static inline uint32_t jrClock(uint16_t ticks) { return 0x00100000UL | ticks; }
+    static inline uint32_t jrTimestamp(uint16_t ticks) { return 0x00200000UL | ticks; }
+
+    static inline uint8_t messageType(uint32_t word) { return word >> 28; }
+
+    // Encodes one USB-MIDI 1.0 packet; returns the number of words written
+    static uint8_t fromPacket(uint8_t group, uint8_t cin, const uint8_t* bytes,
+                                                        UmpSysEx& sysEx, uint32_t* words) {
+        cin &= 0x0F;
+
+        if (cin >= 0x08 && cin <= 0x0E) {
+            words[0] = message(0x2, group, bytes[0], bytes[1], bytes[2]);
+            return 1;
+        }
+
+        uint8_t length;
+        if (cin == 0x04) length = 3;
+        else if (cin >= 0x05 && cin <= 0x07) length = cin - 0x04;
+        else if (cin == 0x02 || cin == 0x03) length = cin;
+        else if (cin == 0x0F) length = 1;
+        else return 0;
+
+        // CIN 4, 6 and 7 are always SysEx; 5 and F only while one is open
+        bool inSysEx = sysEx.open || bytes[0] == 0xF0 || cin == 0x04 || cin == 0x06 || cin == 0x07;
+        if (!inSysEx || (cin == 0x0F && bytes[0] >= 0xF8)) {
+            if (bytes[0] < 0xF1 || bytes[0] == 0xF7) return 0;
+            words[0] = message(0x1, group, bytes[0], length > 1 ? bytes[1] : 0, length > 2 ? bytes[2] : 0);
+            return 1;
+        }
+
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < length; i++) {
+            uint8_t data = bytes[i];
+            if (data == 0xF0) {
+                sysEx.open = true;
+                sysEx.started = false;
+                sysEx.count = 0;
+            } else if (data == 0xF7) {
+                if (sysEx.open) count += sysExPacket(group, sysEx, true, words + count);
+                sysEx.open = false;
+            } else if (sysEx.open) {
+                if (sysEx.count == 6) count += sysExPacket(group, sysEx, false, words + count);
+                sysEx.data[sysEx.count++] = data;
+            }
+        }
+        return count;
+    }
+
+    // Decodes a type 1 or 2 packet back to MIDI 1.0 bytes; returns the length
+    static uint8_t toBytes(uint32_t word, uint8_t* bytes) {
+        uint8_t type = messageType(word);
+        if (type != 0x1 && type != 0x2) return 0;
+
+        bytes[0] = word >> 16;
+        bytes[1] = (word >> 8) & 0x7F;
+        bytes[2] = word & 0x7F;
+
+        return MidiCodec::dataLength(bytes[0]) + 1;
+    }
+
+private:
+    static inline uint32_t message(uint8_t type, uint8_t group, uint8_t status, uint8_t data1, uint8_t data2) {
+        return ((uint32_t)type << 28) | ((uint32_t)(group & 0x0F) << 24) |
+                      ((uint32_t)status << 16) | ((uint16_t)data1 << 8) | data2;
+    }
+
+    static uint8_t sysExPacket(uint8_t group, UmpSysEx& sysEx, bool last, uint32_t* words) {
+        uint8_t status;
+        if (last) status = sysEx.started ? UMP_SYSEX_END : UMP_SYSEX_COMPLETE;
+        else status = sysEx.started ? UMP_SYSEX_CONTINUE : UMP_SYSEX_START;
+
+        uint8_t b[6] = {0, 0, 0, 0, 0, 0};
+        for (uint8_t i = 0; i < sysEx.count; i++) b[i] = sysEx.data[i];
+
+        words[0] = ((uint32_t)0x3 << 28) | ((uint32_t)(group & 0x0F) << 24) |
+                              ((uint32_t)status << 20) | ((uint32_t)sysEx.count << 16) | ((uint16_t)b[0] << 8) | b[1];
+        words[1] = ((uint32_t)b[2] << 24) | ((uint32_t)b[3] << 16) | ((uint16_t)b[4] << 8) | b[5];
+
+        sysEx.started = true;
+        sysEx.count = 0;
+        return 2;
+    }
+};
+
+UmpSysEx sysEx;
+uint32_t words[UMP_MAX_WORDS];
+
+uint8_t encode(uint8_t cin, uint8_t b1, uint8_t b2, uint8_t b3) {
+    const uint8_t bytes[3] = {b1, b2, b3};
+    return Ump::fromPacket(0, cin, bytes, sysEx, words);
+}
+
+// Test channel voice messages become MIDI 1.0 Channel Voice packets
+void test_channel_voice() {
+    TEST_ASSERT_EQUAL_UINT8(1, encode(0x09, 0x93, 60, 100));
+    TEST_ASSERT_EQUAL_HEX32(0x20933C64, words[0]);
+    TEST_ASSERT_EQUAL_UINT8(1, encode(0x0C, 0xC1, 5, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x20C10500, words[0]);
+}
+
+// Test the group lands in the second nibble
+void test_group() {
+    const uint8_t bytes[3] = {0xB0, 7, 127};
+    Ump::fromPacket(5, 0x0B, bytes, sysEx, words);
+    TEST_ASSERT_EQUAL_HEX32(0x25B0077F, words[0]);
+}
+
+// Test realtime and system common become System packets
+void test_system_messages() {
+    TEST_ASSERT_EQUAL_UINT8(1, encode(0x0F, 0xF8, 0, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x10F80000, words[0]);
+    TEST_ASSERT_EQUAL_UINT8(1, encode(0x03, 0xF2, 0x10, 0x20));
+    TEST_ASSERT_EQUAL_HEX32(0x10F21020, words[0]);
+    TEST_ASSERT_EQUAL_UINT8(1, encode(0x02, 0xF1, 0x35, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x10F13500, words[0]);
+    TEST_ASSERT_EQUAL_UINT8(1, encode(0x05, 0xF6, 0, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x10F60000, words[0]);
+}
+
+// Test a short SysEx fits one Complete packet without F0/F7
+void test_sysex_complete() {
+    TEST_ASSERT_EQUAL_UINT8(0, encode(0x04, 0xF0, 0x7D, 0x42));
+    TEST_ASSERT_EQUAL_UINT8(2, encode(0x06, 0x01, 0xF7, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x30037D42, words[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x01000000, words[1]);
+    TEST_ASSERT_FALSE(sysEx.open);
+}
+
+// Test a long SysEx splits into Start, Continue and End packets
+void test_sysex_start_continue_end() {
+    encode(0x04, 0xF0, 1, 2);
+    TEST_ASSERT_EQUAL_UINT8(0, encode(0x04, 3, 4, 5));
+    TEST_ASSERT_EQUAL_UINT8(2, encode(0x04, 6, 7, 8));  // a seventh byte releases the first six
+    TEST_ASSERT_EQUAL_HEX32(0x30160102, words[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x03040506, words[1]);
+    TEST_ASSERT_EQUAL_UINT8(0, encode(0x04, 9, 10, 11));
+    TEST_ASSERT_EQUAL_UINT8(2, encode(0x04, 12, 13, 14));
+    TEST_ASSERT_EQUAL_HEX32(0x30260708, words[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x090A0B0C, words[1]);
+    TEST_ASSERT_EQUAL_UINT8(2, encode(0x07, 15, 16, 0xF7));
+    TEST_ASSERT_EQUAL_HEX32(0x30340D0E, words[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x0F100000, words[1]);
+}
+
+// Test six data bytes still make one Complete packet, never an empty End
+void test_sysex_six_bytes() {
+    encode(0x04, 0xF0, 1, 2);
+    encode(0x04, 3, 4, 5);
+    TEST_ASSERT_EQUAL_UINT8(2, encode(0x06, 6, 0xF7, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x30060102, words[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x03040506, words[1]);
+}
+
+// Test realtime inside a SysEx goes out as a System packet
+void test_realtime_inside_sysex() {
+    encode(0x04, 0xF0, 1, 2);
+    TEST_ASSERT_EQUAL_UINT8(1, encode(0x0F, 0xF8, 0, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x10F80000, words[0]);
+    TEST_ASSERT_TRUE(sysEx.open);
+}
+
+// Test stray SysEx continuation and end bytes produce nothing
+void test_stray_sysex_ignored() {
+    TEST_ASSERT_EQUAL_UINT8(0, encode(0x05, 0xF7, 0, 0));
+    TEST_ASSERT_EQUAL_UINT8(0, encode(0x06, 0x01, 0xF7, 0));
+    TEST_ASSERT_EQUAL_UINT8(0, encode(0x00, 0x90, 1, 2));
+}
+
+// Test JR Clock / Timestamp words and the 32 us tick
+void test_jitter_reduction() {
+    TEST_ASSERT_EQUAL_UINT16(0, Ump::jrTicks(31));
+    TEST_ASSERT_EQUAL_UINT16(1, Ump::jrTicks(32));
+    TEST_ASSERT_EQUAL_UINT16(31250, Ump::jrTicks(1000000));
+    TEST_ASSERT_EQUAL_UINT16(0, Ump::jrTicks(65536UL * 32));  // wraps every 2.097 s
+    TEST_ASSERT_EQUAL_HEX32(0x00101234, Ump::jrClock(0x1234));
+    TEST_ASSERT_EQUAL_HEX32(0x0020FFFF, Ump::jrTimestamp(0xFFFF));
+    TEST_ASSERT_EQUAL_UINT8(0x0, Ump::messageType(Ump::jrTimestamp(1)));
+}
+
+// Test System and Channel Voice packets decode back to the same bytes
+void test_round_trip() {
+    const uint8_t messages[][4] = {
+        {0x09, 0x90, 60, 100}, {0x0C, 0xCF, 9, 0}, {0x0E, 0xE2, 0x00, 0x40},
+        {0x0F, 0xFA, 0, 0}, {0x03, 0xF2, 1, 2}, {0x02, 0xF3, 4, 0}
+    };
+    const uint8_t lengths[] = {3, 2, 3, 1, 3, 2};
+    for (int i = 0; i < 6; i++) {
+        TEST_ASSERT_EQUAL_UINT8(1, encode(messages[i][0], messages[i][1], messages[i][2], messages[i][3]));
+        uint8_t bytes[3];
+        TEST_ASSERT_EQUAL_UINT8(lengths[i], Ump::toBytes(words[0], bytes));
+        for (int j = 0; j < lengths[i]; j++) TEST_ASSERT_EQUAL_HEX8(messages[i][j + 1], bytes[j]);
+    }
+    uint8_t bytes[3];
+    TEST_ASSERT_EQUAL_UINT8(0, Ump::toBytes(0x30160102, bytes));
+}
+
+void setUp(void) {
+    sysEx.count = 0;
+    sysEx.open = false;
+    sysEx.started = false;
+}
+
+void tearDown(void) {
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    
+    // Message tests
+    RUN_TEST(test_channel_voice);
+    RUN_TEST(test_group);
+    RUN_TEST(test_system_messages);
+    RUN_TEST(test_round_trip);
+    
+    // SysEx tests
+    RUN_TEST(test_sysex_complete);
+    RUN_TEST(test_sysex_start_continue_end);
+    RUN_TEST(test_sysex_six_bytes);
+    RUN_TEST(test_realtime_inside_sysex);
+    RUN_TEST(test_stray_sysex_ignored);
+    
+    // Jitter Reduction tests
+    RUN_TEST(test_jitter_reduction);
+    
+    return UNITY_END();
+}
@@ -0,0 +1,196 @@
+#include <unity.h>
+#include <stdint.h>
+#include <string.h>
+
+// Jack numbering and descriptor layout from UsbMidi.cpp
+#define USB_MIDI_CABLES    3
+#define CS_INTERFACE       0x24
+#define CS_ENDPOINT        0x25
+#define MS_MIDI_IN_JACK    0x02
+#define MS_MIDI_OUT_JACK   0x03
+#define JACK_EMBEDDED      0x01
+#define JACK_EXTERNAL      0x02
+#define JACK_STRING_BASE   0x10
+
+#define USB_CABLE_DIN      0
+#define USB_CABLE_CLOCK    1
+#define USB_CABLE_CONTROL  2
+#define USB_MIDI_HEADER(cable, cin)  (uint8_t)(((cable) << 4) | (cin))
+
+uint8_t jackId(uint8_t cable, uint8_t jack) {
+    return cable * 4 + jack + 1;
+}
+
+uint8_t jackName(uint8_t cable) {
+    return (USB_MIDI_CABLES > 1) ? JACK_STRING_BASE + cable : 0;
+}
+
+// The class-specific MIDI Streaming descriptors, header through endpoints
+uint8_t descriptor[256];
+uint16_t descriptorLength;
+
+void append(const uint8_t* data, uint16_t length) {
+    memcpy(descriptor + descriptorLength, data, length);
+    descriptorLength += length;
+}
+
+void build(void) {
+    descriptorLength = 0;
+    const uint16_t jackLength = 7 + USB_MIDI_CABLES * (6 + 6 + 9 + 9);
+    const uint8_t header[] = {7, CS_INTERFACE, 0x01, 0x00, 0x01, (uint8_t)jackLength, (uint8_t)(jackLength >> 8)};
+    append(header, sizeof(header));
+
+    for (uint8_t cable = 0; cable < USB_MIDI_CABLES; cable++) {
+        const uint8_t jacks[] = {
+            6, CS_INTERFACE, MS_MIDI_IN_JACK, JACK_EMBEDDED, jackId(cable, 0), jackName(cable),
+            6, CS_INTERFACE, MS_MIDI_IN_JACK, JACK_EXTERNAL, jackId(cable, 1), 0,
+            9, CS_INTERFACE, MS_MIDI_OUT_JACK, JACK_EMBEDDED, jackId(cable, 2), 1, jackId(cable, 1), 1, jackName(cable),
+            9, CS_INTERFACE, MS_MIDI_OUT_JACK, JACK_EXTERNAL, jackId(cable, 3), 1, jackId(cable, 0), 1, 0
+        };
+        append(jacks, sizeof(jacks));
+    }
+
+    uint8_t endpoint[9 + 4 + USB_MIDI_CABLES] = {
+        9, 0x05, 0x02, 0x02, 64, 0, 0, 0, 0,
+        4 + USB_MIDI_CABLES, CS_ENDPOINT, 0x01, USB_MIDI_CABLES
+    };
+    for (uint8_t cable = 0; cable < USB_MIDI_CABLES; cable++) endpoint[13 + cable] = jackId(cable, 0);
+    append(endpoint, sizeof(endpoint));
+    endpoint[2] = 0x83;
+    for (uint8_t cable = 0; cable < USB_MIDI_CABLES; cable++) endpoint[13 + cable] = jackId(cable, 2);
+    append(endpoint, sizeof(endpoint));
+}
+
+// Offset of the jack descriptor with the given ID, -1 if none
+int findJack(uint8_t id) {
+    for (uint16_t i = 0; i < descriptorLength; i += descriptor[i]) {
+        uint8_t subtype = descriptor[i + 2];
+        if (descriptor[i + 1] == CS_INTERFACE && (subtype == MS_MIDI_IN_JACK || subtype == MS_MIDI_OUT_JACK) &&
+            descriptor[i + 4] == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Where processUSBMIDI sends a packet from the host
+enum { TO_DIN = 1, TO_SYSEX = 2, TO_SYNC = 4 };
+
+uint8_t routeFromHost(uint8_t header) {
+    uint8_t cable = header >> 4;
+    uint8_t cin = header & 0x0F;
+    uint8_t targets = 0;
+    if (cable == USB_CABLE_DIN) targets |= TO_DIN;
+    if (cin >= 0x04 && cin <= 0x07) {
+        if (cable == USB_CABLE_CONTROL) targets |= TO_SYSEX;
+        return targets;
+    }
+    if (cin == 0x0F) targets |= TO_SYNC;
+    return targets;
+}
+
+void setUp(void) {
+    build();
+}
+
+void tearDown(void) {}
+
+void test_descriptors_chain_to_the_end(void) {
+    uint16_t i = 0;
+    uint8_t count = 0;
+    while (i < descriptorLength) {
+        TEST_ASSERT_NOT_EQUAL(0, descriptor[i]);
+        i += descriptor[i];
+        count++;
+    }
+    TEST_ASSERT_EQUAL(descriptorLength, i);
+    TEST_ASSERT_EQUAL(1 + 4 * USB_MIDI_CABLES + 4, count);
+}
+
+void test_header_total_covers_jacks_only(void) {
+    uint16_t total = descriptor[5] | (descriptor[6] << 8);
+    TEST_ASSERT_EQUAL(7 + 30 * USB_MIDI_CABLES, total);
+    // The OUT endpoint and its class-specific descriptor follow the last jack
+    TEST_ASSERT_EQUAL(0x05, descriptor[total + 1]);
+    TEST_ASSERT_EQUAL(CS_ENDPOINT, descriptor[total + 9 + 1]);
+}
+
+void test_jack_ids_are_unique(void) {
+    for (uint8_t id = 1; id <= 4 * USB_MIDI_CABLES; id++) {
+        int first = findJack(id);
+        TEST_ASSERT_TRUE(first >= 0);
+        for (uint8_t other = id + 1; other <= 4 * USB_MIDI_CABLES; other++) {
+            TEST_ASSERT_NOT_EQUAL(first, findJack(other));
+        }
+    }
+    TEST_ASSERT_EQUAL(-1, findJack(4 * USB_MIDI_CABLES + 1));
+}
+
+void test_out_jacks_source_the_opposite_in_jack(void) {
+    for (uint8_t cable = 0; cable < USB_MIDI_CABLES; cable++) {
+        // Embedded OUT (to the host) is fed by the external IN, and vice versa
+        int embeddedOut = findJack(jackId(cable, 2));
+        int externalOut = findJack(jackId(cable, 3));
+        TEST_ASSERT_EQUAL(JACK_EMBEDDED, descriptor[embeddedOut + 3]);
+        TEST_ASSERT_EQUAL(jackId(cable, 1), descriptor[embeddedOut + 6]);
+        TEST_ASSERT_EQUAL(JACK_EXTERNAL, descriptor[externalOut + 3]);
+        TEST_ASSERT_EQUAL(jackId(cable, 0), descriptor[externalOut + 6]);
+        TEST_ASSERT_EQUAL(JACK_EXTERNAL, descriptor[findJack(jackId(cable, 1)) + 3]);
+    }
+}
+
+void test_endpoints_list_embedded_jacks_in_cable_order(void) {
+    uint16_t outEndpoint = descriptorLength - 2 * (13 + USB_MIDI_CABLES);
+    uint16_t inEndpoint = outEndpoint + 13 + USB_MIDI_CABLES;
+    TEST_ASSERT_EQUAL(USB_MIDI_CABLES, descriptor[outEndpoint + 12]);
+    TEST_ASSERT_EQUAL(0x83, descriptor[inEndpoint + 2]);
+    for (uint8_t cable = 0; cable < USB_MIDI_CABLES; cable++) {
+        uint8_t received = descriptor[outEndpoint + 13 + cable];
+        uint8_t sent = descriptor[inEndpoint + 13 + cable];
+        TEST_ASSERT_EQUAL(MS_MIDI_IN_JACK, descriptor[findJack(received) + 2]);
+        TEST_ASSERT_EQUAL(JACK_EMBEDDED, descriptor[findJack(received) + 3]);
+        TEST_ASSERT_EQUAL(MS_MIDI_OUT_JACK, descriptor[findJack(sent) + 2]);
+        TEST_ASSERT_EQUAL(JACK_EMBEDDED, descriptor[findJack(sent) + 3]);
+    }
+}
+
+void test_embedded_jacks_carry_the_port_names(void) {
+    for (uint8_t cable = 0; cable < USB_MIDI_CABLES; cable++) {
+        TEST_ASSERT_EQUAL(JACK_STRING_BASE + cable, descriptor[findJack(jackId(cable, 0)) + 5]);
+        TEST_ASSERT_EQUAL(JACK_STRING_BASE + cable, descriptor[findJack(jackId(cable, 2)) + 8]);
+        TEST_ASSERT_EQUAL(0, descriptor[findJack(jackId(cable, 3)) + 8]);
+    }
+}
+
+void test_din_cable_reaches_din_only(void) {
+    TEST_ASSERT_EQUAL(TO_DIN, routeFromHost(USB_MIDI_HEADER(USB_CABLE_DIN, 0x09)));
+    TEST_ASSERT_EQUAL(0, routeFromHost(USB_MIDI_HEADER(USB_CABLE_CLOCK, 0x09)));
+    TEST_ASSERT_EQUAL(0, routeFromHost(USB_MIDI_HEADER(USB_CABLE_CONTROL, 0x0B)));
+}
+
+void test_sysex_queries_only_on_control_cable(void) {
+    TEST_ASSERT_EQUAL(TO_SYSEX, routeFromHost(USB_MIDI_HEADER(USB_CABLE_CONTROL, 0x04)));
+    TEST_ASSERT_EQUAL(TO_SYSEX, routeFromHost(USB_MIDI_HEADER(USB_CABLE_CONTROL, 0x07)));
+    TEST_ASSERT_EQUAL(TO_DIN, routeFromHost(USB_MIDI_HEADER(USB_CABLE_DIN, 0x04)));
+    TEST_ASSERT_EQUAL(0, routeFromHost(USB_MIDI_HEADER(USB_CABLE_CLOCK, 0x06)));
+}
+
+void test_clock_accepted_on_any_cable(void) {
+    TEST_ASSERT_EQUAL(TO_SYNC, routeFromHost(USB_MIDI_HEADER(USB_CABLE_CLOCK, 0x0F)));
+    TEST_ASSERT_EQUAL(TO_SYNC, routeFromHost(USB_MIDI_HEADER(USB_CABLE_CONTROL, 0x0F)));
+    TEST_ASSERT_EQUAL(TO_DIN | TO_SYNC, routeFromHost(USB_MIDI_HEADER(USB_CABLE_DIN, 0x0F)));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_descriptors_chain_to_the_end);
+    RUN_TEST(test_header_total_covers_jacks_only);
+    RUN_TEST(test_jack_ids_are_unique);
+    RUN_TEST(test_out_jacks_source_the_opposite_in_jack);
+    RUN_TEST(test_endpoints_list_embedded_jacks_in_cable_order);
+    RUN_TEST(test_embedded_jacks_carry_the_port_names);
+    RUN_TEST(test_din_cable_reaches_din_only);
+    RUN_TEST(test_sysex_queries_only_on_control_cable);
+    RUN_TEST(test_clock_accepted_on_any_cable);
+    return UNITY_END();
+}
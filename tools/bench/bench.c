@@ -0,0 +1,374 @@
+/**
+ * MIDI BytePulse - Cycle Benchmark Harness
+ *
+ * Runs the CYCLE_PROBES firmware image under simavr and feeds it a stimulus
+ * trace in the tools/sim text format (din, usb, sync, jack-in, jack-out,
+ * button, every, end). Reports exact CPU cycle counts for every probe and
+ * the latency from each clock input (DIN F8, USB F8, SYNC IN rising edge)
+ * to the SYNC OUT rising edge it produced.
+ *
+ * Usage: bench <firmware.elf> <scenario.trace> [--usb-mailbox 0xADDR] [--tail-ms ms]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/sim_irq.h>
+#include <simavr/sim_cycle_timers.h>
+#include <simavr/avr_uart.h>
+#include <simavr/avr_ioport.h>
+
+#define F_CPU          16000000UL
+#define CYCLES_PER_US  16
+#define DIN_BYTE_US    320
+#define MAX_EVENTS     200000
+
+// Data-space addresses on the ATmega32U4
+#define GPIOR0_ADDR    0x3E
+#define PLLCSR_ADDR    0x49
+#define PLLE           1
+#define PLOCK          0
+
+// Pro Micro pins, as in include/config.h
+#define SYNC_OUT_PORT         'C'   // D5
+#define SYNC_OUT_BIT          6
+#define SYNC_OUT_DETECT_PORT  'D'   // D4
+#define SYNC_OUT_DETECT_BIT   4
+#define SYNC_IN_PORT          'E'   // D7 / INT6
+#define SYNC_IN_BIT           6
+#define SYNC_IN_DETECT_PORT   'D'   // D6
+#define SYNC_IN_DETECT_BIT    7
+#define BUTTON_PORT           'B'   // D16
+#define BUTTON_BIT            2
+
+// Probe ids, as in include/CycleProbe.h
+#define PROBE_COUNT  6
+#define PROBE_ENTRY  0x80
+static const char* const PROBE_NAMES[PROBE_COUNT] = {
+  NULL, "loop()", "Sync::handleClock", "Sync::update",
+  "MIDIHandler::forwardUSBtoDIN", "SYNC IN ISR"
+};
+
+enum { EV_USB, EV_DIN, EV_SYNC, EV_JACK_IN, EV_JACK_OUT, EV_BUTTON, EV_END };
+static const char* const EVENT_NAMES[] = {"usb", "din", "sync", "jack-in", "jack-out", "button", "end"};
+
+typedef struct {
+  uint64_t cycle;
+  uint8_t kind;
+  uint8_t data[4];
+} event_t;
+
+typedef struct {
+  avr_cycle_count_t entered;
+  int open;
+  uint64_t calls, total, min, max;
+} probe_t;
+
+typedef struct {
+  uint64_t count, total, min, max, missed;
+} latency_t;
+
+static event_t* events;
+static size_t eventCount;
+static size_t nextEvent;
+static probe_t probes[PROBE_COUNT];
+static latency_t latency = {0, 0, UINT64_MAX, 0, 0};
+static avr_cycle_count_t clockInCycle;
+static int clockInPending;
+static uint16_t usbMailbox;
+static avr_t* avr;
+
+static avr_irq_t* pinIRQ(char port, int bit) {
+  return avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(port), bit);
+}
+
+// ---------------------------------------------------------------------------
+// Stimulus trace
+
+static void addEvent(uint64_t us, uint8_t kind, const uint8_t* data) {
+  if (eventCount >= MAX_EVENTS) {
+    fprintf(stderr, "too many events (max %d)\n", MAX_EVENTS);
+    exit(2);
+  }
+  event_t* e = &events[eventCount++];
+  e->cycle = us * CYCLES_PER_US;
+  e->kind = kind;
+  memcpy(e->data, data, 4);
+}
+
+static int compareEvents(const void* a, const void* b) {
+  const event_t* x = a;
+  const event_t* y = b;
+  if (x->cycle != y->cycle) return x->cycle < y->cycle ? -1 : 1;
+  return x < y ? -1 : 1;
+}
+
+static int loadTrace(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "cannot read %s\n", path);
+    return 0;
+  }
+
+  char line[512];
+  int lineNumber = 0;
+  while (fgets(line, sizeof(line), file)) {
+    lineNumber++;
+    line[strcspn(line, "#\"\r\n")] = '\0';
+
+    char* tokens[32];
+    int n = 0;
+    for (char* t = strtok(line, " \t"); t && n < 32; t = strtok(NULL, " \t")) tokens[n++] = t;
+    if (n == 0) continue;
+
+    uint64_t us = strtoull(tokens[0], NULL, 10);
+    uint64_t periodUs = 0, repeat = 1;
+    int first = 1;
+    if (n > 3 && strcmp(tokens[1], "every") == 0) {
+      periodUs = strtoull(tokens[2], NULL, 10);
+      repeat = strtoull(tokens[3], NULL, 10);
+      first = 4;
+    }
+
+    int kind = -1;
+    for (int k = 0; first < n && k <= EV_END; k++) {
+      if (strcmp(tokens[first], EVENT_NAMES[k]) == 0) kind = k;
+    }
+    if (kind < 0) {
+      fprintf(stderr, "%s:%d: unknown event\n", path, lineNumber);
+      fclose(file);
+      return 0;
+    }
+
+    uint8_t values[28] = {0};
+    int count = 0;
+    for (int i = first + 1; i < n && count < 28; i++) {
+      values[count++] = (uint8_t)strtoul(tokens[i], NULL, (kind == EV_USB || kind == EV_DIN) ? 16 : 10);
+    }
+
+    for (uint64_t r = 0; r < repeat; r++) {
+      uint64_t t = us + r * periodUs;
+      if (kind == EV_DIN) {
+        for (int i = 0; i < count; i++) {
+          uint8_t data[4] = {values[i], 0, 0, 0};
+          addEvent(t + (uint64_t)i * DIN_BYTE_US, EV_DIN, data);
+        }
+      } else {
+        addEvent(t, kind, values);
+      }
+    }
+  }
+  fclose(file);
+
+  qsort(events, eventCount, sizeof(event_t), compareEvents);
+
+  // One DIN wire: a byte can't complete sooner than one byte time after the
+  // previous one, so overlapping lines queue up as they would on a cable
+  uint64_t wireFree = 0;
+  for (size_t i = 0; i < eventCount; i++) {
+    if (events[i].kind != EV_DIN) continue;
+    if (events[i].cycle < wireFree) events[i].cycle = wireFree;
+    wireFree = events[i].cycle + DIN_BYTE_US * CYCLES_PER_US;
+  }
+  qsort(events, eventCount, sizeof(event_t), compareEvents);
+  return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Probes and outputs
+
+static void recordClockIn(avr_cycle_count_t cycle) {
+  if (clockInPending) latency.missed++;
+  clockInCycle = cycle;
+  clockInPending = 1;
+}
+
+static void gpior0Write(struct avr_t* avr, avr_io_addr_t addr, uint8_t value, void* param) {
+  avr->data[addr] = value;
+
+  uint8_t id = value & ~PROBE_ENTRY;
+  if (id == 0 || id >= PROBE_COUNT) return;
+  probe_t* p = &probes[id];
+
+  if (value & PROBE_ENTRY) {
+    p->entered = avr->cycle;
+    p->open = 1;
+  } else if (p->open) {
+    uint64_t cycles = avr->cycle - p->entered;
+    p->open = 0;
+    p->calls++;
+    p->total += cycles;
+    if (p->calls == 1 || cycles < p->min) p->min = cycles;
+    if (cycles > p->max) p->max = cycles;
+  }
+}
+
+// simavr has no PLL model; Arduino's USB init spins until PLOCK is set
+static void pllcsrWrite(struct avr_t* avr, avr_io_addr_t addr, uint8_t value, void* param) {
+  if (value & _BV(PLLE)) value |= _BV(PLOCK);
+  avr->data[addr] = value;
+}
+
+static void syncOutChanged(struct avr_irq_t* irq, uint32_t value, void* param) {
+  if (!value || !clockInPending) return;
+  uint64_t cycles = avr->cycle - clockInCycle;
+  clockInPending = 0;
+  latency.count++;
+  latency.total += cycles;
+  if (cycles < latency.min) latency.min = cycles;
+  if (cycles > latency.max) latency.max = cycles;
+}
+
+// ---------------------------------------------------------------------------
+// Stimulus delivery
+
+static avr_cycle_count_t deliver(struct avr_t* avr, avr_cycle_count_t when, void* param) {
+  while (nextEvent < eventCount && events[nextEvent].cycle <= avr->cycle) {
+    event_t* e = &events[nextEvent];
+
+    switch (e->kind) {
+      case EV_DIN:
+        // The UART model takes one byte time to receive it: send it early
+        avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_INPUT), e->data[0]);
+        if (e->data[0] == 0xF8) recordClockIn(avr->cycle + DIN_BYTE_US * CYCLES_PER_US);
+        break;
+      case EV_USB:
+        if (!usbMailbox) break;
+        if (avr->data[usbMailbox]) {
+          // Previous packet not taken yet; try again shortly
+          return avr->cycle + 100 * CYCLES_PER_US;
+        }
+        memcpy(&avr->data[usbMailbox + 1], e->data, 4);
+        avr->data[usbMailbox] = 1;
+        if (e->data[0] == 0x0F && e->data[1] == 0xF8) recordClockIn(avr->cycle);
+        break;
+      case EV_SYNC:
+        avr_raise_irq(pinIRQ(SYNC_IN_PORT, SYNC_IN_BIT), e->data[0] ? 1 : 0);
+        if (e->data[0]) recordClockIn(avr->cycle);
+        break;
+      case EV_JACK_IN:
+        avr_raise_irq(pinIRQ(SYNC_IN_DETECT_PORT, SYNC_IN_DETECT_BIT), e->data[0] ? 1 : 0);
+        break;
+      case EV_JACK_OUT:
+        avr_raise_irq(pinIRQ(SYNC_OUT_DETECT_PORT, SYNC_OUT_DETECT_BIT), e->data[0] ? 1 : 0);
+        break;
+      case EV_BUTTON:
+        avr_raise_irq(pinIRQ(BUTTON_PORT, BUTTON_BIT), e->data[0] ? 0 : 1);
+        break;
+    }
+    nextEvent++;
+  }
+
+  if (nextEvent >= eventCount) return 0;
+  uint64_t next = events[nextEvent].cycle;
+  if (events[nextEvent].kind == EV_DIN) next -= DIN_BYTE_US * CYCLES_PER_US;
+  return next > avr->cycle ? next : avr->cycle + 1;
+}
+
+// ---------------------------------------------------------------------------
+
+int main(int argc, char** argv) {
+  const char* elfPath = NULL;
+  const char* tracePath = NULL;
+  uint64_t tailUs = 100000;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--usb-mailbox") == 0 && i + 1 < argc) {
+      usbMailbox = (uint16_t)(strtoul(argv[++i], NULL, 0) & 0xFFFF);
+    } else if (strcmp(argv[i], "--tail-ms") == 0 && i + 1 < argc) {
+      tailUs = strtoull(argv[++i], NULL, 10) * 1000;
+    } else if (!elfPath) {
+      elfPath = argv[i];
+    } else if (!tracePath) {
+      tracePath = argv[i];
+    }
+  }
+  if (!elfPath || !tracePath) {
+    fprintf(stderr, "usage: bench <firmware.elf> <scenario.trace> [--usb-mailbox 0xADDR] [--tail-ms ms]\n");
+    return 2;
+  }
+
+  events = calloc(MAX_EVENTS, sizeof(event_t));
+  if (!events || !loadTrace(tracePath)) return 2;
+
+  elf_firmware_t firmware;
+  memset(&firmware, 0, sizeof(firmware));
+  if (elf_read_firmware(elfPath, &firmware) != 0) {
+    fprintf(stderr, "cannot load %s\n", elfPath);
+    return 2;
+  }
+  avr = avr_make_mcu_by_name("atmega32u4");
+  if (!avr) {
+    fprintf(stderr, "this simavr build has no atmega32u4 core\n");
+    return 2;
+  }
+  avr_init(avr);
+  avr_load_firmware(avr, &firmware);
+  avr->frequency = F_CPU;
+
+  uint32_t uartFlags = 0;  // keep DIN OUT bytes off stdout
+  avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('1'), &uartFlags);
+  avr_register_io_write(avr, GPIOR0_ADDR, gpior0Write, NULL);
+  avr_register_io_write(avr, PLLCSR_ADDR, pllcsrWrite, NULL);
+  avr_irq_register_notify(pinIRQ(SYNC_OUT_PORT, SYNC_OUT_BIT), syncOutChanged, NULL);
+
+  // Idle input levels: no cables in, button up, SYNC IN low
+  avr_raise_irq(pinIRQ(SYNC_IN_PORT, SYNC_IN_BIT), 0);
+  avr_raise_irq(pinIRQ(SYNC_IN_DETECT_PORT, SYNC_IN_DETECT_BIT), 0);
+  avr_raise_irq(pinIRQ(SYNC_OUT_DETECT_PORT, SYNC_OUT_DETECT_BIT), 0);
+  avr_raise_irq(pinIRQ(BUTTON_PORT, BUTTON_BIT), 1);
+
+  uint64_t endCycle = tailUs * CYCLES_PER_US;
+  for (size_t i = 0; i < eventCount; i++) {
+    if (events[i].kind == EV_END) {
+      endCycle = events[i].cycle;
+      break;
+    }
+    endCycle = events[i].cycle + tailUs * CYCLES_PER_US;
+  }
+  if (eventCount > 0) avr_cycle_timer_register(avr, 1, deliver, NULL);
+
+  int state = cpu_Running;
+  while (avr->cycle < endCycle && state != cpu_Done && state != cpu_Crashed) {
+    state = avr_run(avr);
+  }
+  if (state == cpu_Crashed) {
+    fprintf(stderr, "firmware crashed at cycle %" PRIu64 "\n", (uint64_t)avr->cycle);
+    return 1;
+  }
+
+  printf("scenario %s, %.3f s simulated\n\n", tracePath, (double)avr->cycle / F_CPU);
+  printf("%-30s %9s %9s %9s %9s  cycles\n", "probe", "calls", "min", "avg", "max");
+  int seen = 0;
+  for (int id = 1; id < PROBE_COUNT; id++) {
+    probe_t* p = &probes[id];
+    if (p->calls == 0) {
+      printf("%-30s %9s\n", PROBE_NAMES[id], "-");
+      continue;
+    }
+    seen++;
+    printf("%-30s %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64 "\n", PROBE_NAMES[id],
+           p->calls, p->min, p->total / p->calls, p->max);
+  }
+
+  printf("\nclock in -> SYNC OUT rising edge: ");
+  if (latency.count == 0) {
+    printf("no edges (is a jack-out cable in the scenario?)\n");
+  } else {
+    printf("%" PRIu64 " ticks, min %" PRIu64 " / avg %" PRIu64 " / max %" PRIu64 " cycles"
+           " (worst %.1f us), %" PRIu64 " without an edge\n",
+           latency.count, latency.min, latency.total / latency.count, latency.max,
+           (double)latency.max / CYCLES_PER_US, latency.missed);
+  }
+
+  if (!seen) {
+    fprintf(stderr, "no probe writes seen: build with -DCYCLE_PROBES=1 (pio run -e bench)\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""
+Adds a 'bench' target to [env:bench]: builds the simavr harness in
+tools/bench, then runs the CYCLE_PROBES firmware against every scenario in
+tools/bench/scenarios and prints per-function cycle counts and the clock in
+to SYNC OUT latency. The same report is written to
+tools/bench/results/<env>.txt so measured numbers are committed with the
+change that moved them.
+
+    pio run -e bench -t bench
+    BENCH_SCENARIO=din_clock_flood pio run -e bench -t bench
+
+Needs simavr (libsimavr + headers, with the atmega32u4 core) on the host.
+"""
+import glob
+import os
+import subprocess
+import sys
+
+Import("env")
+
+BENCH_DIR = os.path.join(env.subst("$PROJECT_DIR"), "tools", "bench")
+
+
+def simavr_flags():
+    """Compiler and linker flags for simavr, from pkg-config when available."""
+    try:
+        output = subprocess.run(
+            ["pkg-config", "--cflags", "--libs", "simavr"],
+            capture_output=True, text=True, check=True).stdout
+        return output.split()
+    except (OSError, subprocess.CalledProcessError):
+        return ["-lsimavr", "-lelf"]
+
+
+def mailbox_address(elf):
+    """Data-space address of benchUSBMailbox, or None if it was optimized out."""
+    toolchain = env.PioPlatform().get_package_dir("toolchain-atmelavr")
+    nm = os.path.join(toolchain, "bin", "avr-nm") if toolchain else "avr-nm"
+    output = subprocess.run([nm, elf], capture_output=True, text=True, check=True).stdout
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) == 3 and fields[2] == "benchUSBMailbox":
+            # avr-nm reports SRAM symbols in the 0x800000 data section
+            return int(fields[0], 16) - 0x800000
+    return None
+
+
+def run_bench(target, source, env):
+    elf = env.subst("$BUILD_DIR/${PROGNAME}.elf")
+    harness = os.path.join(env.subst("$BUILD_DIR"), "bench")
+
+    compile_cmd = ["cc", "-std=c99", "-O2", "-o", harness,
+                   os.path.join(BENCH_DIR, "bench.c")] + simavr_flags()
+    if subprocess.run(compile_cmd).returncode != 0:
+        print("Could not build the simavr harness (is simavr installed?)")
+        return 1
+
+    scenarios = sorted(glob.glob(os.path.join(BENCH_DIR, "scenarios", "*.trace")))
+    selected = os.environ.get("BENCH_SCENARIO")
+    if selected:
+        scenarios = [s for s in scenarios if os.path.splitext(os.path.basename(s))[0] == selected]
+        if not scenarios:
+            print("No scenario named %s" % selected)
+            return 1
+
+    args = []
+    address = mailbox_address(elf)
+    if address is not None:
+        args = ["--usb-mailbox", "0x%x" % address]
+    else:
+        print("benchUSBMailbox not found: USB events will be ignored")
+
+    report = []
+    failed = 0
+    for scenario in scenarios:
+        report.append("\n" + "=" * 80 + "\n")
+        print(report[-1], end="")
+        result = subprocess.run([harness, elf, scenario] + args, capture_output=True, text=True)
+        sys.stderr.write(result.stderr)
+        report.append(result.stdout)
+        print(result.stdout, end="")
+        if result.returncode != 0:
+            failed += 1
+
+    # A partial run would read as a full one
+    if not failed and not selected:
+        results = os.path.join(BENCH_DIR, "results", env.subst("$PIOENV") + ".txt")
+        os.makedirs(os.path.dirname(results), exist_ok=True)
+        with open(results, "w") as f:
+            f.write("".join(report).lstrip("\n"))
+        print("\nReport written to %s" % os.path.relpath(results, env.subst("$PROJECT_DIR")))
+    return 1 if failed else 0
+
+
+env.AddCustomTarget(
+    name="bench",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=run_bench,
+    title="Cycle Benchmark",
+    description="Run the firmware under simavr and report cycle counts")
@@ -0,0 +1,324 @@
+/**
+ * MIDI BytePulse - Bridge Throughput Benchmark Implementation
+ */
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string.h>
+#include "Bench.h"
+#include "MidiCodec.h"
+#include "Stats.h"
+#include "UsbMidi.h"
+#include "config.h"
+
+#define BENCH_START_US  500000   // traffic starts after the boot splash has begun
+#define SYSEX_KEY       (1ULL << 40)
+
+// ---------------------------------------------------------------------------
+// Message reassembly with the firmware's parser
+
+struct BenchMessage {
+  uint64_t timeUs;
+  uint64_t key;       // status and data bytes, or a hash of a whole SysEx message
+  bool realtime;
+};
+
+enum BenchStream { STREAM_USB_IN, STREAM_DIN_IN, STREAM_USB_OUT, STREAM_DIN_OUT, STREAM_COUNT };
+
+static std::vector<BenchMessage> streams[STREAM_COUNT];
+
+template <int Stream>
+struct Collector {
+  static uint64_t timeUs;
+  static uint32_t sysExHash;
+
+  static void add(uint64_t key, bool realtime) {
+    streams[Stream].push_back({timeUs, key, realtime});
+  }
+  static void channelMessage(byte status, byte data1, byte data2) {
+    add(status | (data1 << 8) | ((uint32_t)data2 << 16), false);
+  }
+  static void systemCommon(byte status, byte data1, byte data2) {
+    add(status | (data1 << 8) | ((uint32_t)data2 << 16), false);
+  }
+  static void realtime(byte status) {
+    add(status, true);
+  }
+  static void sysEx(const byte* data, uint8_t length, bool last) {
+    // FNV-1a over the whole message
+    for (uint8_t i = 0; i < length; i++) sysExHash = (sysExHash ^ data[i]) * 16777619UL;
+    if (last) {
+      add(SYSEX_KEY | sysExHash, false);
+      sysExHash = 2166136261UL;
+    }
+  }
+  static void error() {}
+};
+
+template <int Stream> uint64_t Collector<Stream>::timeUs = 0;
+template <int Stream> uint32_t Collector<Stream>::sysExHash = 2166136261UL;
+
+typedef MidiParser<Collector<STREAM_USB_IN>, 48> UsbInParser;
+typedef MidiParser<Collector<STREAM_DIN_IN>, 48> DinInParser;
+typedef MidiParser<Collector<STREAM_USB_OUT>, 48> UsbOutParser;
+typedef MidiParser<Collector<STREAM_DIN_OUT>, 48> DinOutParser;
+
+// Bytes a USB-MIDI packet carries, by code index
+static uint8_t packetLength(const uint8_t* packet) {
+  switch (packet[0] & 0x0F) {
+    case 0x02: case 0x06: return 2;
+    case 0x03: case 0x04: case 0x07: return 3;
+    case 0x05: case 0x0F: return 1;
+    case 0x08: case 0x09: case 0x0A: case 0x0B:
+    case 0x0C: case 0x0D: case 0x0E: return MidiCodec::dataLength(packet[1]) + 1;
+    default: return 0;
+  }
+}
+
+template <class Parser, int Stream>
+static void feedPacket(const TraceEvent& event) {
+  Collector<Stream>::timeUs = event.timeUs;
+  uint8_t length = packetLength(event.data);
+  for (uint8_t i = 0; i < length; i++) Parser::parse(event.data[1 + i]);
+}
+
+// ---------------------------------------------------------------------------
+// Traffic profiles; every message in a profile is unique so it can be paired
+
+static void addNote(std::vector<TraceEvent>& events, uint64_t timeUs, bool usb, uint32_t i) {
+  uint8_t message[3] = {(uint8_t)(((i & 1) ? 0x80 : 0x90) | ((i >> 1) & 0x0F)),
+                        (uint8_t)((i >> 5) & 0x7F), (uint8_t)(1 + (i >> 12) % 127)};
+  Trace::addMessage(events, timeUs, usb, message, 3);
+}
+
+static void addCC(std::vector<TraceEvent>& events, uint64_t timeUs, bool usb, uint32_t i) {
+  uint8_t message[3] = {(uint8_t)(0xB0 | (i & 0x0F)), (uint8_t)((i >> 4) & 0x3F), (uint8_t)((i >> 10) & 0x7F)};
+  Trace::addMessage(events, timeUs, usb, message, 3);
+}
+
+// 256 bytes, to a device ID other than ours so it is forwarded, not answered
+static size_t addSysEx(std::vector<TraceEvent>& events, uint64_t timeUs, bool usb, uint32_t i) {
+  uint8_t message[256];
+  message[0] = 0xF0;
+  message[1] = 0x7D;
+  message[2] = 0x01;
+  message[3] = i & 0x7F;
+  message[4] = (i >> 7) & 0x7F;
+  for (size_t j = 5; j < sizeof(message) - 1; j++) message[j] = (j * 7 + i) & 0x7F;
+  message[sizeof(message) - 1] = 0xF7;
+  Trace::addMessage(events, timeUs, usb, message, sizeof(message));
+  return sizeof(message);
+}
+
+static void addUSBClock(std::vector<TraceEvent>& events, uint64_t startUs, uint32_t periodUs, uint32_t ticks) {
+  const uint8_t start = 0xFA, clock = 0xF8;
+  Trace::addMessage(events, startUs, true, &start, 1, USB_CABLE_CLOCK);
+  for (uint32_t i = 0; i < ticks; i++) {
+    Trace::addMessage(events, startUs + 100 + (uint64_t)i * periodUs, true, &clock, 1, USB_CABLE_CLOCK);
+  }
+}
+
+// USB SysEx is not routed to DIN OUT by default: SET_ROUTE USB -> DIN, all types
+static void routeUSBSysEx(std::vector<TraceEvent>& events) {
+  const uint8_t setRoute[] = {0xF0, SYSEX_MANUFACTURER_ID, SYSEX_DEVICE_ID, 0x03, 0x01, 0x00,
+                              0x7F, 0x7F, 0x7F, 0x03, 0x7F, 0x7F, 0x03, 0xF7};
+  Trace::addMessage(events, BENCH_START_US / 2, true, setRoute, sizeof(setRoute), USB_CABLE_CONTROL);
+}
+
+static void syncOutCable(std::vector<TraceEvent>& events) {
+  const uint8_t on = 1;
+  events.push_back(Trace::event(0, TRACE_JACK_OUT, &on, 1));
+}
+
+static void buildUSBNotes(std::vector<TraceEvent>& events) {
+  for (uint32_t i = 0; i < 2000; i++) addNote(events, BENCH_START_US + i * 500, true, i);
+}
+
+static void buildUSBCCFlood(std::vector<TraceEvent>& events) {
+  for (uint32_t i = 0; i < 2000; i++) addCC(events, BENCH_START_US + i * 250, true, i);
+}
+
+static void buildUSBSysEx(std::vector<TraceEvent>& events) {
+  routeUSBSysEx(events);
+  for (uint32_t i = 0; i < 25; i++) addSysEx(events, BENCH_START_US + i * 40000, true, i);
+}
+
+static void buildDINNotes(std::vector<TraceEvent>& events) {
+  for (uint32_t i = 0; i < 1000; i++) addNote(events, BENCH_START_US + i * 3 * DIN_BYTE_US, false, i);
+}
+
+static void buildDINSysEx(std::vector<TraceEvent>& events) {
+  uint64_t timeUs = BENCH_START_US;
+  for (uint32_t i = 0; i < 10; i++) timeUs += addSysEx(events, timeUs, false, i) * DIN_BYTE_US;
+}
+
+static void buildClockUnderLoad(std::vector<TraceEvent>& events) {
+  syncOutCable(events);
+  addUSBClock(events, BENCH_START_US, 8333, 120);
+  for (uint32_t i = 0; i < 1500; i++) addNote(events, BENCH_START_US + 200 + i * 666, true, i);
+}
+
+static void buildMixed(std::vector<TraceEvent>& events) {
+  syncOutCable(events);
+  addUSBClock(events, BENCH_START_US, 20833, 48);
+  for (uint32_t i = 0; i < 500; i++) addCC(events, BENCH_START_US + 300 + i * 2000, true, i);
+  for (uint32_t i = 0; i < 1000; i++) addNote(events, BENCH_START_US + i * 3 * DIN_BYTE_US, false, i);
+}
+
+static const BenchProfile PROFILES[] = {
+  {"usb_notes", "USB Note On/Off at 2000/s to DIN OUT (about twice the wire)", buildUSBNotes},
+  {"usb_cc_flood", "USB CC burst at 4000/s for 0.5 s to DIN OUT", buildUSBCCFlood},
+  {"usb_sysex", "256-byte USB SysEx dumps every 40 ms to DIN OUT (twice the wire)", buildUSBSysEx},
+  {"din_notes", "DIN Note On/Off back to back (no running status) to USB", buildDINNotes},
+  {"din_sysex", "256-byte DIN SysEx dumps back to back to USB", buildDINSysEx},
+  {"clock_under_load", "USB clock at 300 BPM with USB notes at 1500/s to DIN OUT", buildClockUnderLoad},
+  {"mixed", "USB clock at 120 BPM and CC at 500/s, DIN notes back to back", buildMixed},
+};
+
+// ---------------------------------------------------------------------------
+// Pairing and report
+
+struct BenchPath {
+  const char* name;
+  std::vector<BenchMessage> inputs;
+  std::vector<BenchMessage> outputs;
+};
+
+static void select(const std::vector<BenchMessage>& from, bool clock, std::vector<BenchMessage>& to) {
+  for (const BenchMessage& message : from) {
+    if (message.timeUs < BENCH_START_US) continue;  // setup, e.g. a routing change
+    if (clock ? message.key == 0xF8 : !message.realtime) to.push_back(message);
+  }
+}
+
+static void reportPath(BenchPath& path, FILE* report) {
+  if (path.inputs.empty()) return;
+
+  auto byTime = [](const BenchMessage& a, const BenchMessage& b) { return a.timeUs < b.timeUs; };
+  std::stable_sort(path.inputs.begin(), path.inputs.end(), byTime);
+  std::stable_sort(path.outputs.begin(), path.outputs.end(), byTime);
+
+  // Each output takes the oldest waiting input with the same content
+  std::map<uint64_t, std::deque<uint64_t>> waiting;
+  std::vector<uint64_t> latencies;
+  size_t next = 0;
+  uint64_t lastUs = 0;
+  for (const BenchMessage& output : path.outputs) {
+    for (; next < path.inputs.size() && path.inputs[next].timeUs <= output.timeUs; next++) {
+      waiting[path.inputs[next].key].push_back(path.inputs[next].timeUs);
+    }
+    auto match = waiting.find(output.key);
+    if (match == waiting.end() || match->second.empty()) continue;
+    latencies.push_back(output.timeUs - match->second.front());
+    match->second.pop_front();
+    lastUs = output.timeUs;
+  }
+
+  size_t sent = path.inputs.size();
+  size_t delivered = latencies.size();
+  std::sort(latencies.begin(), latencies.end());
+  size_t p99 = delivered * 99 / 100;
+  if (p99 >= delivered) p99 = delivered - 1;
+
+  fprintf(report, "  %-16s %7zu %9zu %7zu", path.name, sent, delivered, sent - delivered);
+  if (delivered == 0) {
+    fprintf(report, "\n");
+    return;
+  }
+  uint64_t spanUs = lastUs - path.inputs.front().timeUs;
+  double rate = spanUs ? delivered * 1e6 / spanUs : 0;
+  fprintf(report, " %9.0f %8llu %8llu %8llu\n", rate,
+          (unsigned long long)latencies[delivered / 2],
+          (unsigned long long)latencies[p99],
+          (unsigned long long)latencies.back());
+}
+
+void Bench::runProfile(const BenchProfile& profile, const SimOptions& options, FILE* report) {
+  std::vector<TraceEvent> input;
+  profile.build(input);
+  std::stable_sort(input.begin(), input.end(), [](const TraceEvent& a, const TraceEvent& b) {
+    return a.timeUs < b.timeUs;
+  });
+
+  Stats::reset();
+  std::vector<TraceEvent> output;
+  Sim::run(input, options, output);
+
+  for (int i = 0; i < STREAM_COUNT; i++) streams[i].clear();
+  UsbInParser::reset();
+  DinInParser::reset();
+  UsbOutParser::reset();
+  DinOutParser::reset();
+
+  std::vector<BenchMessage> syncIn, syncOut;
+  for (const TraceEvent& event : input) {
+    if (event.kind == TRACE_USB) {
+      feedPacket<UsbInParser, STREAM_USB_IN>(event);
+    } else if (event.kind == TRACE_DIN) {
+      Collector<STREAM_DIN_IN>::timeUs = event.timeUs;
+      DinInParser::parse(event.data[0]);
+    } else if (event.kind == TRACE_SYNC_IN && event.data[0]) {
+      syncIn.push_back({event.timeUs, 0xF8, true});
+    }
+  }
+  for (const TraceEvent& event : output) {
+    if (event.kind == TRACE_USB) {
+      feedPacket<UsbOutParser, STREAM_USB_OUT>(event);
+    } else if (event.kind == TRACE_DIN) {
+      Collector<STREAM_DIN_OUT>::timeUs = event.timeUs + DIN_BYTE_US;  // byte off the wire
+      DinOutParser::parse(event.data[0]);
+    } else if (event.kind == TRACE_SYNC_OUT && event.data[0]) {
+      syncOut.push_back({event.timeUs, 0xF8, true});
+    }
+  }
+
+  BenchPath paths[5];
+  paths[0].name = "USB -> DIN";
+  select(streams[STREAM_USB_IN], false, paths[0].inputs);
+  select(streams[STREAM_DIN_OUT], false, paths[0].outputs);
+  paths[1].name = "DIN -> USB";
+  select(streams[STREAM_DIN_IN], false, paths[1].inputs);
+  select(streams[STREAM_USB_OUT], false, paths[1].outputs);
+
+  // Clock ticks go to every output but never back to their own port
+  std::vector<BenchMessage> ticks = syncIn;
+  select(streams[STREAM_USB_IN], true, ticks);
+  select(streams[STREAM_DIN_IN], true, ticks);
+  paths[2].name = "clock -> SYNC OUT";
+  paths[2].inputs = ticks;
+  paths[2].outputs = syncOut;
+  paths[3].name = "clock -> DIN";
+  paths[3].inputs = syncIn;
+  select(streams[STREAM_USB_IN], true, paths[3].inputs);
+  select(streams[STREAM_DIN_OUT], true, paths[3].outputs);
+  paths[4].name = "clock -> USB";
+  paths[4].inputs = syncIn;
+  select(streams[STREAM_DIN_IN], true, paths[4].inputs);
+  select(streams[STREAM_USB_OUT], true, paths[4].outputs);
+
+  fprintf(report, "== %s: %s\n", profile.name, profile.description);
+  fprintf(report, "  %-16s %7s %9s %7s %9s %8s %8s %8s\n",
+          "path", "sent", "delivered", "dropped", "msg/s", "p50 us", "p99 us", "max us");
+  for (BenchPath& path : paths) reportPath(path, report);
+  fprintf(report, "  counters: merge drops %u, RX buffer full %u, TX stalls %u, scheduler drops %u, parser errors %u\n\n",
+          Stats::counters.mergeDrops, Stats::counters.rxBufferFull, Stats::counters.txStalls,
+          Stats::counters.schedulerDrops, Stats::counters.parserErrors);
+}
+
+bool Bench::run(const char* name, const SimOptions& options, FILE* report) {
+  bool all = strcmp(name, "all") == 0;
+  bool found = false;
+  for (const BenchProfile& profile : PROFILES) {
+    if (!all && strcmp(name, profile.name) != 0) continue;
+    runProfile(profile, options, report);
+    found = true;
+  }
+  return found;
+}
+
+void Bench::list(FILE* out) {
+  for (const BenchProfile& profile : PROFILES) {
+    fprintf(out, "  %-18s %s\n", profile.name, profile.description);
+  }
+}
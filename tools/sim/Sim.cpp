@@ -0,0 +1,648 @@
+/**
+ * MIDI BytePulse - Host Simulator Implementation
+ */
+
+#include <deque>
+#include <vector>
+#include "Sim.h"
+#include <Arduino.h>
+#include <PluggableUSB.h>
+#include <avr/eeprom.h>
+#include "UsbMidi.h"
+#include <AceTMI.h>
+#include "config.h"
+
+void setup();
+void loop();
+extern "C" void sim_timer1_compa_vect(void);
+
+uint64_t Sim::nowUs = 0;
+const std::vector<TraceEvent>* Sim::input = nullptr;
+size_t Sim::nextInput = 0;
+std::vector<TraceEvent>* Sim::output = nullptr;
+
+// ---------------------------------------------------------------------------
+// Virtual hardware state
+
+static bool interruptsOn = true;
+static bool inInterrupt = false;
+static bool pendingTimer = false;
+static bool pendingPinInterrupt[SIM_PIN_COUNT];
+static bool sleepEnabled = false;
+
+#define TIMER0_TICK_US 1024   // millis() overflow interrupt period at 16 MHz
+
+static uint8_t pinModes[SIM_PIN_COUNT];
+static int8_t pinInput[SIM_PIN_COUNT];      // level driven by the trace, -1 = floating
+static void (*pinISR[SIM_PIN_COUNT])();
+static int pinISRMode[SIM_PIN_COUNT];
+static uint8_t syncOutLevel = 0;
+
+static uint32_t uartByteUs = DIN_BYTE_US;
+static std::deque<uint8_t> uartRx;
+static std::deque<uint8_t> uartTx;
+static bool uartShifting = false;
+static uint64_t uartDoneUs = 0;
+static bool uartComplete = false;            // TXC1, clear at reset
+
+static std::deque<midiEventPacket_t> usbRx;
+
+#define EEPROM_WRITE_US 3400   // erase and write of one byte
+
+static uint8_t eeprom[E2END + 1];
+static uint64_t eepromBusyUntilUs = 0;
+
+static uint8_t displayRam[6];
+static bool displayChanged = false;
+
+volatile uint8_t simPortOut[SIM_PIN_COUNT];
+volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+volatile uint16_t OCR1A, OCR1B;
+volatile uint8_t GPIOR0;
+
+SimRegSREG SREG;
+SimRegUCSR1A UCSR1A;
+SimRegUCSR1B UCSR1B;
+SimRegUDR1 UDR1;
+SimRegTCNT1 TCNT1;
+
+HardwareSerial Serial(false);
+HardwareSerial Serial1(true);
+
+static void reset() {
+  interruptsOn = true;
+  inInterrupt = false;
+  pendingTimer = false;
+  sleepEnabled = false;
+  for (uint8_t i = 0; i < SIM_PIN_COUNT; i++) {
+    pendingPinInterrupt[i] = false;
+    pinModes[i] = INPUT;
+    pinInput[i] = -1;
+    pinISR[i] = nullptr;
+    simPortOut[i] = 0;
+  }
+  // Jack switches short the detect pins to ground with no cable inserted
+  pinInput[SYNC_IN_PIN] = LOW;
+  pinInput[SYNC_IN_DETECT_PIN] = LOW;
+  pinInput[SYNC_OUT_DETECT_PIN] = LOW;
+  syncOutLevel = 0;
+
+  uartByteUs = DIN_BYTE_US;
+  uartRx.clear();
+  uartTx.clear();
+  uartShifting = false;
+  uartComplete = false;
+  usbRx.clear();
+  memset(eeprom, 0xFF, sizeof(eeprom));
+  eepromBusyUntilUs = 0;
+  memset(displayRam, 0, sizeof(displayRam));
+  displayChanged = false;
+  TCCR1A = TCCR1B = TCCR1C = TIMSK1 = TIFR1 = 0;
+  OCR1A = OCR1B = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Timer1
+
+static uint32_t timer1Prescaler() {
+  switch (TCCR1B & 0x07) {
+    case 1: return 1;
+    case 2: return 8;
+    case 3: return 64;
+    case 4: return 256;
+    case 5: return 1024;
+    default: return 0;
+  }
+}
+
+// Counts since power-up at 16 MHz / prescaler
+static uint64_t timer1Counts(uint64_t timeUs) {
+  return timeUs * 16 / timer1Prescaler();
+}
+
+static uint64_t timer1MatchTime() {
+  uint32_t prescaler = timer1Prescaler();
+  if (prescaler == 0 || !(TIMSK1 & _BV(OCIE1A))) return UINT64_MAX;
+
+  uint64_t counts = timer1Counts(Sim::now());
+  uint32_t delta = (uint16_t)(OCR1A - (uint16_t)counts);
+  if (delta == 0) delta = 65536;
+  uint64_t match = counts + delta;
+  return (match * prescaler + 15) / 16;
+}
+
+SimRegTCNT1::operator uint16_t() const {
+  if (timer1Prescaler() == 0) return 0;
+  return (uint16_t)timer1Counts(Sim::now());
+}
+
+// ---------------------------------------------------------------------------
+// Interrupts
+
+static void enterInterrupt(void (*handler)()) {
+  interruptsOn = false;
+  inInterrupt = true;
+  handler();
+  inInterrupt = false;
+  interruptsOn = true;
+  Sim::checkPins();
+}
+
+static void timerInterrupt() {
+  sim_timer1_compa_vect();
+}
+
+void Sim::runPendingInterrupts() {
+  while (interruptsOn && !inInterrupt) {
+    // External interrupts sit ahead of Timer1 in the AVR vector table
+    int pin = -1;
+    for (uint8_t i = 0; i < SIM_PIN_COUNT; i++) {
+      if (pendingPinInterrupt[i]) {
+        pin = i;
+        break;
+      }
+    }
+    if (pin >= 0) {
+      pendingPinInterrupt[pin] = false;
+      if (pinISR[pin]) enterInterrupt(pinISR[pin]);
+    } else if (pendingTimer) {
+      // A compare flag left over after the interrupt was masked is not serviced
+      pendingTimer = false;
+      if (TIMSK1 & _BV(OCIE1A)) enterInterrupt(timerInterrupt);
+    } else {
+      break;
+    }
+  }
+}
+
+void noInterrupts() {
+  interruptsOn = false;
+}
+
+void interrupts() {
+  interruptsOn = true;
+  Sim::runPendingInterrupts();
+}
+
+SimRegSREG::operator uint8_t() const {
+  return interruptsOn ? 0x80 : 0x00;
+}
+
+SimRegSREG& SimRegSREG::operator=(uint8_t value) {
+  interruptsOn = value & 0x80;
+  Sim::runPendingInterrupts();
+  return *this;
+}
+
+// ---------------------------------------------------------------------------
+// Pins
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < SIM_PIN_COUNT) pinModes[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin >= SIM_PIN_COUNT) return;
+  simPortOut[pin] = value ? 1 : 0;
+  Sim::checkPins();
+}
+
+int digitalRead(uint8_t pin) {
+  if (pin >= SIM_PIN_COUNT) return LOW;
+  if (pinModes[pin] == OUTPUT) return simPortOut[pin] & 1;
+  if (pinInput[pin] >= 0) return pinInput[pin];
+  return pinModes[pin] == INPUT_PULLUP ? HIGH : LOW;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode) {
+  if (interrupt >= SIM_PIN_COUNT) return;
+  pinISR[interrupt] = isr;
+  pinISRMode[interrupt] = mode;
+}
+
+static void drivePin(uint8_t pin, int level) {
+  int previous = digitalRead(pin);
+  pinInput[pin] = level;
+  if (!pinISR[pin] || previous == level) return;
+
+  int mode = pinISRMode[pin];
+  if (mode == CHANGE || (mode == RISING && level == HIGH) || (mode == FALLING && level == LOW)) {
+    pendingPinInterrupt[pin] = true;
+    Sim::runPendingInterrupts();
+  }
+}
+
+void Sim::checkPins() {
+  uint8_t level = simPortOut[SYNC_OUT_PIN] & 1;
+  if (level != syncOutLevel) {
+    syncOutLevel = level;
+    emit(TRACE_SYNC_OUT, &level, 1);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Time
+
+unsigned long micros() {
+  return Sim::now();
+}
+
+unsigned long millis() {
+  return Sim::now() / 1000;
+}
+
+void delay(unsigned long ms) {
+  Sim::advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  Sim::advance(us);
+}
+
+// ---------------------------------------------------------------------------
+// DIN MIDI UART
+
+static void uartStart(uint8_t data) {
+  uartShifting = true;
+  uartComplete = false;
+  uartDoneUs = Sim::now() + uartByteUs;
+  Sim::emit(TRACE_DIN, &data, 1);
+}
+
+static void uartShifted() {
+  uartShifting = false;
+  if (!uartTx.empty()) {
+    uint8_t data = uartTx.front();
+    uartTx.pop_front();
+    uartStart(data);
+  } else {
+    uartComplete = true;
+  }
+}
+
+SimRegUCSR1A::operator uint8_t() const {
+  uint8_t value = 0;
+  if (uartTx.empty()) value |= _BV(UDRE1);
+  if (uartComplete) value |= _BV(TXC1);
+  return value;
+}
+
+SimRegUCSR1A& SimRegUCSR1A::operator=(uint8_t value) {
+  if (value & _BV(TXC1)) uartComplete = false;
+  return *this;
+}
+
+SimRegUCSR1A& SimRegUCSR1A::operator|=(uint8_t value) {
+  return *this = (uint8_t)(*this | value);
+}
+
+SimRegUCSR1B::operator uint8_t() const {
+  // HardwareSerial keeps the data register empty interrupt on while it has bytes queued
+  return uartTx.empty() ? 0 : _BV(UDRIE1);
+}
+
+SimRegUDR1& SimRegUDR1::operator=(uint8_t value) {
+  if (uartShifting) {
+    uartTx.push_front(value);
+  } else {
+    uartStart(value);
+  }
+  return *this;
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+  if (uart && baud > 0) uartByteUs = 10000000UL / baud;
+}
+
+int HardwareSerial::available() {
+  return uart ? uartRx.size() : 0;
+}
+
+int HardwareSerial::read() {
+  if (!uart || uartRx.empty()) return -1;
+  uint8_t data = uartRx.front();
+  uartRx.pop_front();
+  return data;
+}
+
+int HardwareSerial::peek() {
+  if (!uart || uartRx.empty()) return -1;
+  return uartRx.front();
+}
+
+int HardwareSerial::availableForWrite() {
+  if (!uart) return SERIAL_TX_BUFFER_SIZE - 1;
+  return (SERIAL_TX_BUFFER_SIZE - 1) - (int)uartTx.size();
+}
+
+size_t HardwareSerial::write(uint8_t data) {
+  if (!uart) return 1;
+  if (!uartShifting && uartTx.empty()) {
+    uartStart(data);
+    return 1;
+  }
+  // Arduino's write() spins until the interrupt handler makes room
+  while (uartTx.size() >= SERIAL_TX_BUFFER_SIZE - 1) {
+    Sim::advance(uartDoneUs - Sim::now());
+  }
+  uartTx.push_back(data);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length; i++) write(data[i]);
+  return length;
+}
+
+void HardwareSerial::flush() {
+  while (uart && (uartShifting || !uartTx.empty())) {
+    Sim::advance(uartDoneUs - Sim::now());
+  }
+}
+
+size_t Print::print(const char* text) { return strlen(text); }
+size_t Print::print(long value) { return 0; }
+size_t Print::println(const char* text) { return strlen(text) + 2; }
+size_t Print::println(long value) { return 2; }
+size_t Print::println() { return 2; }
+
+// ---------------------------------------------------------------------------
+// USB core
+
+static uint8_t usbMidiOut = 0;   // endpoints of the interface that has an OUT endpoint
+static uint8_t usbMidiIn = 0;
+
+PluggableUSB_& PluggableUSB() {
+  static PluggableUSB_ instance;
+  return instance;
+}
+
+bool PluggableUSB_::plug(PluggableUSBModule* module) {
+  static uint8_t nextInterface = 0;
+  static uint8_t nextEndpoint = 1;
+  module->pluggedInterface = nextInterface;
+  module->pluggedEndpoint = nextEndpoint;
+
+  uint8_t out = 0, in = 0;
+  for (uint8_t i = 0; i < module->numEndpoints; i++) {
+    if (module->endpointType[i] == EP_TYPE_BULK_OUT && !out) out = nextEndpoint + i;
+    if (module->endpointType[i] == EP_TYPE_BULK_IN && !in) in = nextEndpoint + i;
+  }
+  if (out) {
+    usbMidiOut = out;
+    usbMidiIn = in;
+  }
+
+  nextInterface += module->numInterfaces;
+  nextEndpoint += module->numEndpoints;
+  return true;
+}
+
+int USB_SendControl(uint8_t flags, const void* data, int length) {
+  return length;
+}
+
+uint8_t USB_Available(uint8_t ep) {
+  if (ep != usbMidiOut) return 0;
+  return usbRx.size() < USB_EP_SIZE / 4 ? usbRx.size() * 4 : USB_EP_SIZE;
+}
+
+int USB_Recv(uint8_t ep, void* data, int length) {
+  uint8_t* bytes = (uint8_t*)data;
+  int received = 0;
+  for (; ep == usbMidiOut && received + 4 <= length && !usbRx.empty(); received += 4) {
+    const midiEventPacket_t& packet = usbRx.front();
+    bytes[received] = packet.header;
+    bytes[received + 1] = packet.byte1;
+    bytes[received + 2] = packet.byte2;
+    bytes[received + 3] = packet.byte3;
+    usbRx.pop_front();
+  }
+  return received;
+}
+
+uint8_t USB_SendSpace(uint8_t ep) {
+  return USB_EP_SIZE;   // the virtual host drains every packet at once
+}
+
+int USB_Send(uint8_t ep, const void* data, int length) {
+  for (int i = 0; ep == usbMidiIn && i + 4 <= length; i += 4) {
+    Sim::emit(TRACE_USB, (const uint8_t*)data + i, 4);
+  }
+  return length;
+}
+
+void USB_Flush(uint8_t ep) {}
+
+// ---------------------------------------------------------------------------
+// EEPROM
+
+uint8_t eeprom_read_byte(const uint8_t* address) {
+  return eeprom[(uintptr_t)address & E2END];
+}
+
+uint16_t eeprom_read_word(const uint16_t* address) {
+  uintptr_t offset = (uintptr_t)address;
+  return eeprom[offset & E2END] | (eeprom[(offset + 1) & E2END] << 8);
+}
+
+void eeprom_read_block(void* destination, const void* source, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    ((uint8_t*)destination)[i] = eeprom[((uintptr_t)source + i) & E2END];
+  }
+}
+
+void eeprom_update_byte(uint8_t* address, uint8_t value) {
+  // Like avr-libc, bytes that already match are not programmed again
+  uint8_t& cell = eeprom[(uintptr_t)address & E2END];
+  if (cell == value) return;
+  cell = value;
+  eepromBusyUntilUs = Sim::now() + EEPROM_WRITE_US;
+}
+
+bool eeprom_is_ready() {
+  return Sim::now() >= eepromBusyUntilUs;
+}
+
+// ---------------------------------------------------------------------------
+// TM1637
+
+namespace ace_tmi {
+
+void SimpleTmi1637Interface::startCondition() {
+  Sim::advance(2 * delayMicros);
+  bytesInFrame = 0;
+}
+
+void SimpleTmi1637Interface::stopCondition() {
+  Sim::advance(2 * delayMicros);
+  Sim::displayLatch();
+}
+
+uint8_t SimpleTmi1637Interface::write(uint8_t data) {
+  // 8 data bits and the ack, each a low and a high clock phase
+  Sim::advance(18 * delayMicros);
+
+  if (bytesInFrame++ == 0) {
+    if ((data & 0xC0) == 0x40) {
+      autoIncrement = !(data & 0x04);
+    } else if ((data & 0xC0) == 0xC0) {
+      address = data & 0x0F;
+    }
+    return 0;
+  }
+
+  Sim::displayWrite(address, data);
+  if (autoIncrement) address++;
+  return 0;
+}
+
+}
+
+void Sim::displayWrite(uint8_t digit, uint8_t pattern) {
+  if (digit >= sizeof(displayRam) || displayRam[digit] == pattern) return;
+  displayRam[digit] = pattern;
+  displayChanged = true;
+}
+
+void Sim::displayLatch() {
+  if (!displayChanged) return;
+  displayChanged = false;
+  emit(TRACE_DISPLAY, displayRam, 4);
+}
+
+// ---------------------------------------------------------------------------
+// Idle sleep
+
+void Sim::setSleepEnabled(bool enabled) {
+  sleepEnabled = enabled;
+}
+
+void Sim::sleep() {
+  if (!sleepEnabled) return;
+
+  // The Timer0 overflow (millis) wakes the CPU every 1024 us at the latest
+  uint64_t wakeUs = (nowUs / TIMER0_TICK_US + 1) * TIMER0_TICK_US;
+  uint64_t matchUs = timer1MatchTime();
+  if (matchUs < wakeUs) wakeUs = matchUs;
+  if (uartShifting && !uartTx.empty() && uartDoneUs < wakeUs) wakeUs = uartDoneUs;
+
+  // DIN bytes and SYNC IN edges interrupt; USB OUT packets and polled pins don't
+  for (size_t i = nextInput; i < input->size() && (*input)[i].timeUs < wakeUs; i++) {
+    uint8_t kind = (*input)[i].kind;
+    if (kind == TRACE_DIN || kind == TRACE_SYNC_IN) {
+      wakeUs = (*input)[i].timeUs;
+      break;
+    }
+  }
+
+  advanceTo(wakeUs);
+}
+
+void simSetSleepEnabled(bool enabled) {
+  Sim::setSleepEnabled(enabled);
+}
+
+void simSleep() {
+  Sim::sleep();
+}
+
+// ---------------------------------------------------------------------------
+// Event loop
+
+void Sim::emit(uint8_t kind, const uint8_t* data, uint8_t length) {
+  if (output) output->push_back(Trace::event(nowUs, kind, data, length));
+}
+
+void Sim::applyInput(const TraceEvent& event) {
+  switch (event.kind) {
+    case TRACE_USB: {
+      midiEventPacket_t packet = {event.data[0], event.data[1], event.data[2], event.data[3]};
+      usbRx.push_back(packet);
+      break;
+    }
+    case TRACE_DIN:
+      // HardwareSerial drops bytes once its ring buffer is full
+      if (uartRx.size() < SERIAL_RX_BUFFER_SIZE - 1) uartRx.push_back(event.data[0]);
+      break;
+    case TRACE_SYNC_IN:
+      drivePin(SYNC_IN_PIN, event.data[0] ? HIGH : LOW);
+      break;
+    case TRACE_JACK_IN:
+      drivePin(SYNC_IN_DETECT_PIN, event.data[0] ? HIGH : LOW);
+      break;
+    case TRACE_JACK_OUT:
+      drivePin(SYNC_OUT_DETECT_PIN, event.data[0] ? HIGH : LOW);
+      break;
+    case TRACE_BUTTON:
+      drivePin(BUTTON_PIN, event.data[0] ? LOW : HIGH);
+      break;
+  }
+}
+
+uint64_t Sim::nextEventTime() {
+  uint64_t next = UINT64_MAX;
+  if (uartShifting) next = uartDoneUs;
+  if (nextInput < input->size() && (*input)[nextInput].timeUs < next) {
+    next = (*input)[nextInput].timeUs;
+  }
+  return next;
+}
+
+void Sim::advanceTo(uint64_t targetUs) {
+  checkPins();
+
+  while (true) {
+    // The compare match has to be worked out before time moves onto it
+    uint64_t matchUs = timer1MatchTime();
+    uint64_t next = nextEventTime();
+    if (matchUs < next) next = matchUs;
+    if (next > targetUs) break;
+    if (next > nowUs) nowUs = next;
+
+    if (uartShifting && uartDoneUs <= nowUs) {
+      uartShifted();
+    }
+    while (nextInput < input->size() && (*input)[nextInput].timeUs <= nowUs) {
+      applyInput((*input)[nextInput++]);
+    }
+    if (matchUs <= nowUs) {
+      pendingTimer = true;
+      runPendingInterrupts();
+    }
+  }
+
+  if (targetUs > nowUs) nowUs = targetUs;
+}
+
+void Sim::advance(uint64_t us) {
+  advanceTo(nowUs + us);
+}
+
+void Sim::run(const std::vector<TraceEvent>& events, const SimOptions& options,
+              std::vector<TraceEvent>& out) {
+  reset();
+  nowUs = 0;
+  input = &events;
+  nextInput = 0;
+  output = &out;
+
+  uint64_t endUs = options.tailUs;
+  for (const TraceEvent& event : events) {
+    if (event.kind == TRACE_END) {
+      endUs = event.timeUs;
+      break;
+    }
+    endUs = event.timeUs + options.tailUs;
+  }
+
+  setup();
+  while (nowUs < endUs) {
+    loop();
+    checkPins();
+    advanceTo(nowUs + options.loopUs);
+  }
+
+  output = nullptr;
+  input = nullptr;
+}
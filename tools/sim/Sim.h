@@ -0,0 +1,53 @@
+/**
+ * MIDI BytePulse - Host Simulator
+ *
+ * Runs the firmware's setup()/loop() against virtual hardware. Time only
+ * moves when the simulator moves it: each loop pass costs a fixed number of
+ * microseconds, and blocking calls (display bus writes, a full TX buffer,
+ * delay()) advance the clock while the firmware waits. Input events and
+ * Timer1 compare matches fire at their exact time, running the firmware's
+ * interrupt handlers unless interrupts are disabled, in which case they are
+ * held until the firmware re-enables them. Idle sleep skips ahead to the
+ * next event that would raise an interrupt on the real board.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <vector>
+#include "Trace.h"
+
+struct SimOptions {
+  uint32_t loopUs = 20;        // virtual cost of one loop() pass
+  uint32_t tailUs = 100000;    // keep running after the last input event
+};
+
+class Sim {
+public:
+  static void run(const std::vector<TraceEvent>& input, const SimOptions& options,
+                  std::vector<TraceEvent>& output);
+
+  // Hooks for the hardware shims
+  static uint64_t now() { return nowUs; }
+  static void advance(uint64_t us);
+  static void emit(uint8_t kind, const uint8_t* data, uint8_t length);
+  static void checkPins();
+  static void runPendingInterrupts();
+  static void displayWrite(uint8_t digit, uint8_t pattern);
+  static void displayLatch();
+  static void setSleepEnabled(bool enabled);
+  static void sleep();
+
+private:
+  static uint64_t nowUs;
+  static const std::vector<TraceEvent>* input;
+  static size_t nextInput;
+  static std::vector<TraceEvent>* output;
+
+  static void advanceTo(uint64_t targetUs);
+  static uint64_t nextEventTime();
+  static void applyInput(const TraceEvent& event);
+};
+
+#endif
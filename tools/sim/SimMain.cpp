@@ -0,0 +1,126 @@
+/**
+ * MIDI BytePulse - Trace Replay Tool
+ *
+ * Usage: bytepulse-sim [options] <trace>
+ *        bytepulse-sim --bench <profile|all|list> [--loop-us us] [--tail-ms ms]
+ *   -o <file>           write the output timeline to a file (default stdout)
+ *   --golden <file>     diff the output against a golden run, exit 1 on differences
+ *   --tolerance <us>    allowed timing difference per event (default 0)
+ *   --loop-us <us>      virtual time one loop() pass takes (default 20)
+ *   --tail-ms <ms>      keep running after the last input event (default 100)
+ *   --smf-din           Standard MIDI File events arrive on DIN IN instead of USB
+ *   --smf-clock         add 24 PPQN clock, Start and Stop to a Standard MIDI File
+ *   --dump              print the parsed input timeline and exit
+ *   --bench <profile>   run a throughput / latency profile instead of a trace
+ *                       (tail defaults to 3000 ms so queued traffic drains)
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "Sim.h"
+#include "Trace.h"
+#include "Bench.h"
+
+static int usage() {
+  fprintf(stderr,
+          "usage: bytepulse-sim [-o out] [--golden file] [--tolerance us] [--loop-us us]\n"
+          "                     [--tail-ms ms] [--smf-din] [--smf-clock] [--dump] <trace>\n"
+          "       bytepulse-sim --bench <profile|all|list> [--loop-us us] [--tail-ms ms]\n");
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  SimOptions simOptions;
+  TraceOptions traceOptions;
+  const char* tracePath = nullptr;
+  const char* outputPath = nullptr;
+  const char* goldenPath = nullptr;
+  const char* benchProfile = nullptr;
+  bool tailGiven = false;
+  uint32_t toleranceUs = 0;
+  bool dump = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = (i + 1 < argc);
+    if (arg == "-o" && hasValue) {
+      outputPath = argv[++i];
+    } else if (arg == "--golden" && hasValue) {
+      goldenPath = argv[++i];
+    } else if (arg == "--tolerance" && hasValue) {
+      toleranceUs = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--loop-us" && hasValue) {
+      simOptions.loopUs = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--tail-ms" && hasValue) {
+      simOptions.tailUs = strtoul(argv[++i], nullptr, 10) * 1000;
+      tailGiven = true;
+    } else if (arg == "--smf-din") {
+      traceOptions.smfToUSB = false;
+    } else if (arg == "--smf-clock") {
+      traceOptions.smfClock = true;
+    } else if (arg == "--dump") {
+      dump = true;
+    } else if (arg == "--bench" && hasValue) {
+      benchProfile = argv[++i];
+    } else if (arg[0] != '-' && !tracePath) {
+      tracePath = argv[i];
+    } else {
+      return usage();
+    }
+  }
+  if (simOptions.loopUs == 0) return usage();
+
+  if (benchProfile) {
+    if (strcmp(benchProfile, "list") == 0) {
+      Bench::list(stdout);
+      return 0;
+    }
+    if (!tailGiven) simOptions.tailUs = 3000000;
+    if (!Bench::run(benchProfile, simOptions, stdout)) {
+      fprintf(stderr, "no bench profile named %s; profiles:\n", benchProfile);
+      Bench::list(stderr);
+      return 2;
+    }
+    return 0;
+  }
+
+  if (!tracePath) return usage();
+
+  std::vector<TraceEvent> input;
+  std::string error;
+  if (!Trace::load(tracePath, traceOptions, input, error)) {
+    fprintf(stderr, "%s: %s\n", tracePath, error.c_str());
+    return 2;
+  }
+  if (dump) {
+    Trace::write(stdout, input);
+    return 0;
+  }
+
+  std::vector<TraceEvent> output;
+  Sim::run(input, simOptions, output);
+
+  FILE* out = outputPath ? fopen(outputPath, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "cannot write %s\n", outputPath);
+    return 2;
+  }
+  Trace::write(out, output);
+  if (outputPath) fclose(out);
+
+  if (goldenPath) {
+    std::vector<TraceEvent> golden;
+    if (!Trace::load(goldenPath, traceOptions, golden, error)) {
+      fprintf(stderr, "%s: %s\n", goldenPath, error.c_str());
+      return 2;
+    }
+    int problems = Trace::diff(output, golden, toleranceUs, stderr);
+    if (problems) {
+      fprintf(stderr, "%d difference(s) against %s\n", problems, goldenPath);
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,461 @@
+/**
+ * MIDI BytePulse - Simulator Timelines Implementation
+ */
+
+#include <algorithm>
+#include <sstream>
+#include "Trace.h"
+#include "Display.h"
+
+static const char* const KIND_NAMES[TRACE_KIND_COUNT] = {
+  "usb", "din", "sync", "jack-in", "jack-out", "button", "end", "syncout", "disp"
+};
+
+// Payload length per kind; DIN lines may carry several bytes on input
+static const uint8_t KIND_LENGTHS[TRACE_KIND_COUNT] = {4, 1, 1, 1, 1, 1, 0, 1, 4};
+
+TraceEvent Trace::event(uint64_t timeUs, uint8_t kind, const uint8_t* data, uint8_t length) {
+  TraceEvent e;
+  e.timeUs = timeUs;
+  e.kind = kind;
+  e.length = length;
+  memset(e.data, 0, sizeof(e.data));
+  memcpy(e.data, data, length);
+  return e;
+}
+
+static bool readFile(const char* path, std::vector<uint8_t>& bytes) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return false;
+  uint8_t buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    bytes.insert(bytes.end(), buffer, buffer + n);
+  }
+  fclose(file);
+  return true;
+}
+
+bool Trace::load(const char* path, const TraceOptions& options,
+                 std::vector<TraceEvent>& events, std::string& error) {
+  std::vector<uint8_t> bytes;
+  if (!readFile(path, bytes)) {
+    error = std::string("cannot read ") + path;
+    return false;
+  }
+
+  bool ok;
+  if (bytes.size() >= 4 && memcmp(bytes.data(), "MThd", 4) == 0) {
+    ok = loadSMF(bytes, options, events, error);
+  } else if (bytes.size() >= 4 && memcmp(bytes.data(), "BPTR", 4) == 0) {
+    ok = loadBinary(bytes, events, error);
+  } else {
+    ok = loadText(bytes, events, error);
+  }
+
+  std::stable_sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) {
+    return a.timeUs < b.timeUs;
+  });
+  return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Text traces
+
+static int kindByName(const std::string& name) {
+  for (int kind = 0; kind < TRACE_KIND_COUNT; kind++) {
+    if (name == KIND_NAMES[kind]) return kind;
+  }
+  return -1;
+}
+
+static bool parseNumber(const std::string& token, uint64_t& value, int base = 10) {
+  if (token.empty()) return false;
+  char* end = nullptr;
+  value = strtoull(token.c_str(), &end, base);
+  return *end == '\0';
+}
+
+bool Trace::parseLine(const std::string& line, std::vector<TraceEvent>& events, std::string& error) {
+  // Anything from a quote on is annotation (display text in outputs)
+  std::string body = line.substr(0, line.find_first_of("#\""));
+  std::istringstream in(body);
+  std::vector<std::string> tokens;
+  std::string token;
+  while (in >> token) tokens.push_back(token);
+  if (tokens.empty()) return true;
+
+  uint64_t timeUs;
+  if (!parseNumber(tokens[0], timeUs)) {
+    error = "bad timestamp '" + tokens[0] + "'";
+    return false;
+  }
+
+  uint64_t periodUs = 0, repeat = 1;
+  size_t first = 1;
+  if (tokens.size() > 3 && tokens[1] == "every") {
+    if (!parseNumber(tokens[2], periodUs) || !parseNumber(tokens[3], repeat)) {
+      error = "bad 'every <us> <count>'";
+      return false;
+    }
+    first = 4;
+  }
+  if (first >= tokens.size()) {
+    error = "missing event";
+    return false;
+  }
+
+  int kind = kindByName(tokens[first]);
+  if (kind < 0) {
+    error = "unknown event '" + tokens[first] + "'";
+    return false;
+  }
+
+  bool hex = (kind == TRACE_USB || kind == TRACE_DIN || kind == TRACE_DISPLAY);
+  std::vector<uint8_t> data;
+  for (size_t i = first + 1; i < tokens.size(); i++) {
+    uint64_t value;
+    if (!parseNumber(tokens[i], value, hex ? 16 : 10) || value > 0xFF) {
+      error = "bad byte '" + tokens[i] + "'";
+      return false;
+    }
+    data.push_back((uint8_t)value);
+  }
+
+  size_t length = KIND_LENGTHS[kind];
+  bool valid = (kind == TRACE_DIN) ? !data.empty() : data.size() == length;
+  if (!valid) {
+    error = std::string("'") + KIND_NAMES[kind] + "' takes " + std::to_string(length) + " value(s)";
+    return false;
+  }
+
+  for (uint64_t n = 0; n < repeat; n++) {
+    uint64_t t = timeUs + n * periodUs;
+    if (kind == TRACE_DIN) {
+      for (size_t i = 0; i < data.size(); i++) {
+        events.push_back(event(t + i * DIN_BYTE_US, kind, &data[i], 1));
+      }
+    } else {
+      events.push_back(event(t, kind, data.data(), length));
+    }
+  }
+  return true;
+}
+
+bool Trace::loadText(const std::vector<uint8_t>& bytes, std::vector<TraceEvent>& events, std::string& error) {
+  std::istringstream in(std::string(bytes.begin(), bytes.end()));
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(in, line)) {
+    lineNumber++;
+    if (!parseLine(line, events, error)) {
+      error = "line " + std::to_string(lineNumber) + ": " + error;
+      return false;
+    }
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Binary captures
+
+bool Trace::loadBinary(const std::vector<uint8_t>& bytes, std::vector<TraceEvent>& events, std::string& error) {
+  if (bytes.size() < 8 || bytes[4] != 1) {
+    error = "unsupported binary trace version";
+    return false;
+  }
+
+  size_t pos = 8;
+  while (pos + 6 <= bytes.size()) {
+    uint32_t timeUs = bytes[pos] | (bytes[pos + 1] << 8) | (bytes[pos + 2] << 16) | ((uint32_t)bytes[pos + 3] << 24);
+    uint8_t kind = bytes[pos + 4];
+    uint8_t length = bytes[pos + 5];
+    pos += 6;
+    if (kind >= TRACE_KIND_COUNT || length > 4 || pos + length > bytes.size()) {
+      error = "corrupt record at offset " + std::to_string(pos - 6);
+      return false;
+    }
+    events.push_back(event(timeUs, kind, &bytes[pos], length));
+    pos += length;
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Standard MIDI Files
+
+struct SmfMessage {
+  double tick;
+  std::vector<uint8_t> bytes;
+};
+
+struct SmfTempo {
+  uint32_t tick;
+  uint32_t usPerQuarter;
+};
+
+static uint32_t readBE(const std::vector<uint8_t>& bytes, size_t pos, int count) {
+  uint32_t value = 0;
+  for (int i = 0; i < count; i++) value = (value << 8) | bytes[pos + i];
+  return value;
+}
+
+static bool readVarLen(const std::vector<uint8_t>& bytes, size_t& pos, size_t end, uint32_t& value) {
+  value = 0;
+  for (int i = 0; i < 4; i++) {
+    if (pos >= end) return false;
+    uint8_t b = bytes[pos++];
+    value = (value << 7) | (b & 0x7F);
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+static uint8_t channelMessageLength(uint8_t status) {
+  uint8_t type = status & 0xF0;
+  return (type == 0xC0 || type == 0xD0) ? 2 : 3;
+}
+
+void Trace::addMessage(std::vector<TraceEvent>& events, uint64_t timeUs, bool usb,
+                       const uint8_t* message, size_t length, uint8_t cable) {
+  if (!usb) {
+    for (size_t i = 0; i < length; i++) {
+      events.push_back(event(timeUs + i * DIN_BYTE_US, TRACE_DIN, &message[i], 1));
+    }
+    return;
+  }
+
+  uint8_t status = message[0];
+  uint8_t packet[4] = {0, 0, 0, 0};
+  if (status == 0xF0) {
+    // SysEx: CIN 4 for each full chunk, CIN 5-7 for the one holding F7
+    for (size_t i = 0; i < length; i += 3) {
+      size_t chunk = length - i < 3 ? length - i : 3;
+      bool last = (i + chunk >= length);
+      packet[0] = (cable << 4) | (last ? 0x04 + chunk : 0x04);
+      memset(packet + 1, 0, 3);
+      memcpy(packet + 1, message + i, chunk);
+      events.push_back(event(timeUs, TRACE_USB, packet, 4));
+    }
+    return;
+  }
+
+  if (status >= 0xF8 || status == 0xF6) {
+    packet[0] = (status >= 0xF8) ? 0x0F : 0x05;
+  } else if (status == 0xF1 || status == 0xF3) {
+    packet[0] = 0x02;
+  } else if (status == 0xF2) {
+    packet[0] = 0x03;
+  } else {
+    packet[0] = status >> 4;
+  }
+  packet[0] |= cable << 4;
+  memcpy(packet + 1, message, length < 3 ? length : 3);
+  events.push_back(event(timeUs, TRACE_USB, packet, 4));
+}
+
+bool Trace::loadSMF(const std::vector<uint8_t>& bytes, const TraceOptions& options,
+                    std::vector<TraceEvent>& events, std::string& error) {
+  if (bytes.size() < 14 || readBE(bytes, 4, 4) < 6) {
+    error = "truncated MThd";
+    return false;
+  }
+  uint16_t trackCount = readBE(bytes, 10, 2);
+  uint16_t division = readBE(bytes, 12, 2);
+  bool smpte = division & 0x8000;
+  double ticksPerSecond = smpte ? (double)(-(int8_t)(division >> 8)) * (division & 0xFF) : 0;
+  if (!smpte && division == 0) {
+    error = "zero ticks per quarter note";
+    return false;
+  }
+
+  std::vector<SmfMessage> messages;
+  std::vector<SmfTempo> tempos;
+  uint32_t lastTick = 0;
+  size_t pos = 8 + readBE(bytes, 4, 4);
+
+  for (uint16_t track = 0; track < trackCount && pos + 8 <= bytes.size(); track++) {
+    if (memcmp(&bytes[pos], "MTrk", 4) != 0) {
+      error = "missing MTrk";
+      return false;
+    }
+    size_t end = pos + 8 + readBE(bytes, pos + 4, 4);
+    if (end > bytes.size()) {
+      error = "truncated MTrk";
+      return false;
+    }
+    pos += 8;
+
+    uint32_t tick = 0;
+    uint8_t runningStatus = 0;
+    while (pos < end) {
+      uint32_t delta, length;
+      if (!readVarLen(bytes, pos, end, delta) || pos >= end) {
+        error = "bad delta time";
+        return false;
+      }
+      tick += delta;
+
+      uint8_t status = bytes[pos];
+      if (status == 0xFF) {
+        if (pos + 2 > end) break;
+        uint8_t type = bytes[pos + 1];
+        pos += 2;
+        if (!readVarLen(bytes, pos, end, length) || pos + length > end) break;
+        if (type == 0x51 && length == 3) {
+          tempos.push_back({tick, readBE(bytes, pos, 3)});
+        }
+        pos += length;
+      } else if (status == 0xF0 || status == 0xF7) {
+        pos++;
+        if (!readVarLen(bytes, pos, end, length) || pos + length > end) break;
+        SmfMessage m = {(double)tick, {}};
+        if (status == 0xF0) m.bytes.push_back(0xF0);
+        m.bytes.insert(m.bytes.end(), bytes.begin() + pos, bytes.begin() + pos + length);
+        messages.push_back(m);
+        pos += length;
+      } else {
+        if (status & 0x80) {
+          runningStatus = status;
+          pos++;
+        } else if (!runningStatus) {
+          error = "data byte without status";
+          return false;
+        }
+        uint8_t length = channelMessageLength(runningStatus);
+        if (pos + length - 1 > end) break;
+        SmfMessage m = {(double)tick, {runningStatus}};
+        m.bytes.insert(m.bytes.end(), bytes.begin() + pos, bytes.begin() + pos + length - 1);
+        messages.push_back(m);
+        pos += length - 1;
+      }
+      if (tick > lastTick) lastTick = tick;
+    }
+    pos = end;
+  }
+
+  std::stable_sort(tempos.begin(), tempos.end(), [](const SmfTempo& a, const SmfTempo& b) {
+    return a.tick < b.tick;
+  });
+
+  auto tickToUs = [&](double tick) -> uint64_t {
+    if (smpte) return (uint64_t)(tick * 1000000.0 / ticksPerSecond);
+    double us = 0, fromTick = 0, usPerQuarter = 500000;
+    for (const SmfTempo& tempo : tempos) {
+      if (tempo.tick >= tick) break;
+      us += (tempo.tick - fromTick) * usPerQuarter / division;
+      fromTick = tempo.tick;
+      usPerQuarter = tempo.usPerQuarter;
+    }
+    return (uint64_t)(us + (tick - fromTick) * usPerQuarter / division);
+  };
+
+  // Clock goes ahead of anything else on the same tick, as sequencers send it
+  std::vector<SmfMessage> timeline;
+  if (options.smfClock && !smpte) {
+    timeline.push_back({0, {0xFA}});
+    double step = division / 24.0;
+    for (double tick = 0; tick <= lastTick; tick += step) {
+      timeline.push_back({tick, {0xF8}});
+    }
+  }
+  timeline.insert(timeline.end(), messages.begin(), messages.end());
+  if (options.smfClock && !smpte) {
+    timeline.push_back({(double)lastTick, {0xFC}});
+  }
+  std::stable_sort(timeline.begin(), timeline.end(), [](const SmfMessage& a, const SmfMessage& b) {
+    return a.tick < b.tick;
+  });
+
+  // One DIN wire: a message starts once the previous one is out
+  uint64_t dinFreeUs = 0;
+  for (const SmfMessage& m : timeline) {
+    uint64_t timeUs = tickToUs(m.tick);
+    if (!options.smfToUSB) {
+      if (timeUs < dinFreeUs) timeUs = dinFreeUs;
+      dinFreeUs = timeUs + m.bytes.size() * DIN_BYTE_US;
+    }
+    addMessage(events, timeUs, options.smfToUSB, m.bytes.data(), m.bytes.size());
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Output
+
+static void displayText(const uint8_t* patterns, char* text) {
+  static const char CHARSET[] = "0123456789AbCdEFGHJLnoPtUY-_";
+  char* p = text;
+  for (uint8_t i = 0; i < 4; i++) {
+    uint8_t segments = patterns[i] & 0x7F;
+    char c = segments ? '?' : ' ';
+    for (const char* s = CHARSET; segments && *s; s++) {
+      if (Display::glyph(*s) == segments) {
+        c = *s;
+        break;
+      }
+    }
+    *p++ = c;
+    if (patterns[i] & 0x80) *p++ = '.';
+  }
+  *p = '\0';
+}
+
+void Trace::write(FILE* out, const std::vector<TraceEvent>& events) {
+  for (const TraceEvent& e : events) {
+    fprintf(out, "%llu %s", (unsigned long long)e.timeUs, KIND_NAMES[e.kind]);
+    bool hex = (e.kind == TRACE_USB || e.kind == TRACE_DIN || e.kind == TRACE_DISPLAY);
+    for (uint8_t i = 0; i < e.length; i++) {
+      fprintf(out, hex ? " %02X" : " %u", e.data[i]);
+    }
+    if (e.kind == TRACE_DISPLAY) {
+      char text[9];
+      displayText(e.data, text);
+      fprintf(out, " \"%s\"", text);
+    }
+    fputc('\n', out);
+  }
+}
+
+// Events of each kind are paired in order, so one late tick shows up as a
+// timing delta on that tick rather than as a cascade of mismatches
+int Trace::diff(const std::vector<TraceEvent>& actual, const std::vector<TraceEvent>& golden,
+                uint32_t toleranceUs, FILE* report) {
+  int problems = 0;
+
+  for (int kind = 0; kind < TRACE_KIND_COUNT; kind++) {
+    std::vector<const TraceEvent*> a, g;
+    for (const TraceEvent& e : actual) if (e.kind == kind) a.push_back(&e);
+    for (const TraceEvent& e : golden) if (e.kind == kind) g.push_back(&e);
+    if (a.empty() && g.empty()) continue;
+
+    size_t common = a.size() < g.size() ? a.size() : g.size();
+    int64_t maxDelta = 0, sumDelta = 0;
+    for (size_t i = 0; i < common; i++) {
+      if (a[i]->length != g[i]->length || memcmp(a[i]->data, g[i]->data, a[i]->length) != 0) {
+        fprintf(report, "%s #%zu at %llu: payload differs from golden at %llu\n", KIND_NAMES[kind], i,
+                (unsigned long long)a[i]->timeUs, (unsigned long long)g[i]->timeUs);
+        problems++;
+        continue;
+      }
+      int64_t delta = (int64_t)(a[i]->timeUs - g[i]->timeUs);
+      sumDelta += delta;
+      int64_t magnitude = delta < 0 ? -delta : delta;
+      if (magnitude > maxDelta) maxDelta = magnitude;
+      if (magnitude > toleranceUs) {
+        fprintf(report, "%s #%zu at %llu: %+lld us against golden\n", KIND_NAMES[kind], i,
+                (unsigned long long)a[i]->timeUs, (long long)delta);
+        problems++;
+      }
+    }
+    if (a.size() != g.size()) {
+      fprintf(report, "%s: %zu events, golden has %zu\n", KIND_NAMES[kind], a.size(), g.size());
+      problems++;
+    }
+
+    fprintf(report, "%-8s %6zu events  max |delta| %lld us  mean delta %+.1f us\n", KIND_NAMES[kind],
+            a.size(), (long long)maxDelta, common ? (double)sumDelta / common : 0.0);
+  }
+
+  return problems;
+}
@@ -0,0 +1,80 @@
+/**
+ * MIDI BytePulse - Simulator Timelines
+ *
+ * Input and output timelines are lists of timestamped events. Inputs load
+ * from a text trace, a binary capture or a Standard MIDI File; outputs are
+ * written as text in the same syntax so a run can be kept as a golden file
+ * and diffed against later runs.
+ *
+ * Text syntax, one event per line, '#' starts a comment:
+ *   <time_us> usb HH HH HH HH          USB-MIDI event packet
+ *   <time_us> din HH [HH ...]          bytes on the DIN wire, back to back
+ *   <time_us> sync 0|1                 SYNC IN level
+ *   <time_us> jack-in 0|1              SYNC IN cable inserted
+ *   <time_us> jack-out 0|1             SYNC OUT cable inserted
+ *   <time_us> button 0|1               button held
+ *   <time_us> every <us> <n> <event>   <event> n times, <us> apart
+ *   <time_us> end                      stop the run here
+ * Outputs use syncout, din, usb and disp (four segment patterns).
+ *
+ * Binary captures start with "BPTR" and a version byte, padded to 8 bytes,
+ * followed by records of <uint32 LE time_us, uint8 kind, uint8 length,
+ * length bytes>.
+ */
+
+#ifndef SIM_TRACE_H
+#define SIM_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#define DIN_BYTE_US 320   // 10 bits at 31250 baud
+
+enum TraceKind {
+  TRACE_USB = 0,
+  TRACE_DIN,
+  TRACE_SYNC_IN,
+  TRACE_JACK_IN,
+  TRACE_JACK_OUT,
+  TRACE_BUTTON,
+  TRACE_END,
+  TRACE_SYNC_OUT,
+  TRACE_DISPLAY,
+  TRACE_KIND_COUNT
+};
+
+struct TraceEvent {
+  uint64_t timeUs;
+  uint8_t kind;
+  uint8_t length;
+  uint8_t data[4];
+};
+
+struct TraceOptions {
+  bool smfToUSB = true;     // SMF events arrive over USB, otherwise on DIN IN
+  bool smfClock = false;    // add 24 PPQN clock, Start and Stop from the tempo map
+};
+
+class Trace {
+public:
+  static bool load(const char* path, const TraceOptions& options,
+                   std::vector<TraceEvent>& events, std::string& error);
+  static void write(FILE* out, const std::vector<TraceEvent>& events);
+  static int diff(const std::vector<TraceEvent>& actual, const std::vector<TraceEvent>& golden,
+                  uint32_t toleranceUs, FILE* report);
+
+  static TraceEvent event(uint64_t timeUs, uint8_t kind, const uint8_t* data, uint8_t length);
+  static void addMessage(std::vector<TraceEvent>& events, uint64_t timeUs, bool usb,
+                         const uint8_t* message, size_t length, uint8_t cable = 0);
+
+private:
+  static bool loadText(const std::vector<uint8_t>& bytes, std::vector<TraceEvent>& events, std::string& error);
+  static bool loadBinary(const std::vector<uint8_t>& bytes, std::vector<TraceEvent>& events, std::string& error);
+  static bool loadSMF(const std::vector<uint8_t>& bytes, const TraceOptions& options,
+                      std::vector<TraceEvent>& events, std::string& error);
+  static bool parseLine(const std::string& line, std::vector<TraceEvent>& events, std::string& error);
+};
+
+#endif
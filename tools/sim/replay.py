@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+"""
+Replays every trace in tools/sim/traces through the host simulator and diffs
+the result against the golden output next to it.
+
+    python tools/sim/replay.py              build, replay, report
+    python tools/sim/replay.py --update     rewrite the golden files
+    python tools/sim/replay.py --tolerance 50 traces/foo.trace
+"""
+import argparse
+import glob
+import os
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+TRACES = os.path.join(ROOT, "tools", "sim", "traces")
+
+
+def simulator_path():
+    program = os.path.join(ROOT, ".pio", "build", "sim", "program")
+    return program + ".exe" if sys.platform == "win32" else program
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Replay traces against golden outputs")
+    parser.add_argument("traces", nargs="*", help="trace files (default: tools/sim/traces/*.trace)")
+    parser.add_argument("--update", action="store_true", help="rewrite golden files from this run")
+    parser.add_argument("--tolerance", type=int, default=0, help="allowed timing difference in us")
+    parser.add_argument("--no-build", action="store_true", help="use the existing simulator build")
+    args = parser.parse_args()
+
+    if not args.no_build:
+        subprocess.run(["pio", "run", "-e", "sim"], cwd=ROOT, check=True)
+
+    traces = args.traces or sorted(glob.glob(os.path.join(TRACES, "*.trace")))
+    failed = 0
+    for trace in traces:
+        golden = os.path.splitext(trace)[0] + ".golden"
+        name = os.path.relpath(trace, ROOT)
+
+        if args.update or not os.path.exists(golden):
+            subprocess.run([simulator_path(), "-o", golden, trace], check=True)
+            print("WROTE %s" % os.path.relpath(golden, ROOT))
+            continue
+
+        result = subprocess.run(
+            [simulator_path(), "--golden", golden, "--tolerance", str(args.tolerance), trace],
+            stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+        if result.returncode == 0:
+            print("PASS %s" % name)
+        else:
+            failed += 1
+            print("FAIL %s" % name)
+            print(result.stderr)
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,36 @@
+/**
+ * MIDI BytePulse - Host Simulator TM1637 Interface
+ *
+ * Decodes the TM1637 command stream into digit writes. Each byte costs the
+ * bus time the real bit-banged interface spends on it, so display updates
+ * hold up the main loop in the simulator as they do on hardware.
+ */
+
+#ifndef SIM_ACE_TMI_H
+#define SIM_ACE_TMI_H
+
+#include <Arduino.h>
+
+namespace ace_tmi {
+
+class SimpleTmi1637Interface {
+public:
+  SimpleTmi1637Interface(uint8_t dioPin, uint8_t clkPin, uint8_t delayMicros)
+      : delayMicros(delayMicros) {}
+
+  void begin() {}
+  void end() {}
+  void startCondition();
+  void stopCondition();
+  uint8_t write(uint8_t data);
+
+private:
+  uint8_t delayMicros;
+  uint8_t bytesInFrame = 0;
+  uint8_t address = 0;
+  bool autoIncrement = true;
+};
+
+}
+
+#endif
@@ -0,0 +1,162 @@
+/**
+ * MIDI BytePulse - Host Simulator Arduino Core
+ *
+ * Just enough of the Arduino/AVR API for the firmware sources to build on a
+ * PC. Time, pins, the MIDI UART, Timer1 and the interrupt flag are all
+ * virtual and owned by Sim (tools/sim/Sim.cpp); registers the firmware
+ * reads or writes with side effects are small proxy objects.
+ */
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW  0
+
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define PROGMEM
+#define F(x) x
+#define pgm_read_byte(p)  (*(const uint8_t*)(p))
+#define pgm_read_word(p)  (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(reg, bit) ((reg) & _BV(bit))
+
+#define SIM_PIN_COUNT 32
+
+#define digitalPinToInterrupt(p) (p)
+#define digitalPinToPort(p)      (p)
+#define digitalPinToBitMask(p)   (1)
+#define portOutputRegister(p)    (&simPortOut[p])
+
+extern volatile uint8_t simPortOut[SIM_PIN_COUNT];
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void noInterrupts();
+void interrupts();
+#define cli() noInterrupts()
+#define sei() interrupts()
+
+// Interrupt vectors are plain functions the simulator calls
+#define ISR(vector) extern "C" void vector(void)
+#define TIMER1_COMPA_vect sim_timer1_compa_vect
+
+// USART1
+#define DOR1   3
+#define FE1    4
+#define UDRE1  5
+#define TXC1   6
+#define UDRIE1 5
+
+// Timer1
+#define CS10   0
+#define CS11   1
+#define CS12   2
+#define TOIE1  0
+#define OCIE1A 1
+#define OCIE1B 2
+#define OCF1A  1
+#define OCF1B  2
+
+struct SimRegSREG {
+  operator uint8_t() const;
+  SimRegSREG& operator=(uint8_t value);
+};
+
+struct SimRegUCSR1A {
+  operator uint8_t() const;
+  SimRegUCSR1A& operator=(uint8_t value);   // writing TXC1 clears it
+  SimRegUCSR1A& operator|=(uint8_t value);
+};
+
+struct SimRegUCSR1B {
+  operator uint8_t() const;
+};
+
+struct SimRegUDR1 {
+  SimRegUDR1& operator=(uint8_t value);
+};
+
+struct SimRegTCNT1 {
+  operator uint16_t() const;
+};
+
+extern SimRegSREG SREG;
+extern SimRegUCSR1A UCSR1A;
+extern SimRegUCSR1B UCSR1B;
+extern SimRegUDR1 UDR1;
+extern SimRegTCNT1 TCNT1;
+extern volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+extern volatile uint16_t OCR1A, OCR1B;
+extern volatile uint8_t GPIOR0;
+
+#ifndef SERIAL_RX_BUFFER_SIZE
+#define SERIAL_RX_BUFFER_SIZE 64
+#endif
+#ifndef SERIAL_TX_BUFFER_SIZE
+#define SERIAL_TX_BUFFER_SIZE 64
+#endif
+
+class Print {
+public:
+  virtual size_t write(uint8_t data) = 0;
+  size_t print(const char* text);
+  size_t print(long value);
+  size_t println(const char* text);
+  size_t println(long value);
+  size_t println();
+};
+
+// Serial1 is the DIN MIDI UART; Serial (USB CDC) swallows debug output
+class HardwareSerial : public Print {
+public:
+  explicit HardwareSerial(bool uart) : uart(uart) {}
+  void begin(unsigned long baud);
+  void end() {}
+  int available();
+  int read();
+  int peek();
+  int availableForWrite();
+  size_t write(uint8_t data) override;
+  size_t write(const uint8_t* data, size_t length);
+  void flush();
+  operator bool() { return true; }
+
+private:
+  bool uart;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * MIDI BytePulse - Host Simulator PluggableUSB
+ *
+ * The slice of the Arduino USB core the firmware's USB interfaces use.
+ * Endpoints are numbered in plug order; the OUT endpoint of the USB MIDI
+ * interface reads packets from the trace, and what is written to its IN
+ * endpoint is logged with the virtual time it was handed over.
+ */
+
+#ifndef SIM_PLUGGABLE_USB_H
+#define SIM_PLUGGABLE_USB_H
+
+#include <Arduino.h>
+
+typedef uint8_t EPTYPE_DESCRIPTOR_SIZE;
+
+#define EP_TYPE_BULK_IN              0x81
+#define EP_TYPE_BULK_OUT             0x80
+#define TRANSFER_PGM                 0x80
+#define USB_ENDPOINT_OUT(ep)         ((uint8_t)(ep))
+#define USB_ENDPOINT_IN(ep)          ((uint8_t)((ep) | 0x80))
+#define USB_ENDPOINT_TYPE_BULK       0x02
+#define USB_STRING_DESCRIPTOR_TYPE   3
+#define USB_EP_SIZE                  64
+
+struct USBSetup {
+  uint8_t bmRequestType;
+  uint8_t bRequest;
+  uint8_t wValueL;
+  uint8_t wValueH;
+  uint16_t wIndex;
+  uint16_t wLength;
+};
+
+class PluggableUSBModule {
+public:
+  PluggableUSBModule(uint8_t numEps, uint8_t numIfs, EPTYPE_DESCRIPTOR_SIZE* epType)
+    : numEndpoints(numEps), numInterfaces(numIfs), endpointType(epType) {}
+
+protected:
+  virtual bool setup(USBSetup& setup) = 0;
+  virtual int getInterface(uint8_t* interfaceCount) = 0;
+  virtual int getDescriptor(USBSetup& setup) = 0;
+
+  uint8_t pluggedInterface = 0;
+  uint8_t pluggedEndpoint = 0;
+
+  const uint8_t numEndpoints;
+  const uint8_t numInterfaces;
+  const EPTYPE_DESCRIPTOR_SIZE* endpointType;
+
+  friend class PluggableUSB_;
+};
+
+class PluggableUSB_ {
+public:
+  bool plug(PluggableUSBModule* module);
+};
+
+PluggableUSB_& PluggableUSB();
+
+int USB_SendControl(uint8_t flags, const void* data, int length);
+uint8_t USB_Available(uint8_t ep);
+int USB_Recv(uint8_t ep, void* data, int length);
+uint8_t USB_SendSpace(uint8_t ep);
+int USB_Send(uint8_t ep, const void* data, int length);
+void USB_Flush(uint8_t ep);
+
+#endif
@@ -0,0 +1,22 @@
+/**
+ * MIDI BytePulse - Host Simulator avr/eeprom.h
+ *
+ * 1 KB of virtual EEPROM, erased at the start of every run. A byte write
+ * keeps the EEPROM busy for its real programming time (see Sim.cpp).
+ */
+
+#ifndef SIM_AVR_EEPROM_H
+#define SIM_AVR_EEPROM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define E2END  0x3FF
+
+uint8_t eeprom_read_byte(const uint8_t* address);
+uint16_t eeprom_read_word(const uint16_t* address);
+void eeprom_read_block(void* destination, const void* source, size_t length);
+void eeprom_update_byte(uint8_t* address, uint8_t value);
+bool eeprom_is_ready();
+
+#endif
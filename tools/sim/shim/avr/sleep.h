@@ -0,0 +1,21 @@
+/**
+ * MIDI BytePulse - Host Simulator avr/sleep.h
+ *
+ * sleep_cpu() moves virtual time on to the next event that raises an
+ * interrupt (see Sim::sleep).
+ */
+
+#ifndef SIM_AVR_SLEEP_H
+#define SIM_AVR_SLEEP_H
+
+#define SLEEP_MODE_IDLE  0
+
+void simSetSleepEnabled(bool enabled);
+void simSleep();
+
+#define set_sleep_mode(mode)
+#define sleep_enable()   simSetSleepEnabled(true)
+#define sleep_disable()  simSetSleepEnabled(false)
+#define sleep_cpu()      simSleep()
+
+#endif
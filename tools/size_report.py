@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""
+Post-build size report for the firmware environments: flash and RAM against
+the ATmega32U4 limits, and what each module takes, summed from the symbols of
+the linked image. Printed after every build and written next to the firmware
+as size_report.txt, so two variants can be diffed.
+
+    pio run -e clock
+    diff .pio/build/clock/size_report.txt .pio/build/sparkfun_promicro16/size_report.txt
+"""
+import os
+import subprocess
+
+Import("env")
+
+FLASH_BYTES = 28672   # 32 KB less the 4 KB Caterina bootloader
+RAM_BYTES = 2560
+MODULES_SHOWN = 16
+
+
+def tool(name):
+    toolchain = env.PioPlatform().get_package_dir("toolchain-atmelavr")
+    return os.path.join(toolchain, "bin", name) if toolchain else name
+
+
+def section_sizes(elf):
+    """Bytes per section, from avr-size -A."""
+    output = subprocess.run([tool("avr-size"), "-A", elf],
+                            capture_output=True, text=True, check=True).stdout
+    sizes = {}
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) == 3 and fields[0].startswith(".") and fields[1].isdigit():
+            sizes[fields[0]] = int(fields[1])
+    return sizes
+
+
+def module_sizes(elf):
+    """Flash and RAM per class (the part before '::'), from the symbol table."""
+    output = subprocess.run([tool("avr-nm"), "-C", "-S", "--size-sort", elf],
+                            capture_output=True, text=True, check=True).stdout
+    modules = {}
+    for line in output.splitlines():
+        fields = line.split(None, 3)
+        if len(fields) != 4:
+            continue
+        size, kind, name = int(fields[1], 16), fields[2].lower(), fields[3]
+        module = name.split("::")[0] if "::" in name else "(other)"
+        flash, ram = modules.get(module, (0, 0))
+        if kind in "tr":
+            flash += size
+        elif kind == "d":
+            flash += size
+            ram += size
+        elif kind == "b":
+            ram += size
+        modules[module] = (flash, ram)
+    return modules
+
+
+def report(target, source, env):
+    elf = env.subst("$BUILD_DIR/${PROGNAME}.elf")
+    sizes = section_sizes(elf)
+    flash = sizes.get(".text", 0) + sizes.get(".data", 0)
+    ram = sizes.get(".data", 0) + sizes.get(".bss", 0) + sizes.get(".noinit", 0)
+
+    lines = [
+        "Size report: %s" % env.subst("$PIOENV"),
+        "  flash  %5d / %d bytes (%.1f%%)" % (flash, FLASH_BYTES, 100.0 * flash / FLASH_BYTES),
+        "  RAM    %5d / %d bytes (%.1f%%), %d left for the stack"
+        % (ram, RAM_BYTES, 100.0 * ram / RAM_BYTES, RAM_BYTES - ram),
+        "",
+        "  %-24s %7s %7s" % ("module", "flash", "RAM"),
+    ]
+    modules = sorted(module_sizes(elf).items(), key=lambda item: -(item[1][0] + item[1][1]))
+    for module, (module_flash, module_ram) in modules[:MODULES_SHOWN]:
+        lines.append("  %-24s %7d %7d" % (module[:24], module_flash, module_ram))
+
+    text = "\n".join(lines)
+    print("\n" + text + "\n")
+    with open(env.subst("$BUILD_DIR/size_report.txt"), "w") as out:
+        out.write(text + "\n")
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", report)
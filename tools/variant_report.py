@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""
+Builds every firmware variant and prints one size and latency line per
+variant. Sizes come from the size_report.txt each firmware build writes
+(tools/size_report.py); latencies come from the host simulator built as the
+same variant, running the bridge benchmark.
+
+    python tools/variant_report.py
+    python tools/variant_report.py --scenario clock_under_load
+    python tools/variant_report.py --no-build
+
+Cycle-exact numbers per variant need simavr: pio run -e bench_clock -t bench
+"""
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# (variant, firmware environment, simulator environment)
+VARIANTS = [
+    ("clock", "clock", "sim_clock"),
+    ("bridge", "sparkfun_promicro16", "sim_bridge"),
+    ("instrumented", "instrumented", "sim"),
+]
+
+LATENCY_PATHS = ("clock -> SYNC OUT", "clock -> DIN", "USB -> DIN", "DIN -> USB")
+
+
+def program(environment):
+    path = os.path.join(ROOT, ".pio", "build", environment, "program")
+    return path + ".exe" if sys.platform == "win32" else path
+
+
+def sizes(environment):
+    """(flash, RAM) in bytes from the build's size report, None if missing."""
+    try:
+        with open(os.path.join(ROOT, ".pio", "build", environment, "size_report.txt")) as report:
+            text = report.read()
+    except OSError:
+        return None
+    flash = re.search(r"flash\s+(\d+)", text)
+    ram = re.search(r"RAM\s+(\d+)", text)
+    return (int(flash.group(1)), int(ram.group(1))) if flash and ram else None
+
+
+def latencies(environment, scenario):
+    """p99 and max us per path of one bench scenario."""
+    output = subprocess.run([program(environment), "--bench", scenario],
+                            capture_output=True, text=True, check=True).stdout
+    results = {}
+    for line in output.splitlines():
+        for path in LATENCY_PATHS:
+            if line.strip().startswith(path):
+                fields = line.split()
+                results[path] = (int(fields[-2]), int(fields[-1]))
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Size and latency per build variant")
+    parser.add_argument("--scenario", default="mixed", help="bench scenario (default: mixed)")
+    parser.add_argument("--no-build", action="store_true", help="use the existing builds")
+    args = parser.parse_args()
+
+    if not args.no_build:
+        environments = [env for _, firmware, sim in VARIANTS for env in (firmware, sim)]
+        command = ["pio", "run"]
+        for environment in environments:
+            command += ["-e", environment]
+        subprocess.run(command, cwd=ROOT, check=True)
+
+    print("\nscenario: %s, latencies p99 / max us\n" % args.scenario)
+    header = "%-13s %7s %6s  %s" % ("variant", "flash", "RAM",
+                                    "  ".join("%-17s" % path for path in LATENCY_PATHS))
+    print(header.rstrip())
+    for variant, firmware, sim in VARIANTS:
+        size = sizes(firmware)
+        flash, ram = ("%7d" % size[0], "%6d" % size[1]) if size else ("%7s" % "-", "%6s" % "-")
+        paths = latencies(sim, args.scenario)
+        columns = ["%-17s" % ("%d / %d" % paths[path] if path in paths else "-")
+                   for path in LATENCY_PATHS]
+        print(("%-13s %s %s  %s" % (variant, flash, ram, "  ".join(columns))).rstrip())
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())